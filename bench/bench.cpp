@@ -0,0 +1,1407 @@
+/*
+	Headless benchmarks of the engine's hot paths.
+
+	Builds the game's code without its main and runs fixed scenarios on it: GJK, EPA and support
+	on seeded shapes, .anims and number parsing, animation stepping, and recording and drawing
+	sprites with SDL's software renderer into a surface, so neither a window nor a GPU is needed.
+	Every benchmark warms up, then times each repetition on its own and reports the min, median
+	and p99 of them.
+
+	The subsystems get their own at the scale they are meant to hold up at:
+		array/vector/slot map	push, iteration and churn (swap removes and adds) of 64k items,
+								ren_array.h against std::vector
+		small array/vector		8k lists of 8 items filled from empty and churned, Small_Array
+								inline against std::vector on the heap
+		entities 10k/100k		a tick of movement and animation, then recording the sprites
+		animation 100k			advance_animations over a flat array of playbacks
+		projectiles				16k projectiles moved and swept against 1k colliders
+		flow field 256/1024		a flow field over a whole cave grid of that size, moving goal
+		flow field near			the same on the 1024 one, only out to the AI's aggro distance like
+								the game's, per cell it reaches
+		flow agents				1k agents following the 1024 one
+		jps 256/1024			paths to the middle of the caves from cells that reach it
+		tile edit/draw			an edit recorded and drawn with its chunk rebuilt, and the view
+								of the 1024 caves drawn from the chunk cache
+		snapshot/restore/resim	of a stress scene of 1k actors, resim reports per tick simulated again
+		jobs empty				a queue full of jobs that do nothing, run and waited for
+		jobs parallel_for		a parallel_for over 1M values that only touch their own
+	They build what they run on the first time they are picked, so --filter only pays for those.
+
+	Run it from the repository root, it reads the .anims files and sprite sheets from data/:
+		bench [--filter name] [--warmup N] [--reps N] [--workers N]
+		      [--json results.json] [--baseline baseline.json] [--tolerance 0.1]
+
+	--workers sizes the job system the benchmarks run on, 1 by default. How the jobs scale is a
+	sweep over it:
+		bench --filter jobs --workers 1, then 2, 4 and so on up to the cores, each with --json
+
+	--json writes the results, a file written that way is also what --baseline reads back. A
+	benchmark whose median is more than the tolerance slower than in the baseline is reported
+	as a regression and makes bench exit with 1.
+
+	Instead of the benchmarks, --sweep measures stress scenes (see stress.h) of 1, 2, 4 and so on
+	up to the configured number of actors, with as many colliders and projectiles each time:
+		bench --sweep [actors=16384,colliders=1024,projectiles=4096,density=64,seed=1]
+		      [--warmup N] [--reps N] [--workers N] [--csv sweep.csv]
+	Every size gets its own world, which is stepped with the game's simulate_tick, then recorded
+	and drawn like a frame. The log has the medians next to how much they grew since half the
+	actors, where 2x is linear, and --csv writes the same to chart.
+*/
+
+#define SDL_MAIN_HANDLED
+#define NO_GAME_MAIN
+#include "main.cpp"
+
+#include <vector>
+
+constexpr u64 BENCH_SEED = 0x5eed;
+constexpr i32 BENCH_SHAPES = 4096;
+constexpr i32 BENCH_SPRITES = 4096;
+constexpr i32 BENCH_NUMBERS = 16384;
+constexpr i32 BENCH_ANIMS_PARSES = 64;		// of each file per repetition
+constexpr i32 MAX_BENCH_REPS = 10000;
+
+constexpr i32 BENCH_ITEMS = 65536;
+constexpr i32 BENCH_CHURN = 1024;			// items removed and added per repetition
+constexpr i32 BENCH_SMALL_ARRAYS = 8192;
+constexpr i32 BENCH_SMALL_ITEMS = 8;		// what a Small_Array holds inline
+constexpr i32 BENCH_CROWDS[] = { 10000, 100000 };
+constexpr i32 BENCH_PLAYBACKS = 100000;
+constexpr i32 BENCH_PROJECTILES = 16384;
+constexpr i32 BENCH_COLLIDERS = 1024;
+constexpr i32 BENCH_NAV_SIZES[] = { 256, 1024 };	// cells on a side
+constexpr i32 BENCH_AGENTS = 1024;
+constexpr i32 BENCH_PATHS = 16;				// per repetition
+constexpr i32 BENCH_PATH_POINTS = 4096;
+constexpr i32 BENCH_RESIM_TICKS = 32;
+constexpr u32 BENCH_JOB_VALUES = 1 << 20;
+constexpr u32 BENCH_JOB_ROUNDS = 16;		// of work per value
+constexpr Stress_Config BENCH_SIM_CONFIG = { BENCH_SEED, 1024, 256, 1024, 64.f };
+
+// What a container holds for the container benchmarks, about the size of a small component
+struct Bench_Item {
+	V2 pos;
+	V2 vel;
+	u32 entity;
+	r32 age;
+};
+
+typedef Small_Array<Bench_Item, BENCH_SMALL_ITEMS> Bench_Small_Array;
+
+struct Bench_Crowd {
+	World world;
+	Previous_Positions previous;
+};
+
+// Caves of one of BENCH_NAV_SIZES, the grid lines up with the map
+struct Bench_Nav {
+	Tilemap map;
+	Nav_Grid grid;
+	Flow_Field field;
+	Flow_Field near;	// stops at the AI's aggro distance, like the game's
+	V2i middle;			// cell, cleared of walls
+	V2 *starts;			// BENCH_AGENTS points the middle can be reached from
+};
+
+// A simulation like the game's on an empty level, with a stress scene around the player
+struct Bench_Sim {
+	World world;
+	Projectile_Pool projectiles;
+	Projectile_Pool effects;
+	Tilemap level;
+	Static_Geometry level_collision;
+	Nav_Grid grid;
+	Flow_Field_Builder flow_builder;
+	Previous_Positions previous;
+	Stress_Scene stress;
+	Simulation sim;
+};
+
+// Everything the benchmarks run on, built from BENCH_SEED
+struct Bench_Scene {
+	Random_Series random;
+
+	Rect *rects;
+	Circle *circles;
+	Polygon *polygons;
+	Capsule *capsules;
+	V2 *directions;
+	V2 *epa_points;
+
+	String anims[2];
+	String numbers;
+
+	Job_System jobs;
+	World world;
+	Previous_Positions previous;
+	Animation *animations[2];
+	u32 ticks;
+
+	SDL_Surface *surface;
+	SDL_Renderer *renderer;
+	Render_Thread render;
+	Render_List *record_list;
+	Render_List *draw_list;		// recorded once, drawn every repetition
+
+	// the rest is built by the setups of the benchmarks that need it, in arena
+	Memory_Arena arena;
+
+	Array<Bench_Item> items;
+	std::vector<Bench_Item> vector_items;
+	Slot_Map<Bench_Item> slot_items;
+	Handle *slot_handles;
+	Bench_Small_Array *small_arrays;
+
+	Bench_Crowd *crowds[ArrayCount(BENCH_CROWDS)];
+	Render_List crowd_list;
+	Animation_Playback *playbacks;
+
+	World *targets;				// colliders for the projectiles
+	Projectile_Pool *projectiles;
+	Stress_Scene *projectile_scene;
+	Projectile_Hit *hits;
+
+	Bench_Nav *navs[ArrayCount(BENCH_NAV_SIZES)];
+	V2 *agents;
+	Nav_Path path;
+
+	Bench_Sim *sim;
+
+	Job *empty_jobs;			// JOB_QUEUE_SIZE of them
+	r32 *job_values;
+	Sim_History history;
+};
+
+// Returns how many operations it did, which the timings get divided by
+typedef i32 Bench_Proc(Bench_Scene *scene);
+// Builds what a benchmark runs on, before its warmup
+typedef void Bench_Setup(Bench_Scene *scene);
+
+struct Benchmark {
+	const char *name;
+	Bench_Proc *proc;
+	Bench_Setup *setup;
+};
+
+struct Bench_Result {
+	const char *name;
+	i32 reps;
+	i32 ops;
+	r64 min_ms;
+	r64 median_ms;
+	r64 p99_ms;
+	r64 mean_ms;
+};
+
+// results end up here so that the compiler can't drop the work, logged at the end as a checksum
+// that stays the same from run to run with the same arguments
+u64 bench_sink;
+
+////////////////////////////////////////
+//				Scene
+
+V2 random_point(Random_Series *random, r32 extent)
+{
+	return V2(random_between(random, -extent, extent), random_between(random, -extent, extent));
+}
+
+// Shapes of 20 to 80 units in a 600 unit square, about a third of the pairs overlap
+void build_shapes(Bench_Scene *scene, Memory_Arena *arena)
+{
+	Random_Series *random = &scene->random;
+	scene->rects = PushArrayNoZero(arena, Rect, BENCH_SHAPES);
+	scene->circles = PushArrayNoZero(arena, Circle, BENCH_SHAPES);
+	scene->polygons = PushArrayNoZero(arena, Polygon, BENCH_SHAPES + 1);
+	scene->capsules = PushArrayNoZero(arena, Capsule, BENCH_SHAPES);
+	scene->directions = PushArrayNoZero(arena, V2, BENCH_SHAPES);
+	scene->epa_points = PushArrayNoZero(arena, V2, EPA_MAX_POINTS);
+	constexpr r32 extent = 300.f;
+	for (i32 i = 0; i < BENCH_SHAPES; ++i) {
+		V2 pos = random_point(random, extent);
+		V2 size = V2(random_between(random, 20.f, 80.f), random_between(random, 20.f, 80.f));
+		scene->rects[i] = { pos, pos + size };
+		scene->circles[i] = { random_point(random, extent), random_between(random, 10.f, 40.f) };
+		V2 a = random_point(random, extent);
+		scene->capsules[i] = { a, a + random_point(random, 40.f), random_between(random, 5.f, 20.f) };
+		r32 angle = random_between(random, 0, 2 * PI32);
+		scene->directions[i] = V2(cosf(angle), sinf(angle));
+	}
+	for (i32 i = 0; i <= BENCH_SHAPES; ++i) {
+		make_polygon(&scene->polygons[i], 3 + random_choice(random, MAX_POINTS - 2), random_between(random, 10.f, 40.f),
+					 random_between(random, 0, PI32));
+		scene->polygons[i].pos = random_point(random, extent);
+	}
+}
+
+// Lines of "int,float" to parse
+String build_numbers(Bench_Scene *scene, Memory_Arena *arena)
+{
+	constexpr i32 max_line = 32;
+	char *text = PushArrayNoZero(arena, char, BENCH_NUMBERS * max_line + 1);
+	imem length = 0;
+	for (i32 i = 0; i < BENCH_NUMBERS; ++i) {
+		length += SDL_snprintf(text + length, max_line, "%d,%.3f\n", (i32) (random_next(&scene->random) % 100000) - 50000,
+							   random_between(&scene->random, -1000.f, 1000.f));
+	}
+	return String(text, length);
+}
+
+void bench_scene_init(Bench_Scene *scene, i32 workers)
+{
+	*scene = {};
+	scene->random = random_seed(BENCH_SEED);
+	build_shapes(scene, &permanent_arena);
+	scene->numbers = build_numbers(scene, &permanent_arena);
+	scene->anims[0] = read_entire_file(&permanent_arena, "./data/player.anims");
+	scene->anims[1] = read_entire_file(&permanent_arena, "./data/enemy.anims");
+
+	resolution = V2(1280, 720);
+	scene->surface = SDL_CreateRGBSurfaceWithFormat(0, (i32) resolution.x, (i32) resolution.y, 32, SDL_PIXELFORMAT_RGBA32);
+	if (!scene->surface)
+		fatal_error(SDL_GetError());
+	scene->renderer = SDL_CreateSoftwareRenderer(scene->surface);
+	if (!scene->renderer)
+		fatal_error(SDL_GetError());
+	SDL_SetRenderDrawBlendMode(scene->renderer, SDL_BLENDMODE_BLEND);
+	render_thread_init(&scene->render, scene->renderer, &render_arena, &frame_arena, false);
+	scene->record_list = &scene->render.frames[0].list;
+	scene->draw_list = &scene->render.frames[1].list;
+
+	scene->animations[0] = parse_animation_file(scene->renderer, "./data/player.anims", player_animation_names, COUNT_PLAYER_ANIMATION);
+	scene->animations[1] = parse_animation_file(scene->renderer, "./data/enemy.anims", enemy_animation_names, COUNT_ENEMY_ANIMATION);
+
+	// sprites all over the screen, half of them players and half enemies, at different points
+	// of their animations
+	job_system_init(&scene->jobs, &permanent_arena, workers);
+	world_init(&scene->world, &world_arena);
+	previous_positions_init(&scene->previous, &world_arena, BENCH_SPRITES);
+	for (i32 i = 0; i < BENCH_SPRITES; ++i) {
+		Animation *animation = scene->animations[i & 1];
+		Entity entity = create_entity(&scene->world);
+		V2 pos = V2(random_between(&scene->random, -resolution.x / 2, resolution.x / 2),
+					random_between(&scene->random, -resolution.y / 2, resolution.y / 2));
+		add_component(&scene->world, &scene->world.transforms, entity, { pos, V2(48.f, 48.f) });
+		Animation_Playback playback = make_animation_playback(animation);
+		playback.time = random_between(&scene->random, 0, animation->frame_duration);
+		add_component(&scene->world, &scene->world.sprites, entity, { playback, (i & 2) != 0 });
+	}
+	save_previous_positions(&scene->previous, &scene->world.transforms);
+	render_sprites(scene->draw_list, &scene->world, &scene->previous, 1.f);
+
+	arena_create(&scene->arena, Megabytes(512), "bench", MEMORY_TAG_ENTITIES);
+}
+
+void bench_scene_shutdown(Bench_Scene *scene)
+{
+	job_system_shutdown(&scene->jobs);
+	render_thread_shutdown(&scene->render, nullptr);
+	SDL_DestroyRenderer(scene->renderer);
+	SDL_FreeSurface(scene->surface);
+}
+
+// Like the game's setup on an empty level, with the stress scene around the player. sim points
+// into bench, which has to stay where it is
+void bench_sim_init(Bench_Sim *bench, Bench_Scene *scene, Stress_Config *config, Memory_Arena *arena)
+{
+	World *world = &bench->world;
+	world_init(world, arena);
+	projectile_pool_init(&bench->projectiles, arena, (u32) config->projectiles + 1024);
+	projectile_pool_init(&bench->effects, arena, 16384);
+	tilemap_init(&bench->level, arena, 32, 32, V2(-16.f * TILE_CHUNK_PIXELS), 1);
+	static_geometry_init(&bench->level_collision, arena, &bench->level);
+	Nav_Grid *grid = &bench->grid;
+	nav_grid_init(grid, arena, bench->level.width, bench->level.height, (r32) TILE_SIZE, bench->level.origin);
+	flow_field_builder_init(&bench->flow_builder, arena, grid, (u32) (AI_AGGRO_DISTANCE / grid->cell_size) * NAV_DIAGONAL_COST, false);
+	previous_positions_init(&bench->previous, arena, world->transforms.capacity);
+
+	Animation *player_animation = scene->animations[0];
+	Animation *enemy_animation = scene->animations[1];
+	Entity player = create_entity(world);
+	add_component(world, &world->transforms, player, { V2(), V2(3.f * player_animation->width, 3.f * player_animation->height) });
+	add_component(world, &world->velocities, player, { V2(), V2(), 250.f });
+	add_component(world, &world->sprites, player, { make_animation_playback(player_animation), false });
+	add_component(world, &world->colliders, player, { COLLIDER_CAPSULE, V2(0.5f, 0.375f), V2(0.5f, 0.775f), 0.2f });
+	Entity enemy = spawn_enemy(world, enemy_animation, V2(400.f, 0));
+	spawn_stress_scene(&bench->stress, config, world, &bench->projectiles, scene->animations, ArrayCount(scene->animations),
+					   enemy_animation, V2());
+
+	constexpr i32 max_hits = 1024;
+	Simulation *sim = &bench->sim;
+	*sim = {};
+	sim->state.player = player;
+	sim->state.enemy = enemy;
+	sim->state.random = random_seed(config->seed);
+	// every brain that is due thinks, so that the step times don't depend on a time budget
+	ai_scheduler_init(&sim->state.ai, 0.f);
+	make_polygon(&sim->state.poly, 3, 500);
+	sim->state.poly.pos = V2(0, 150);
+	sim->world = world;
+	sim->jobs = &scene->jobs;
+	sim->projectiles = &bench->projectiles;
+	sim->effects = &bench->effects;
+	sim->level = &bench->level_collision;
+	sim->flow_builder = &bench->flow_builder;
+	sim->grid = grid;
+	sim->player_animation = player_animation;
+	sim->enemy_animation = enemy_animation;
+	sim->view_size = resolution;
+	sim->scratch = &frame_arena;
+	sim->epa_points = PushArrayNoZero(arena, V2, EPA_MAX_POINTS);
+	sim->hits = PushArrayNoZero(arena, Projectile_Hit, max_hits);
+	sim->max_hits = max_hits;
+}
+
+//				Scene
+////////////////////////////////////////
+
+////////////////////////////////////////
+//				Benchmarks
+
+i32 bench_gjk(Bench_Scene *scene)
+{
+	u64 hits = 0;
+	for (i32 i = 0; i < BENCH_SHAPES; ++i) {
+		hits += gjk(scene->rects[i], scene->circles[i]);
+		hits += gjk(scene->polygons[i], scene->capsules[i]);
+		hits += gjk(scene->polygons[i], scene->polygons[i + 1]);
+		hits += gjk(scene->capsules[i], scene->rects[i]);
+	}
+	bench_sink += hits;
+	return 4 * BENCH_SHAPES;
+}
+
+i32 bench_epa(Bench_Scene *scene)
+{
+	r32 depth = 0;
+	V2 distance;
+	for (i32 i = 0; i < BENCH_SHAPES; ++i) {
+		if (epa(scene->rects[i], scene->circles[i], distance, scene->epa_points, EPA_MAX_POINTS))
+			depth += distance.x + distance.y;
+		if (epa(scene->polygons[i], scene->capsules[i], distance, scene->epa_points, EPA_MAX_POINTS))
+			depth += distance.x + distance.y;
+		if (epa(scene->polygons[i], scene->polygons[i + 1], distance, scene->epa_points, EPA_MAX_POINTS))
+			depth += distance.x + distance.y;
+		if (epa(scene->capsules[i], scene->rects[i], distance, scene->epa_points, EPA_MAX_POINTS))
+			depth += distance.x + distance.y;
+	}
+	bench_sink += (u64) depth;
+	return 4 * BENCH_SHAPES;
+}
+
+i32 bench_support(Bench_Scene *scene)
+{
+	V2 sum = {};
+	for (i32 j = 0; j < 4; ++j) {
+		for (i32 i = 0; i < BENCH_SHAPES; ++i) {
+			V2 direction = scene->directions[(i + j) & (BENCH_SHAPES - 1)];
+			sum = sum + support(scene->polygons[i], direction);
+			sum = sum + support(scene->capsules[i], direction);
+		}
+	}
+	bench_sink += (u64) (sum.x + sum.y);
+	return 8 * BENCH_SHAPES;
+}
+
+i32 bench_parse_anims(Bench_Scene *scene)
+{
+	static Animation_Desc desc;
+	for (i32 i = 0; i < BENCH_ANIMS_PARSES; ++i) {
+		for (String file : scene->anims) {
+			if (parse_animation_desc(file, &desc))
+				fatal_error("Could not parse an .anims file");
+			bench_sink += desc.frame_count;
+		}
+	}
+	return 2 * BENCH_ANIMS_PARSES;
+}
+
+i32 bench_parse_numbers(Bench_Scene *scene)
+{
+	String text = scene->numbers;
+	i64 ints = 0;
+	r64 floats = 0;
+	while (text.len > 0) {
+		String line = string_trim(string_chop_by_delim(&text, '\n'));
+		ints += string_parse_i32(string_trim(string_chop_by_delim(&line, ',')));
+		floats += string_parse_r32(string_trim(line));
+	}
+	bench_sink += ints + (u64) floats;
+	return BENCH_NUMBERS;
+}
+
+// A tick of animation for every sprite, with a sixteenth of them asked to attack
+i32 bench_animation(Bench_Scene *scene)
+{
+	Component_Pool<Sprite> *sprites = &scene->world.sprites;
+	for (u32 i = scene->ticks++ & 15; i < sprites->count; i += 16) {
+		Animation_Playback *playback = &sprites->data[i].playback;
+		i32 name = playback->animation == scene->animations[0] ? (i32) PLAYER_ANIMATION_ATK1 : (i32) ENEMY_ANIMATION_ATK;
+		play_animation(playback, animation_state(playback->animation, name), ANIMATION_ONE_SHOT | ANIMATION_UNINTERRUPTIBLE);
+	}
+	update_sprites(&scene->jobs, &scene->world, 0.01f);
+	return (i32) sprites->count;
+}
+
+i32 bench_record_sprites(Bench_Scene *scene)
+{
+	reset_render_list(scene->record_list);
+	render_sprites(scene->record_list, &scene->world, &scene->previous, 0.5f);
+	return (i32) scene->record_list->count;
+}
+
+i32 bench_draw_sprites(Bench_Scene *scene)
+{
+	execute_render_list(&scene->render, scene->draw_list);
+	return (i32) scene->draw_list->count;
+}
+
+////////////////////////////////////////
+//				Containers
+
+inline Bench_Item make_bench_item(Random_Series *random, u32 entity)
+{
+	return { random_point(random, 1000.f), random_point(random, 100.f), entity, 0.f };
+}
+
+inline r32 step_bench_item(Bench_Item *item)
+{
+	item->pos += item->vel * 0.01f;
+	item->age += 0.01f;
+	return item->pos.x;
+}
+
+// The same BENCH_ITEMS in each container
+void setup_containers(Bench_Scene *scene)
+{
+	if (scene->small_arrays)
+		return;
+	Random_Series random = random_seed(BENCH_SEED);
+	array_init(&scene->items, heap_allocator(MEMORY_TAG_ENTITIES), BENCH_ITEMS);
+	scene->vector_items.reserve(BENCH_ITEMS);
+	slot_map_init(&scene->slot_items, heap_allocator(MEMORY_TAG_ENTITIES), BENCH_ITEMS);
+	scene->slot_handles = PushArrayNoZero(&scene->arena, Handle, BENCH_ITEMS);
+	for (i32 i = 0; i < BENCH_ITEMS; ++i) {
+		Bench_Item item = make_bench_item(&random, (u32) i);
+		array_add(&scene->items, item);
+		scene->vector_items.push_back(item);
+		scene->slot_handles[i] = slot_map_add(&scene->slot_items, item);
+	}
+	// one item short of full, so that the churn stays inline
+	scene->small_arrays = PushArray(&scene->arena, Bench_Small_Array, BENCH_SMALL_ARRAYS);
+	for (i32 i = 0; i < BENCH_SMALL_ARRAYS; ++i) {
+		for (i32 j = 0; j < BENCH_SMALL_ITEMS - 1; ++j) {
+			array_add(&scene->small_arrays[i], make_bench_item(&random, (u32) i));
+		}
+	}
+}
+
+// From empty, so that the growth is part of it
+i32 bench_array_push(Bench_Scene *scene)
+{
+	Array<Bench_Item> items;
+	array_init(&items, heap_allocator(MEMORY_TAG_ENTITIES));
+	for (i32 i = 0; i < BENCH_ITEMS; ++i) {
+		array_add(&items, { V2((r32) i), V2(1.f), (u32) i, 0.f });
+	}
+	bench_sink += items.count;
+	array_free(&items);
+	return BENCH_ITEMS;
+}
+
+i32 bench_vector_push(Bench_Scene *scene)
+{
+	std::vector<Bench_Item> items;
+	for (i32 i = 0; i < BENCH_ITEMS; ++i) {
+		items.push_back({ V2((r32) i), V2(1.f), (u32) i, 0.f });
+	}
+	bench_sink += items.size();
+	return BENCH_ITEMS;
+}
+
+i32 bench_array_iterate(Bench_Scene *scene)
+{
+	r32 sum = 0;
+	for (Bench_Item &item : scene->items) {
+		sum += step_bench_item(&item);
+	}
+	bench_sink += (u64) sum;
+	return (i32) scene->items.count;
+}
+
+i32 bench_vector_iterate(Bench_Scene *scene)
+{
+	r32 sum = 0;
+	for (Bench_Item &item : scene->vector_items) {
+		sum += step_bench_item(&item);
+	}
+	bench_sink += (u64) sum;
+	return (i32) scene->vector_items.size();
+}
+
+// Short lists that come and go, like the contacts of a collider or the targets of an attack
+i32 bench_small_array_push(Bench_Scene *scene)
+{
+	u64 count = 0;
+	for (i32 i = 0; i < BENCH_SMALL_ARRAYS; ++i) {
+		Bench_Small_Array items = {};
+		for (i32 j = 0; j < BENCH_SMALL_ITEMS; ++j) {
+			array_add(&items, { V2((r32) j), V2(1.f), (u32) i, 0.f });
+		}
+		count += items.count;
+		array_free(&items);
+	}
+	bench_sink += count;
+	return BENCH_SMALL_ARRAYS * BENCH_SMALL_ITEMS;
+}
+
+i32 bench_small_vector_push(Bench_Scene *scene)
+{
+	u64 count = 0;
+	for (i32 i = 0; i < BENCH_SMALL_ARRAYS; ++i) {
+		std::vector<Bench_Item> items;
+		for (i32 j = 0; j < BENCH_SMALL_ITEMS; ++j) {
+			items.push_back({ V2((r32) j), V2(1.f), (u32) i, 0.f });
+		}
+		count += items.size();
+	}
+	bench_sink += count;
+	return BENCH_SMALL_ARRAYS * BENCH_SMALL_ITEMS;
+}
+
+// A swap remove and an add in every list, then a pass over it
+i32 bench_small_array_churn(Bench_Scene *scene)
+{
+	Random_Series random = random_seed(BENCH_SEED);
+	r32 sum = 0;
+	for (i32 i = 0; i < BENCH_SMALL_ARRAYS; ++i) {
+		Bench_Small_Array *items = &scene->small_arrays[i];
+		array_remove_unordered(items, random_choice(&random, (i32) items->count));
+		array_add(items, make_bench_item(&random, (u32) i));
+		for (Bench_Item &item : *items) {
+			sum += step_bench_item(&item);
+		}
+	}
+	bench_sink += (u64) sum;
+	return BENCH_SMALL_ARRAYS * BENCH_SMALL_ITEMS;
+}
+
+// Entities dying and spawning: swap removes at random and as many adds, then a pass over all of
+// them. Every repetition and container churns the same indices
+i32 bench_array_churn(Bench_Scene *scene)
+{
+	Array<Bench_Item> *items = &scene->items;
+	Random_Series random = random_seed(BENCH_SEED);
+	for (i32 i = 0; i < BENCH_CHURN; ++i) {
+		i32 index = random_choice(&random, (i32) items->count);
+		array_remove_unordered(items, index);
+		array_add(items, make_bench_item(&random, (u32) index));
+	}
+	bench_array_iterate(scene);
+	return BENCH_CHURN + (i32) items->count;
+}
+
+i32 bench_vector_churn(Bench_Scene *scene)
+{
+	std::vector<Bench_Item> *items = &scene->vector_items;
+	Random_Series random = random_seed(BENCH_SEED);
+	for (i32 i = 0; i < BENCH_CHURN; ++i) {
+		i32 index = random_choice(&random, (i32) items->size());
+		(*items)[index] = items->back();
+		items->pop_back();
+		items->push_back(make_bench_item(&random, (u32) index));
+	}
+	bench_vector_iterate(scene);
+	return BENCH_CHURN + (i32) items->size();
+}
+
+// Through handles, which is how entities would hold on to them
+i32 bench_slot_map_churn(Bench_Scene *scene)
+{
+	Slot_Map<Bench_Item> *map = &scene->slot_items;
+	Random_Series random = random_seed(BENCH_SEED);
+	for (i32 i = 0; i < BENCH_CHURN; ++i) {
+		i32 index = random_choice(&random, BENCH_ITEMS);
+		slot_map_remove(map, scene->slot_handles[index]);
+		scene->slot_handles[index] = slot_map_add(map, make_bench_item(&random, (u32) index));
+	}
+	r32 sum = 0;
+	for (Bench_Item &item : map->items) {
+		sum += step_bench_item(&item);
+	}
+	bench_sink += (u64) sum;
+	return BENCH_CHURN + (i32) map->items.count;
+}
+
+//				Containers
+////////////////////////////////////////
+
+////////////////////////////////////////
+//				Entities
+
+// Wandering actors like the stress scene's, 64 per screen
+void spawn_crowd(Bench_Crowd *crowd, Bench_Scene *scene, Memory_Arena *arena, i32 count)
+{
+	World *world = &crowd->world;
+	world_init(world, arena);
+	previous_positions_init(&crowd->previous, arena, count);
+	r32 extent = sqrtf(count / 64.f * resolution.x * resolution.y) / 2.f;
+	for (i32 i = 0; i < count; ++i) {
+		Animation *animation = scene->animations[i & 1];
+		Entity actor = create_entity(world);
+		r32 angle = random_between(&scene->random, 0, 2 * PI32);
+		Animation_Playback playback = make_animation_playback(animation);
+		playback.time = random_between(&scene->random, 0, animation->frame_duration);
+		add_component(world, &world->transforms, actor, { random_point(&scene->random, extent), V2(48.f, 48.f) });
+		add_component(world, &world->velocities, actor, { V2(), V2(cosf(angle), sinf(angle)), random_between(&scene->random, 50.f, 200.f) });
+		add_component(world, &world->sprites, actor, { playback, angle > PI32 / 2 && angle < 3 * PI32 / 2 });
+	}
+	save_previous_positions(&crowd->previous, &world->transforms);
+}
+
+void setup_crowds(Bench_Scene *scene)
+{
+	if (scene->crowds[0])
+		return;
+	for (i32 i = 0; i < (i32) ArrayCount(BENCH_CROWDS); ++i) {
+		scene->crowds[i] = PushStruct(&scene->arena, Bench_Crowd);
+		spawn_crowd(scene->crowds[i], scene, &scene->arena, BENCH_CROWDS[i]);
+	}
+	// the game's list would drop most of the larger crowd
+	render_list_init(&scene->crowd_list, &scene->arena, (u32) BENCH_CROWDS[ArrayCount(BENCH_CROWDS) - 1], Megabytes(1), "bench crowd");
+}
+
+// What a tick and a frame do with each of them, except for drawing, which "draw sprites" covers
+i32 run_crowd(Bench_Scene *scene, Bench_Crowd *crowd)
+{
+	World *world = &crowd->world;
+	save_previous_positions(&crowd->previous, &world->transforms);
+	integrate_velocities(world, 0.01f);
+	update_sprites(&scene->jobs, world, 0.01f);
+	reset_render_list(&scene->crowd_list);
+	render_sprites(&scene->crowd_list, world, &crowd->previous, 0.5f);
+	bench_sink += scene->crowd_list.count;
+	return (i32) world->sprites.count;
+}
+
+i32 bench_entities_10k(Bench_Scene *scene)
+{
+	return run_crowd(scene, scene->crowds[0]);
+}
+
+i32 bench_entities_100k(Bench_Scene *scene)
+{
+	return run_crowd(scene, scene->crowds[1]);
+}
+
+void setup_playbacks(Bench_Scene *scene)
+{
+	if (scene->playbacks)
+		return;
+	scene->playbacks = PushArrayNoZero(&scene->arena, Animation_Playback, BENCH_PLAYBACKS);
+	for (i32 i = 0; i < BENCH_PLAYBACKS; ++i) {
+		Animation *animation = scene->animations[i & 1];
+		scene->playbacks[i] = make_animation_playback(animation);
+		scene->playbacks[i].time = random_between(&scene->random, 0, animation->frame_duration);
+	}
+}
+
+i32 bench_animation_100k(Bench_Scene *scene)
+{
+	advance_animations(Array_View<Animation_Playback>(scene->playbacks, BENCH_PLAYBACKS), 0.01f);
+	bench_sink += scene->playbacks[scene->ticks++ % BENCH_PLAYBACKS].frame;
+	return BENCH_PLAYBACKS;
+}
+
+//				Entities
+////////////////////////////////////////
+
+////////////////////////////////////////
+//				Projectiles
+
+// A stress scene of nothing but colliders and projectiles
+void setup_projectiles(Bench_Scene *scene)
+{
+	if (scene->projectiles)
+		return;
+	Stress_Config config = { BENCH_SEED, 0, BENCH_COLLIDERS, BENCH_PROJECTILES, 64.f };
+	scene->targets = PushStruct(&scene->arena, World);
+	scene->projectiles = PushStruct(&scene->arena, Projectile_Pool);
+	scene->projectile_scene = PushStruct(&scene->arena, Stress_Scene);
+	scene->hits = PushArrayNoZero(&scene->arena, Projectile_Hit, BENCH_PROJECTILES);
+	world_init(scene->targets, &scene->arena);
+	projectile_pool_init(scene->projectiles, &scene->arena, BENCH_PROJECTILES);
+	spawn_stress_scene(scene->projectile_scene, &config, scene->targets, scene->projectiles, scene->animations,
+					   ArrayCount(scene->animations), scene->animations[1], V2());
+}
+
+// A tick of them, with the ones that expired or hit something brought back first
+i32 bench_projectiles(Bench_Scene *scene)
+{
+	Projectile_Pool *pool = scene->projectiles;
+	refill_stress_projectiles(scene->projectile_scene, pool);
+	i32 count = (i32) pool->count;
+	move_projectiles(pool, 0.01f);
+	bench_sink += collide_projectiles(pool, scene->targets, &frame_arena, 0.01f, scene->hits, BENCH_PROJECTILES);
+	remove_expired_projectiles(pool);
+	return count;
+}
+
+//				Projectiles
+////////////////////////////////////////
+
+////////////////////////////////////////
+//				Navigation
+
+// Cells the flow field of nav reaches, it has to be built towards the middle
+void pick_reached_points(Bench_Nav *nav, Random_Series *random, V2 *points, i32 count)
+{
+	for (i32 i = 0; i < count; ) {
+		V2i cell = V2i(random_choice(random, nav->grid.width), random_choice(random, nav->grid.height));
+		if (nav->field.directions[cell.y * nav->grid.width + cell.x] != NAV_NO_DIRECTION)
+			points[i++] = nav_cell_center(&nav->grid, cell);
+	}
+}
+
+// Caves with the middle cleared, one per size, and the agents in the largest one
+void setup_navs(Bench_Scene *scene)
+{
+	if (scene->navs[0])
+		return;
+	Memory_Arena *arena = &scene->arena;
+	for (i32 i = 0; i < (i32) ArrayCount(BENCH_NAV_SIZES); ++i) {
+		i32 chunks = BENCH_NAV_SIZES[i] / TILE_CHUNK_SIZE;
+		Bench_Nav *nav = scene->navs[i] = PushStruct(arena, Bench_Nav);
+		tilemap_init(&nav->map, arena, chunks, chunks, V2(), chunks * chunks);
+		make_all_chunks_resident(&nav->map);
+		nav_grid_init(&nav->grid, arena, nav->map.width, nav->map.height, (r32) TILE_SIZE, nav->map.origin);
+		nav->middle = V2i(nav->map.width / 2, nav->map.height / 2);
+		generate_cave_tilemap(&nav->map, arena, &scene->random, 0.45f, 5, nav_cell_center(&nav->grid, nav->middle), 8.f * TILE_SIZE);
+		tiles_to_nav_grid(&nav->map, &nav->grid, V2i(0, 0), V2i(nav->map.width - 1, nav->map.height - 1));
+		flow_field_init(&nav->field, arena, &nav->grid, NAV_UNREACHED);
+		build_flow_field(&nav->field, &nav->grid, nav->middle);
+		flow_field_init(&nav->near, arena, &nav->grid, (u32) (AI_AGGRO_DISTANCE / TILE_SIZE) * NAV_DIAGONAL_COST);
+		nav->starts = PushArrayNoZero(arena, V2, BENCH_AGENTS);
+		pick_reached_points(nav, &scene->random, nav->starts, BENCH_AGENTS);
+	}
+
+	// they walk, the paths keep starting from where they started
+	scene->agents = PushArrayNoZero(arena, V2, BENCH_AGENTS);
+	SDL_memcpy(scene->agents, scene->navs[ArrayCount(BENCH_NAV_SIZES) - 1]->starts, BENCH_AGENTS * sizeof(V2));
+	scene->path.points = PushArrayNoZero(arena, V2, BENCH_PATH_POINTS);
+	scene->path.capacity = BENCH_PATH_POINTS;
+}
+
+// The goal steps around the middle, so that no two builds in a row are the same
+i32 run_flow_field(Bench_Scene *scene, Bench_Nav *nav)
+{
+	V2i goal = nav->middle + V2i((i32) (scene->ticks++ & 3), 0);
+	build_flow_field(&nav->field, &nav->grid, goal);
+	bench_sink += nav->field.costs[0];
+	return nav->grid.width * nav->grid.height;
+}
+
+i32 bench_flow_field_256(Bench_Scene *scene)
+{
+	return run_flow_field(scene, scene->navs[0]);
+}
+
+i32 bench_flow_field_1024(Bench_Scene *scene)
+{
+	return run_flow_field(scene, scene->navs[1]);
+}
+
+i32 bench_flow_field_near(Bench_Scene *scene)
+{
+	Bench_Nav *nav = scene->navs[1];
+	V2i goal = nav->middle + V2i((i32) (scene->ticks++ & 3), 0);
+	build_flow_field(&nav->near, &nav->grid, goal);
+	bench_sink += nav->near.touched_count;
+	return (i32) nav->near.touched_count;
+}
+
+void setup_flow_agents(Bench_Scene *scene)
+{
+	setup_navs(scene);
+	Bench_Nav *nav = scene->navs[ArrayCount(BENCH_NAV_SIZES) - 1];
+	build_flow_field(&nav->field, &nav->grid, nav->middle);
+}
+
+// A tick of the agents walking down the field
+i32 bench_flow_agents(Bench_Scene *scene)
+{
+	Bench_Nav *nav = scene->navs[ArrayCount(BENCH_NAV_SIZES) - 1];
+	V2 sum = {};
+	for (i32 i = 0; i < BENCH_AGENTS; ++i) {
+		scene->agents[i] += sample_flow_field(&nav->field, &nav->grid, scene->agents[i]) * (100.f * 0.01f);
+		sum += scene->agents[i];
+	}
+	bench_sink += (u64) (sum.x + sum.y);
+	return BENCH_AGENTS;
+}
+
+// Paths from where the agents started to the middle, a few of them at a time
+i32 run_paths(Bench_Scene *scene, Bench_Nav *nav)
+{
+	V2 goal = nav_cell_center(&nav->grid, nav->middle);
+	for (i32 i = 0; i < BENCH_PATHS; ++i) {
+		V2 start = nav->starts[(scene->ticks * BENCH_PATHS + i) % BENCH_AGENTS];
+		if (find_path(&nav->grid, &scene->arena, start, goal, &scene->path))
+			bench_sink += scene->path.count;
+	}
+	scene->ticks++;
+	return BENCH_PATHS;
+}
+
+i32 bench_jps_256(Bench_Scene *scene)
+{
+	return run_paths(scene, scene->navs[0]);
+}
+
+i32 bench_jps_1024(Bench_Scene *scene)
+{
+	return run_paths(scene, scene->navs[1]);
+}
+
+//				Navigation
+////////////////////////////////////////
+
+////////////////////////////////////////
+//				Tiles
+
+// The screen around the middle of the largest caves, where the edits go too
+inline Rect bench_tile_view(Bench_Nav *nav)
+{
+	V2 center = nav_cell_center(&nav->grid, nav->middle);
+	return { center - resolution / 2, center + resolution / 2 };
+}
+
+i32 draw_bench_tiles(Bench_Scene *scene, Bench_Nav *nav)
+{
+	Rect view = bench_tile_view(nav);
+	reset_render_list(scene->record_list);
+	render_tilemap(scene->record_list, &nav->map, view, -view.min);
+	execute_render_list(&scene->render, scene->record_list);
+	return (i32) scene->record_list->count;
+}
+
+// Paints a tile the way the editor does, then records and draws the frame that shows it, which
+// rebuilds the texture of its chunk
+i32 bench_tile_edit(Bench_Scene *scene)
+{
+	Bench_Nav *nav = scene->navs[ArrayCount(BENCH_NAV_SIZES) - 1];
+	// beside the middle, away from the goals of the flow fields
+	V2i cell = nav->middle + V2i(-4, 4);
+	Tile_Kind kind = get_tile(&nav->map, cell.x, cell.y) == TILE_WALL ? TILE_FLOOR : TILE_WALL;
+	if (set_tile(&nav->map, cell.x, cell.y, kind))
+		tiles_to_nav_grid(&nav->map, &nav->grid, cell, cell);
+	bench_sink += scene->render.tiles.stats.chunks_rebuilt;
+	draw_bench_tiles(scene, nav);
+	return 1;
+}
+
+// Nothing changed, every chunk comes from the cache
+i32 bench_tile_draw(Bench_Scene *scene)
+{
+	return draw_bench_tiles(scene, scene->navs[ArrayCount(BENCH_NAV_SIZES) - 1]);
+}
+
+//				Tiles
+////////////////////////////////////////
+
+////////////////////////////////////////
+//				Snapshots
+
+void setup_sim(Bench_Scene *scene)
+{
+	if (scene->sim)
+		return;
+	Stress_Config config = BENCH_SIM_CONFIG;
+	scene->sim = PushStruct(&scene->arena, Bench_Sim);
+	bench_sim_init(scene->sim, scene, &config, &scene->arena);
+	// room for twice the ticks resim goes back, with snapshots that grew by half
+	imem size = save_simulation(&scene->sim->sim, nullptr);
+	sim_history_init(&scene->history, &scene->arena, 2 * BENCH_RESIM_TICKS, 3 * BENCH_RESIM_TICKS * size);
+}
+
+void setup_restore(Bench_Scene *scene)
+{
+	setup_sim(scene);
+	Tick_Input input = {};
+	record_tick(&scene->history, &scene->sim->sim, &input);
+}
+
+// The history has to hold the ticks that lead up to where the simulation is for resimulate to
+// end up there again
+void setup_resim(Bench_Scene *scene)
+{
+	setup_sim(scene);
+	Tick_Input input = {};
+	for (i32 i = 0; i < BENCH_RESIM_TICKS; ++i) {
+		record_tick(&scene->history, &scene->sim->sim, &input);
+		simulate_tick(&scene->sim->sim, &input, 0.01f);
+	}
+}
+
+// What the game does before every tick
+i32 bench_snapshot(Bench_Scene *scene)
+{
+	Tick_Input input = {};
+	record_tick(&scene->history, &scene->sim->sim, &input);
+	bench_sink += scene->history.stats.snapshot_bytes;
+	return 1;
+}
+
+i32 bench_restore(Bench_Scene *scene)
+{
+	Sim_History *history = &scene->history;
+	Tick_Record *record = history_record(history, history->count - 1);
+	restore_simulation(&scene->sim->sim, tick_snapshot(history, record), record->size);
+	bench_sink += scene->sim->sim.state.tick;
+	return 1;
+}
+
+// Per tick simulated again, a restore included for every BENCH_RESIM_TICKS of them
+i32 bench_resim(Bench_Scene *scene)
+{
+	Resimulation result = resimulate(&scene->history, &scene->sim->sim, BENCH_RESIM_TICKS, 0.01f);
+	if (!result.matched)
+		fatal_error("Simulating the history again ended somewhere else");
+	return result.ticks;
+}
+
+//				Snapshots
+////////////////////////////////////////
+
+////////////////////////////////////////
+//				Jobs
+
+void empty_job(void *, u32, u32) {}
+
+void bench_job_work(void *data, u32 begin, u32 end)
+{
+	r32 *values = (r32 *) data;
+	for (u32 i = begin; i < end; ++i) {
+		r32 x = values[i];
+		for (u32 round = 0; round < BENCH_JOB_ROUNDS; ++round) {
+			x = sqrtf(x * x + 1.f) * 0.5f;
+		}
+		values[i] = x;
+	}
+}
+
+void setup_jobs(Bench_Scene *scene)
+{
+	if (scene->empty_jobs)
+		return;
+	scene->empty_jobs = PushArrayNoZero(&scene->arena, Job, JOB_QUEUE_SIZE);
+	for (u32 i = 0; i < JOB_QUEUE_SIZE; ++i) {
+		scene->empty_jobs[i] = { empty_job, nullptr, 0, 1, nullptr, "empty" };
+	}
+	scene->job_values = PushArray(&scene->arena, r32, BENCH_JOB_VALUES);
+}
+
+// What a job costs to schedule, per job
+i32 bench_jobs_empty(Bench_Scene *scene)
+{
+	Job_Counter counter = {};
+	run_jobs(&scene->jobs, scene->empty_jobs, JOB_QUEUE_SIZE, &counter);
+	wait_for_counter(&scene->jobs, &counter);
+	return JOB_QUEUE_SIZE;
+}
+
+i32 bench_jobs_parallel_for(Bench_Scene *scene)
+{
+	parallel_for(&scene->jobs, "benchmark", BENCH_JOB_VALUES, 1024, bench_job_work, scene->job_values);
+	bench_sink += (u64) (scene->job_values[scene->ticks++ % BENCH_JOB_VALUES] * 1000.f);
+	return BENCH_JOB_VALUES;
+}
+
+//				Jobs
+////////////////////////////////////////
+
+Benchmark benchmarks[] = {
+	{ "gjk", bench_gjk },
+	{ "epa", bench_epa },
+	{ "support", bench_support },
+	{ "parse anims", bench_parse_anims },
+	{ "parse numbers", bench_parse_numbers },
+	{ "animation", bench_animation },
+	{ "record sprites", bench_record_sprites },
+	{ "draw sprites", bench_draw_sprites },
+	{ "array push", bench_array_push },
+	{ "vector push", bench_vector_push },
+	{ "array iterate", bench_array_iterate, setup_containers },
+	{ "vector iterate", bench_vector_iterate, setup_containers },
+	{ "array churn", bench_array_churn, setup_containers },
+	{ "vector churn", bench_vector_churn, setup_containers },
+	{ "slot map churn", bench_slot_map_churn, setup_containers },
+	{ "small array push", bench_small_array_push },
+	{ "small vector push", bench_small_vector_push },
+	{ "small array churn", bench_small_array_churn, setup_containers },
+	{ "entities 10k", bench_entities_10k, setup_crowds },
+	{ "entities 100k", bench_entities_100k, setup_crowds },
+	{ "animation 100k", bench_animation_100k, setup_playbacks },
+	{ "projectiles", bench_projectiles, setup_projectiles },
+	{ "flow field 256", bench_flow_field_256, setup_navs },
+	{ "flow field 1024", bench_flow_field_1024, setup_navs },
+	{ "flow field near", bench_flow_field_near, setup_navs },
+	{ "flow agents", bench_flow_agents, setup_flow_agents },
+	{ "jps 256", bench_jps_256, setup_navs },
+	{ "jps 1024", bench_jps_1024, setup_navs },
+	{ "tile edit", bench_tile_edit, setup_navs },
+	{ "tile draw", bench_tile_draw, setup_navs },
+	{ "snapshot", bench_snapshot, setup_sim },
+	{ "restore", bench_restore, setup_restore },
+	{ "resim", bench_resim, setup_resim },
+	{ "jobs empty", bench_jobs_empty, setup_jobs },
+	{ "jobs parallel_for", bench_jobs_parallel_for, setup_jobs },
+};
+
+//				Benchmarks
+////////////////////////////////////////
+
+int compare_r64(const void *a, const void *b)
+{
+	r64 x = *(r64 *) a, y = *(r64 *) b;
+	return (x > y) - (x < y);
+}
+
+////////////////////////////////////////
+//				Stress sweep
+
+constexpr Stress_Config DEFAULT_SWEEP_CONFIG = { 1, 16384, 1024, 4096, 64.f };
+
+struct Sweep_Result {
+	i32 actors;
+	u32 entities;
+	u32 projectiles;		// alive at the end
+	r64 step_ms;			// medians
+	r64 step_p99_ms;
+	r64 record_ms;
+	r64 draw_ms;
+	imem state_bytes;		// the live part of the simulation, what a snapshot copies
+	imem scratch_bytes;		// the most the ticks had on the frame arena
+	imem render_bytes;		// of the render list
+	u32 commands;
+};
+
+// Sets up a simulation on a stress scene of config and steps it like the game would, then
+// records and draws it like a frame
+Sweep_Result run_stress_size(Bench_Scene *scene, Stress_Config *config, Memory_Arena *arena, i32 warmup, i32 reps, r64 *times)
+{
+	arena_reset(arena);
+	Bench_Sim *bench = PushStruct(arena, Bench_Sim);
+	bench_sim_init(bench, scene, config, arena);
+	Simulation *sim = &bench->sim;
+	World *world = &bench->world;
+
+	Sweep_Result result = { config->actors };
+	Tick_Input input = {};
+	r64 *record_times = times + reps;
+	r64 *draw_times = times + 2 * reps;
+	Render_List *list = scene->record_list;
+	arena_reset(&frame_arena);
+	frame_arena.high_water = 0;
+	for (i32 i = -warmup; i < reps; ++i) {
+		refill_stress_projectiles(&bench->stress, &bench->projectiles);
+		save_previous_positions(&bench->previous, &world->transforms);
+		u64 start = SDL_GetPerformanceCounter();
+		simulate_tick(sim, &input, 0.01f);
+		u64 simulated = SDL_GetPerformanceCounter();
+		sim->impact_count = 0;
+
+		reset_render_list(list);
+		render_sprites(list, world, &bench->previous, 0.5f);
+		render_projectiles(list, &bench->projectiles, 0.005f);
+		render_projectiles(list, &bench->effects, 0.005f);
+		u64 recorded = SDL_GetPerformanceCounter();
+		execute_render_list(&scene->render, list);
+		u64 drawn = SDL_GetPerformanceCounter();
+		if (i < 0)
+			continue;
+		times[i] = counter_to_ms(simulated - start);
+		record_times[i] = counter_to_ms(recorded - simulated);
+		draw_times[i] = counter_to_ms(drawn - recorded);
+	}
+	SDL_qsort(times, reps, sizeof(r64), compare_r64);
+	SDL_qsort(record_times, reps, sizeof(r64), compare_r64);
+	SDL_qsort(draw_times, reps, sizeof(r64), compare_r64);
+	result.step_ms = times[reps / 2];
+	result.step_p99_ms = times[Min(reps - 1, reps * 99 / 100)];
+	result.record_ms = record_times[reps / 2];
+	result.draw_ms = draw_times[reps / 2];
+
+	result.state_bytes = save_simulation(sim, nullptr);
+	result.entities = world->alive_count;
+	result.projectiles = bench->projectiles.count;
+	result.scratch_bytes = frame_arena.high_water;
+	result.render_bytes = list->data.used + list->count * sizeof(Render_Command);
+	result.commands = list->count;
+	bench_sink += hash_simulation(sim);
+	return result;
+}
+
+bool write_sweep_csv(const char *path, Stress_Config *config, Sweep_Result *results, i32 count)
+{
+	SDL_RWops *out = SDL_RWFromFile(path, "wb");
+	if (!out)
+		return false;
+	Text_Writer writer = { out };
+	write_text(&writer, "actors,colliders,projectiles,entities,step_ms,step_p99_ms,record_ms,draw_ms,state_kb,scratch_kb,render_kb,commands\n");
+	for (i32 i = 0; i < count; ++i) {
+		Sweep_Result *result = &results[i];
+		write_text(&writer, "%d,%d,%u,%u,%.4f,%.4f,%.4f,%.4f,%.1f,%.1f,%.1f,%u\n", result->actors, config->colliders, result->projectiles,
+				   result->entities, result->step_ms, result->step_p99_ms, result->record_ms, result->draw_ms,
+				   result->state_bytes / 1024.0, result->scratch_bytes / 1024.0, result->render_bytes / 1024.0, result->commands);
+	}
+	SDL_RWclose(out);
+	return !writer.failed;
+}
+
+// How much a median grew since the previous size, 0 for the first one
+inline r64 sweep_growth(r64 ms, r64 previous_ms)
+{
+	return previous_ms > 0 ? ms / previous_ms : 0;
+}
+
+i32 run_stress_sweep(Bench_Scene *scene, Stress_Config *config, i32 warmup, i32 reps, const char *csv_path)
+{
+	Memory_Arena stress_arena;
+	arena_create(&stress_arena, Megabytes(64), "stress", MEMORY_TAG_ENTITIES);
+	r64 *times = PushArrayNoZero(&permanent_arena, r64, 3 * reps);
+	Sweep_Result results[32];
+	i32 count = 0;
+	SDL_Log("Sweeping up to %d actors with %d colliders, %d projectiles, %.0f per screen, seed %llu", config->actors,
+			config->colliders, config->projectiles, config->density, (unsigned long long) config->seed);
+	for (i32 actors = 1; actors <= config->actors && count < (i32) ArrayCount(results); actors *= 2) {
+		Stress_Config size = *config;
+		size.actors = actors;
+		Sweep_Result *result = &results[count++];
+		*result = run_stress_size(scene, &size, &stress_arena, warmup, reps, times);
+		Sweep_Result *previous = count > 1 ? result - 1 : result;
+		SDL_Log("%6d actors: step %8.3f ms (%4.2fx, p99 %8.3f), record %7.3f (%4.2fx), draw %7.3f (%4.2fx), "
+				"state %7.1f KB, scratch %7.1f KB, render %7.1f KB",
+				actors, result->step_ms, sweep_growth(result->step_ms, previous->step_ms), result->step_p99_ms, result->record_ms,
+				sweep_growth(result->record_ms, previous->record_ms), result->draw_ms, sweep_growth(result->draw_ms, previous->draw_ms),
+				result->state_bytes / 1024.0, result->scratch_bytes / 1024.0, result->render_bytes / 1024.0);
+		if (scene->record_list->dropped)
+			SDL_Log("%6d actors: the render list was full, %u commands dropped", actors, scene->record_list->dropped);
+	}
+	SDL_Log("Checksum %016llx", (unsigned long long) bench_sink);
+	if (csv_path) {
+		if (!write_sweep_csv(csv_path, config, results, count)) {
+			SDL_Log("Could not write %s", csv_path);
+			return 2;
+		}
+		SDL_Log("Wrote %s", csv_path);
+	}
+	return 0;
+}
+
+//				Stress sweep
+////////////////////////////////////////
+
+Bench_Result run_benchmark(Bench_Scene *scene, Benchmark *benchmark, i32 warmup, i32 reps, r64 *times)
+{
+	if (benchmark->setup)
+		benchmark->setup(scene);
+	for (i32 i = 0; i < warmup; ++i) {
+		benchmark->proc(scene);
+	}
+	Bench_Result result = { benchmark->name, reps };
+	r64 sum = 0;
+	for (i32 i = 0; i < reps; ++i) {
+		u64 start = SDL_GetPerformanceCounter();
+		result.ops = benchmark->proc(scene);
+		times[i] = counter_to_ms(SDL_GetPerformanceCounter() - start);
+		sum += times[i];
+	}
+	SDL_qsort(times, reps, sizeof(r64), compare_r64);
+	result.min_ms = times[0];
+	result.median_ms = times[reps / 2];
+	result.p99_ms = times[Min(reps - 1, reps * 99 / 100)];
+	result.mean_ms = sum / reps;
+	return result;
+}
+
+bool write_bench_json(const char *path, Bench_Result *results, i32 count, i32 workers)
+{
+	SDL_RWops *out = SDL_RWFromFile(path, "wb");
+	if (!out)
+		return false;
+	Text_Writer writer = { out };
+	// one benchmark per line, read_bench_baseline depends on it
+	write_text(&writer, "{\"seed\": %llu, \"workers\": %d, \"benchmarks\": [\n", (unsigned long long) BENCH_SEED, workers);
+	for (i32 i = 0; i < count; ++i) {
+		Bench_Result *result = &results[i];
+		write_text(&writer, "{\"name\": \"%s\", \"reps\": %d, \"ops\": %d, \"min_ms\": %.6f, \"median_ms\": %.6f, \"p99_ms\": %.6f, \"mean_ms\": %.6f}%s\n",
+				   result->name, result->reps, result->ops, result->min_ms, result->median_ms, result->p99_ms, result->mean_ms,
+				   i + 1 < count ? "," : "");
+	}
+	write_text(&writer, "]}\n");
+	SDL_RWclose(out);
+	return !writer.failed;
+}
+
+// What follows "key": on the line, up to the next comma or brace
+String json_field(String line, String key)
+{
+	imem at = string_find(line, key);
+	if (at < 0)
+		return {};
+	String value = String(line.data + at + key.len, line.len - at - key.len);
+	string_chop_by_delim(&value, ':');
+	value = string_trim(value);
+	if (value.len > 0 && value[0] == '"') {
+		string_chop_left(&value, 1);
+		return string_chop_by_delim(&value, '"');
+	}
+	imem length = 0;
+	while (length < value.len && value[length] != ',' && value[length] != '}')
+		++length;
+	return string_trim(String(value.data, length));
+}
+
+// Compares against a file write_bench_json wrote, returns how many benchmarks regressed
+i32 compare_bench_baseline(const char *path, Bench_Result *results, i32 count, r32 tolerance)
+{
+	String baseline;
+	if (!try_read_entire_file(&frame_arena, path, &baseline)) {
+		SDL_Log("Could not read the baseline %s: %s", path, SDL_GetError());
+		return -1;
+	}
+	i32 regressions = 0;
+	for (i32 i = 0; i < count; ++i) {
+		Bench_Result *result = &results[i];
+		String name = String(result->name, SDL_strlen(result->name));
+		r64 base_ms = -1;
+		String lines = baseline;
+		while (lines.len > 0) {
+			String line = string_chop_by_delim(&lines, '\n');
+			if (json_field(line, "\"name\"") == name) {
+				// strtod stops at the comma after the number
+				base_ms = string_parse_r64(json_field(line, "\"median_ms\""));
+				break;
+			}
+		}
+		if (base_ms <= 0) {
+			SDL_Log("%-18s median %9.4f ms, not in the baseline", result->name, result->median_ms);
+			continue;
+		}
+		r64 change = result->median_ms / base_ms - 1.0;
+		const char *verdict = "";
+		if (change > tolerance) {
+			verdict = "  REGRESSED";
+			regressions++;
+		} else if (change < -tolerance) {
+			verdict = "  improved";
+		}
+		SDL_Log("%-18s median %9.4f ms, baseline %9.4f (%+.1f%%)%s", result->name, result->median_ms, base_ms, change * 100.0, verdict);
+	}
+	return regressions;
+}
+
+int main(int argc, char **argv)
+{
+	i32 warmup = 10;
+	i32 reps = 100;
+	i32 workers = 1;	// more make the animation numbers depend on the machine's load
+	const char *filter = nullptr;
+	const char *json_path = nullptr;
+	const char *baseline_path = nullptr;
+	r32 tolerance = 0.1f;
+	bool sweep = false;
+	Stress_Config sweep_config = DEFAULT_SWEEP_CONFIG;
+	const char *csv_path = nullptr;
+	for (i32 i = 1; i < argc; ++i) {
+		if (SDL_strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+			// Max and Clamp evaluate their arguments more than once, argv[++i] can't go in there
+			warmup = SDL_atoi(argv[++i]);
+			warmup = Max(0, warmup);
+		} else if (SDL_strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+			reps = SDL_atoi(argv[++i]);
+			reps = Clamp(1, reps, MAX_BENCH_REPS);
+		} else if (SDL_strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+			workers = SDL_atoi(argv[++i]);
+		} else if (SDL_strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+			filter = argv[++i];
+		} else if (SDL_strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+			json_path = argv[++i];
+		} else if (SDL_strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+			baseline_path = argv[++i];
+		} else if (SDL_strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+			tolerance = (r32) SDL_atof(argv[++i]);
+		} else if (SDL_strcmp(argv[i], "--sweep") == 0) {
+			sweep = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-') {
+				if (!parse_stress_config(String(argv[i + 1], SDL_strlen(argv[i + 1])), &sweep_config)) {
+					SDL_Log("%s", SDL_GetError());
+					return 2;
+				}
+				++i;
+			}
+		} else if (SDL_strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+			csv_path = argv[++i];
+		} else {
+			SDL_Log("Unknown argument %s, see the top of bench/bench.cpp", argv[i]);
+			return 2;
+		}
+	}
+
+	SDL_SetMainReady();
+	if (SDL_Init(0) < 0)
+		fatal_error(SDL_GetError());
+	arena_create(&permanent_arena, Megabytes(64), "permanent", MEMORY_TAG_ASSETS);
+	arena_create(&world_arena, Megabytes(32), "world", MEMORY_TAG_ENTITIES);
+	arena_create(&render_arena, Megabytes(16), "render", MEMORY_TAG_RENDERING);
+	arena_create(&frame_arena, Megabytes(16), "frame", MEMORY_TAG_FRAME_SCRATCH);
+	array_init(&animations, arena_allocator(&permanent_arena), 16);
+	array_init(&animation_paths, arena_allocator(&permanent_arena), 16);
+	array_init(&textures, arena_allocator(&permanent_arena), 64);
+	array_init(&texture_paths, arena_allocator(&permanent_arena), 64);
+
+	Bench_Scene scene;
+	bench_scene_init(&scene, workers);
+	if (sweep) {
+		load_projectile_types(scene.renderer);
+		i32 status = run_stress_sweep(&scene, &sweep_config, warmup, reps, csv_path);
+		bench_scene_shutdown(&scene);
+		return status;
+	}
+
+	Bench_Result results[ArrayCount(benchmarks)];
+	i32 result_count = 0;
+	r64 *times = PushArrayNoZero(&permanent_arena, r64, reps);
+	for (Benchmark &benchmark : benchmarks) {
+		if (filter && !SDL_strstr(benchmark.name, filter))
+			continue;
+		Bench_Result *result = &results[result_count++];
+		*result = run_benchmark(&scene, &benchmark, warmup, reps, times);
+		SDL_Log("%-18s min %9.4f ms, median %9.4f, p99 %9.4f (%d reps, %.1f ns per op)", result->name, result->min_ms,
+				result->median_ms, result->p99_ms, result->reps, result->median_ms * 1e6 / Max(result->ops, 1));
+	}
+
+	SDL_Log("Checksum %016llx", (unsigned long long) bench_sink);
+
+	i32 status = 0;
+	if (json_path) {
+		if (write_bench_json(json_path, results, result_count, scene.jobs.worker_count)) {
+			SDL_Log("Wrote %s", json_path);
+		} else {
+			SDL_Log("Could not write %s", json_path);
+			status = 2;
+		}
+	}
+	if (baseline_path) {
+		i32 regressions = compare_bench_baseline(baseline_path, results, result_count, tolerance);
+		if (regressions < 0) {
+			status = 2;
+		} else if (regressions > 0) {
+			SDL_Log("%d benchmarks regressed by more than %.0f%%", regressions, tolerance * 100.f);
+			status = Max(status, 1);
+		}
+	}
+
+	bench_scene_shutdown(&scene);
+	return status;
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+// Enemy AI scheduling.
+//
+// The AI is part of the simulation and runs once per fixed tick (see simulation.h). Brains don't
+// all think every tick. Each tick every brain is put in a level of detail bucket by its distance
+// to the player and whether it is on screen, and the bucket decides how often it thinks: near
+// ones every tick, the others every few ticks, with their turns staggered so that a bucket's work
+// is spread evenly over its interval. The intervals are in seconds, so the cadence stays the same
+// whatever the tick rate. Off-screen brains only get a coarse update (keep heading for the player,
+// no decisions, no animation).
+//
+// Thinking runs under a per-tick time budget. Buckets are served nearest first and each one
+// continues round-robin from where it stopped last time, so when the budget runs out it is the
+// far brains that wait, and none of them waits forever. A frame that catches up on several ticks
+// spends up to that many budgets. A budget of 0 lets every brain that is due think, which
+// recorded sessions and re-simulation need to come out the same (see replay.h).
+
+enum AI_Lod : u8 {
+	AI_LOD_NEAR,
+	AI_LOD_MID,
+	AI_LOD_FAR,
+	AI_LOD_OFFSCREEN,
+
+	COUNT_AI_LOD,
+};
+
+const char *ai_lod_names[COUNT_AI_LOD] = { "near", "mid", "far", "offscreen" };
+
+// seconds between two thinks, never less than a tick
+constexpr r32 ai_lod_intervals[COUNT_AI_LOD] = { 0, 4 / 60.f, 8 / 60.f, 16 / 60.f };
+
+constexpr r32 AI_NEAR_DISTANCE = 500.f;
+constexpr r32 AI_MID_DISTANCE = 1000.f;
+constexpr r32 AI_AGGRO_DISTANCE = 1500.f;
+constexpr r32 AI_ATTACK_DISTANCE = 120.f;
+
+struct AI_Bucket_Metrics {
+	u32 brains;
+	u32 thinks;
+	u32 deferred;			// due this tick, left for the next one by the budget
+	r32 avg_interval_ms;	// between two thinks of the same brain, which is what the AI lags behind
+	r32 max_interval_ms;
+};
+
+struct AI_Metrics {
+	r32 tick_ms;
+	r32 peak_tick_ms;
+	AI_Bucket_Metrics buckets[COUNT_AI_LOD];
+};
+
+struct AI_Scheduler {
+	u32 tick;
+	r32 budget_ms;				// per tick
+	u32 cursors[COUNT_AI_LOD];	// brain each bucket continues from
+	AI_Metrics metrics;
+};
+
+// What brains get to know about the world when they think
+struct AI_Context {
+	World *world;
+	Animation *animation;	// of the enemies, to play its states
+	V2 player_pos;
+	Rect view;
+	Nav_Grid *grid;
+	Flow_Field *flow;		// towards the player
+	r32 dt;					// of a tick
+};
+
+void ai_scheduler_init(AI_Scheduler *scheduler, r32 budget_ms)
+{
+	*scheduler = {};
+	scheduler->budget_ms = budget_ms;
+}
+
+AI_Lod classify_brain(AI_Context *context, Transform *transform)
+{
+	Rect bounds = { transform->pos, transform->pos + transform->size };
+	bool on_screen = bounds.max.x >= context->view.min.x && bounds.min.x <= context->view.max.x &&
+					 bounds.max.y >= context->view.min.y && bounds.min.y <= context->view.max.y;
+	if (!on_screen)
+		return AI_LOD_OFFSCREEN;
+	r32 distance_squared = length_squared(transform->pos + transform->size / 2 - context->player_pos);
+	if (distance_squared < AI_NEAR_DISTANCE * AI_NEAR_DISTANCE)
+		return AI_LOD_NEAR;
+	if (distance_squared < AI_MID_DISTANCE * AI_MID_DISTANCE)
+		return AI_LOD_MID;
+	return AI_LOD_FAR;
+}
+
+// Around walls by the flow field where it reaches, straight at the player everywhere else
+V2 chase_direction(AI_Context *context, V2 pos, V2 to_player, r32 distance)
+{
+	V2 direction = context->flow ? sample_flow_field(context->flow, context->grid, pos) : V2();
+	if (direction.x == 0 && direction.y == 0)
+		direction = to_player / distance;
+	return direction;
+}
+
+void think(AI_Context *context, Brain *brain, Transform *transform, Velocity *velocity, Sprite *sprite)
+{
+	V2 to_player = context->player_pos - (transform->pos + transform->size / 2);
+	r32 distance = length(to_player);
+	Animation_Playback *playback = &sprite->playback;
+	Animation *animation = context->animation;
+
+	if (distance < AI_ATTACK_DISTANCE) {
+		brain->state = AI_ATTACK;
+		velocity->accn = {};
+		if (!(playback->flags & ANIMATION_ONE_SHOT))
+			play_animation(playback, animation_state(animation, ENEMY_ANIMATION_ATK), ANIMATION_ONE_SHOT | ANIMATION_UNINTERRUPTIBLE);
+	} else if (distance < AI_AGGRO_DISTANCE) {
+		brain->state = AI_CHASE;
+		velocity->accn = chase_direction(context, transform->pos + transform->size / 2, to_player, distance);
+		sprite->flipped = to_player.x < 0;
+		play_animation(playback, animation_state(animation, ENEMY_ANIMATION_WALK));
+	} else {
+		brain->state = AI_IDLE;
+		velocity->accn = {};
+		play_animation(playback, animation_state(animation, ENEMY_ANIMATION_IDLE));
+	}
+}
+
+// Nobody sees off-screen brains, so they only keep moving the right way
+void think_coarse(AI_Context *context, Brain *brain, Transform *transform, Velocity *velocity)
+{
+	V2 to_player = context->player_pos - (transform->pos + transform->size / 2);
+	r32 distance = length(to_player);
+	if (distance < AI_AGGRO_DISTANCE) {
+		brain->state = AI_CHASE;
+		velocity->accn = chase_direction(context, transform->pos + transform->size / 2, to_player, distance);
+	} else {
+		brain->state = AI_IDLE;
+		velocity->accn = {};
+	}
+}
+
+void update_ai(AI_Scheduler *scheduler, AI_Context *context)
+{
+	u64 start_counter = SDL_GetPerformanceCounter();
+	u64 budget_counter = (u64) (scheduler->budget_ms / 1000.0 * SDL_GetPerformanceFrequency());
+	r64 now = start_counter / (r64) SDL_GetPerformanceFrequency();
+
+	World *world = context->world;
+	Component_Pool<Brain> *brains = &world->brains;
+	u32 tick = ++scheduler->tick;
+	AI_Metrics *metrics = &scheduler->metrics;
+	r64 interval_sums[COUNT_AI_LOD] = {};
+	u32 interval_counts[COUNT_AI_LOD] = {};
+	for (i32 lod = 0; lod < COUNT_AI_LOD; ++lod) {
+		metrics->buckets[lod] = {};
+	}
+
+	for (u32 i = 0; i < brains->count; ++i) {
+		Transform *transform = joined_component(brains, i, &world->transforms);
+		Brain *brain = &brains->data[i];
+		brain->lod = transform ? classify_brain(context, transform) : AI_LOD_OFFSCREEN;
+		metrics->buckets[brain->lod].brains++;
+	}
+
+	bool over_budget = false;
+	for (i32 lod = 0; lod < COUNT_AI_LOD; ++lod) {
+		AI_Bucket_Metrics *bucket = &metrics->buckets[lod];
+		u32 interval = Max((u32) (ai_lod_intervals[lod] / context->dt + .5f), 1u);
+		u32 count = brains->count;
+		u32 cursor = count ? scheduler->cursors[lod] % count : 0;
+
+		for (u32 n = 0; n < count; ++n) {
+			u32 i = (cursor + n) % count;
+			Brain *brain = &brains->data[i];
+			if (brain->lod != lod || (i32) (tick - brain->next_tick) < 0)
+				continue;
+
+			// checking the clock isn't free, a few thinks at a time is close enough
+			if (!over_budget && scheduler->budget_ms > 0 && bucket->thinks % 8 == 0)
+				over_budget = SDL_GetPerformanceCounter() - start_counter > budget_counter;
+			if (over_budget) {
+				if (bucket->deferred++ == 0)
+					scheduler->cursors[lod] = i;
+				continue;
+			}
+
+			Transform *transform = joined_component(brains, i, &world->transforms);
+			Velocity *velocity = joined_component(brains, i, &world->velocities);
+			Sprite *sprite = joined_component(brains, i, &world->sprites);
+			if (!transform || !velocity)
+				continue;
+			if (lod == AI_LOD_OFFSCREEN || !sprite)
+				think_coarse(context, brain, transform, velocity);
+			else
+				think(context, brain, transform, velocity, sprite);
+
+			// stagger by entity so that a bucket doesn't think all at once
+			brain->next_tick = tick + interval - (tick + brains->entities[i]) % interval;
+			if (brain->last_think > 0) {
+				r32 interval_ms = (r32) ((now - brain->last_think) * 1000.0);
+				interval_sums[lod] += interval_ms;
+				interval_counts[lod]++;
+				bucket->max_interval_ms = Max(bucket->max_interval_ms, interval_ms);
+			}
+			brain->last_think = now;
+			bucket->thinks++;
+		}
+		if (bucket->deferred == 0)
+			scheduler->cursors[lod] = cursor;
+		if (interval_counts[lod] > 0)
+			bucket->avg_interval_ms = (r32) (interval_sums[lod] / interval_counts[lod]);
+	}
+
+	metrics->tick_ms = counter_to_ms(SDL_GetPerformanceCounter() - start_counter);
+	metrics->peak_tick_ms = Max(metrics->peak_tick_ms, metrics->tick_ms);
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+// Animation playback.
+//
+// An Animation is the shared asset loaded from an .anims file, an Animation_Playback is one
+// instance playing it: the state, the frame and how far into that frame it is. Every instance
+// has its own, so two skeletons can be at different points of the same animation. They are
+// advanced by elapsed time, independent of the physics step, in one pass over all of them.
+//
+// Playing a state switches to it right away unless the current state is an uninterruptible one
+// shot (attacks), in which case one shots wait in a small queue and looping states are
+// remembered. Once a one shot ends the next queued one plays, and when the queue is empty the
+// last looping state that was asked for (or the default state) takes over again.
+
+constexpr i32 MAX_QUEUED_ANIMATIONS = 3;
+
+enum Animation_Flags : u8 {
+	ANIMATION_ONE_SHOT = 1 << 0,
+	ANIMATION_UNINTERRUPTIBLE = 1 << 1,	// only makes sense together with ANIMATION_ONE_SHOT
+	ANIMATION_RESTART = 1 << 2,			// start over even if the state is already playing
+};
+
+struct Animation_Request {
+	i8 state;
+	u8 flags;
+};
+
+struct Animation_Playback {
+	Animation *animation;
+	r32 time;		// seconds into the current frame
+	i8 state;
+	u8 frame;
+	u8 flags;		// Animation_Flags of the current state
+	i8 loop_state;	// looping state to return to after one shots, -1 for the default state
+	Animation_Request queue[MAX_QUEUED_ANIMATIONS];
+	u8 queue_count;
+};
+
+Animation_Playback make_animation_playback(Animation *animation)
+{
+	Animation_Playback result = {};
+	result.animation = animation;
+	result.state = (i8) animation->default_state;
+	result.loop_state = -1;
+	return result;
+}
+
+inline void start_animation_state(Animation_Playback *playback, i32 state, u8 flags)
+{
+	playback->state = (i8) state;
+	playback->frame = 0;
+	playback->time = 0;
+	playback->flags = flags;
+}
+
+// state is a state of the animation file, see animation_state()
+void play_animation(Animation_Playback *playback, i32 state, u8 flags = 0)
+{
+	bool one_shot = flags & ANIMATION_ONE_SHOT;
+	if (!one_shot)
+		playback->loop_state = (i8) state;
+
+	if (playback->flags & ANIMATION_UNINTERRUPTIBLE) {
+		if (one_shot) {
+			// the newest request wins once the queue is full
+			if (playback->queue_count < MAX_QUEUED_ANIMATIONS)
+				playback->queue_count++;
+			playback->queue[playback->queue_count - 1] = { (i8) state, flags };
+		}
+		return;
+	}
+
+	if (playback->state == state && !(flags & ANIMATION_RESTART)) {
+		playback->flags = flags;
+		return;
+	}
+	start_animation_state(playback, state, flags);
+}
+
+// Called when a one shot has played its last frame
+void finish_animation_state(Animation_Playback *playback)
+{
+	if (playback->queue_count > 0) {
+		Animation_Request next = playback->queue[0];
+		playback->queue_count--;
+		SDL_memmove(playback->queue, playback->queue + 1, playback->queue_count * sizeof(Animation_Request));
+		start_animation_state(playback, next.state, next.flags);
+	} else {
+		i32 state = playback->loop_state >= 0 ? playback->loop_state : playback->animation->default_state;
+		start_animation_state(playback, state, 0);
+	}
+}
+
+inline void advance_animation(Animation_Playback *playback, r32 dt)
+{
+	Animation *animation = playback->animation;
+	playback->time += dt;
+	if (playback->time < animation->frame_duration)
+		return;
+
+	// a long frame can skip several animation frames at once
+	i32 steps = (i32) (playback->time * animation->frames_per_second);
+	playback->time -= steps * animation->frame_duration;
+
+	i32 frame = playback->frame + steps;
+	i32 count = animation->frames[playback->state].count;
+	if (frame < count) {
+		playback->frame = (u8) frame;
+	} else if (playback->flags & ANIMATION_ONE_SHOT) {
+		finish_animation_state(playback);
+	} else {
+		playback->frame = (u8) (frame % count);
+	}
+}
+
+void advance_animations(Array_View<Animation_Playback> playbacks, r32 dt)
+{
+	for (Animation_Playback &playback : playbacks) {
+		advance_animation(&playback, dt);
+	}
+}
+
+// After a hot reload the states or frames an instance refers to may be gone
+void clamp_animation_playback(Animation_Playback *playback)
+{
+	Animation *animation = playback->animation;
+	if (playback->state >= animation->frame_count) {
+		playback->queue_count = 0;
+		playback->loop_state = -1;
+		start_animation_state(playback, animation->default_state, 0);
+	}
+	if (playback->loop_state >= animation->frame_count)
+		playback->loop_state = -1;
+	if (playback->frame >= animation->frames[playback->state].count)
+		playback->frame = 0;
+
+	i32 queue_count = 0;
+	for (i32 i = 0; i < playback->queue_count; ++i) {
+		if (playback->queue[i].state < animation->frame_count)
+			playback->queue[queue_count++] = playback->queue[i];
+	}
+	playback->queue_count = (u8) queue_count;
+}
@@ -0,0 +1,323 @@
+#pragma once
+
+// Hot reloading of .anims files and the sprite sheets they use.
+//
+// A watcher thread blocks on inotify for every directory that contains a loaded asset. When one
+// of those files is rewritten, only that file is re-read and decoded (or re-parsed) on the watcher
+// thread and the result is queued. The main thread applies the queue at the start of a frame,
+// since SDL textures can only be touched there, and patches the live Texture / Animation entries
+// in place. Nothing else gets reloaded and the frame loop never waits on the disk or the decoder.
+//
+// TODO: ReadDirectoryChangesW version for windows, right now this only does something on linux
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#define ASSET_WATCH_SUPPORTED 1
+#else
+#define ASSET_WATCH_SUPPORTED 0
+#endif
+
+enum Asset_Kind {
+	ASSET_TEXTURE,
+	ASSET_ANIMATION,
+};
+
+struct Watched_Asset {
+	Asset_Kind kind;
+	i32 index;			// into textures or animations
+	i32 watch;			// watch descriptor of the directory containing the file
+	const char *path;
+	const char *name;	// file name part of path, which is what inotify reports
+};
+
+struct Asset_Reload {
+	i32 asset;
+	u64 changed_counter;
+	u64 decoded_counter;
+	bool ok;
+
+	// ASSET_TEXTURE
+	u8 *pixels;
+	i32 width;
+	i32 height;
+
+	// ASSET_ANIMATION
+	Animation_Desc *desc;
+};
+
+constexpr i32 MAX_WATCHED_ASSETS = 256;
+
+struct Asset_Watch {
+	Watched_Asset assets[MAX_WATCHED_ASSETS];
+	i32 asset_count;
+	i32 watched_texture_count;
+	i32 watched_animation_count;
+
+	Asset_Reload pending[32];
+	i32 pending_count;
+	Memory_Pool desc_pool;	// Animation_Descs of pending reloads
+	SDL_mutex *mutex;		// guards pending, desc_pool and asset_count
+
+	Memory_Arena arena;		// scratch memory of the watcher thread
+
+	SDL_Thread *thread;
+	SDL_atomic_t running;
+	int fd;
+};
+
+Asset_Watch asset_watch;
+
+void watch_asset(Asset_Kind kind, i32 index, const char *path)
+{
+#if ASSET_WATCH_SUPPORTED
+	if (asset_watch.asset_count >= MAX_WATCHED_ASSETS) {
+		SDL_Log("Asset watch: too many assets, not watching %s", path);
+		return;
+	}
+
+	char directory[MAX_ASSET_PATH] = ".";
+	const char *name = SDL_strrchr(path, '/');
+	if (name) {
+		SDL_memcpy(directory, path, name - path);
+		directory[name - path] = 0;
+		name++;
+	} else {
+		name = path;
+	}
+
+	i32 watch = inotify_add_watch(asset_watch.fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (watch < 0) {
+		SDL_Log("Asset watch: could not watch %s", directory);
+		return;
+	}
+
+	Watched_Asset asset = { kind, index, watch, path, name };
+	SDL_LockMutex(asset_watch.mutex);
+	asset_watch.assets[asset_watch.asset_count++] = asset;
+	SDL_UnlockMutex(asset_watch.mutex);
+#endif
+}
+
+// Registers everything loaded since the last call, reloads can pull in new textures as well
+void watch_loaded_assets()
+{
+	for (; asset_watch.watched_texture_count < textures.count; asset_watch.watched_texture_count++) {
+		i32 index = asset_watch.watched_texture_count;
+		watch_asset(ASSET_TEXTURE, index, texture_paths[index]);
+	}
+	for (; asset_watch.watched_animation_count < animations.count; asset_watch.watched_animation_count++) {
+		i32 index = asset_watch.watched_animation_count;
+		watch_asset(ASSET_ANIMATION, index, animation_paths[index]);
+	}
+}
+
+void free_reload_desc(Animation_Desc *desc)
+{
+	SDL_LockMutex(asset_watch.mutex);
+	pool_free(&asset_watch.desc_pool, desc);
+	SDL_UnlockMutex(asset_watch.mutex);
+}
+
+// Runs on the watcher thread: does all the slow work so that applying the result is cheap
+Asset_Reload decode_asset(i32 asset_index, u64 changed_counter)
+{
+	Watched_Asset *asset = &asset_watch.assets[asset_index];
+	Asset_Reload result = {};
+	result.asset = asset_index;
+	result.changed_counter = changed_counter;
+
+	Temp_Memory temp = begin_temp_memory(&asset_watch.arena);
+	Defer(end_temp_memory(temp));
+
+	String content;
+	if (!try_read_entire_file(&asset_watch.arena, asset->path, &content)) {
+		SDL_Log("Asset watch: could not read %s: %s", asset->path, SDL_GetError());
+		return result;
+	}
+
+	switch (asset->kind) {
+		case ASSET_TEXTURE: {
+			result.pixels = stbi_load_from_memory(content.data, (i32) content.len, &result.width, &result.height, nullptr, 4);
+			if (result.pixels) {
+				result.ok = true;
+			} else {
+				SDL_Log("Asset watch: could not decode %s: %s", asset->path, stbi_failure_reason());
+			}
+		} break;
+
+		case ASSET_ANIMATION: {
+			SDL_LockMutex(asset_watch.mutex);
+			result.desc = (Animation_Desc *) pool_alloc(&asset_watch.desc_pool);
+			SDL_UnlockMutex(asset_watch.mutex);
+			if (!result.desc) {
+				SDL_Log("Asset watch: too many reloads pending, skipping %s", asset->path);
+				break;
+			}
+
+			const char *error = parse_animation_desc(content, result.desc);
+			if (error) {
+				SDL_Log("Asset watch: could not parse %s: %s", asset->path, error);
+				free_reload_desc(result.desc);
+				result.desc = nullptr;
+			} else {
+				result.ok = true;
+			}
+		} break;
+	}
+
+	result.decoded_counter = SDL_GetPerformanceCounter();
+	return result;
+}
+
+#if ASSET_WATCH_SUPPORTED
+int asset_watch_thread(void *)
+{
+	alignas(inotify_event) char buffer[4096];
+	pollfd poll_fd = { asset_watch.fd, POLLIN, 0 };
+
+	while (SDL_AtomicGet(&asset_watch.running)) {
+		// time out every now and then to notice when we should stop
+		if (poll(&poll_fd, 1, 100) <= 0)
+			continue;
+		ssize_t length = read(asset_watch.fd, buffer, sizeof(buffer));
+		if (length <= 0)
+			continue;
+		u64 changed_counter = SDL_GetPerformanceCounter();
+
+		SDL_LockMutex(asset_watch.mutex);
+		i32 asset_count = asset_watch.asset_count;
+		SDL_UnlockMutex(asset_watch.mutex);
+
+		// editors like to emit several events for a single save, only reload each file once
+		i32 changed[ArrayCount(asset_watch.assets)];
+		i32 changed_count = 0;
+		for (char *at = buffer; at < buffer + length; ) {
+			inotify_event *event = (inotify_event *) at;
+			at += sizeof(inotify_event) + event->len;
+			if (event->len == 0)
+				continue;
+
+			for (i32 i = 0; i < asset_count; ++i) {
+				Watched_Asset *asset = &asset_watch.assets[i];
+				if (asset->watch != event->wd || SDL_strcmp(asset->name, event->name) != 0)
+					continue;
+				bool seen = false;
+				for (i32 j = 0; j < changed_count; ++j)
+					seen |= changed[j] == i;
+				if (!seen)
+					changed[changed_count++] = i;
+			}
+		}
+
+		for (i32 i = 0; i < changed_count; ++i) {
+			Asset_Reload reload = decode_asset(changed[i], changed_counter);
+			if (!reload.ok)
+				continue;
+
+			SDL_LockMutex(asset_watch.mutex);
+			bool queued = asset_watch.pending_count < (i32) ArrayCount(asset_watch.pending);
+			if (queued)
+				asset_watch.pending[asset_watch.pending_count++] = reload;
+			SDL_UnlockMutex(asset_watch.mutex);
+
+			if (!queued) {
+				SDL_Log("Asset watch: reload queue is full, dropping %s", asset_watch.assets[reload.asset].path);
+				if (reload.pixels) stbi_image_free(reload.pixels);
+				if (reload.desc) free_reload_desc(reload.desc);
+			}
+		}
+	}
+	return 0;
+}
+#endif
+
+void start_asset_watch()
+{
+#if ASSET_WATCH_SUPPORTED
+	asset_watch.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (asset_watch.fd < 0) {
+		SDL_Log("Asset watch: inotify is unavailable, hot reloading is disabled");
+		return;
+	}
+	asset_watch.mutex = SDL_CreateMutex();
+	arena_create(&asset_watch.arena, Megabytes(4), "asset watch", MEMORY_TAG_ASSETS);
+	pool_init(&asset_watch.desc_pool, &permanent_arena, sizeof(Animation_Desc), ArrayCount(asset_watch.pending), MEMORY_TAG_ASSETS);
+	watch_loaded_assets();
+	SDL_AtomicSet(&asset_watch.running, 1);
+	asset_watch.thread = SDL_CreateThread(asset_watch_thread, "asset_watch", nullptr);
+#else
+	SDL_Log("Asset watch: hot reloading is not supported on this platform");
+#endif
+}
+
+void stop_asset_watch()
+{
+#if ASSET_WATCH_SUPPORTED
+	if (!asset_watch.thread)
+		return;
+	SDL_AtomicSet(&asset_watch.running, 0);
+	SDL_WaitThread(asset_watch.thread, nullptr);
+	asset_watch.thread = nullptr;
+	close(asset_watch.fd);
+#endif
+}
+
+// Called once per frame on the main thread, while the render thread is idle (see render_thread.h)
+// and before anything reads textures or animations.
+// Returns whether an animation changed, instances playing it may have to be clamped
+bool apply_asset_reloads(SDL_Renderer *renderer)
+{
+	if (!asset_watch.mutex)
+		return false;
+
+	Asset_Reload reloads[ArrayCount(asset_watch.pending)];
+	SDL_LockMutex(asset_watch.mutex);
+	i32 reload_count = asset_watch.pending_count;
+	SDL_memcpy(reloads, asset_watch.pending, reload_count * sizeof(*reloads));
+	asset_watch.pending_count = 0;
+	SDL_UnlockMutex(asset_watch.mutex);
+
+	bool animation_changed = false;
+	for (i32 i = 0; i < reload_count; ++i) {
+		Asset_Reload *reload = &reloads[i];
+		Watched_Asset *asset = &asset_watch.assets[reload->asset];
+
+		switch (asset->kind) {
+			case ASSET_TEXTURE: {
+				Texture *texture = &textures[asset->index];
+				if (texture->width != reload->width || texture->height != reload->height) {
+					SDL_DestroyTexture(texture->tex);
+					texture->tex = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, reload->width, reload->height);
+					SDL_SetTextureBlendMode(texture->tex, SDL_BLENDMODE_BLEND);
+					texture->width = reload->width;
+					texture->height = reload->height;
+				}
+				if (SDL_UpdateTexture(texture->tex, nullptr, reload->pixels, reload->width * 4) < 0) {
+					SDL_Log("Asset watch: could not update %s: %s", asset->path, SDL_GetError());
+				}
+				stbi_image_free(reload->pixels);
+			} break;
+
+			case ASSET_ANIMATION: {
+				Animation *animation = animations[asset->index];
+				apply_animation_desc(renderer, reload->desc, animation);
+				bind_animation_states(animation, asset->path);
+				free_reload_desc(reload->desc);
+				animation_changed = true;
+			} break;
+		}
+
+		u64 applied_counter = SDL_GetPerformanceCounter();
+		SDL_Log("Reloaded %s in %.2f ms (decode %.2f ms, waited %.2f ms for the frame)", asset->path,
+				counter_to_ms(applied_counter - reload->changed_counter),
+				counter_to_ms(reload->decoded_counter - reload->changed_counter),
+				counter_to_ms(applied_counter - reload->decoded_counter));
+	}
+
+	// an .anims file may have pulled in a new sprite sheet
+	if (reload_count > 0)
+		watch_loaded_assets();
+	return animation_changed;
+}
@@ -0,0 +1,271 @@
+#pragma once
+
+// Entity storage.
+//
+// An entity is only a generational handle. Its data lives in one sparse set per component
+// type: a dense, tightly packed array of the components plus the entity each of them belongs
+// to, and a sparse array from entity index to dense index. Systems walk the dense arrays front
+// to back. When two pools hold the same entities in the same order (the common case, since
+// entities get their components when they are spawned and swap-removal moves the same entity
+// in every pool) the join is a straight walk over both arrays, otherwise it falls back to a
+// lookup through the sparse array.
+//
+// All of it is allocated up front for MAX_ENTITIES, nothing allocates while the game runs.
+
+typedef Handle Entity;
+
+constexpr u32 MAX_ENTITIES = 1 << 17;
+constexpr u32 ENTITY_NONE = 0xffffffff;
+
+struct Transform {
+	V2 pos;
+	V2 size;
+};
+
+struct Velocity {
+	V2 vel;
+	V2 accn;	// direction the entity wants to move in, normalized
+	r32 speed;
+};
+
+struct Sprite {
+	Animation_Playback playback;
+	bool flipped;
+};
+
+enum Collider_Kind {
+	COLLIDER_RECT,
+	COLLIDER_CAPSULE,
+};
+
+enum AI_State : u8 {
+	AI_IDLE,
+	AI_CHASE,
+	AI_ATTACK,
+};
+
+// See ai.h for how often brains think
+struct Brain {
+	AI_State state;
+	u8 lod;
+	u32 next_tick;		// first tick it is due to think again
+	r64 last_think;		// seconds
+};
+
+// Relative to the entity's transform, in fractions of its size, so that colliders scale along
+// with the sprite. a and b are min and max for rects and the two end points for capsules
+struct Collider {
+	Collider_Kind kind;
+	V2 a;
+	V2 b;
+	r32 radius;		// fraction of size.x
+};
+
+template <typename T>
+struct Component_Pool {
+	T *data;
+	u32 *entities;	// entity index of each component
+	u32 *sparse;	// dense index of each entity's component, ENTITY_NONE if it has none
+	u32 count;
+	u32 capacity;
+};
+
+struct World {
+	u32 *generations;
+	u32 *free_indices;
+	u32 free_count;
+	u32 next_index;
+	u32 alive_count;
+
+	Component_Pool<Transform> transforms;
+	Component_Pool<Velocity> velocities;
+	Component_Pool<Sprite> sprites;
+	Component_Pool<Collider> colliders;
+	Component_Pool<Brain> brains;
+};
+
+template <typename T>
+void component_pool_init(Component_Pool<T> *pool, Memory_Arena *arena, u32 capacity)
+{
+	pool->data = PushArrayNoZero(arena, T, capacity);
+	pool->entities = PushArrayNoZero(arena, u32, capacity);
+	pool->sparse = PushArrayNoZero(arena, u32, MAX_ENTITIES);
+	SDL_memset(pool->sparse, 0xff, MAX_ENTITIES * sizeof(u32));
+	pool->count = 0;
+	pool->capacity = capacity;
+}
+
+void world_init(World *world, Memory_Arena *arena)
+{
+	*world = {};
+	world->generations = PushArray(arena, u32, MAX_ENTITIES);
+	world->free_indices = PushArrayNoZero(arena, u32, MAX_ENTITIES);
+	component_pool_init(&world->transforms, arena, MAX_ENTITIES);
+	component_pool_init(&world->velocities, arena, MAX_ENTITIES);
+	component_pool_init(&world->sprites, arena, MAX_ENTITIES);
+	component_pool_init(&world->colliders, arena, MAX_ENTITIES);
+	component_pool_init(&world->brains, arena, MAX_ENTITIES);
+}
+
+inline bool entity_alive(World *world, Entity entity)
+{
+	return entity.index < world->next_index && world->generations[entity.index] == entity.generation;
+}
+
+Entity create_entity(World *world)
+{
+	u32 index;
+	if (world->free_count > 0) {
+		index = world->free_indices[--world->free_count];
+	} else {
+		if (world->next_index >= MAX_ENTITIES) {
+			fatal_error("Too many entities");
+		}
+		index = world->next_index++;
+		world->generations[index] = 1;
+	}
+	world->alive_count++;
+	return { index, world->generations[index] };
+}
+
+// nullptr when the entity has none, or when the handle is stale: its index may belong to another
+// entity by now
+template <typename T>
+inline T *get_component(World *world, Component_Pool<T> *pool, Entity entity)
+{
+	if (!entity_alive(world, entity))
+		return nullptr;
+	u32 dense = pool->sparse[entity.index];
+	return dense == ENTITY_NONE ? nullptr : &pool->data[dense];
+}
+
+template <typename T>
+T *add_component(World *world, Component_Pool<T> *pool, Entity entity, T value)
+{
+	assert(entity_alive(world, entity));
+	assert(pool->sparse[entity.index] == ENTITY_NONE);
+	assert(pool->count < pool->capacity);
+	u32 dense = pool->count++;
+	pool->data[dense] = value;
+	pool->entities[dense] = entity.index;
+	pool->sparse[entity.index] = dense;
+	return &pool->data[dense];
+}
+
+template <typename T>
+void remove_component(World *world, Component_Pool<T> *pool, Entity entity)
+{
+	assert(entity_alive(world, entity));
+	u32 dense = pool->sparse[entity.index];
+	if (dense == ENTITY_NONE)
+		return;
+	u32 last = --pool->count;
+	if (dense != last) {
+		pool->data[dense] = pool->data[last];
+		pool->entities[dense] = pool->entities[last];
+		pool->sparse[pool->entities[dense]] = dense;
+	}
+	pool->sparse[entity.index] = ENTITY_NONE;
+}
+
+void destroy_entity(World *world, Entity entity)
+{
+	if (!entity_alive(world, entity))
+		return;
+	remove_component(world, &world->transforms, entity);
+	remove_component(world, &world->velocities, entity);
+	remove_component(world, &world->sprites, entity);
+	remove_component(world, &world->colliders, entity);
+	remove_component(world, &world->brains, entity);
+
+	u32 generation = world->generations[entity.index] + 1;
+	world->generations[entity.index] = generation ? generation : 1;
+	world->free_indices[world->free_count++] = entity.index;
+	world->alive_count--;
+}
+
+// Component of the entity that owns pool_a's i-th component, with the lockstep fast path
+template <typename A, typename B>
+inline B *joined_component(Component_Pool<A> *pool_a, u32 i, Component_Pool<B> *pool_b)
+{
+	u32 entity = pool_a->entities[i];
+	if (i < pool_b->count && pool_b->entities[i] == entity)
+		return &pool_b->data[i];
+	u32 dense = pool_b->sparse[entity];
+	return dense == ENTITY_NONE ? nullptr : &pool_b->data[dense];
+}
+
+////////////////////////////////////////
+//				Systems
+
+void integrate_velocities(World *world, r32 dt)
+{
+	Component_Pool<Velocity> *velocities = &world->velocities;
+	for (u32 i = 0; i < velocities->count; ++i) {
+		Transform *transform = joined_component(velocities, i, &world->transforms);
+		if (!transform)
+			continue;
+		Velocity *velocity = &velocities->data[i];
+		velocity->vel = velocity->speed * velocity->accn;
+		transform->pos += velocity->vel * dt;
+	}
+}
+
+Rect collider_rect(Collider *collider, Transform *transform)
+{
+	assert(collider->kind == COLLIDER_RECT);
+	return { transform->pos + collider->a * transform->size, transform->pos + collider->b * transform->size };
+}
+
+Capsule collider_capsule(Collider *collider, Transform *transform)
+{
+	assert(collider->kind == COLLIDER_CAPSULE);
+	Capsule result;
+	result.a = transform->pos + collider->a * transform->size;
+	result.b = transform->pos + collider->b * transform->size;
+	result.radius = collider->radius * transform->size.x;
+	return result;
+}
+
+//				Systems
+////////////////////////////////////////
+
+////////////////////////////////////////
+//				Interpolation
+
+// Where the transforms were before the last tick. A frame is drawn somewhere in between two
+// ticks, blending the two keeps motion smooth when the frame rate and the tick rate don't line up
+struct Previous_Positions {
+	V2 *pos;
+	u32 *entities;	// of each position, the pool may have been reordered since
+	u32 count;
+};
+
+void previous_positions_init(Previous_Positions *previous, Memory_Arena *arena, u32 capacity)
+{
+	previous->pos = PushArrayNoZero(arena, V2, capacity);
+	previous->entities = PushArrayNoZero(arena, u32, capacity);
+	previous->count = 0;
+}
+
+void save_previous_positions(Previous_Positions *previous, Component_Pool<Transform> *transforms)
+{
+	previous->count = transforms->count;
+	for (u32 i = 0; i < transforms->count; ++i) {
+		previous->pos[i] = transforms->data[i].pos;
+	}
+	SDL_memcpy(previous->entities, transforms->entities, transforms->count * sizeof(u32));
+}
+
+// Where to draw the i-th transform, alpha of the way from the previous tick to the last one
+inline V2 interpolated_position(Previous_Positions *previous, Component_Pool<Transform> *transforms, u32 i, r32 alpha)
+{
+	V2 pos = transforms->data[i].pos;
+	// spawned or moved in the pool since, drawn where it is for this one frame
+	if (i >= previous->count || previous->entities[i] != transforms->entities[i])
+		return pos;
+	return lerp(previous->pos[i], alpha, pos);
+}
+
+//				Interpolation
+////////////////////////////////////////
@@ -0,0 +1,191 @@
+#pragma once
+
+// Gameplay input.
+//
+// SDL stamps every event with when it happened, not when it was polled. Key and button events
+// bound to an Action go into a ring with that timestamp, and every fixed tick takes the ones that
+// happened before the tick ends. A press early in a long frame then lands in the tick that covers
+// it instead of in the first tick of the next frame, and events newer than the last tick of a
+// frame wait in the ring for the next one.
+//
+// Everything else (editor, debug keys) still reads the per-frame Input.
+//
+// Presses keep their timestamp after a tick took them, until the frame showing what they did is
+// presented. That is what the input to photon histograms are made of.
+
+constexpr u32 INPUT_RING_SIZE = 256;	// power of two
+constexpr i32 MAX_UNSHOWN_PRESSES = 64;
+constexpr i32 LATENCY_HISTOGRAM_MS = 200;
+
+struct Input_Event {
+	u32 timestamp;	// SDL_GetTicks() time
+	Action action;
+	bool down;
+};
+
+struct Key_Binding {
+	SDL_Scancode key;
+	Action action;
+};
+
+const Key_Binding key_bindings[] = {
+	{ SDL_SCANCODE_W, ACTION_MOVE_UP },
+	{ SDL_SCANCODE_A, ACTION_MOVE_LEFT },
+	{ SDL_SCANCODE_S, ACTION_MOVE_DOWN },
+	{ SDL_SCANCODE_D, ACTION_MOVE_RIGHT },
+	{ SDL_SCANCODE_E, ACTION_ATTACK },
+	{ SDL_SCANCODE_SPACE, ACTION_JUMP },
+	{ SDL_SCANCODE_LCTRL, ACTION_CROUCH },
+};
+
+// One bucket per millisecond, the last one gets everything longer
+struct Latency_Histogram {
+	u32 buckets[LATENCY_HISTOGRAM_MS];
+	u32 count;
+};
+
+// Of the presses taken so far
+struct Input_Latency {
+	u32 presses;
+	r64 latency_sum_ms;		// from the press to the tick that got it actually running
+	r32 peak_latency_ms;
+	r64 tick_error_sum_ms;	// between the press and the simulated time of the tick that got it
+	r64 frame_error_sum_ms;	// same, had it gone into the first tick of the frame that polled it
+
+	Latency_Histogram to_submit;	// from the press to the frame showing it being handed to the render thread
+	Latency_Histogram to_present;	// to SDL_RenderPresent returning, which includes waiting for vsync
+};
+
+struct Input_Ring {
+	Input_Event events[INPUT_RING_SIZE];
+	u32 read;
+	u32 write;		// both only count up, masked when indexing
+	u32 dropped;	// found the ring full
+	u32 held;		// Action bits, as of the last event taken
+	Input_Latency latency;
+
+	// timestamps of the presses ticks took since the last submitted frame
+	u32 unshown[MAX_UNSHOWN_PRESSES];
+	i32 unshown_count;
+};
+
+void push_input_event(Input_Ring *ring, u32 timestamp, Action action, bool down)
+{
+	if (ring->write - ring->read == INPUT_RING_SIZE) {
+		ring->dropped++;
+		return;
+	}
+	ring->events[ring->write++ & (INPUT_RING_SIZE - 1)] = { timestamp, action, down };
+}
+
+// Pushes the event when the key is bound to an action
+void push_key_event(Input_Ring *ring, SDL_KeyboardEvent *key)
+{
+	if (key->repeat)
+		return;
+	for (const Key_Binding &binding : key_bindings) {
+		if (binding.key == key->keysym.scancode)
+			push_input_event(ring, key->timestamp, binding.action, key->type == SDL_KEYDOWN);
+	}
+}
+
+// Input of the tick simulating [tick_start, tick_end), in SDL_GetTicks() time. frame_start is
+// where the first tick of the frame starts and now when the tick runs, both only for the latency.
+// An action held at any point of the tick counts as held for all of it, so a tap shorter than a
+// tick isn't lost
+Tick_Input take_tick_input(Input_Ring *ring, r64 tick_start, r64 tick_end, r64 frame_start, u32 now)
+{
+	Tick_Input result = { ring->held, 0 };
+	while (ring->read != ring->write) {
+		Input_Event *event = &ring->events[ring->read & (INPUT_RING_SIZE - 1)];
+		if (event->timestamp >= tick_end)
+			break;
+		ring->read++;
+
+		u32 bit = 1 << event->action;
+		if (!event->down) {
+			ring->held &= ~bit;
+			continue;
+		}
+		ring->held |= bit;
+		result.held |= bit;
+		result.pressed |= bit;
+
+		Input_Latency *latency = &ring->latency;
+		r32 latency_ms = (r32) (i32) (now - event->timestamp);
+		latency->presses++;
+		latency->latency_sum_ms += latency_ms;
+		latency->peak_latency_ms = Max(latency->peak_latency_ms, latency_ms);
+		latency->tick_error_sum_ms += fabs(event->timestamp - tick_start);
+		latency->frame_error_sum_ms += fabs(event->timestamp - frame_start);
+		if (ring->unshown_count < MAX_UNSHOWN_PRESSES)
+			ring->unshown[ring->unshown_count++] = event->timestamp;
+	}
+	return result;
+}
+
+inline void add_latency_sample(Latency_Histogram *histogram, i32 ms)
+{
+	histogram->buckets[Clamp(0, ms, LATENCY_HISTOGRAM_MS - 1)]++;
+	histogram->count++;
+}
+
+// Upper edge of the bucket the fraction of the samples falls in, in milliseconds
+r32 latency_percentile(Latency_Histogram *histogram, r32 fraction)
+{
+	u32 target = (u32) ceilf(fraction * histogram->count);
+	u32 sum = 0;
+	for (i32 i = 0; i < LATENCY_HISTOGRAM_MS; ++i) {
+		sum += histogram->buckets[i];
+		if (sum >= target && sum > 0)
+			return (r32) (i + 1);
+	}
+	return 0;
+}
+
+// Moves the presses ticks took since the last call into presses, for the frame that shows them
+i32 take_unshown_presses(Input_Ring *ring, u32 *presses)
+{
+	i32 count = ring->unshown_count;
+	SDL_memcpy(presses, ring->unshown, count * sizeof(u32));
+	ring->unshown_count = 0;
+	return count;
+}
+
+// Call with the presses the frame showed, when it was handed to the renderer and when
+// SDL_RenderPresent returned
+void record_presented_input(Input_Ring *ring, const u32 *presses, i32 count, u32 submitted, u32 presented)
+{
+	for (i32 i = 0; i < count; ++i) {
+		add_latency_sample(&ring->latency.to_submit, (i32) (submitted - presses[i]));
+		add_latency_sample(&ring->latency.to_present, (i32) (presented - presses[i]));
+	}
+}
+
+// The histograms as CSV, one row per millisecond
+bool dump_input_latency(Input_Ring *ring, const char *path)
+{
+	SDL_RWops *out = SDL_RWFromFile(path, "wb");
+	if (!out)
+		return false;
+	Text_Writer writer = { out };
+
+	Input_Latency *latency = &ring->latency;
+	write_text(&writer, "ms,to_submit,to_present\n");
+	for (i32 i = 0; i < LATENCY_HISTOGRAM_MS; ++i) {
+		write_text(&writer, "%d,%u,%u\n", i, latency->to_submit.buckets[i], latency->to_present.buckets[i]);
+	}
+	SDL_RWclose(out);
+	return !writer.failed;
+}
+
+void log_input_latency(Input_Ring *ring)
+{
+	Input_Latency *latency = &ring->latency;
+	if (latency->presses == 0)
+		return;
+	SDL_Log("Input: %u presses reached the simulation after %.1f ms on average (peak %.1f), %u dropped",
+			latency->presses, latency->latency_sum_ms / latency->presses, latency->peak_latency_ms, ring->dropped);
+	SDL_Log("Input: presses were %.1f ms off the tick they went into, %.1f ms when sampled once per frame",
+			latency->tick_error_sum_ms / latency->presses, latency->frame_error_sum_ms / latency->presses);
+}
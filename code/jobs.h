@@ -0,0 +1,387 @@
+#pragma once
+
+// Job system.
+//
+// A job is a function and a range of indices to run it over. Every worker has a deque of jobs:
+// it pushes and pops at the bottom, and when its own deque is empty it steals from the top of
+// someone else's, so the oldest (usually biggest) jobs move between workers and the newest stay
+// where they are warm in the cache. Worker 0 is the thread that created the system, it only runs
+// jobs while it waits for some (see wait_for_counter), the others are threads that sleep when
+// there is nothing to steal anywhere.
+//
+// Completion is tracked with counters: a counter counts the jobs that were started with it and
+// haven't finished yet. Waiting for one runs other jobs in the meantime, so jobs may wait for
+// the jobs they started without tying up a thread. Jobs can also be held back until a counter
+// reaches zero (run_jobs_after), which is how one batch depends on another.
+//
+// Deques are guarded by a spin lock each. They are only held to copy a job in or out, so the
+// lock is hardly ever contended and much simpler than a lock free deque.
+
+constexpr i32 MAX_JOB_WORKERS = 64;
+constexpr u32 JOB_QUEUE_SIZE = 4096;	// power of two
+constexpr i32 MAX_PARALLEL_FOR_JOBS = 256;
+constexpr i32 JOB_SPIN_COUNT = 1000;	// looks for work this many times before a worker sleeps
+
+// Runs over [begin, end)
+typedef void Job_Proc(void *data, u32 begin, u32 end);
+
+struct Job_Counter;
+
+struct Job {
+	Job_Proc *proc;
+	void *data;
+	u32 begin;
+	u32 end;
+	Job_Counter *counter;
+	const char *name;	// for the instrumentation hook
+};
+
+struct Job_Counter {
+	SDL_atomic_t pending;
+	SDL_SpinLock lock;
+	// started once pending reaches zero
+	const Job *next;
+	i32 next_count;
+	Job_Counter *next_counter;
+};
+
+// Called after every job with when it started and ended (performance counter values), on the
+// thread that ran it
+typedef void Job_Hook(const Job *job, i32 worker, u64 start, u64 end, void *context);
+
+struct Job_Queue {
+	SDL_SpinLock lock;
+	SDL_atomic_t size;	// to skip empty queues without taking the lock
+	u32 top;			// stolen from
+	u32 bottom;			// pushed and popped by the owner
+	Job jobs[JOB_QUEUE_SIZE];
+};
+
+struct Job_Worker_Stats {
+	u32 jobs;
+	u32 stolen;			// of the jobs, from another worker
+	u64 busy_counter;	// running them
+};
+
+struct Job_System;
+
+struct Job_Worker {
+	Job_System *system;
+	i32 index;
+	u32 random;			// picks whom to steal from
+	SDL_Thread *thread;
+	Job_Queue queue;
+	Job_Worker_Stats stats;
+};
+
+struct Job_System {
+	Job_Worker *workers;
+	i32 worker_count;
+	SDL_atomic_t queued;	// jobs in all queues together
+	SDL_atomic_t sleeping;
+	SDL_atomic_t running;
+	SDL_sem *wake;
+
+	Job_Hook *hook;
+	void *hook_context;
+};
+
+// Which worker of its system the thread is, threads that aren't a worker count as worker 0
+thread_local i32 job_worker_index = 0;
+
+inline bool push_job(Job_Queue *queue, const Job *job)
+{
+	SDL_AtomicLock(&queue->lock);
+	bool pushed = queue->bottom - queue->top < JOB_QUEUE_SIZE;
+	if (pushed) {
+		queue->jobs[queue->bottom++ & (JOB_QUEUE_SIZE - 1)] = *job;
+		SDL_AtomicAdd(&queue->size, 1);
+	}
+	SDL_AtomicUnlock(&queue->lock);
+	return pushed;
+}
+
+inline bool pop_job(Job_Queue *queue, Job *job)
+{
+	if (SDL_AtomicGet(&queue->size) == 0)
+		return false;
+	SDL_AtomicLock(&queue->lock);
+	bool popped = queue->bottom != queue->top;
+	if (popped) {
+		*job = queue->jobs[--queue->bottom & (JOB_QUEUE_SIZE - 1)];
+		SDL_AtomicAdd(&queue->size, -1);
+	}
+	SDL_AtomicUnlock(&queue->lock);
+	return popped;
+}
+
+inline bool steal_job(Job_Queue *queue, Job *job)
+{
+	if (SDL_AtomicGet(&queue->size) == 0)
+		return false;
+	SDL_AtomicLock(&queue->lock);
+	bool stolen = queue->bottom != queue->top;
+	if (stolen) {
+		*job = queue->jobs[queue->top++ & (JOB_QUEUE_SIZE - 1)];
+		SDL_AtomicAdd(&queue->size, -1);
+	}
+	SDL_AtomicUnlock(&queue->lock);
+	return stolen;
+}
+
+inline Job_Worker *current_job_worker(Job_System *system)
+{
+	return &system->workers[job_worker_index < system->worker_count ? job_worker_index : 0];
+}
+
+void wake_job_workers(Job_System *system, i32 count)
+{
+	i32 sleeping = SDL_AtomicGet(&system->sleeping);
+	for (i32 i = 0; i < Min(count, sleeping); ++i) {
+		SDL_SemPost(system->wake);
+	}
+}
+
+void queue_jobs(Job_System *system, const Job *jobs, i32 count, Job_Counter *counter);
+
+// The counter may live on the stack of whoever waits for it, so once it reached zero it must not
+// be touched anymore. The last job takes it to zero under its lock, and waiters take the lock
+// once before they return (see wait_for_counter), so they can't return before it lets go
+void finish_job(Job_System *system, Job_Counter *counter)
+{
+	if (!counter)
+		return;
+	for (;;) {
+		int pending = SDL_AtomicGet(&counter->pending);
+		assert(pending > 0);
+		if (pending > 1) {
+			if (SDL_AtomicCAS(&counter->pending, pending, pending - 1))
+				return;
+			continue;
+		}
+		SDL_AtomicLock(&counter->lock);
+		if (SDL_AtomicCAS(&counter->pending, 1, 0))
+			break;
+		// more jobs were counted in the meantime
+		SDL_AtomicUnlock(&counter->lock);
+	}
+	const Job *next = counter->next;
+	i32 next_count = counter->next_count;
+	Job_Counter *next_counter = counter->next_counter;
+	counter->next = nullptr;
+	counter->next_count = 0;
+	SDL_AtomicUnlock(&counter->lock);
+	if (next)
+		queue_jobs(system, next, next_count, next_counter);
+}
+
+void run_job(Job_System *system, Job_Worker *worker, Job *job)
+{
+	u64 start = SDL_GetPerformanceCounter();
+	job->proc(job->data, job->begin, job->end);
+	u64 end = SDL_GetPerformanceCounter();
+	worker->stats.jobs++;
+	worker->stats.busy_counter += end - start;
+	if (system->hook)
+		system->hook(job, worker->index, start, end, system->hook_context);
+	finish_job(system, job->counter);
+}
+
+// Runs one job of the worker's own queue, or one stolen from another. Returns false when there
+// was none
+bool run_next_job(Job_System *system, Job_Worker *worker)
+{
+	Job job;
+	bool found = pop_job(&worker->queue, &job);
+	if (!found) {
+		worker->random ^= worker->random << 13;
+		worker->random ^= worker->random >> 17;
+		worker->random ^= worker->random << 5;
+		i32 first = (i32) (worker->random % (u32) system->worker_count);
+		for (i32 i = 0; i < system->worker_count && !found; ++i) {
+			Job_Worker *victim = &system->workers[(first + i) % system->worker_count];
+			if (victim != worker)
+				found = steal_job(&victim->queue, &job);
+		}
+		if (found)
+			worker->stats.stolen++;
+	}
+	if (!found)
+		return false;
+	SDL_AtomicAdd(&system->queued, -1);
+	run_job(system, worker, &job);
+	return true;
+}
+
+int job_worker_thread(void *data)
+{
+	Job_Worker *worker = (Job_Worker *) data;
+	Job_System *system = worker->system;
+	job_worker_index = worker->index;
+	char name[32];
+	SDL_snprintf(name, sizeof(name), "job worker %d", worker->index);
+	set_profile_thread_name(name);
+	while (SDL_AtomicGet(&system->running)) {
+		if (run_next_job(system, worker))
+			continue;
+		bool found = false;
+		for (i32 i = 0; i < JOB_SPIN_COUNT && !found; ++i) {
+			found = SDL_AtomicGet(&system->queued) > 0;
+		}
+		if (found)
+			continue;
+		// counted as sleeping before looking once more, so that a push either sees this worker
+		// sleeping or this worker sees the push
+		SDL_AtomicAdd(&system->sleeping, 1);
+		if (SDL_AtomicGet(&system->queued) == 0 && SDL_AtomicGet(&system->running))
+			SDL_SemWait(system->wake);
+		SDL_AtomicAdd(&system->sleeping, -1);
+	}
+	return 0;
+}
+
+// worker_count includes the calling thread, with 1 every job runs on it while it waits
+void job_system_init(Job_System *system, Memory_Arena *arena, i32 worker_count)
+{
+	*system = {};
+	worker_count = Clamp(1, worker_count, MAX_JOB_WORKERS);
+	system->workers = PushArray(arena, Job_Worker, worker_count);
+	system->worker_count = worker_count;
+	system->wake = SDL_CreateSemaphore(0);
+	SDL_AtomicSet(&system->running, 1);
+	for (i32 i = 0; i < worker_count; ++i) {
+		Job_Worker *worker = &system->workers[i];
+		worker->system = system;
+		worker->index = i;
+		worker->random = 0x9e3779b9u * (i + 1);
+	}
+	for (i32 i = 1; i < worker_count; ++i) {
+		Job_Worker *worker = &system->workers[i];
+		worker->thread = SDL_CreateThread(job_worker_thread, "job worker", worker);
+		if (!worker->thread) {
+			SDL_Log("Could not start job worker %d: %s", i, SDL_GetError());
+		}
+	}
+}
+
+void job_system_shutdown(Job_System *system)
+{
+	SDL_AtomicSet(&system->running, 0);
+	for (i32 i = 1; i < system->worker_count; ++i) {
+		SDL_SemPost(system->wake);
+	}
+	for (i32 i = 1; i < system->worker_count; ++i) {
+		if (system->workers[i].thread)
+			SDL_WaitThread(system->workers[i].thread, nullptr);
+		system->workers[i].thread = nullptr;
+	}
+	SDL_DestroySemaphore(system->wake);
+	system->wake = nullptr;
+}
+
+// Queues the jobs on the calling thread's worker, they have to be counted in counter already. Jobs
+// that don't fit in the queue run right away
+void queue_jobs(Job_System *system, const Job *jobs, i32 count, Job_Counter *counter)
+{
+	Job_Worker *worker = current_job_worker(system);
+	i32 pushed = 0;
+	for (i32 i = 0; i < count; ++i) {
+		Job job = jobs[i];
+		job.counter = counter;
+		if (push_job(&worker->queue, &job)) {
+			pushed++;
+			SDL_AtomicAdd(&system->queued, 1);
+			continue;
+		}
+		wake_job_workers(system, pushed);
+		pushed = 0;
+		run_job(system, worker, &job);
+	}
+	wake_job_workers(system, pushed);
+}
+
+// Runs the jobs on whichever worker gets to them first, counting them in counter (may be nullptr)
+void run_jobs(Job_System *system, const Job *jobs, i32 count, Job_Counter *counter)
+{
+	if (counter)
+		SDL_AtomicAdd(&counter->pending, count);
+	queue_jobs(system, jobs, count, counter);
+}
+
+// Starts the jobs once after is done. The jobs are copied only then, so they have to stay where
+// they are until after reached zero. One batch per counter
+void run_jobs_after(Job_System *system, Job_Counter *after, const Job *jobs, i32 count, Job_Counter *counter)
+{
+	// counted right away, so that waiting for counter also waits for after
+	SDL_AtomicAdd(&counter->pending, count);
+	SDL_AtomicLock(&after->lock);
+	bool ready = SDL_AtomicGet(&after->pending) == 0;
+	if (!ready) {
+		assert(!after->next);
+		after->next = jobs;
+		after->next_count = count;
+		after->next_counter = counter;
+	}
+	SDL_AtomicUnlock(&after->lock);
+	if (ready)
+		queue_jobs(system, jobs, count, counter);
+}
+
+// Runs jobs until the counter reached zero. Afterwards the jobs are done with it, it can go out of
+// scope
+void wait_for_counter(Job_System *system, Job_Counter *counter)
+{
+	Job_Worker *worker = current_job_worker(system);
+	while (SDL_AtomicGet(&counter->pending) > 0) {
+		run_next_job(system, worker);
+	}
+	// the last job may still hold the lock, handing off what runs after the counter
+	SDL_AtomicLock(&counter->lock);
+	SDL_AtomicUnlock(&counter->lock);
+}
+
+// Runs proc over [0, count) in batches of batch indices, or of a multiple of it when that would
+// make too many jobs. The calling thread takes the first batch and helps with the others
+void parallel_for(Job_System *system, const char *name, u32 count, u32 batch, Job_Proc *proc, void *data)
+{
+	if (count == 0)
+		return;
+	batch = Max(batch, 1u);
+	u32 min_batch = (count + MAX_PARALLEL_FOR_JOBS - 1) / MAX_PARALLEL_FOR_JOBS;
+	if (batch < min_batch)
+		batch = (min_batch + batch - 1) / batch * batch;
+	if (count <= batch || system->worker_count == 1) {
+		Job job = { proc, data, 0, count, nullptr, name };
+		run_job(system, current_job_worker(system), &job);
+		return;
+	}
+
+	Job jobs[MAX_PARALLEL_FOR_JOBS];
+	i32 job_count = 0;
+	for (u32 begin = batch; begin < count; begin += batch) {
+		jobs[job_count++] = { proc, data, begin, Min(begin + batch, count), nullptr, name };
+	}
+	Job_Counter counter = {};
+	run_jobs(system, jobs, job_count, &counter);
+	Job first = { proc, data, 0, batch, nullptr, name };
+	run_job(system, current_job_worker(system), &first);
+	wait_for_counter(system, &counter);
+}
+
+#if PROFILER_ENABLED
+// Puts every job in the profile as a zone named after it
+void profile_job_hook(const Job *job, i32 worker, u64 start, u64 end, void *context)
+{
+	add_profile_event(job->name, start, end);
+}
+#else
+#define profile_job_hook nullptr
+#endif
+
+void log_job_stats(Job_System *system)
+{
+	for (i32 i = 0; i < system->worker_count; ++i) {
+		Job_Worker_Stats *stats = &system->workers[i].stats;
+		SDL_Log("Jobs: worker %d ran %u jobs (%u stolen), busy %.2f ms", i, stats->jobs, stats->stolen, counter_to_ms(stats->busy_counter));
+	}
+}
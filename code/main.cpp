@@ -9,17 +9,6 @@
 		- Can't afford to call GJK between each pair of existing colliders
 		- Use something akin to an AABB (or even quad trees in the future) to get list 
 		  of possible collisions and finally test the collisions and resolve if required
-	* Tileset editor or maybe just a level editor
-		- maybe use bitmasks to make them blend automatically, something akin to cellular 
-		  automata by counting the neighbours.
-	* Re-think the animation system: Maybe use animation queues?
-	  - essentially each animation knows if it is a one shot thing or not, 
-	    as well as how much time it has to be played for and possibly if it can be interrupted
-	  - so if we want to play an animation, we simply queue it up in the buffer of the enumeration 
-	    values on which animation to play next
-	  - then while updating the animation, if it is interruptable, we interrupt it, if its a one shot we
-	    switch back to the idle animation, and finally if its a loopable animation, we just replay it.
-	* Re think the InputAction buffer.
 	* Font rendering
 */
 
@@ -50,14 +39,22 @@ void log_error(const char *message, SDL_Window *window = nullptr) {
 #include "ren_math.h"
 // TODO: Add support for something like Option<T>?
 #include "ren_string.h"
+#include "ren_memory.h"
+#include "ren_array.h"
 #include <string.h>
 
+// route stb's allocations through the tagged heap so they show up in the memory stats
+#define STBI_MALLOC(size) tagged_malloc(MEMORY_TAG_ASSETS, size)
+#define STBI_REALLOC(ptr, size) tagged_realloc(MEMORY_TAG_ASSETS, ptr, size)
+#define STBI_FREE(ptr) tagged_free(ptr)
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb_write.h>
 
+#define STBTT_malloc(size, user) ((void) (user), tagged_malloc(MEMORY_TAG_FONTS, size))
+#define STBTT_free(ptr, user) ((void) (user), tagged_free(ptr))
 #define STB_TRUETYPE_IMPLEMENTATION
 #include "stb_truetype.h"
 
@@ -86,8 +83,8 @@ inline bool is_released(Input *input, SDL_Scancode key) {
 	return !input->is_down[key] && input->was_down[key];
 }
 
-// NOTE: Animations need to be defined in order as they appear in the animation file
-// TODO: Maybe use hashmaps to not do this?
+// NOTE: These are only the ids used by the code, the order of the states in the animation
+// file doesn't matter. They are bound by name when the file is loaded (see bind_animation_states)
 enum {
 	PLAYER_ANIMATION_IDLE,
 	PLAYER_ANIMATION_CROUCH,
@@ -107,6 +104,22 @@ enum {
 	COUNT_ENEMY_ANIMATION
 };
 
+// Name of an animation state as written before the ':' in the .anims file, hashed at compile time
+struct Animation_Name {
+	const char *name;
+	u32 id;
+
+	consteval Animation_Name(const char *_name) : name(_name), id(hash_string(_name)) {}
+};
+
+constexpr Animation_Name player_animation_names[COUNT_PLAYER_ANIMATION] = {
+	"IDLE", "CROUCH", "RUN", "ATK1", "ATK2", "ATK3",
+};
+
+constexpr Animation_Name enemy_animation_names[COUNT_ENEMY_ANIMATION] = {
+	"IDLE", "WALK", "ATK",
+};
+
 // TODO: Maybe refactor this? Look into Zero's actual animation frame idea
 struct AnimationFrame {
 	i32 start_frame_index;
@@ -114,29 +127,56 @@ struct AnimationFrame {
 	i32 texture_index;
 };
 
+constexpr i32 MAX_ASSET_PATH = 256;
+constexpr i32 MAX_ANIMATION_STATES = 32;
+constexpr i32 MAX_ANIMATION_TEXTURES = 8;
+constexpr i32 MAX_ANIMATION_NAME = 32;
+constexpr i32 ANIMATION_STATE_TABLE_SIZE = 64; // power of 2, at least twice MAX_ANIMATION_STATES
+
+// Parsed contents of an .anims file, before any texture is loaded
+struct Animation_Desc {
+	AnimationFrame frames[MAX_ANIMATION_STATES]; // texture_index points into texture_paths
+	char state_names[MAX_ANIMATION_STATES][MAX_ANIMATION_NAME];
+	u32 state_ids[MAX_ANIMATION_STATES];
+	char texture_paths[MAX_ANIMATION_TEXTURES][MAX_ASSET_PATH];
+	i32 texture_path_count;
+	i32 frame_count;
+	i32 width;
+	i32 height;
+	r32 frame_duration; // seconds
+	i32 default_state;
+};
+
 struct Animation {
 	AnimationFrame *frames;
 	i32 frame_count;
+	i32 frame_capacity;
 	i32 width;
 	i32 height;
-	i32 count_till_update;
-	i32 update_counter;
-	i32 state;
-	i32 current_animation_frame;
+	r32 frame_duration; // seconds
+	r32 frames_per_second;
 	i32 default_state; // default animation to return to after one shot
-	bool one_shot;
-};
 
-struct Actor {
-	V2 pos;
-	V2 size;
-	V2 vel;
-	V2 accn;
-	Animation *animation;
-	i32 combo; // only used for the player
-	bool flipped;
+	// open addressing table from hashed state name to state, 0 marks an empty slot
+	u32 state_table_ids[ANIMATION_STATE_TABLE_SIZE];
+	i8 state_table_states[ANIMATION_STATE_TABLE_SIZE];
+
+	// the ids the code refers to this animation with, resolved to states at load time
+	const Animation_Name *names;
+	i32 name_count;
+	i32 bound_states[MAX_ANIMATION_STATES];
 };
 
+r32 counter_to_ms(u64 counter)
+{
+	return (r32) (1000.0 * (r64) counter / (r64) SDL_GetPerformanceFrequency());
+}
+
+#include "animation.h"
+#include "entity.h"
+#include "profiler.h"
+#include "jobs.h"
+
 enum Action {
 	ACTION_NONE,
 	ACTION_MOVE_LEFT,
@@ -159,17 +199,26 @@ struct InputAction {
 /////////////////////////////////////////////////////////
 ////////////            globals
 
-// TODO: Pool this into an allocator
-// TODO: Turn them into array_view as well
-Animation animations[256];
-i32 animation_count;
-AnimationFrame animation_frame_buffer[256] = {};
-i32 animation_frame_buffer_count = 0;
-Texture textures[64];
-i32 texture_count = 0;
-
-InputAction buffer_actions[16];
-int buffer_action_size = 0;
+// Lives for the whole run: animations, textures and everything else about loaded assets
+Memory_Arena permanent_arena;
+Memory_Arena world_arena;
+Memory_Arena particle_arena;
+Memory_Arena navigation_arena;
+Memory_Arena level_arena;
+Memory_Arena font_arena;
+Memory_Arena physics_arena;
+// The ticks F4 can go back to, see simulation.h
+Memory_Arena snapshot_arena;
+// Render lists, see render_thread.h
+Memory_Arena render_arena;
+// Reset at the start of every frame, also used as scratch memory while loading
+Memory_Arena frame_arena;
+
+// The animations themselves live in the permanent arena so that pointers to them stay valid
+Array<Animation *> animations;
+Array<const char *> animation_paths;
+Array<Texture> textures;
+Array<const char *> texture_paths;
 
 //TODO: Better camera system
 V2 camera;
@@ -179,23 +228,39 @@ V2 resolution;
 /////////////////////////////////////////////////////////
 
 // TODO: Make this platform dependent?
-String read_entire_file(const char *filename)
+// Same as read_entire_file, but reports failure instead of exiting so that it can be used
+// for files that may be in the middle of being written (see asset_watch.h)
+bool try_read_entire_file(Memory_Arena *arena, const char *filename, String *result)
 {
 	SDL_RWops *rwio = SDL_RWFromFile(filename, "rb");
 	if (rwio == nullptr) {
-		fatal_error(SDL_GetError(), nullptr);
+		return false;
 	}
 	Sint64 size = rwio->size(rwio);
-	u8 *file_content = (u8*) SDL_malloc(sizeof(*file_content) * (size + 1));
+	if (size < 0) {
+		rwio->close(rwio);
+		return false;
+	}
+	u8 *file_content = PushArrayNoZero(arena, u8, size + 1);
 	SDL_ClearError();
 	size_t n = rwio->read(rwio, file_content, size, 1);
-	const char *error = SDL_GetError();
-	if (*error != 0 && n == 0) {
-		fatal_error(error, nullptr);
-	}
+	bool failed = *SDL_GetError() != 0 && n == 0;
 	rwio->close(rwio);
+	if (failed) {
+		deallocate(arena_allocator(arena), file_content, size + 1);
+		return false;
+	}
 	file_content[size] = 0;
-	String result(file_content, size);
+	*result = String(file_content, size);
+	return true;
+}
+
+String read_entire_file(Memory_Arena *arena, const char *filename)
+{
+	String result;
+	if (!try_read_entire_file(arena, filename, &result)) {
+		fatal_error(SDL_GetError(), nullptr);
+	}
 	return result;
 }
 
@@ -203,11 +268,13 @@ Texture load_texture(SDL_Renderer *renderer, const char *filename)
 {
 	Texture result = {};
 	i32 w, h;
-	String file_content = read_entire_file(filename);
+	Temp_Memory temp = begin_temp_memory(&frame_arena);
+	String file_content = read_entire_file(&frame_arena, filename);
 
+	// TODO: stb_image still mallocs internally, only happens while loading though
 	u8 *data = stbi_load_from_memory(file_content.data, (i32) file_content.len, &w, &h, nullptr, 4);
 
-	SDL_free(file_content.data);
+	end_temp_memory(temp);
 
 	if (data == nullptr) {
 		fatal_error(stbi_failure_reason(), nullptr);
@@ -225,16 +292,29 @@ Texture load_texture(SDL_Renderer *renderer, const char *filename)
 	return result;
 }
 
-void display_frame(SDL_Renderer *renderer, Texture *textures, Actor* actor)
+i32 find_or_load_texture(SDL_Renderer *renderer, const char *filename)
 {
-	Animation *animation = actor->animation;
+	for (i32 i = 0; i < texture_paths.count; ++i) {
+		if (SDL_strcmp(texture_paths[i], filename) == 0)
+			return i;
+	}
+	array_add(&textures, load_texture(renderer, filename));
+	array_add(&texture_paths, (const char *) arena_push_string(&permanent_arena, String(filename, SDL_strlen(filename))).data);
+	return (i32) textures.count - 1;
+}
+
+#include "render_list.h"
+
+void display_frame(Render_List *list, Array_View<Texture> textures, Transform *transform, Sprite *sprite)
+{
+	Animation *animation = sprite->playback.animation;
+	AnimationFrame *frame = &animation->frames[sprite->playback.state];
 	// HACK: Simplify this (or even think up a better solution)
-	i32 frame_index = animation->current_animation_frame +
-		animation->frames[animation->state].start_frame_index;
+	i32 frame_index = sprite->playback.frame + frame->start_frame_index;
 	i32 index_x = (frame_index) %
-		(i32) (textures[animation->frames[animation->state].texture_index].width / animation->width);
+		(i32) (textures[frame->texture_index].width / animation->width);
 	i32 index_y = (frame_index) /
-		(i32) (textures[animation->frames[animation->state].texture_index].width / animation->width);
+		(i32) (textures[frame->texture_index].width / animation->width);
 
 	SDL_Rect src_rect = {};
 	src_rect.x = index_x * animation->width;
@@ -242,35 +322,57 @@ void display_frame(SDL_Renderer *renderer, Texture *textures, Actor* actor)
 	src_rect.w = animation->width;
 	src_rect.h = animation->height;
 
-	SDL_FRect dest_rect = { actor->pos.x - camera.x + resolution.x / 2.f, actor->pos.y - camera.y + resolution.y / 2.f,  actor->size.x, actor->size.y };
+	SDL_FRect dest_rect = { transform->pos.x - camera.x + resolution.x / 2.f, transform->pos.y - camera.y + resolution.y / 2.f,  transform->size.x, transform->size.y };
 
-	//SDL_RenderCopyF(renderer, textures[animation->frames[animation->state].texture_index].tex, &src_rect, &dest_rect);
-	SDL_RenderCopyExF(renderer, 
-					  textures[animation->frames[animation->state].texture_index].tex,
-					  &src_rect, &dest_rect,
-					  0, nullptr, 
-					  actor->flipped ? SDL_FLIP_HORIZONTAL : SDL_FLIP_NONE);
+	//SDL_RenderCopyF(renderer, textures[frame->texture_index].tex, &src_rect, &dest_rect);
+	push_texture_copy(list, frame->texture_index, &src_rect, &dest_rect, 0,
+					  sprite->flipped ? SDL_FLIP_HORIZONTAL : SDL_FLIP_NONE);
 }
 
-void update_frame(Actor* actor)
+void render_sprites(Render_List *list, World *world, Previous_Positions *previous, r32 alpha)
 {
-	Animation *animation = actor->animation;
-	if (animation->update_counter > animation->count_till_update) {
-		animation->current_animation_frame = (animation->current_animation_frame + 1) % animation->frames[animation->state].count;
-		animation->update_counter = 0;
-
-		if (animation->current_animation_frame == 0) {
-			if (animation->one_shot) {
-				animation->state = animation->default_state;
-				animation->one_shot = false;
-			}
-		}
+	Component_Pool<Sprite> *sprites = &world->sprites;
+	for (u32 i = 0; i < sprites->count; ++i) {
+		Transform *transform = joined_component(sprites, i, &world->transforms);
+		if (!transform)
+			continue;
+		Transform drawn = *transform;
+		drawn.pos = interpolated_position(previous, &world->transforms, (u32) (transform - world->transforms.data), alpha);
+		display_frame(list, textures, &drawn, &sprites->data[i]);
+	}
+}
 
-	} else {
-		animation->update_counter++;
+struct Sprite_Job {
+	World *world;
+	r32 dt;
+};
+
+void update_sprites_job(void *data, u32 begin, u32 end)
+{
+	Sprite_Job *job = (Sprite_Job *) data;
+	for (u32 i = begin; i < end; ++i) {
+		advance_animation(&job->world->sprites.data[i].playback, job->dt);
+	}
+}
+
+void update_sprites(Job_System *jobs, World *world, r32 dt)
+{
+	ProfileFunction();
+	Sprite_Job job = { world, dt };
+	parallel_for(jobs, "animation", world->sprites.count, 256, update_sprites_job, &job);
+}
+
+// Run after a hot reload, it may have removed states that sprites are playing
+void clamp_sprites(World *world)
+{
+	for (u32 i = 0; i < world->sprites.count; ++i) {
+		clamp_animation_playback(&world->sprites.data[i].playback);
 	}
 }
 
+#include "projectile.h"
+#include "particles.h"
+
 ////////////////////////////////////////
 //				STB FONT
 
@@ -286,30 +388,34 @@ typedef struct {
 } Font;
 
 Font *load_font(SDL_Renderer *renderer, const char *filename, r32 size) {
-	String font_file = read_entire_file(filename);
+	Temp_Memory temp = begin_temp_memory(&frame_arena);
+	Defer(end_temp_memory(temp));
+
+	// everything of a font that failed to load is given back
+	Temp_Memory font_temp = begin_temp_memory(&font_arena);
 
-	Defer( SDL_free(font_file.data); );
+	// stbtt_fontinfo keeps pointing into the file, so it has to live as long as the font
+	String font_file = read_entire_file(&font_arena, filename);
 
-	Font *font = (Font *) SDL_calloc(sizeof(Font), 1);
-	if (!font) return nullptr;
-	font->info = (stbtt_fontinfo *) SDL_malloc(sizeof(stbtt_fontinfo));
-	font->chars = (stbtt_packedchar *) SDL_malloc(sizeof(stbtt_packedchar) * 96);
+	Font *font = PushStruct(&font_arena, Font);
+	font->info = PushStruct(&font_arena, stbtt_fontinfo);
+	font->chars = PushArray(&font_arena, stbtt_packedchar, 96);
 	if (stbtt_InitFont(font->info, font_file.data, 0) == 0) {
-		if (font) SDL_free(font);
-		if (font->info) SDL_free(font->info);
-		if (font->chars) SDL_free(font->chars);
+		end_temp_memory(font_temp);
 		return nullptr;
 	}
+	commit_temp_memory(font_temp);
 
 	font->texture_size = 32; // gradually build up a texture
 	u8 *bitmap = nullptr;
 	while (1) {
-		bitmap = (u8 *) SDL_malloc(font->texture_size * font->texture_size);
+		imem bitmap_size = font->texture_size * font->texture_size;
+		bitmap = PushArrayNoZero(&frame_arena, u8, bitmap_size);
 		stbtt_pack_context pack_context;
 		stbtt_PackBegin(&pack_context, bitmap, font->texture_size, font->texture_size, 0, 1, nullptr);
 		stbtt_PackSetOversampling(&pack_context, 1, 1);
 		if (!stbtt_PackFontRange(&pack_context, font_file.data, 0, size, ' ', 127 - ' ', font->chars)) {
-			SDL_free(bitmap);
+			deallocate(arena_allocator(&frame_arena), bitmap, bitmap_size);
 			stbtt_PackEnd(&pack_context);
 			font->texture_size *= 2;
 		} else {
@@ -321,15 +427,13 @@ Font *load_font(SDL_Renderer *renderer, const char *filename, r32 size) {
 	font->atlas = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, font->texture_size, font->texture_size);
 	SDL_SetTextureBlendMode(font->atlas, SDL_BLENDMODE_BLEND);
 
-	u32 *pixels = (u32 *) SDL_malloc(font->texture_size * font->texture_size * sizeof(u32));
-	Defer(SDL_free(pixels));
+	u32 *pixels = PushArrayNoZero(&frame_arena, u32, font->texture_size * font->texture_size);
 	static SDL_PixelFormat *format = NULL;
 	if (format == NULL) format = SDL_AllocFormat(SDL_PIXELFORMAT_RGBA32);
 	for (int i = 0; i < font->texture_size * font->texture_size; i++) {
 		pixels[i] = SDL_MapRGBA(format, 0xff, 0xff, 0xff, bitmap[i]);
 	}
 	SDL_UpdateTexture(font->atlas, NULL, pixels, font->texture_size * sizeof(u32));
-	SDL_free(bitmap);
 
 	font->scale = stbtt_ScaleForPixelHeight(font->info, size);
 	stbtt_GetFontVMetrics(font->info, &font->ascent, 0, 0);
@@ -338,18 +442,13 @@ Font *load_font(SDL_Renderer *renderer, const char *filename, r32 size) {
 	return font;
 }
 
+// The font's memory belongs to the font arena, only the atlas needs to go
 void unload_font(Font *font) {
 	if (font->atlas) SDL_DestroyTexture(font->atlas);
-	if (font->info) SDL_free(font->info);
-	if (font->chars) SDL_free(font->chars);
-	SDL_free(font);
+	font->atlas = nullptr;
 }
 
-void render_text(SDL_Renderer *renderer, Font *font, r32 x, r32 y, String text, u32 color) {
-	Uint8 r, g, b, a;
-	UnHexColor(color, r, g, b, a);
-	SDL_SetTextureColorMod(font->atlas, r, g, b);
-	SDL_SetTextureAlphaMod(font->atlas, a);
+void render_text(Render_List *list, Font *font, r32 x, r32 y, String text, u32 color) {
 	for (int i = 0; i < text.len; i++) {
 		if (text[i] >= ' ' && text[i] < 128) {
 			stbtt_packedchar *info = &font->chars[text[i] - ' '];
@@ -357,17 +456,13 @@ void render_text(SDL_Renderer *renderer, Font *font, r32 x, r32 y, String text,
 			//SDL_FRect dst_rect = { x + info->xoff, y + info->yoff, (r32) info->x1 - info->x0, (r32) info->y1 - info->y0 };
 			SDL_FRect dst_rect = { x + info->xoff, y + info->yoff, info->xoff2 - info->xoff, info->yoff2 - info->yoff };
 			dst_rect.y += font->baseline;
-			SDL_RenderCopyF(renderer, font->atlas, &src_rect, &dst_rect);
+			push_copy(list, font->atlas, &src_rect, &dst_rect, color);
 			x += info->xadvance;
 		}
 	}
 }
 
-void render_text_fit_width(SDL_Renderer *renderer, Font *font, r32 x0, r32 y0, String text, u32 color, r32 fit_width) {
-	Uint8 r, g, b, a;
-	UnHexColor(color, r, g, b, a);
-	SDL_SetTextureColorMod(font->atlas, r, g, b);
-	SDL_SetTextureAlphaMod(font->atlas, a);
+void render_text_fit_width(Render_List *list, Font *font, r32 x0, r32 y0, String text, u32 color, r32 fit_width) {
 	r32 x = x0;
 	r32 y = y0;
 
@@ -381,7 +476,7 @@ void render_text_fit_width(SDL_Renderer *renderer, Font *font, r32 x0, r32 y0, S
 			}
 			SDL_FRect dst_rect = { x + info->xoff, y + info->yoff, info->xoff2 - info->xoff, info->yoff2 - info->yoff };
 			dst_rect.y += font->baseline;
-			SDL_RenderCopyF(renderer, font->atlas, &src_rect, &dst_rect);
+			push_copy(list, font->atlas, &src_rect, &dst_rect, color);
 			
 			// TODO: think about this
 			if (x + 2.f * info->xadvance + info->xoff < x0 + fit_width) {
@@ -409,75 +504,212 @@ r32 compute_text_width(Font *font, const char *text) {
 ////////////////////////////////////////
 
 
-bool expect(String* a, u8 c, const char *error)
+// Parses an .anims file without touching any global state so that it can also run on the
+// asset watch thread. Returns nullptr on success, or a description of the first error
+const char *parse_animation_desc(String animation_file, Animation_Desc *desc)
 {
-	if (a->data[0] == c) {
-		string_chop_left(a, 1);
-		return true;
+	*desc = {};
+	while (animation_file.len > 0) {
+		String line = string_trim(string_chop_by_delim(&animation_file, '\n'));
+		if (line.len == 0)
+			continue;
+
+		if (line[0] == '#') {
+			String prefix = string_trim(string_chop_by_delim(&line, ' '));
+			string_chop_left(&prefix, 1);
+			line = string_trim(line);
+			if (prefix == String("path:")) {
+				if (line.len == 0 || line[0] != '"')
+					return "Path must start with a \"";
+				string_chop_left(&line, 1);
+				String texture_path = string_chop_by_delim(&line, '"');
+				if (desc->texture_path_count >= MAX_ANIMATION_TEXTURES)
+					return "Too many textures in animation file";
+				if (texture_path.len >= MAX_ASSET_PATH)
+					return "Texture path is too long";
+				char *path = desc->texture_paths[desc->texture_path_count++];
+				SDL_memcpy(path, texture_path.data, texture_path.len);
+				path[texture_path.len] = 0;
+			} else if (prefix == String("width:")) { desc->width = string_parse_i32(line); }
+			else if (prefix == String("height:")) { desc->height = string_parse_i32(line); }
+			else if (prefix == String("frame_ms:")) { desc->frame_duration = string_parse_i32(line) / 1000.f; }
+			// older files count updates of the 100 Hz physics step, which advanced a frame every count + 2 steps
+			else if (prefix == String("count:")) { desc->frame_duration = (string_parse_i32(line) + 2) / 100.f; }
+			else {
+				return "Unexpected metadata";
+			}
+		} else {
+			if (desc->texture_path_count == 0)
+				return "Animation defined before any #path";
+			if (desc->frame_count >= MAX_ANIMATION_STATES)
+				return "Too many animations in animation file";
+			if (line[0] == '!') {
+				desc->default_state = desc->frame_count;
+				string_chop_left(&line, 1);
+			}
+			String name = string_trim(string_chop_by_delim(&line, ':'));
+			if (name.len == 0 || name.len >= MAX_ANIMATION_NAME)
+				return "Animation name must be between 1 and 31 characters long";
+			u32 id = hash_string(name);
+			for (i32 i = 0; i < desc->frame_count; ++i) {
+				if (desc->state_ids[i] == id)
+					return "Animation name is used twice (or two names have the same hash)";
+			}
+			SDL_memcpy(desc->state_names[desc->frame_count], name.data, name.len);
+			desc->state_names[desc->frame_count][name.len] = 0;
+			desc->state_ids[desc->frame_count] = id;
+
+			AnimationFrame *frame = &desc->frames[desc->frame_count++];
+			line = string_trim(line);
+			frame->start_frame_index = string_parse_i32(line);
+			string_chop_by_delim(&line, ' ');
+			line = string_trim(line);
+			frame->count = string_parse_i32(line);
+			if (frame->count <= 0 || frame->count > 255)
+				return "Animation must have between 1 and 255 frames";
+			// in case one shot: true is required in the animation file
+			/*string_chop_by_delim(&line, ' ');
+			line = string_trim(line);
+			frame->one_shot = line == "true";*/
+
+			frame->texture_index = desc->texture_path_count - 1;
+		}
 	}
-	fatal_error(error);
+	return nullptr;
 }
 
-Animation* parse_animation_file(SDL_Renderer *renderer, const char *file_path)
+// Returns the state with the given name in the animation file, or -1 when there is none
+i32 find_animation_state(Animation *animation, u32 id)
 {
-	Animation animation = {};
-	animation.frames = animation_frame_buffer + animation_frame_buffer_count;
-	String animation_file = read_entire_file(file_path);
-	String animation_file_start = animation_file;
-
-	Defer(	SDL_free(animation_file_start.data); );
-
-	{
-		String line = string_chop_by_delim(&animation_file, '\n');
-		while (line.len > 0) {
-			if (line[0] == '#') {
-				String prefix = string_trim(string_chop_by_delim(&line, ' '));
-				string_chop_left(&prefix, 1);
-				line = string_trim(line);
-				if (prefix == String("path:")) {
-					if (expect(&line, '"', "Path must start with a \"")) {
-						String texture_path = string_chop_by_delim(&line, '"');
-						char scratch_buffer[512] = {};	// TODO remove this by making it so that load_texture can work with String as well
-						SDL_memcpy(scratch_buffer, texture_path.data, texture_path.len);
-						textures[texture_count++] = load_texture(renderer, scratch_buffer);
-					}
-				} else if (prefix == String("width:")) { animation.width = string_parse_i32(line); }
-				else if (prefix == String("height:")) { animation.height = string_parse_i32(line); }
-				else if (prefix == String("count:")) { animation.count_till_update = string_parse_i32(line); }
-				else {
-					fatal_error("Unexpected metadata", nullptr);
-				}
-			} else if (line[0] != '\r') {
-				if (line[0] == '!') {
-					animation.default_state = animation.frame_count;
-				}
-				string_chop_by_delim(&line, ':');
-				line = string_trim(line);
-				animation.frames[animation.frame_count].start_frame_index = string_parse_i32(line);
-				string_chop_by_delim(&line, ' ');
-				line = string_trim(line);
-				animation.frames[animation.frame_count].count = string_parse_i32(line);
-				// in case one shot: true is required in the animation file
-				/*string_chop_by_delim(&line, ' ');
-				line = string_trim(line);
-				animation.frames[animation.frame_count].one_shot = line == "true";*/
-				
-				animation.frames[animation.frame_count].texture_index = texture_count - 1;
-				animation.frame_count++;
-				animation_frame_buffer_count++;
-			}
-			line = string_chop_by_delim(&animation_file, '\n');
+	id = id ? id : 1;
+	u32 mask = ANIMATION_STATE_TABLE_SIZE - 1;
+	for (u32 slot = id & mask; animation->state_table_ids[slot]; slot = (slot + 1) & mask) {
+		if (animation->state_table_ids[slot] == id)
+			return animation->state_table_states[slot];
+	}
+	return -1;
+}
+
+// State for one of the ids in the enums above. Resolved when loading, so this is just a load
+inline i32 animation_state(Animation *animation, i32 id)
+{
+	assert(id >= 0 && id < animation->name_count);
+	return animation->bound_states[id];
+}
+
+// Resolves the names the code uses to states of the animation file. Returns how many of them
+// are missing from the file, those fall back to the default state so that a hot reload of a
+// half edited file doesn't take the game down
+i32 bind_animation_states(Animation *animation, const char *file_path)
+{
+	i32 missing = 0;
+	for (i32 i = 0; i < animation->name_count; ++i) {
+		i32 state = find_animation_state(animation, animation->names[i].id);
+		if (state < 0) {
+			SDL_Log("%s: missing animation \"%s\"", file_path, animation->names[i].name);
+			state = animation->default_state;
+			missing++;
 		}
+		animation->bound_states[i] = state;
+	}
+	return missing;
+}
+
+// Loads the textures an animation refers to and (re)builds it from desc. Used both for the
+// initial load and for hot reloading, where the live animation is patched in place
+void apply_animation_desc(SDL_Renderer *renderer, Animation_Desc *desc, Animation *animation)
+{
+	i32 texture_indices[MAX_ANIMATION_TEXTURES];
+	for (i32 i = 0; i < desc->texture_path_count; ++i) {
+		texture_indices[i] = find_or_load_texture(renderer, desc->texture_paths[i]);
+	}
+
+	// NOTE: a reload that adds states leaves the old frames behind in the permanent arena
+	if (desc->frame_count > animation->frame_capacity) {
+		animation->frames = PushArray(&permanent_arena, AnimationFrame, desc->frame_count);
+		animation->frame_capacity = desc->frame_count;
+	}
+
+	for (i32 i = 0; i < desc->frame_count; ++i) {
+		animation->frames[i] = desc->frames[i];
+		animation->frames[i].texture_index = texture_indices[desc->frames[i].texture_index];
+	}
+	animation->frame_count = desc->frame_count;
+	animation->width = desc->width;
+	animation->height = desc->height;
+	animation->frame_duration = desc->frame_duration > 0 ? desc->frame_duration : 0.1f;
+	animation->frames_per_second = 1.f / animation->frame_duration;
+	animation->default_state = desc->default_state;
+
+	SDL_memset(animation->state_table_ids, 0, sizeof(animation->state_table_ids));
+	u32 mask = ANIMATION_STATE_TABLE_SIZE - 1;
+	for (i32 i = 0; i < desc->frame_count; ++i) {
+		u32 id = desc->state_ids[i] ? desc->state_ids[i] : 1;
+		u32 slot = id & mask;
+		while (animation->state_table_ids[slot])
+			slot = (slot + 1) & mask;
+		animation->state_table_ids[slot] = id;
+		animation->state_table_states[slot] = (i8) i;
 	}
+}
+
+Animation* parse_animation_file(SDL_Renderer *renderer, const char *file_path, const Animation_Name *names, i32 name_count)
+{
+	Temp_Memory temp = begin_temp_memory(&frame_arena);
+	Defer(end_temp_memory(temp));
+	String animation_file = read_entire_file(&frame_arena, file_path);
+
+	Animation_Desc desc;
+	const char *error = parse_animation_desc(animation_file, &desc);
+	if (error) {
+		fatal_error(error, nullptr);
+	}
+
+	Animation *animation = PushStruct(&permanent_arena, Animation);
+	apply_animation_desc(renderer, &desc, animation);
 
-	animations[animation_count] = animation;
-	return &animations[animation_count++];
+	assert(name_count <= MAX_ANIMATION_STATES);
+	animation->names = names;
+	animation->name_count = name_count;
+	if (bind_animation_states(animation, file_path) > 0) {
+		fatal_error("Animation file is missing animations used by the game, see the log", nullptr);
+	}
+	array_add(&animations, animation);
+	array_add(&animation_paths, (const char *) arena_push_string(&permanent_arena, String(file_path, SDL_strlen(file_path))).data);
+	return animation;
+}
+
+#include "asset_watch.h"
+#include "navigation.h"
+#include "tilemap.h"
+#include "static_collision.h"
+#include "ai.h"
+
+Entity spawn_enemy(World *world, Animation *animation, V2 pos)
+{
+	Entity enemy = create_entity(world);
+	V2 size = V2(2.f * animation->width, 2.f * animation->height);
+	add_component(world, &world->transforms, enemy, { pos, size });
+	add_component(world, &world->velocities, enemy, { V2(), V2(), 120.f });
+	add_component(world, &world->sprites, enemy, { make_animation_playback(animation), false });
+	add_component(world, &world->colliders, enemy, { COLLIDER_RECT, V2(0.25f, 0.25f), V2(0.75f, 0.75f), 0.f });
+	add_component(world, &world->brains, enemy, {});
+	return enemy;
 }
 
+#include "stress.h"
+#include "streaming.h"
+#include "simulation.h"
+#include "input.h"
+#include "timestep.h"
+#include "render_thread.h"
+#include "perf_overlay.h"
+#include "replay.h"
+
 // TODO: YEET
-void draw_ring(SDL_Renderer *renderer, Circle circle, u32 color)
+void draw_ring(Render_List *list, Circle circle, u32 color)
 {
-	SDL_SetRenderDrawColor(renderer, HexColor(color));
+	push_draw_color(list, color);
 
 	r32 offsetx, offsety, d;
 
@@ -488,14 +720,14 @@ void draw_ring(SDL_Renderer *renderer, Circle circle, u32 color)
 	r32 y = circle.pos.y;
 
 	while (offsety >= offsetx) {
-		SDL_RenderDrawPointF(renderer, x + offsetx, y + offsety);
-		SDL_RenderDrawPointF(renderer, x + offsety, y + offsetx);
-		SDL_RenderDrawPointF(renderer, x - offsetx, y + offsety);
-		SDL_RenderDrawPointF(renderer, x - offsety, y + offsetx);
-		SDL_RenderDrawPointF(renderer, x + offsetx, y - offsety);
-		SDL_RenderDrawPointF(renderer, x + offsety, y - offsetx);
-		SDL_RenderDrawPointF(renderer, x - offsetx, y - offsety);
-		SDL_RenderDrawPointF(renderer, x - offsety, y - offsetx);
+		push_point(list, x + offsetx, y + offsety);
+		push_point(list, x + offsety, y + offsetx);
+		push_point(list, x - offsetx, y + offsety);
+		push_point(list, x - offsety, y + offsetx);
+		push_point(list, x + offsetx, y - offsety);
+		push_point(list, x + offsety, y - offsetx);
+		push_point(list, x - offsetx, y - offsety);
+		push_point(list, x - offsety, y - offsetx);
 
 		if (d >= 2 * offsetx) {
 			d -= 2 * offsetx + 1;
@@ -519,110 +751,323 @@ void make_polygon(Polygon *p, i32 n, r32 r, r32 offset_angle = 0.f) {
 	}
 }
 
-void draw_polygon(SDL_Renderer *renderer, Polygon *p, u32 color) {
-	SDL_SetRenderDrawColor(renderer, HexColor(color));
+void draw_polygon(Render_List *list, Polygon *p, u32 color) {
+	push_draw_color(list, color);
 	for (i32 i = 0; i < p->size; ++i) {
 		V2 p1 = p->pos + p->points[i];
 		V2 p2 = p->pos + p->points[(i + 1) % p->size];
-		SDL_RenderDrawLineF(renderer, p1.x - camera.x + resolution.x / 2.f, p1.y - camera.y + resolution.y / 2.f, p2.x - camera.x + resolution.x / 2.f, p2.y - camera.y + resolution.y / 2.f);
+		push_line(list, p1.x - camera.x + resolution.x / 2.f, p1.y - camera.y + resolution.y / 2.f, p2.x - camera.x + resolution.x / 2.f, p2.y - camera.y + resolution.y / 2.f);
 	}
 }
 
-void draw_capsule(SDL_Renderer *renderer, Capsule c, u32 color)
+void draw_capsule(Render_List *list, Capsule c, u32 color)
 {
-	SDL_SetRenderDrawColor(renderer, HexColor(color));
-	draw_ring(renderer, {c.a - camera + resolution / 2.f, c.radius}, color);
+	push_draw_color(list, color);
+	draw_ring(list, {c.a - camera + resolution / 2.f, c.radius}, color);
 	V2 ab = c.b - c.a;
 	V2 norm = normalizez(V2(-ab.y, ab.x));
 	V2 p1 = c.a + c.radius * norm;
 	V2 p2 = c.b + c.radius * norm;
-	SDL_RenderDrawLineF(renderer, p1.x - camera.x + resolution.x / 2.f, p1.y - camera.y + resolution.y / 2.f, p2.x - camera.x + resolution.x / 2.f, p2.y - camera.y + resolution.y / 2.f);
+	push_line(list, p1.x - camera.x + resolution.x / 2.f, p1.y - camera.y + resolution.y / 2.f, p2.x - camera.x + resolution.x / 2.f, p2.y - camera.y + resolution.y / 2.f);
 	p1 = c.a - c.radius * norm;
 	p2 = c.b - c.radius * norm;
-	SDL_RenderDrawLineF(renderer, p1.x - camera.x + resolution.x / 2.f, p1.y - camera.y + resolution.y / 2.f, p2.x - camera.x + resolution.x / 2.f, p2.y - camera.y + resolution.y / 2.f);
-	draw_ring(renderer, {c.b - camera + resolution / 2.f, c.radius}, color);
+	push_line(list, p1.x - camera.x + resolution.x / 2.f, p1.y - camera.y + resolution.y / 2.f, p2.x - camera.x + resolution.x / 2.f, p2.y - camera.y + resolution.y / 2.f);
+	draw_ring(list, {c.b - camera + resolution / 2.f, c.radius}, color);
 }
 
-void refresh_buffer(InputAction* buffer, int* size) 
+// bench/bench.cpp builds everything above into its own executable
+#ifndef NO_GAME_MAIN
+i32 main(i32 argc, char **argv)
 {
-	InputAction buffer_buffer[ArrayCount(buffer_actions)] = {};
-	int buffer_buffer_count = 0;
-
-	for (int i = 0; i < *size; ++i) {
-		if (buffer[i].duration > 0) {
-			buffer_buffer[buffer_buffer_count++] = buffer[i];
+	r32 tick_rate = 100.f;
+	r32 frame_cap = 0;
+	bool busy_wait = false;
+	bool render_thread = true;
+	i32 worker_count = SDL_GetCPUCount();
+	i32 profile_frames = DEFAULT_PROFILE_CAPTURE_FRAMES;
+	bool profile_at_start = false;
+	Replay_Mode replay_mode = REPLAY_OFF;
+	const char *replay_path = nullptr;
+	bool headless = false;
+	bool stress = false;
+	Stress_Config stress_config = DEFAULT_STRESS_CONFIG;
+	for (i32 i = 1; i < argc; ++i) {
+		if (SDL_strcmp(argv[i], "--track-sdl-memory") == 0) {
+			if (!track_sdl_allocations())
+				SDL_Log("Could not hook SDL's allocations");
+		} else if (SDL_strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc) {
+			// Max evaluates its arguments twice, argv[++i] can't go in there
+			tick_rate = (r32) SDL_atof(argv[++i]);
+			tick_rate = Max(1.f, tick_rate);
+		} else if (SDL_strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+			frame_cap = (r32) SDL_atof(argv[++i]);
+		} else if (SDL_strcmp(argv[i], "--busy-wait") == 0) {
+			busy_wait = true;
+		} else if (SDL_strcmp(argv[i], "--no-render-thread") == 0) {
+			render_thread = false;
+		} else if (SDL_strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+			worker_count = SDL_atoi(argv[++i]);
+		} else if (SDL_strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+			profile_frames = SDL_atoi(argv[++i]);
+			profile_frames = Max(1, profile_frames);
+			profile_at_start = true;
+		} else if (SDL_strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			replay_mode = REPLAY_RECORDING;
+			replay_path = argv[++i];
+		} else if (SDL_strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+			replay_mode = REPLAY_PLAYING;
+			replay_path = argv[++i];
+		} else if (SDL_strcmp(argv[i], "--headless") == 0) {
+			headless = true;
+		} else if (SDL_strcmp(argv[i], "--stress") == 0) {
+			stress = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-') {
+				if (!parse_stress_config(String(argv[i + 1], SDL_strlen(argv[i + 1])), &stress_config))
+					fatal_error(SDL_GetError(), nullptr);
+				++i;
+			}
 		}
 	}
-	for (int i = 0; i < buffer_buffer_count; ++i) {
-		buffer[i] = buffer_buffer[i];
+	if (headless && replay_mode != REPLAY_PLAYING) {
+		SDL_Log("--headless only goes with --replay");
+		headless = false;
+	}
+	if (headless) {
+		// the environment still wins, to look at a replay going as fast as it can
+		SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+		SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
 	}
 
-	*size = buffer_buffer_count;
-	
-	memset(buffer, 0, sizeof(buffer_actions)); // TODO: fix this with an array type
-	memcpy(buffer, buffer_buffer, buffer_buffer_count * sizeof(*buffer));
-}
-
-i32 main(i32 argc, char **argv)
-{
 	if (SDL_Init(SDL_INIT_EVERYTHING) < 0) {
 		fatal_error(SDL_GetError());
 	}
 
+	arena_create(&permanent_arena, Megabytes(64), "permanent", MEMORY_TAG_ASSETS);
+	arena_create(&world_arena, Megabytes(32), "world", MEMORY_TAG_ENTITIES);
+	arena_create(&particle_arena, Megabytes(48), "particles", MEMORY_TAG_PARTICLES);
+	arena_create(&navigation_arena, Megabytes(16), "navigation", MEMORY_TAG_NAVIGATION);
+	arena_create(&level_arena, Megabytes(1), "level", MEMORY_TAG_LEVEL);
+	arena_create(&font_arena, Megabytes(4), "fonts", MEMORY_TAG_FONTS);
+	arena_create(&physics_arena, Kilobytes(64), "physics", MEMORY_TAG_PHYSICS);
+	arena_create(&snapshot_arena, Megabytes(64) + Kilobytes(64), "snapshots", MEMORY_TAG_SNAPSHOTS);
+	arena_create(&render_arena, Megabytes(16), "render", MEMORY_TAG_RENDERING);
+	arena_create(&frame_arena, Megabytes(16), "frame", MEMORY_TAG_FRAME_SCRATCH);
+
+	// --record and --replay, see replay.h. Both need the game to play out the same from the same
+	// input, which turns off whatever depends on timing or on keys the simulation doesn't see
+	Replay replay;
+	replay_init(&replay, replay_mode, replay_path);
+	if (replay.mode == REPLAY_PLAYING) {
+		if (!load_replay(&replay))
+			fatal_error(SDL_GetError(), nullptr);
+		tick_rate = replay.header.tick_rate;
+	}
+	bool deterministic = replay.mode != REPLAY_OFF;
+
+	// --workers overrides one per core, the main thread being one of them
+	set_profile_thread_name("main");
+	Job_System jobs;
+	job_system_init(&jobs, &permanent_arena, worker_count);
+	jobs.hook = profile_job_hook;
+	SDL_Log("Running jobs on %d workers", jobs.worker_count);
+
+	array_init(&animations, arena_allocator(&permanent_arena), 16);
+	array_init(&animation_paths, arena_allocator(&permanent_arena), 16);
+	array_init(&textures, arena_allocator(&permanent_arena), 64);
+	array_init(&texture_paths, arena_allocator(&permanent_arena), 64);
+
 	resolution = V2(1280, 720);
 	SDL_Window *window = SDL_CreateWindow("Untitled-Game", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, (i32) resolution.x, (i32) resolution.y,
 										  SDL_WINDOW_RESIZABLE | SDL_WINDOW_HIDDEN);
 	// NOTE: Apparently using SDL_RENDERER_ACCELERATED is bad because it forces us to create a hardware
 	// renderer, and just crash if it can't instead of falling back to a software renderer.
 
-	SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_PRESENTVSYNC);
+	SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, headless ? SDL_RENDERER_SOFTWARE : SDL_RENDERER_PRESENTVSYNC);
 	if (SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND) < 0) {
 		fatal_error(SDL_GetError(), nullptr);
 	}
-	SDL_ShowWindow(window);
+	if (!headless)
+		SDL_ShowWindow(window);
 
 	bool is_running = true;
 	u64 last_ms = SDL_GetTicks64();
 	u64 start_ms = SDL_GetTicks64();
 
 	Input input = {};
-	Actor player = {};
-	Actor enemy = {};
 
-	player.animation = parse_animation_file(renderer, "./data/player.anims");
-	//player.animation->default_animation = PLAYER_ANIMATION_IDLE;
-	player.size = { 3.f * player.animation->width, 3.f * player.animation->height };
-
-	enemy.animation = parse_animation_file(renderer, "./data/enemy.anims");
-	//enemy.animation->default_animation = ENEMY_ANIMATION_IDLE;
-	enemy.size = { 2.f * enemy.animation->width, 2.f * enemy.animation->height };
-
-	enemy.pos = (resolution - enemy.size) / 2;
-
-	r32 t = 0;
-	r32 dt = 0.01f;
-
-	u64 last_counter = SDL_GetPerformanceCounter();
-	const u64 query_perf_freq = SDL_GetPerformanceFrequency();
-	r32 accumulator = dt;
-
-	Polygon poly;
-	make_polygon(&poly, 3, 500);
-	//poly.pos = V2(mouse.x, mouse.y);
-	poly.pos = V2(0, 150);
+	World world;
+	world_init(&world, &world_arena);
+
+	r32 speed = 250.f;
+
+	Animation *player_animation = parse_animation_file(renderer, "./data/player.anims", player_animation_names, COUNT_PLAYER_ANIMATION);
+	Entity player = create_entity(&world);
+	add_component(&world, &world.transforms, player, { V2(), V2(3.f * player_animation->width, 3.f * player_animation->height) });
+	add_component(&world, &world.velocities, player, { V2(), V2(), speed });
+	add_component(&world, &world.sprites, player, { make_animation_playback(player_animation), false });
+	add_component(&world, &world.colliders, player, { COLLIDER_CAPSULE, V2(0.5f, 0.375f), V2(0.5f, 0.775f), 0.2f });
+
+	Animation *enemy_animation = parse_animation_file(renderer, "./data/enemy.anims", enemy_animation_names, COUNT_ENEMY_ANIMATION);
+	V2 enemy_size = V2(2.f * enemy_animation->width, 2.f * enemy_animation->height);
+	Entity enemy = spawn_enemy(&world, enemy_animation, (resolution - enemy_size) / 2);
+
+	Projectile_Pool projectiles;
+	Projectile_Pool effects;
+	projectile_pool_init(&projectiles, &world_arena, 16384);
+	projectile_pool_init(&effects, &world_arena, 16384);
+	load_projectile_types(renderer);
+	Random_Series random = random_seed(SDL_GetPerformanceCounter());
+
+	SDL_Texture *glow_texture = create_particle_texture(renderer, &frame_arena, SDL_BLENDMODE_ADD);
+	SDL_Texture *smoke_texture = create_particle_texture(renderer, &frame_arena, SDL_BLENDMODE_BLEND);
+
+	Particle_Buffer sparks;
+	particle_buffer_init(&sparks, &particle_arena, 16384, glow_texture, 0xffe070ff, 0xff200000, 10.f, 2.f);
+	sparks.drag = 4.f;
+	Particle_Emission spark_emission = { 200.f, 500.f, 0.f, PI32, 0.15f, 0.35f, 4.f };
+
+	Particle_Buffer dust;
+	particle_buffer_init(&dust, &particle_arena, 8192, smoke_texture, 0xb0a090a0, 0x80706000, 6.f, 24.f);
+	dust.drag = 3.f;
+	dust.gravity = V2(0, -30.f);
+	Particle_Emitter dust_emitter = { &dust, { 20.f, 60.f, -PI32 / 2, PI32 / 3, 0.4f, 0.8f, 10.f }, V2(), 40.f };
+
+	// F6 toggles this, it keeps well over 100k particles alive to see what the system can take
+	Particle_Buffer fountain;
+	particle_buffer_init(&fountain, &particle_arena, 1 << 17, glow_texture, 0x40c0ffff, 0x2040ff00, 6.f, 2.f);
+	fountain.gravity = V2(0, 400.f);
+	Particle_Emitter fountain_emitter = { &fountain, { 300.f, 700.f, -PI32 / 2, 0.4f, 1.5f, 2.5f, 4.f }, V2(0, -200.f), 60000.f };
+
+	Simulation sim = {};
+	sim.state.player = player;
+	sim.state.enemy = enemy;
+	sim.state.collision_color = 0xff0000ff;
+	sim.state.random = random_seed(replay_seed(&replay, random_next(&random)));
+	// about 1 ms of every 60 Hz frame at the default tick rate
+	ai_scheduler_init(&sim.state.ai, deterministic ? 0.f : 0.6f);
+	make_polygon(&sim.state.poly, 3, 500);
+	//sim.state.poly.pos = V2(mouse.x, mouse.y);
+	sim.state.poly.pos = V2(0, 150);
+
+	// the level streams in around the camera from this file
+	const char *world_path = "./data/level.world";
+	Tilemap level;
+	tilemap_init(&level, &level_arena, 32, 32, V2(-16.f * TILE_CHUNK_PIXELS), 160);
+	if (!check_world_file(&level, world_path)) {
+		// no world saved yet, make up some caves around the spawn
+		if (!create_world_file(&level, &frame_arena, world_path, &random, V2(), 900.f))
+			fatal_error(SDL_GetError(), window);
+		SDL_Log("Made up a new world in %s", world_path);
+	}
+	Static_Geometry level_collision;
+	static_geometry_init(&level_collision, &level_arena, &level);
+
+	// F10 toggles the editor: 1, 2 and 3 pick floor, wall or empty and 4 places enemies, left click
+	// paints, right click erases and F11 saves the edited chunks
+	bool editing = false;
+	Tile_Kind brush = TILE_WALL;
+	bool placing_spawns = false;
+	V2i last_painted = {};
+
+	Nav_Grid nav_grid;
+	nav_grid_init(&nav_grid, &navigation_arena, level.width, level.height, (r32) TILE_SIZE, level.origin);
+	Flow_Field_Builder flow_builder;
+	flow_field_builder_init(&flow_builder, &navigation_arena, &nav_grid,
+							(u32) (AI_AGGRO_DISTANCE / nav_grid.cell_size) * NAV_DIAGONAL_COST, !deterministic);
+
+	World_Stream stream;
+	world_stream_init(&stream, &level_arena, world_path, &level, &level_collision, &flow_builder, &world, enemy_animation, enemy_size);
+	if (deterministic)
+		settle_world_stream(&stream, &frame_arena, sim.state.camera, { sim.state.camera - resolution / 2.f, sim.state.camera + resolution / 2.f });
+	else
+		finish_world_stream_loads(&stream, &frame_arena, camera, { camera - resolution / 2.f, camera + resolution / 2.f });
+	update_static_geometry(&level_collision);
+	SDL_Log("Level collision: %u solid tiles baked into %u rects and %u edges in %.2f ms",
+			level_collision.solid_tiles, level_collision.rect_count, level_collision.edge_count, level_collision.bake_ms);
+	// --stress [config] fills the world around the spawn, see stress.h
+	if (stress) {
+		Stress_Scene stress_scene;
+		Animation *stress_animations[] = { player_animation, enemy_animation };
+		spawn_stress_scene(&stress_scene, &stress_config, &world, &projectiles, stress_animations, ArrayCount(stress_animations),
+						   enemy_animation, V2());
+		SDL_Log("Stress scene: %d actors (%d with brains), %d colliders and %u projectiles over %.0f units square",
+				stress_config.actors, stress_scene.brains, stress_config.colliders, projectiles.count, 2.f * stress_scene.extent);
+	}
+	// F12 flies the camera across the world and logs how the frame times held up
+	Fly_Through fly_through = {};
+	bool show_navigation = false;
+	V2 path_points[256];
+	Nav_Path path = { path_points, 0, ArrayCount(path_points) };
 
 	bool left_button_is_down = false;
 	bool right_button_is_down = false;
 	bool left_button_was_down = false;
 	bool right_button_was_down = false;
-	r32 frame_time = 1/60.f;
-
 	r32 total_frame_time = 0;
 
+	V2 *epa_points = PushArrayNoZero(&physics_arena, V2, EPA_MAX_POINTS);
+	constexpr i32 MAX_PROJECTILE_HITS = 1024;
+	Projectile_Hit *projectile_hits = PushArrayNoZero(&physics_arena, Projectile_Hit, MAX_PROJECTILE_HITS);
+
+	sim.world = &world;
+	sim.jobs = &jobs;
+	sim.projectiles = &projectiles;
+	sim.effects = &effects;
+	sim.level = &level_collision;
+	sim.flow_builder = &flow_builder;
+	sim.grid = &nav_grid;
+	sim.player_animation = player_animation;
+	sim.enemy_animation = enemy_animation;
+	sim.view_size = resolution;
+	sim.scratch = &frame_arena;
+	sim.epa_points = epa_points;
+	sim.hits = projectile_hits;
+	sim.max_hits = MAX_PROJECTILE_HITS;
+
+	// F4 goes back through the recorded ticks and simulates them all again
+	Sim_History history;
+	sim_history_init(&history, &snapshot_arena, 256, Megabytes(64));
+	u32 stream_epoch = stream.epoch;
+	// F3 logs how long presses took to reach the simulation, F2 dumps how long they took to show
+	Input_Ring input_ring = {};
+	i32 shown_attack_count = -1;
+
 
 	Font *font = load_font(renderer, "./data/fonts/Swansea-q3pd.ttf", 32);
 
+	// --no-render-thread renders on the main thread, F2 also writes how the frames overlapped
+	Render_Thread render;
+	render_thread_init(&render, renderer, &render_arena, &frame_arena, render_thread);
+
+	// --tick-rate, --fps and --busy-wait set it up, F1 cycles through a few tick rates
+	Frame_Scheduler scheduler;
+	frame_scheduler_init(&scheduler, tick_rate, DEFAULT_MAX_TICKS_PER_FRAME);
+	if (frame_cap > 0)
+		scheduler.target_frame_ms = 1000.f / frame_cap;
+	scheduler.busy_wait = busy_wait;
+	scheduler.lockstep = headless;
+	Previous_Positions previous_positions;
+	previous_positions_init(&previous_positions, &world_arena, world.transforms.capacity);
+	V2 previous_camera = sim.state.camera;
+	// O shows frame times, what is alive and the most expensive zones, see perf_overlay.h
+	Perf_Overlay perf_overlay;
+	perf_overlay_init(&perf_overlay, &render_arena);
+
+	start_asset_watch();
+	// --profile N captures the first N frames, P the next ones, see profiler.h
+	if (profile_at_start)
+		start_profile_capture(profile_frames);
+	begin_replay(&replay, &sim, scheduler.tick_rate);
+
 	while (is_running) {
+		begin_profile_frame();
+		ProfileZone("frame");
+		arena_reset(&frame_arena);
+		// the render thread is idle from here until the frame recorded last time around is
+		// submitted, renderer calls from this thread have to happen in between
+		wait_for_render(&render, &input_ring);
+		if (apply_asset_reloads(renderer))
+			clamp_sprites(&world);
 
 		SDL_memcpy(input.was_down, input.is_down, sizeof(input.is_down));
 		// memset(input.is_down, 0, sizeof(input.is_down));
@@ -631,6 +1076,8 @@ i32 main(i32 argc, char **argv)
 		left_button_was_down = left_button_is_down;
 		right_button_was_down = right_button_is_down;
 
+		r32 frame_time = scheduler.frame_time;
+		r32 dt = scheduler.dt;
 		total_frame_time += frame_time;
 
 		V2 mouse;
@@ -642,6 +1089,7 @@ i32 main(i32 argc, char **argv)
 			mouse = { (r32) mouse_x, (r32) mouse_y };
 		}
 
+		u64 events_start = SDL_GetPerformanceCounter();
 		SDL_Event event;
 		while (SDL_PollEvent(&event)) {
 			switch (event.type) {
@@ -655,20 +1103,97 @@ i32 main(i32 argc, char **argv)
 					if (event.key.keysym.scancode == SDL_SCANCODE_ESCAPE)
 						is_running = false;
 
+					if (event.key.keysym.scancode == SDL_SCANCODE_F1 && !event.key.repeat && !deterministic) {
+						r32 rates[] = { 100.f, 60.f, 30.f, 20.f };
+						i32 next = 0;
+						for (i32 i = 0; i < (i32) ArrayCount(rates); ++i) {
+							if (rates[i] == scheduler.tick_rate)
+								next = (i + 1) % ArrayCount(rates);
+						}
+						set_tick_rate(&scheduler, rates[next]);
+						// the recorded ticks ran with the old dt, they wouldn't simulate the same again
+						history.count = 0;
+						SDL_Log("Ticking at %.0f Hz", scheduler.tick_rate);
+					}
+
+					if (event.key.keysym.scancode == SDL_SCANCODE_F2 && !event.key.repeat) {
+						if (dump_input_latency(&input_ring, "input_latency.csv"))
+							SDL_Log("Wrote input_latency.csv");
+						if (dump_frame_traces(&render, "frame_trace.csv"))
+							SDL_Log("Wrote frame_trace.csv");
+						log_frame_traces(&render);
+					}
+
+					if (event.key.keysym.scancode == SDL_SCANCODE_F3 && !event.key.repeat) {
+						log_input_latency(&input_ring);
+					}
+
+					if (event.key.keysym.scancode == SDL_SCANCODE_F4 && !event.key.repeat) {
+						Resimulation resim = resimulate(&history, &sim, history.count, dt);
+						if (resim.ticks > 0) {
+							SDL_Log("Re-simulated %d ticks in %.2f ms (%.0f ticks/s) after a %.3f ms restore, %s",
+									resim.ticks, resim.simulate_ms, resim.ticks / (resim.simulate_ms / 1000.f), resim.restore_ms,
+									resim.matched ? "same result" : "the result diverged");
+							SDL_Log("Snapshots are %lld bytes and take %.3f ms (peak %.3f)", (long long) history.stats.snapshot_bytes,
+									history.stats.save_ms, history.stats.peak_save_ms);
+						} else {
+							SDL_Log("No ticks to re-simulate since the world last changed outside of them");
+						}
+					}
+
+					if (event.key.keysym.scancode == SDL_SCANCODE_F6 && !event.key.repeat) {
+						fountain_emitter.active = !fountain_emitter.active;
+					}
+
+					if (event.key.keysym.scancode == SDL_SCANCODE_F8 && !event.key.repeat) {
+						show_navigation = !show_navigation;
+					}
+
+					if (event.key.keysym.scancode == SDL_SCANCODE_F10 && !event.key.repeat && !deterministic) {
+						editing = !editing;
+					}
+
+					if (event.key.keysym.scancode == SDL_SCANCODE_F11 && !event.key.repeat && editing) {
+						SDL_Log("Saving %d chunks to %s", save_world_stream(&stream), world_path);
+					}
+
+					if (event.key.keysym.scancode == SDL_SCANCODE_F12 && !event.key.repeat && !fly_through.active) {
+						start_fly_through(&fly_through, &level_arena, &stream, 3000.f);
+					}
+
+					if (event.key.keysym.scancode == SDL_SCANCODE_P && !event.key.repeat && !editing) {
+						start_profile_capture(profile_frames);
+					}
+
+					if (event.key.keysym.scancode == SDL_SCANCODE_O && !event.key.repeat && !editing) {
+						perf_overlay.visible = !perf_overlay.visible;
+					}
+
+					if (event.key.keysym.scancode == SDL_SCANCODE_F9 && !event.key.repeat) {
+						if (dump_memory_report("memory_report.txt"))
+							SDL_Log("Wrote memory_report.txt");
+					}
+
 					input.is_down[event.key.keysym.scancode] = true;
 					input.half_transition[event.key.keysym.scancode]++;
+					push_key_event(&input_ring, &event.key);
 				} break;
 
 				case SDL_MOUSEBUTTONDOWN: {
-					if (event.button.button == SDL_BUTTON_LEFT)
+					if (event.button.button == SDL_BUTTON_LEFT) {
 						left_button_is_down = true;
+						if (!editing)
+							push_input_event(&input_ring, event.button.timestamp, ACTION_ATTACK, true);
+					}
 					if (event.button.button == SDL_BUTTON_RIGHT)
 						right_button_is_down = true;
 				} break;
 
 				case SDL_MOUSEBUTTONUP: {
-					if (event.button.button == SDL_BUTTON_LEFT)
+					if (event.button.button == SDL_BUTTON_LEFT) {
 						left_button_is_down = false;
+						push_input_event(&input_ring, event.button.timestamp, ACTION_ATTACK, false);
+					}
 					if (event.button.button == SDL_BUTTON_RIGHT)
 						right_button_is_down = false;
 				} break;
@@ -676,261 +1201,329 @@ i32 main(i32 argc, char **argv)
 				case SDL_KEYUP:
 				{
 					input.is_down[event.key.keysym.scancode] = false;
+					push_key_event(&input_ring, &event.key);
 				} break;
-			}
-		}
-
-		// TODO: Check the half transitions here
-
-		bool left_button_clicked = left_button_is_down && !left_button_was_down;
-
-		if (is_held(&input, SDL_SCANCODE_W)) {
-			buffer_actions[buffer_action_size++] = { .action = ACTION_MOVE_UP,};
-		}
-		if (is_held(&input, SDL_SCANCODE_A)) {
-			buffer_actions[buffer_action_size++] = { .action = ACTION_MOVE_LEFT,};
-		}
-		if (is_held(&input, SDL_SCANCODE_S)) {
-			buffer_actions[buffer_action_size++] = { .action = ACTION_MOVE_DOWN,};
-		}
-		if (is_held(&input, SDL_SCANCODE_D)) {
-			buffer_actions[buffer_action_size++] = { .action = ACTION_MOVE_RIGHT,};
-		}
-		if (is_pressed(&input, SDL_SCANCODE_E) || left_button_clicked) {
-			buffer_actions[buffer_action_size++] = { .action = ACTION_ATTACK, .duration = .9f, };
-		}
-		if (is_pressed(&input, SDL_SCANCODE_SPACE)) {
-			buffer_actions[buffer_action_size++] = { .action = ACTION_JUMP,};
-		}
-		if (is_held(&input, SDL_SCANCODE_LCTRL)) {
-			buffer_actions[buffer_action_size++] = { .action = ACTION_CROUCH,};
-		}
-
-
-		player.accn = {};
 
-		// apply all buffer actions here
-		{
-			if (buffer_action_size >= ArrayCount(buffer_actions)) {
-				__debugbreak();
+				// the renderer lost what was drawn into the chunk textures
+				case SDL_RENDER_TARGETS_RESET:
+				case SDL_RENDER_DEVICE_RESET:
+				{
+					invalidate_tile_cache(&render.tiles);
+				} break;
 			}
+		}
 
-			bool attack_encountered = false;
-			static int counter = 0;
-
-			for (int i = 0; i < buffer_action_size; ++i) {
-				if (!attack_encountered && buffer_actions[i].action == ACTION_ATTACK)
-					buffer_actions[i].duration -= frame_time;
-				switch (buffer_actions[i].action) {
-					case ACTION_NONE: {
-						// no op
-						player.animation->state = PLAYER_ANIMATION_IDLE;
-						player.animation->one_shot = false;
-					} break;
-					case ACTION_MOVE_LEFT: {
-						player.accn.x -= 1;
-						player.animation->state = PLAYER_ANIMATION_RUN;
-						player.flipped = true;
-						player.animation->one_shot = false;
-					} break;
-
-					case ACTION_MOVE_RIGHT: {
-						player.accn.x += 1;
-						player.animation->state = PLAYER_ANIMATION_RUN;
-						player.flipped = false;
-						player.animation->one_shot = false;
-					} break;
-
-					case ACTION_MOVE_UP: {
-						player.accn.y -= 1;
-					} break;
-
-					case ACTION_MOVE_DOWN: {
-						player.accn.y += 1;
-					} break;
-
-					case ACTION_ATTACK: {
-						if (buffer_actions[i].duration > 0 && !attack_encountered && !buffer_actions[i].consumed) {
-							buffer_actions[i].consumed = true;
-							player.animation->state = PLAYER_ANIMATION_ATK1 + player.combo;
-							player.animation->current_animation_frame = 0;
-							player.combo = (player.combo + 1) % 3; // TODO: un-hardcode this
-							player.animation->one_shot = true;
-							char buff[32] = {};
-							SDL_snprintf(buff, sizeof(buff), "Attack %d", counter++);
-							SDL_SetWindowTitle(window, buff);
+		add_profile_event("events", events_start, SDL_GetPerformanceCounter());
 
-						}
-						attack_encountered = true;
-					} break;
+		submit_render_frame(&render, &input_ring);
+		Render_List *list = begin_render_frame(&render);
 
-					case ACTION_JUMP: {
+		// TODO: Check the half transitions here
 
-					} break;
+		bool left_button_clicked = left_button_is_down && !left_button_was_down;
 
-					case ACTION_CROUCH: {
-						player.animation->state = PLAYER_ANIMATION_CROUCH;
-					} break;
+		// recording and replaying stream in the ticks instead
+		if (!deterministic)
+			update_world_stream(&stream, &frame_arena, camera, { camera - resolution / 2.f, camera + resolution / 2.f });
+
+		// pools never reallocate and nothing removes components during a frame, so these stay valid until the end of it
+		Transform *player_transform = get_component(&world, &world.transforms, sim.state.player);
+		Velocity *player_velocity = get_component(&world, &world.velocities, sim.state.player);
+		Collider *player_collider = get_component(&world, &world.colliders, sim.state.player);
+		Transform *enemy_transform = get_component(&world, &world.transforms, sim.state.enemy);
+		Collider *enemy_collider = get_component(&world, &world.colliders, sim.state.enemy);
+
+		if (editing) {
+			if (is_pressed(&input, SDL_SCANCODE_1)) brush = TILE_FLOOR, placing_spawns = false;
+			if (is_pressed(&input, SDL_SCANCODE_2)) brush = TILE_WALL, placing_spawns = false;
+			if (is_pressed(&input, SDL_SCANCODE_3)) brush = TILE_EMPTY, placing_spawns = false;
+			if (is_pressed(&input, SDL_SCANCODE_4)) placing_spawns = true;
+
+			V2i cell = tile_cell(&level, mouse + camera - resolution / 2.f);
+			if (placing_spawns && left_button_clicked) {
+				if (!add_chunk_spawn(&stream, mouse + camera - resolution / 2.f))
+					SDL_Log("No more room for enemies in that chunk");
+			} else if ((left_button_is_down && !placing_spawns) || right_button_is_down) {
+				Tile_Kind kind = left_button_is_down ? brush : TILE_EMPTY;
+				// fill the line from where the last frame painted, so that fast strokes have no gaps
+				V2i from = (left_button_was_down || right_button_was_down) ? last_painted : cell;
+				i32 steps = Max(SDL_abs(cell.x - from.x), SDL_abs(cell.y - from.y));
+				for (i32 i = 0; i <= steps; ++i) {
+					r32 t = steps ? (r32) i / steps : 0.f;
+					V2i p = V2i((i32) roundf(lerp((r32) from.x, t, (r32) cell.x)), (i32) roundf(lerp((r32) from.y, t, (r32) cell.y)));
+					if (set_tile(&level, p.x, p.y, kind)) {
+						tiles_to_nav_grid(&level, edit_nav_grid(&flow_builder), p, p);
+						mark_static_geometry_dirty(&level_collision, p.x, p.y);
+					}
 				}
+				last_painted = cell;
 			}
+		}
 
-			if (buffer_action_size == 0) {
-				player.animation->state = player.animation->default_state;
+		// spawns a horde around the player to put the AI scheduler under load
+		if (is_pressed(&input, SDL_SCANCODE_F7) && !deterministic) {
+			for (i32 i = 0; i < 100; ++i) {
+				r32 angle = random_unilateral(&random) * 2 * PI32;
+				V2 pos = player_transform->pos + V2(cosf(angle), sinf(angle)) * random_between(&random, 300.f, 3000.f);
+				V2i cell = tile_cell(&level, pos);
+				if (tile_is_solid(&level, cell.x, cell.y))
+					continue;
+				spawn_enemy(&world, enemy_animation, pos - enemy_size / 2);
 			}
+			break_history(&history);
+		}
 
-			if (!attack_encountered) {
-				player.combo = 0;
-				counter = 0;
-				SDL_SetWindowTitle(window, "Attacks Ended");
+		// stress test: the enemy sprays projectiles while F5 is held
+		if (is_held(&input, SDL_SCANCODE_F5) && !deterministic) {
+			V2 origin = enemy_transform->pos + enemy_transform->size / 2;
+			for (i32 i = 0; i < 64; ++i) {
+				Projectile_Kind kind = (Projectile_Kind) (PROJECTILE_BOMB + random_choice(&random, 3));
+				r32 angle = random_unilateral(&random) * 2 * PI32;
+				V2 vel = V2(cosf(angle), sinf(angle)) * random_between(&random, 150.f, 600.f);
+				spawn_projectile(&projectiles, kind, origin, vel, sim.state.enemy.index);
 			}
+			break_history(&history);
+		}
 
+		update_static_geometry(&level_collision);
+		// a re-simulation can't go back past chunks the stream or the editor added or removed enemies for
+		if (stream.epoch != stream_epoch) {
+			stream_epoch = stream.epoch;
+			break_history(&history);
 		}
 
-		refresh_buffer(buffer_actions, &buffer_action_size);
-
-		enemy.accn = {};
-		enemy.accn.y -= is_held(&input, SDL_SCANCODE_UP);
-		enemy.accn.x -= is_held(&input, SDL_SCANCODE_LEFT);
-		enemy.accn.x += is_held(&input, SDL_SCANCODE_RIGHT);
-		enemy.accn.y += is_held(&input, SDL_SCANCODE_DOWN);
-
-		//if (is_pressed(&input, SDL_SCANCODE_SPACE)) {
-		//	// player.animation_state = (player.animation_state + 1) % PLAYER_ANIMATION_COUNT;
-		//	enemy.animation_state = (enemy.animation_state + 1) % COUNT_ENEMY_ANIMATION;
-		//}
-
-		player.accn = normalizez(player.accn);
-		enemy.accn = normalizez(enemy.accn);
-
-		r32 speed = 250.f;
-
-		//if (player.accn.x != 0 && player.animation_state == PLAYER_ANIMATION_RUN)
-		//		player.animation_state = PLAYER_ANIMATION_IDLE;
-
-		//if (is_held(&input, SDL_SCANCODE_LCTRL)) {
-		//} else {
-		//	if (player.animation_state == PLAYER_ANIMATION_CROUCH)
-		//		player.animation_state = PLAYER_ANIMATION_IDLE;
-		//}
-
-		// TODO: generate sword collider and make others get damaged if appropriate
-
-		Rect r_player = { player.pos, player.pos + player.size };
-		Rect r_enemy = { enemy.pos + enemy.size / 4.f , enemy.pos + enemy.size * 3.f / 4.f };
-		Capsule c_player;
-		c_player.radius = player.size.x / 5.f;
-		c_player.a = player.pos + V2(1, 0.75) * player.size * 0.5f;
-		c_player.b = c_player.a + V2(0, 1) * player.size * 0.4f;
-		//Circle c_player = { player.pos + player.size / 2.f, player.size.y / 2.f };
-		u32 collision_color = 0xff0000ff;
-
-		while (accumulator >= dt) {
-			// call into physics
-
-			player.pos += speed * player.accn * dt;
-			// forgot to update the player capsule after moving woops
-			c_player.a = player.pos + V2(1, 0.75) * player.size * 0.5f;
-			c_player.b = c_player.a + V2(0, 1) * player.size * 0.4f;
-			r_player = { player.pos, player.pos + player.size };
-
-			// forgot to update the enemy rect after moving woops
-			enemy.pos += speed * enemy.accn * dt;
-			r_enemy = { enemy.pos + enemy.size / 4.f , enemy.pos + enemy.size * 3.f / 4.f };
-
-			{
-				V2 dist;
-
-				if (epa(c_player, r_enemy, dist)) {
-					player.pos -= dist / 2;
-					enemy.pos += dist / 2;
-					c_player.a = player.pos + V2(1, 0.75) * player.size * 0.5f;
-					c_player.b = c_player.a + V2(0, 1) * player.size * 0.4f;
-					r_enemy = { enemy.pos + enemy.size / 4.f , enemy.pos + enemy.size * 3.f / 4.f };
-					collision_color = 0xffffffff;
-				}
-			}
-			{
-				V2 dist;
-				if (epa(poly, r_enemy, dist)) {
-					poly.pos -= dist;	// for the polygon, just updating its position works
-					collision_color = 0xff00ffff;
+		// the ticks simulate from where the last frame's left off
+		r64 frame_start = simulation_ticks(&scheduler);
+		r64 tick_start = frame_start;
+		u32 now = SDL_GetTicks();
+		begin_ticks(&scheduler);
+		while (next_tick(&scheduler)) {
+			Tick_Input tick_input = take_tick_input(&input_ring, tick_start, tick_start + dt * 1000.0, frame_start, now);
+			if (deterministic) {
+				if (!replay_tick_input(&replay, &tick_input)) {
+					is_running = false;
+					break;
 				}
-			}
-			{
-				V2 dist;
-				if (epa(c_player, poly, dist)) {
-					player.pos -= dist;	// same here
-					c_player.a = player.pos + V2(1, 0.75) * player.size * 0.5f;
-					c_player.b = c_player.a + V2(0, 1) * player.size * 0.4f;
-					collision_color = 0x00ffffff;
+				// what is active can't depend on how many ticks the frames happened to run
+				Rect view = { sim.state.camera - resolution / 2.f, sim.state.camera + resolution / 2.f };
+				settle_world_stream(&stream, &frame_arena, sim.state.camera, view);
+				update_static_geometry(&level_collision);
+				if (stream.epoch != stream_epoch) {
+					stream_epoch = stream.epoch;
+					break_history(&history);
 				}
 			}
+			save_previous_positions(&previous_positions, &world.transforms);
+			previous_camera = sim.state.camera;
+			record_tick(&history, &sim, &tick_input);
+			u64 simulate_start = SDL_GetPerformanceCounter();
+			simulate_tick(&sim, &tick_input, dt);
+			add_replay_tick_time(&replay, counter_to_ms(SDL_GetPerformanceCounter() - simulate_start));
+			tick_start += dt * 1000.0;
+		}
+		if (deterministic) {
+			// the stream created and destroyed entities, which moves components around
+			player_transform = get_component(&world, &world.transforms, sim.state.player);
+			player_velocity = get_component(&world, &world.velocities, sim.state.player);
+			player_collider = get_component(&world, &world.colliders, sim.state.player);
+			enemy_transform = get_component(&world, &world.transforms, sim.state.enemy);
+			enemy_collider = get_component(&world, &world.colliders, sim.state.enemy);
+		}
+		r32 alpha = scheduler.timing.alpha;
+		camera = lerp(previous_camera, alpha, sim.state.camera);
+		update_fly_through(&fly_through, &frame_arena, &stream, frame_time, &camera);
+
+		Rect r_enemy = collider_rect(enemy_collider, enemy_transform);
+		Capsule c_player = collider_capsule(player_collider, player_transform);
+		u32 collision_color = sim.state.collision_color;
+		for (i32 i = 0; i < sim.impact_count; ++i) {
+			emit_particles(&sparks, &spark_emission, sim.impacts[i], 16, &random);
+		}
+		sim.impact_count = 0;
 
-			camera = lerp(camera, 0.025f, player.pos);
-
-			update_frame(&player);
-			update_frame(&enemy);
+		if (sim.state.attack_count != shown_attack_count) {
+			shown_attack_count = sim.state.attack_count;
+			char buff[32] = {};
+			if (shown_attack_count > 0)
+				SDL_snprintf(buff, sizeof(buff), "Attack %d", shown_attack_count - 1);
+			else
+				SDL_snprintf(buff, sizeof(buff), "Attacks Ended");
+			SDL_SetWindowTitle(window, buff);
+		}
 
 
-			t += dt;
-			accumulator -= dt;
-		}
+		dust_emitter.active = player_velocity->accn.x != 0 || player_velocity->accn.y != 0;
+		dust_emitter.pos = player_transform->pos + player_transform->size * V2(0.5f, 0.95f);
+		update_particle_emitter(&dust_emitter, frame_time, &random);
+		update_particle_emitter(&fountain_emitter, frame_time, &random);
+		update_particles(&jobs, &sparks, frame_time);
+		update_particles(&jobs, &dust, frame_time);
+		update_particles(&jobs, &fountain, frame_time);
 
-		SDL_SetRenderDrawColor(renderer, HexColor(0x181818ff));
-		SDL_RenderClear(renderer);
+		begin_recording(&render);
+		push_draw_color(list, 0x181818ff);
+		push_clear(list);
 
-		display_frame(renderer, textures, &player);
-		display_frame(renderer, textures, &enemy);
+		V2 screen_offset = resolution / 2.f - camera;
+		render_tilemap(list, &level, { camera - resolution / 2.f, camera + resolution / 2.f }, screen_offset);
+		render_particles(list, &jobs, &dust, screen_offset);
+		render_sprites(list, &world, &previous_positions, alpha);
+		render_projectiles(list, &projectiles, (1.f - alpha) * dt);
+		render_projectiles(list, &effects, (1.f - alpha) * dt);
+		render_particles(list, &jobs, &sparks, screen_offset);
+		render_particles(list, &jobs, &fountain, screen_offset);
 
 		auto rect_to_sdl_rect = [] (Rect a) -> SDL_FRect {
 			return { a.min.x, a.min.y, (a.max - a.min).x, (a.max - a.min).y };
 		};
 
-		SDL_SetRenderDrawColor(renderer, HexColor(collision_color));
+		push_draw_color(list, collision_color);
 
 		SDL_FRect f_enemy = rect_to_sdl_rect(r_enemy);
 		f_enemy.x = f_enemy.x - camera.x + resolution.x / 2.f;
 		f_enemy.y = f_enemy.y - camera.y + resolution.y / 2.f;
-		SDL_RenderDrawRectF(renderer, &f_enemy);
-
-		draw_capsule(renderer, c_player, collision_color);
+		push_draw_rect(list, &f_enemy);
+
+		draw_capsule(list, c_player, collision_color);
+
+		draw_polygon(list, &sim.state.poly, collision_color);
+
+		// blocked cells and the path from the player to the mouse
+		if (show_navigation) {
+			V2i min = nav_cell(&nav_grid, camera - resolution / 2.f);
+			V2i max = nav_cell(&nav_grid, camera + resolution / 2.f);
+			push_draw_color(list, 0xff404060);
+			for (i32 y = Max(min.y, 0); y <= Min(max.y, nav_grid.height - 1); ++y) {
+				for (i32 x = Max(min.x, 0); x <= Min(max.x, nav_grid.width - 1); ++x) {
+					if (!nav_grid.blocked[y * nav_grid.width + x])
+						continue;
+					V2 corner = nav_grid.origin + V2((r32) x, (r32) y) * nav_grid.cell_size - camera + resolution / 2.f;
+					SDL_FRect cell = { corner.x, corner.y, nav_grid.cell_size, nav_grid.cell_size };
+					push_fill_rect(list, &cell);
+				}
+			}
 
-		draw_polygon(renderer, &poly, collision_color);
+			V2 from = player_transform->pos + player_transform->size / 2;
+			if (find_path(&nav_grid, &frame_arena, from, mouse + camera - resolution / 2.f, &path)) {
+				push_draw_color(list, 0x40ff40ff);
+				for (i32 i = 0; i + 1 < path.count; ++i) {
+					V2 a = path.points[i] - camera + resolution / 2.f;
+					V2 b = path.points[i + 1] - camera + resolution / 2.f;
+					push_line(list, a.x, a.y, b.x, b.y);
+				}
+			}
+		}
 
 		static SDL_FRect text_rect = {.w = 100};
 
 
-		//render_text(renderer, font, text_rect.x, text_rect.h, "This is a test", 0x7f0000ff);
-		render_text_fit_width(renderer, font, text_rect.x, text_rect.y, "The quick brown fox jumps over the lazy dog", 0x7f0000ff, text_rect.w);
+		//render_text(list, font, text_rect.x, text_rect.h, "This is a test", 0x7f0000ff);
+		render_text_fit_width(list, font, text_rect.x, text_rect.y, "The quick brown fox jumps over the lazy dog", 0x7f0000ff, text_rect.w);
 		{
 			char buff[32] = {};
 			SDL_snprintf(buff, sizeof(buff), "%f", text_rect.w);
-			render_text(renderer, font, 0, 0, String(buff, strlen(buff)), 0x7f0000ff);
+			render_text(list, font, 0, 0, String(buff, strlen(buff)), 0x7f0000ff);
+		}
+		{
+			AI_Metrics *metrics = &sim.state.ai.metrics;
+			char buff[128] = {};
+			SDL_snprintf(buff, sizeof(buff), "AI %.2f ms (peak %.2f), %u brains, near %u/%u, offscreen %u/%u, deferred %u",
+						 metrics->tick_ms, metrics->peak_tick_ms, world.brains.count,
+						 metrics->buckets[AI_LOD_NEAR].thinks, metrics->buckets[AI_LOD_NEAR].brains,
+						 metrics->buckets[AI_LOD_OFFSCREEN].thinks, metrics->buckets[AI_LOD_OFFSCREEN].brains,
+						 metrics->buckets[AI_LOD_NEAR].deferred + metrics->buckets[AI_LOD_MID].deferred +
+						 metrics->buckets[AI_LOD_FAR].deferred + metrics->buckets[AI_LOD_OFFSCREEN].deferred);
+			render_text(list, font, 0, font->size, String(buff, strlen(buff)), 0x7f0000ff);
 		}
-		//render_text(renderer, font, 0, font->size, "abcdefghijklmnopqrstuvwxyz");
+		{
+			Latency_Histogram *to_present = &input_ring.latency.to_present;
+			char buff[128] = {};
+			SDL_snprintf(buff, sizeof(buff), "Input to photon p50 %.0f ms, p95 %.0f ms, p99 %.0f ms (%u presses, submit p50 %.0f ms)",
+						 latency_percentile(to_present, .5f), latency_percentile(to_present, .95f), latency_percentile(to_present, .99f),
+						 to_present->count, latency_percentile(&input_ring.latency.to_submit, .5f));
+			render_text(list, font, 0, 2 * font->size, String(buff, strlen(buff)), 0x7f0000ff);
+		}
+		if (editing) {
+			V2i cell = tile_cell(&level, mouse + camera - resolution / 2.f);
+			V2 corner = level.origin + V2((r32) cell.x, (r32) cell.y) * (r32) TILE_SIZE + screen_offset;
+			SDL_FRect hovered = { corner.x, corner.y, TILE_SIZE, TILE_SIZE };
+			push_draw_color(list, 0xffff00ff);
+			push_draw_rect(list, &hovered);
+
+			// the baked collision outline, with the merged rects under it
+			V2i min, max;
+			static_chunk_range(&level_collision, { camera - resolution / 2.f, camera + resolution / 2.f }, &min, &max);
+			for (i32 cy = min.y; cy <= max.y; ++cy) {
+				for (i32 cx = min.x; cx <= max.x; ++cx) {
+					Static_Chunk *chunk = static_chunk_at(&level_collision, cx, cy);
+					if (!chunk)
+						continue;
+					push_draw_color(list, 0x4080ff80);
+					for (i32 i = 0; i < chunk->rects.count; ++i) {
+						Rect rect = chunk->rects[i];
+						SDL_FRect dest = { rect.min.x + screen_offset.x, rect.min.y + screen_offset.y, rect.max.x - rect.min.x, rect.max.y - rect.min.y };
+						push_draw_rect(list, &dest);
+					}
+					for (i32 i = 0; i < chunk->edges.count; ++i) {
+						Static_Edge *edge = &chunk->edges[i];
+						V2 a = edge->a + screen_offset, b = edge->b + screen_offset;
+						push_draw_color(list, 0x40ff40ff);
+						push_line(list, a.x, a.y, b.x, b.y);
+						// the corners actors get pushed around
+						push_draw_color(list, 0xff4040ff);
+						if (is_corner(edge, edge->a, edge->ghost_a)) {
+							SDL_FRect corner = { a.x - 2, a.y - 2, 4, 4 };
+							push_draw_rect(list, &corner);
+						}
+					}
+				}
+			}
+
+			Tilemap_Stats *stats = &render.tile_stats;
+			char buff[160] = {};
+			SDL_snprintf(buff, sizeof(buff), "Editing, brush %s. Tiles %.2f ms, %u chunks, %u rebuilt in %.2f ms (peak %.2f)",
+						 placing_spawns ? "enemy" : tile_types[brush].name, stats->draw_ms, stats->chunks_drawn, stats->chunks_rebuilt,
+						 stats->rebuild_ms, stats->peak_rebuild_ms);
+			render_text(list, font, 0, 3 * font->size, String(buff, strlen(buff)), 0x7f0000ff);
+			SDL_snprintf(buff, sizeof(buff), "Collision: %u solid tiles in %u rects, %u edges, last bake %.2f ms",
+						 level_collision.solid_tiles, level_collision.rect_count, level_collision.edge_count, level_collision.bake_ms);
+			render_text(list, font, 0, 4 * font->size, String(buff, strlen(buff)), 0x7f0000ff);
+			World_Stream_Stats *stream_stats = &stream.stats;
+			SDL_snprintf(buff, sizeof(buff), "Stream: %u chunks in %lld KB, %u stalled (%u frames), update %.2f ms (peak %.2f), %u loads, %u evictions",
+						 stream_stats->resident_chunks, (long long) stream_stats->resident_bytes / 1024, stream_stats->stalled_chunks,
+						 stream_stats->stall_frames, stream_stats->update_ms, stream_stats->peak_update_ms, stream_stats->loads, stream_stats->evictions);
+			render_text(list, font, 0, 5 * font->size, String(buff, strlen(buff)), 0x7f0000ff);
+		}
+		//render_text(list, font, 0, font->size, "abcdefghijklmnopqrstuvwxyz");
 		// render the atlas to check its content
 		//SDL_Rect dest = {0, 0, font->texture_size, font->texture_size };
 		//SDL_RenderCopy(renderer, font->atlas, &dest, &dest);
 
-		if (left_button_is_down) {
+		if (left_button_is_down && !editing) {
 			text_rect.x = mouse.x;
 			text_rect.y = mouse.y;
 		}
 
-		if (right_button_is_down) {
+		if (right_button_is_down && !editing) {
 			text_rect.w = mouse.x - text_rect.x;
 			text_rect.h = mouse.y - text_rect.y;
 		}
 
-		SDL_SetRenderDrawColor(renderer, HexColor(0xffffffff));
-		SDL_RenderDrawRectF(renderer, &text_rect);
-		
-		SDL_RenderPresent(renderer);
+		push_draw_color(list, 0xffffffff);
+		push_draw_rect(list, &text_rect);
 
+		Perf_Counts counts = {};
+		counts.entities = world.alive_count;
+		counts.colliders = world.colliders.count;
+		counts.static_colliders = level_collision.rect_count + level_collision.edge_count;
+		counts.projectiles = projectiles.count;
+		counts.particles = sparks.count + dust.count + fountain.count;
+		draw_perf_overlay(&perf_overlay, list, font, &frame_arena, &counts, frame_time, resolution.x);
+		add_profile_event("record", render.frames[render.recording].trace.record_start, SDL_GetPerformanceCounter());
 
-		u64 current_counter = SDL_GetPerformanceCounter();
-		frame_time = ((1000000.0f * (current_counter - last_counter)) / (r32) query_perf_freq) / 1000000.0f;
-		last_counter = current_counter;
+		end_frame(&scheduler);
+		record_perf_frame(&perf_overlay, &scheduler.timing, list->draws);
+		add_replay_frame(&replay, &scheduler.timing);
 
 		/*{
 			char buff[32] = {};
@@ -938,10 +1531,32 @@ i32 main(i32 argc, char **argv)
 			SDL_SetWindowTitle(window, buff);
 		}*/
 		// TODO: look into this
-		// camera = damp(camera, 0.025f, frame_time, player.pos);
+		// camera = damp(camera, 0.025f, frame_time, player_transform->pos);
 
-		accumulator += frame_time;
 	}
 
-	return 0;
-}
\ No newline at end of file
+	bool replay_matched = true;
+	if (replay.mode == REPLAY_RECORDING) {
+		if (save_replay(&replay, &sim))
+			SDL_Log("Recorded %llu ticks to %s", (unsigned long long) replay.ticks, replay.path);
+		else
+			SDL_Log("Could not write %s: %s", replay.path, SDL_GetError());
+	} else if (replay.mode == REPLAY_PLAYING) {
+		replay_matched = finish_replay(&replay, &sim, &frame_arena);
+	}
+
+	render_thread_shutdown(&render, &input_ring);
+	stop_asset_watch();
+	world_stream_shutdown(&stream);
+	flow_field_builder_shutdown(&flow_builder);
+	log_job_stats(&jobs);
+	job_system_shutdown(&jobs);
+	profiler_shutdown();
+
+	for (i32 i = 0; i < memory_arena_count; ++i) {
+		log_arena_usage(memory_arenas[i]);
+	}
+
+	return replay_matched ? 0 : 1;
+}
+#endif // NO_GAME_MAIN
@@ -0,0 +1,546 @@
+#pragma once
+
+// Navigation over a grid of walkable / blocked cells.
+//
+// Crowds chasing the player share one flow field: a Dijkstra map from the player's cell
+// outwards, where every reached cell stores the direction of its next step towards the player.
+// An enemy only has to look up its cell, whatever the number of enemies. The field is only
+// rebuilt when the player moves to another cell, only out to a maximum distance (enemies further
+// away steer straight at the player anyway), and can be built on a worker thread into a second
+// field that is swapped in once it is done.
+//
+// Single agents going somewhere else use jump point search, A* that skips over the long runs
+// of open cells that make plain A* slow on a grid.
+//
+// Diagonal steps are only allowed when both cells next to them are open, so nothing cuts a
+// corner.
+
+constexpr u8 NAV_NO_DIRECTION = 0xff;
+constexpr u32 NAV_UNREACHED = 0xffffffff;
+constexpr u32 NAV_NOT_IN_HEAP = 0xffffffff;
+constexpr u32 NAV_CLOSED = 0xfffffffe;
+
+constexpr u32 NAV_STRAIGHT_COST = 10;
+constexpr u32 NAV_DIAGONAL_COST = 14;
+
+// starting right and going clockwise (y points down), even ones are straight
+constexpr i32 nav_direction_x[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+constexpr i32 nav_direction_y[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+
+struct Nav_Grid {
+	i32 width;
+	i32 height;
+	r32 cell_size;
+	V2 origin;		// world position of the corner of cell (0, 0)
+	u8 *blocked;
+};
+
+struct Flow_Field {
+	i32 width;
+	i32 height;
+	V2i goal;
+	u32 max_cost;
+	u32 *costs;
+	u8 *directions;	// towards the goal, NAV_NO_DIRECTION where the field didn't reach
+
+	// scratch of the build, owned by the field so that a worker thread needs nothing else
+	u32 *heap;
+	u32 *heap_positions;
+	u32 *touched;	// cells the last build gave a cost, the next one only resets these
+	u32 touched_count;
+};
+
+// Binary min heap of cells keyed by an array of costs, with decrease key
+struct Nav_Heap {
+	u32 *cells;
+	u32 *positions;	// of each cell in cells, NAV_NOT_IN_HEAP or NAV_CLOSED
+	const u32 *keys;
+	u32 count;
+};
+
+void nav_heap_sift_up(Nav_Heap *heap, u32 i)
+{
+	u32 cell = heap->cells[i];
+	u32 key = heap->keys[cell];
+	while (i > 0) {
+		u32 parent = (i - 1) / 2;
+		if (heap->keys[heap->cells[parent]] <= key)
+			break;
+		heap->cells[i] = heap->cells[parent];
+		heap->positions[heap->cells[i]] = i;
+		i = parent;
+	}
+	heap->cells[i] = cell;
+	heap->positions[cell] = i;
+}
+
+// Pushes the cell or moves it up after its key went down
+void nav_heap_update(Nav_Heap *heap, u32 cell)
+{
+	u32 i = heap->positions[cell];
+	if (i == NAV_NOT_IN_HEAP) {
+		i = heap->count++;
+		heap->cells[i] = cell;
+	}
+	nav_heap_sift_up(heap, i);
+}
+
+u32 nav_heap_pop(Nav_Heap *heap)
+{
+	u32 result = heap->cells[0];
+	heap->positions[result] = NAV_CLOSED;
+	u32 cell = heap->cells[--heap->count];
+	u32 key = heap->keys[cell];
+	u32 i = 0;
+	if (heap->count > 0) {
+		while (true) {
+			u32 child = i * 2 + 1;
+			if (child >= heap->count)
+				break;
+			if (child + 1 < heap->count && heap->keys[heap->cells[child + 1]] < heap->keys[heap->cells[child]])
+				child++;
+			if (key <= heap->keys[heap->cells[child]])
+				break;
+			heap->cells[i] = heap->cells[child];
+			heap->positions[heap->cells[i]] = i;
+			i = child;
+		}
+		heap->cells[i] = cell;
+		heap->positions[cell] = i;
+	}
+	return result;
+}
+
+void nav_grid_init(Nav_Grid *grid, Memory_Arena *arena, i32 width, i32 height, r32 cell_size, V2 origin)
+{
+	grid->width = width;
+	grid->height = height;
+	grid->cell_size = cell_size;
+	grid->origin = origin;
+	grid->blocked = PushArray(arena, u8, width * height);
+}
+
+inline bool nav_walkable(Nav_Grid *grid, i32 x, i32 y)
+{
+	return x >= 0 && y >= 0 && x < grid->width && y < grid->height && !grid->blocked[y * grid->width + x];
+}
+
+inline V2i nav_cell(Nav_Grid *grid, V2 pos)
+{
+	V2 cell = (pos - grid->origin) / grid->cell_size;
+	return V2i((i32) floorf(cell.x), (i32) floorf(cell.y));
+}
+
+inline V2 nav_cell_center(Nav_Grid *grid, V2i cell)
+{
+	return grid->origin + (V2((r32) cell.x, (r32) cell.y) + V2(0.5f)) * grid->cell_size;
+}
+
+// Whether a step in direction d from (x, y) is allowed, the cell itself has to be open already
+inline bool nav_can_step(Nav_Grid *grid, i32 x, i32 y, i32 d)
+{
+	i32 dx = nav_direction_x[d], dy = nav_direction_y[d];
+	if (!nav_walkable(grid, x + dx, y + dy))
+		return false;
+	return (d & 1) == 0 || (nav_walkable(grid, x + dx, y) && nav_walkable(grid, x, y + dy));
+}
+
+// Blocks every cell that overlaps shape
+template <typename Shape>
+void nav_block_shape(Nav_Grid *grid, Shape shape, Rect bounds)
+{
+	V2i min = nav_cell(grid, bounds.min);
+	V2i max = nav_cell(grid, bounds.max);
+	for (i32 y = Max(min.y, 0); y <= Min(max.y, grid->height - 1); ++y) {
+		for (i32 x = Max(min.x, 0); x <= Min(max.x, grid->width - 1); ++x) {
+			V2 corner = grid->origin + V2((r32) x, (r32) y) * grid->cell_size;
+			Rect cell = { corner, corner + V2(grid->cell_size) };
+			if (gjk(cell, shape))
+				grid->blocked[y * grid->width + x] = 1;
+		}
+	}
+}
+
+void nav_block_polygon(Nav_Grid *grid, Polygon *polygon)
+{
+	Rect bounds = { polygon->pos, polygon->pos };
+	for (i32 i = 0; i < polygon->size; ++i) {
+		V2 p = polygon->pos + polygon->points[i];
+		bounds.min = V2(Min(bounds.min.x, p.x), Min(bounds.min.y, p.y));
+		bounds.max = V2(Max(bounds.max.x, p.x), Max(bounds.max.y, p.y));
+	}
+	nav_block_shape(grid, *polygon, bounds);
+}
+
+////////////////////////////////////////
+//				Flow field
+
+void flow_field_init(Flow_Field *field, Memory_Arena *arena, Nav_Grid *grid, u32 max_cost)
+{
+	*field = {};
+	i32 cells = grid->width * grid->height;
+	field->width = grid->width;
+	field->height = grid->height;
+	field->goal = V2i(-1, -1);
+	field->max_cost = max_cost;
+	field->costs = PushArrayNoZero(arena, u32, cells);
+	SDL_memset(field->costs, 0xff, cells * sizeof(u32));
+	field->directions = PushArrayNoZero(arena, u8, cells);
+	SDL_memset(field->directions, NAV_NO_DIRECTION, cells);
+	field->heap = PushArrayNoZero(arena, u32, cells);
+	field->heap_positions = PushArrayNoZero(arena, u32, cells);
+	SDL_memset(field->heap_positions, 0xff, cells * sizeof(u32));
+	field->touched = PushArrayNoZero(arena, u32, cells);
+}
+
+// Dijkstra from the goal outwards, stopping at field->max_cost. Every cell learns its direction
+// from the neighbour that reached it with the lowest cost, which is its next step to the goal.
+// Only the cells the last build reached are reset, so a field bounded by max_cost costs about the
+// same to rebuild on any size of grid
+void build_flow_field(Flow_Field *field, Nav_Grid *grid, V2i goal)
+{
+	for (u32 i = 0; i < field->touched_count; ++i) {
+		u32 index = field->touched[i];
+		field->costs[index] = NAV_UNREACHED;
+		field->directions[index] = NAV_NO_DIRECTION;
+		field->heap_positions[index] = NAV_NOT_IN_HEAP;
+	}
+	field->touched_count = 0;
+	field->goal = goal;
+	if (!nav_walkable(grid, goal.x, goal.y))
+		return;
+
+	Nav_Heap heap = { field->heap, field->heap_positions, field->costs, 0 };
+	u32 goal_index = goal.y * grid->width + goal.x;
+	field->costs[goal_index] = 0;
+	field->touched[field->touched_count++] = goal_index;
+	nav_heap_update(&heap, goal_index);
+
+	while (heap.count > 0) {
+		u32 index = nav_heap_pop(&heap);
+		u32 cost = field->costs[index];
+		if (cost > field->max_cost)
+			break;
+		i32 x = index % grid->width;
+		i32 y = index / grid->width;
+		for (i32 d = 0; d < 8; ++d) {
+			if (!nav_can_step(grid, x, y, d))
+				continue;
+			u32 next = (y + nav_direction_y[d]) * grid->width + x + nav_direction_x[d];
+			if (heap.positions[next] == NAV_CLOSED)
+				continue;
+			u32 next_cost = cost + ((d & 1) ? NAV_DIAGONAL_COST : NAV_STRAIGHT_COST);
+			if (next_cost < field->costs[next]) {
+				if (field->costs[next] == NAV_UNREACHED)
+					field->touched[field->touched_count++] = next;
+				field->costs[next] = next_cost;
+				field->directions[next] = (u8) ((d + 4) & 7);	// back where it came from
+				nav_heap_update(&heap, next);
+			}
+		}
+	}
+}
+
+// Unit direction to walk in from pos, or zero if the field doesn't reach there
+V2 sample_flow_field(Flow_Field *field, Nav_Grid *grid, V2 pos)
+{
+	V2i cell = nav_cell(grid, pos);
+	if (cell.x < 0 || cell.y < 0 || cell.x >= field->width || cell.y >= field->height)
+		return {};
+	u8 d = field->directions[cell.y * field->width + cell.x];
+	if (d == NAV_NO_DIRECTION)
+		return {};
+	return normalize(V2((r32) nav_direction_x[d], (r32) nav_direction_y[d]));
+}
+
+// Builds flow fields on a worker thread. The game keeps reading the front field while the back
+// one is built, and swaps them once the worker is done
+struct Flow_Field_Builder {
+	Nav_Grid *grid;
+	Flow_Field fields[2];
+	Flow_Field *front;
+	Flow_Field *back;
+
+	V2i requested_goal;
+	SDL_sem *request;
+	SDL_atomic_t busy;		// set by the game when it requests, cleared once it swapped
+	SDL_atomic_t done;		// set by the worker when back is ready
+	SDL_atomic_t running;
+	SDL_Thread *thread;
+
+	u64 last_build_counter;	// how long the last build took
+	u32 builds;
+	bool stale;				// the grid changed since the front field was built
+};
+
+int flow_field_thread(void *data)
+{
+	Flow_Field_Builder *builder = (Flow_Field_Builder *) data;
+	set_profile_thread_name("flow field");
+	while (true) {
+		SDL_SemWait(builder->request);
+		if (!SDL_AtomicGet(&builder->running))
+			break;
+		u64 start = SDL_GetPerformanceCounter();
+		build_flow_field(builder->back, builder->grid, builder->requested_goal);
+		builder->last_build_counter = SDL_GetPerformanceCounter() - start;
+		SDL_AtomicSet(&builder->done, 1);
+	}
+	return 0;
+}
+
+// Without threaded, requests are built right away on the calling thread
+void flow_field_builder_init(Flow_Field_Builder *builder, Memory_Arena *arena, Nav_Grid *grid, u32 max_cost, bool threaded)
+{
+	*builder = {};
+	builder->grid = grid;
+	flow_field_init(&builder->fields[0], arena, grid, max_cost);
+	flow_field_init(&builder->fields[1], arena, grid, max_cost);
+	builder->front = &builder->fields[0];
+	builder->back = &builder->fields[1];
+	if (threaded) {
+		builder->request = SDL_CreateSemaphore(0);
+		SDL_AtomicSet(&builder->running, 1);
+		builder->thread = SDL_CreateThread(flow_field_thread, "flow_field", builder);
+		if (!builder->thread) {
+			SDL_Log("Could not start the flow field thread, building on the main thread: %s", SDL_GetError());
+		}
+	}
+}
+
+void flow_field_builder_shutdown(Flow_Field_Builder *builder)
+{
+	if (!builder->thread)
+		return;
+	SDL_AtomicSet(&builder->running, 0);
+	SDL_SemPost(builder->request);
+	SDL_WaitThread(builder->thread, nullptr);
+	SDL_DestroySemaphore(builder->request);
+	builder->thread = nullptr;
+}
+
+// Waits for the build in flight, which reads the grid, so that the caller can change the grid.
+// The next update rebuilds the field even if the goal stayed in the same cell
+Nav_Grid *edit_nav_grid(Flow_Field_Builder *builder)
+{
+	while (SDL_AtomicGet(&builder->busy) && !SDL_AtomicGet(&builder->done))
+		SDL_Delay(0);
+	builder->stale = true;
+	return builder->grid;
+}
+
+// Same without waiting, nullptr while a build is in flight
+Nav_Grid *try_edit_nav_grid(Flow_Field_Builder *builder)
+{
+	if (SDL_AtomicGet(&builder->busy) && !SDL_AtomicGet(&builder->done))
+		return nullptr;
+	builder->stale = true;
+	return builder->grid;
+}
+
+// Call once per frame with where the agents should go. Swaps in a finished field and starts a
+// new build when the goal moved to another cell. Returns the field to sample this frame
+Flow_Field *update_flow_field(Flow_Field_Builder *builder, V2 goal_pos)
+{
+	if (SDL_AtomicGet(&builder->done)) {
+		Flow_Field *front = builder->front;
+		builder->front = builder->back;
+		builder->back = front;
+		builder->builds++;
+		SDL_AtomicSet(&builder->done, 0);
+		SDL_AtomicSet(&builder->busy, 0);
+	}
+
+	V2i goal = nav_cell(builder->grid, goal_pos);
+	if (SDL_AtomicGet(&builder->busy) || (!builder->stale && goal.x == builder->front->goal.x && goal.y == builder->front->goal.y))
+		return builder->front;
+	builder->stale = false;
+
+	if (builder->thread) {
+		builder->requested_goal = goal;
+		SDL_AtomicSet(&builder->busy, 1);
+		SDL_SemPost(builder->request);
+	} else {
+		u64 start = SDL_GetPerformanceCounter();
+		build_flow_field(builder->back, builder->grid, goal);
+		builder->last_build_counter = SDL_GetPerformanceCounter() - start;
+		Flow_Field *front = builder->front;
+		builder->front = builder->back;
+		builder->back = front;
+		builder->builds++;
+	}
+	return builder->front;
+}
+
+//				Flow field
+////////////////////////////////////////
+
+////////////////////////////////////////
+//				Jump point search
+
+struct Nav_Path {
+	V2 *points;		// cell centers from start to goal, one for each turn
+	i32 count;
+	i32 capacity;
+};
+
+// Walks from (x, y) in (dx, dy) until it finds a jump point: the goal, a cell with a forced
+// neighbour or, going diagonally, a cell from which a straight jump finds one. Returns false if
+// it runs into a wall first
+bool nav_jump(Nav_Grid *grid, i32 x, i32 y, i32 dx, i32 dy, V2i goal, V2i *result)
+{
+	while (true) {
+		if (!nav_walkable(grid, x, y))
+			return false;
+		if (x == goal.x && y == goal.y) {
+			*result = V2i(x, y);
+			return true;
+		}
+
+		if (dx != 0 && dy != 0) {
+			V2i ignored;
+			if (nav_jump(grid, x + dx, y, dx, 0, goal, &ignored) || nav_jump(grid, x, y + dy, 0, dy, goal, &ignored)) {
+				*result = V2i(x, y);
+				return true;
+			}
+			if (!nav_walkable(grid, x + dx, y) || !nav_walkable(grid, x, y + dy))
+				return false;
+		} else if (dx != 0) {
+			if ((nav_walkable(grid, x, y - 1) && !nav_walkable(grid, x - dx, y - 1)) ||
+				(nav_walkable(grid, x, y + 1) && !nav_walkable(grid, x - dx, y + 1))) {
+				*result = V2i(x, y);
+				return true;
+			}
+		} else {
+			if ((nav_walkable(grid, x - 1, y) && !nav_walkable(grid, x - 1, y - dy)) ||
+				(nav_walkable(grid, x + 1, y) && !nav_walkable(grid, x + 1, y - dy))) {
+				*result = V2i(x, y);
+				return true;
+			}
+		}
+		x += dx;
+		y += dy;
+	}
+}
+
+inline u32 nav_octile_distance(V2i a, V2i b)
+{
+	u32 dx = (u32) SDL_abs(a.x - b.x);
+	u32 dy = (u32) SDL_abs(a.y - b.y);
+	return NAV_STRAIGHT_COST * Max(dx, dy) + (NAV_DIAGONAL_COST - NAV_STRAIGHT_COST) * Min(dx, dy);
+}
+
+inline i32 nav_sign(i32 a) { return (a > 0) - (a < 0); }
+
+// Directions worth looking at from a cell reached from parent: the natural ones (straight on,
+// and the two straight parts of a diagonal) and the forced ones around walls next to it
+i32 nav_jps_successors(Nav_Grid *grid, i32 x, i32 y, i32 dx, i32 dy, V2i *directions)
+{
+	i32 count = 0;
+	auto add = [&](i32 ndx, i32 ndy) {
+		if (nav_walkable(grid, x + ndx, y + ndy) &&
+			(ndx == 0 || ndy == 0 || (nav_walkable(grid, x + ndx, y) && nav_walkable(grid, x, y + ndy))))
+			directions[count++] = V2i(ndx, ndy);
+	};
+
+	if (dx == 0 && dy == 0) {
+		for (i32 d = 0; d < 8; ++d)
+			add(nav_direction_x[d], nav_direction_y[d]);
+	} else if (dx != 0 && dy != 0) {
+		add(0, dy);
+		add(dx, 0);
+		add(dx, dy);
+	} else if (dx != 0) {
+		add(dx, 0);
+		add(dx, 1);
+		add(dx, -1);
+		add(0, 1);
+		add(0, -1);
+	} else {
+		add(0, dy);
+		add(1, dy);
+		add(-1, dy);
+		add(1, 0);
+		add(-1, 0);
+	}
+	return count;
+}
+
+// A* over jump points, scratch memory comes from arena. Returns false if there is no path or it
+// doesn't fit in path->capacity
+bool find_path(Nav_Grid *grid, Memory_Arena *arena, V2 from, V2 to, Nav_Path *path)
+{
+	path->count = 0;
+	V2i start = nav_cell(grid, from);
+	V2i goal = nav_cell(grid, to);
+	if (!nav_walkable(grid, start.x, start.y) || !nav_walkable(grid, goal.x, goal.y))
+		return false;
+
+	Temp_Memory temp = begin_temp_memory(arena);
+	Defer(end_temp_memory(temp));
+
+	i32 cells = grid->width * grid->height;
+	u32 *g = PushArrayNoZero(arena, u32, cells);
+	u32 *f = PushArrayNoZero(arena, u32, cells);
+	u32 *parents = PushArrayNoZero(arena, u32, cells);
+	Nav_Heap heap = { PushArrayNoZero(arena, u32, cells), PushArrayNoZero(arena, u32, cells), f, 0 };
+	SDL_memset(g, 0xff, cells * sizeof(u32));
+	SDL_memset(heap.positions, 0xff, cells * sizeof(u32));
+
+	u32 start_index = start.y * grid->width + start.x;
+	u32 goal_index = goal.y * grid->width + goal.x;
+	g[start_index] = 0;
+	f[start_index] = nav_octile_distance(start, goal);
+	parents[start_index] = start_index;
+	nav_heap_update(&heap, start_index);
+
+	bool found = false;
+	while (heap.count > 0) {
+		u32 index = nav_heap_pop(&heap);
+		if (index == goal_index) {
+			found = true;
+			break;
+		}
+		i32 x = index % grid->width;
+		i32 y = index / grid->width;
+		u32 parent = parents[index];
+		i32 dx = nav_sign(x - (i32) (parent % grid->width));
+		i32 dy = nav_sign(y - (i32) (parent / grid->width));
+
+		V2i directions[8];
+		i32 direction_count = nav_jps_successors(grid, x, y, dx, dy, directions);
+		for (i32 i = 0; i < direction_count; ++i) {
+			V2i jump;
+			if (!nav_jump(grid, x + directions[i].x, y + directions[i].y, directions[i].x, directions[i].y, goal, &jump))
+				continue;
+			u32 jump_index = jump.y * grid->width + jump.x;
+			if (heap.positions[jump_index] == NAV_CLOSED)
+				continue;
+			u32 jump_g = g[index] + nav_octile_distance(V2i(x, y), jump);
+			if (jump_g < g[jump_index]) {
+				g[jump_index] = jump_g;
+				f[jump_index] = jump_g + nav_octile_distance(jump, goal);
+				parents[jump_index] = index;
+				nav_heap_update(&heap, jump_index);
+			}
+		}
+	}
+	if (!found)
+		return false;
+
+	i32 count = 1;
+	for (u32 index = goal_index; index != start_index; index = parents[index])
+		count++;
+	if (count > path->capacity)
+		return false;
+	path->count = count;
+	u32 index = goal_index;
+	for (i32 i = count - 1; i >= 0; --i) {
+		path->points[i] = nav_cell_center(grid, V2i(index % grid->width, index / grid->width));
+		index = parents[index];
+	}
+	return true;
+}
+
+//				Jump point search
+////////////////////////////////////////
@@ -0,0 +1,263 @@
+#pragma once
+
+// CPU particles for combat feedback: hit sparks, dust and the like.
+//
+// A Particle_Buffer holds every particle that shares a texture and a look (gravity, drag, size
+// and colour over the lifetime), as padded SoA arrays so that integration and the size / colour
+// curves run over whole arrays in Wide lanes (see ren_simd.h). The vertex buffer is written
+// straight from those arrays and drawn with a single SDL_RenderGeometry call per buffer. There
+// are two vertex buffers, the render thread draws from one while the next frame writes the other.
+//
+// The kernels work on ranges of particles, the update and the vertices are split into jobs (see
+// jobs.h) of PARTICLE_JOB_BATCH particles.
+
+#include "ren_simd.h"
+
+constexpr u32 PARTICLE_JOB_BATCH = 4096;	// a multiple of WIDE_LANES
+
+struct Particle_Buffer {
+	// per particle, padded to WIDE_LANES
+	r32 *x;
+	r32 *y;
+	r32 *vx;
+	r32 *vy;
+	r32 *age;
+	r32 *inv_lifetime;
+	u32 count;
+	u32 capacity;
+	u32 dropped;	// particles that found the buffer full
+
+	// the same for every particle of the buffer
+	V2 gravity;
+	r32 drag;		// fraction of the velocity lost per second
+	r32 size_start;
+	r32 size_end;
+	r32 color_start[4];
+	r32 color_end[4];
+	SDL_Texture *texture;
+
+	SDL_Vertex *vertices[2];
+	i32 vertex_buffer;	// written last
+	i32 *indices;
+};
+
+struct Particle_Emission {
+	r32 speed_min;
+	r32 speed_max;
+	r32 direction;	// radians
+	r32 spread;		// radians to either side of direction
+	r32 lifetime_min;
+	r32 lifetime_max;
+	r32 jitter;		// random offset from the emitter position
+};
+
+struct Particle_Emitter {
+	Particle_Buffer *buffer;
+	Particle_Emission emission;
+	V2 pos;
+	r32 rate;		// particles per second
+	r32 accumulator;
+	bool active;
+};
+
+// colors are 0xRRGGBBAA like everywhere else
+void particle_buffer_init(Particle_Buffer *buffer, Memory_Arena *arena, u32 capacity, SDL_Texture *texture,
+						  u32 color_start, u32 color_end, r32 size_start, r32 size_end)
+{
+	*buffer = {};
+	capacity = (u32) wide_padded((i32) capacity);
+	imem size = capacity * sizeof(r32);
+	// zeroed so that the padding lanes never hold garbage (like NaNs) that slows the math down
+	buffer->x = (r32 *) arena_push_zero(arena, size, WIDE_ALIGN);
+	buffer->y = (r32 *) arena_push_zero(arena, size, WIDE_ALIGN);
+	buffer->vx = (r32 *) arena_push_zero(arena, size, WIDE_ALIGN);
+	buffer->vy = (r32 *) arena_push_zero(arena, size, WIDE_ALIGN);
+	buffer->age = (r32 *) arena_push_zero(arena, size, WIDE_ALIGN);
+	buffer->inv_lifetime = (r32 *) arena_push_zero(arena, size, WIDE_ALIGN);
+	buffer->capacity = capacity;
+
+	buffer->vertices[0] = PushArrayNoZero(arena, SDL_Vertex, capacity * 4);
+	buffer->vertices[1] = PushArrayNoZero(arena, SDL_Vertex, capacity * 4);
+	buffer->indices = PushArrayNoZero(arena, i32, capacity * 6);
+	for (u32 i = 0; i < capacity; ++i) {
+		i32 *index = buffer->indices + i * 6;
+		i32 vertex = (i32) i * 4;
+		index[0] = vertex + 0; index[1] = vertex + 1; index[2] = vertex + 2;
+		index[3] = vertex + 0; index[4] = vertex + 2; index[5] = vertex + 3;
+	}
+
+	for (i32 i = 0; i < 4; ++i) {
+		buffer->color_start[i] = (r32) ((color_start >> (8 * (3 - i))) & 0xff);
+		buffer->color_end[i] = (r32) ((color_end >> (8 * (3 - i))) & 0xff);
+	}
+	buffer->size_start = size_start;
+	buffer->size_end = size_end;
+	buffer->texture = texture;
+}
+
+void emit_particles(Particle_Buffer *buffer, const Particle_Emission *emission, V2 pos, i32 count, Random_Series *random)
+{
+	for (i32 n = 0; n < count; ++n) {
+		if (buffer->count >= buffer->capacity) {
+			buffer->dropped += count - n;
+			return;
+		}
+		u32 i = buffer->count++;
+		r32 angle = emission->direction + emission->spread * random_bilateral(random);
+		r32 speed = random_between(random, emission->speed_min, emission->speed_max);
+		buffer->x[i] = pos.x + emission->jitter * random_bilateral(random);
+		buffer->y[i] = pos.y + emission->jitter * random_bilateral(random);
+		buffer->vx[i] = cosf(angle) * speed;
+		buffer->vy[i] = sinf(angle) * speed;
+		buffer->age[i] = 0;
+		buffer->inv_lifetime[i] = 1.f / random_between(random, emission->lifetime_min, emission->lifetime_max);
+	}
+}
+
+void update_particle_emitter(Particle_Emitter *emitter, r32 dt, Random_Series *random)
+{
+	if (!emitter->active) {
+		emitter->accumulator = 0;
+		return;
+	}
+	emitter->accumulator += emitter->rate * dt;
+	i32 count = (i32) emitter->accumulator;
+	emitter->accumulator -= count;
+	emit_particles(emitter->buffer, &emitter->emission, emitter->pos, count, random);
+}
+
+// begin has to be a multiple of WIDE_LANES, end is rounded up to one
+void integrate_particles(Particle_Buffer *buffer, u32 begin, u32 end, r32 dt)
+{
+	end = (u32) wide_padded((i32) end);
+	Wide wide_dt = wide_set1(dt);
+	Wide damping = wide_set1(Max(0.f, 1.f - buffer->drag * dt));
+	Wide gravity_x = wide_set1(buffer->gravity.x * dt);
+	Wide gravity_y = wide_set1(buffer->gravity.y * dt);
+	for (u32 i = begin; i < end; i += WIDE_LANES) {
+		Wide vx = wide_load(buffer->vx + i) * damping + gravity_x;
+		Wide vy = wide_load(buffer->vy + i) * damping + gravity_y;
+		wide_store(buffer->vx + i, vx);
+		wide_store(buffer->vy + i, vy);
+		wide_store(buffer->x + i, wide_load(buffer->x + i) + vx * wide_dt);
+		wide_store(buffer->y + i, wide_load(buffer->y + i) + vy * wide_dt);
+		wide_store(buffer->age + i, wide_load(buffer->age + i) + wide_dt);
+	}
+}
+
+void remove_dead_particles(Particle_Buffer *buffer)
+{
+	// back to front, so that whatever gets swapped into i was already checked
+	for (u32 i = buffer->count; i-- > 0; ) {
+		if (buffer->age[i] * buffer->inv_lifetime[i] < 1.f)
+			continue;
+		u32 last = --buffer->count;
+		buffer->x[i] = buffer->x[last];
+		buffer->y[i] = buffer->y[last];
+		buffer->vx[i] = buffer->vx[last];
+		buffer->vy[i] = buffer->vy[last];
+		buffer->age[i] = buffer->age[last];
+		buffer->inv_lifetime[i] = buffer->inv_lifetime[last];
+	}
+}
+
+struct Particle_Job {
+	Particle_Buffer *buffer;
+	r32 dt;
+	V2 offset;
+};
+
+void integrate_particles_job(void *data, u32 begin, u32 end)
+{
+	Particle_Job *job = (Particle_Job *) data;
+	integrate_particles(job->buffer, begin, end, job->dt);
+}
+
+void update_particles(Job_System *jobs, Particle_Buffer *buffer, r32 dt)
+{
+	Particle_Job job = { buffer, dt };
+	parallel_for(jobs, "integrate particles", buffer->count, PARTICLE_JOB_BATCH, integrate_particles_job, &job);
+	remove_dead_particles(buffer);
+}
+
+// Writes the quads of particles [begin, end) into the current vertex buffer, with offset added to
+// their positions. begin has to be a multiple of WIDE_LANES
+void build_particle_vertices(Particle_Buffer *buffer, u32 begin, u32 end, V2 offset)
+{
+	alignas(WIDE_ALIGN) r32 half_size[WIDE_LANES];
+	alignas(WIDE_ALIGN) r32 color[4][WIDE_LANES];
+
+	Wide one = wide_set1(1.f);
+	Wide size_start = wide_set1(buffer->size_start * 0.5f);
+	Wide size_end = wide_set1(buffer->size_end * 0.5f);
+	Wide color_start[4], color_end[4];
+	for (i32 c = 0; c < 4; ++c) {
+		color_start[c] = wide_set1(buffer->color_start[c]);
+		color_end[c] = wide_set1(buffer->color_end[c]);
+	}
+
+	for (u32 i = begin; i < end; i += WIDE_LANES) {
+		Wide t = wide_min(wide_load(buffer->age + i) * wide_load(buffer->inv_lifetime + i), one);
+		wide_store(half_size, wide_lerp(size_start, t, size_end));
+		for (i32 c = 0; c < 4; ++c)
+			wide_store(color[c], wide_lerp(color_start[c], t, color_end[c]));
+
+		u32 lanes = Min((u32) WIDE_LANES, end - i);
+		for (u32 lane = 0; lane < lanes; ++lane) {
+			r32 x = buffer->x[i + lane] + offset.x;
+			r32 y = buffer->y[i + lane] + offset.y;
+			r32 h = half_size[lane];
+			SDL_Color c = { (u8) color[0][lane], (u8) color[1][lane], (u8) color[2][lane], (u8) color[3][lane] };
+			SDL_Vertex *v = buffer->vertices[buffer->vertex_buffer] + (i + lane) * 4;
+			v[0] = { { x - h, y - h }, c, { 0, 0 } };
+			v[1] = { { x + h, y - h }, c, { 1, 0 } };
+			v[2] = { { x + h, y + h }, c, { 1, 1 } };
+			v[3] = { { x - h, y + h }, c, { 0, 1 } };
+		}
+	}
+}
+
+void build_particle_vertices_job(void *data, u32 begin, u32 end)
+{
+	Particle_Job *job = (Particle_Job *) data;
+	build_particle_vertices(job->buffer, begin, end, job->offset);
+}
+
+void render_particles(Render_List *list, Job_System *jobs, Particle_Buffer *buffer, V2 offset)
+{
+	if (buffer->count == 0)
+		return;
+	buffer->vertex_buffer ^= 1;
+	Particle_Job job = { buffer, 0, offset };
+	parallel_for(jobs, "particle vertices", buffer->count, PARTICLE_JOB_BATCH, build_particle_vertices_job, &job);
+	push_geometry(list, buffer->texture, buffer->vertices[buffer->vertex_buffer], buffer->count * 4, buffer->indices, buffer->count * 6);
+}
+
+// White dot that fades out towards its edge, tinted by the vertex colours
+SDL_Texture *create_particle_texture(SDL_Renderer *renderer, Memory_Arena *arena, SDL_BlendMode blend_mode)
+{
+	constexpr i32 size = 32;
+	Temp_Memory temp = begin_temp_memory(arena);
+	Defer(end_temp_memory(temp));
+
+	u32 *pixels = PushArrayNoZero(arena, u32, size * size);
+	for (i32 y = 0; y < size; ++y) {
+		for (i32 x = 0; x < size; ++x) {
+			V2 d = (V2((r32) x, (r32) y) + V2(0.5f)) / (size / 2.f) - V2(1.f);
+			r32 falloff = Clamp(0.f, 1.f - length(d), 1.f);
+			u8 alpha = (u8) (255 * falloff * falloff);
+			// SDL_PIXELFORMAT_RGBA32 is byte order, so alpha is the last byte in memory
+			u8 *pixel = (u8 *) &pixels[y * size + x];
+			pixel[0] = pixel[1] = pixel[2] = 0xff;
+			pixel[3] = alpha;
+		}
+	}
+
+	SDL_Texture *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, size, size);
+	if (!texture) {
+		fatal_error(SDL_GetError());
+	}
+	SDL_UpdateTexture(texture, nullptr, pixels, size * 4);
+	SDL_SetTextureBlendMode(texture, blend_mode);
+	return texture;
+}
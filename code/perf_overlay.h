@@ -0,0 +1,229 @@
+#pragma once
+
+// Performance overlay.
+//
+// O shows the frame times of the last PERF_HISTORY frames as a graph along with their
+// percentiles, the ticks that ran in them, what got drawn, what is alive, and which profiler
+// zones took the longest (see profiler.h). Frames are recorded whether it is shown or not, so
+// opening it right after a hitch still has the hitch in it.
+//
+// It must not show up in what it measures. The text is laid out into glyph quads a few times a
+// second only and copied into the render list in between, and the text and the graph go out as
+// one geometry command each instead of a copy per glyph and a rect per bar. How long building it
+// took is one of its lines.
+
+constexpr i32 PERF_HISTORY = 256;			// frames, power of two
+constexpr i32 PERF_TOP_ZONES = 8;
+constexpr i32 PERF_MAX_ZONES = 64;			// different names added up per refresh
+constexpr i32 PERF_MAX_GLYPHS = 1024;
+constexpr i32 PERF_MAX_QUADS = PERF_MAX_GLYPHS > PERF_HISTORY + 3 ? PERF_MAX_GLYPHS : PERF_HISTORY + 3;
+constexpr r32 PERF_REFRESH_SECONDS = 0.25f;
+constexpr r32 PERF_GRAPH_MS = 50.f;			// at the top of the graph
+constexpr r32 PERF_GRAPH_HEIGHT = 80.f;
+
+struct Perf_Frame {
+	r32 frame_ms;
+	r32 tick_ms;	// per tick
+	i32 ticks;
+	u32 draws;
+};
+
+struct Perf_Counts {
+	u32 entities;
+	u32 colliders;
+	u32 static_colliders;	// rects and edges baked from the level
+	u32 projectiles;
+	u32 particles;
+};
+
+struct Perf_Overlay {
+	bool visible;
+	r32 width;
+	r32 text_scale;
+
+	Perf_Frame frames[PERF_HISTORY];
+	u64 frame_count;
+
+	// the cached text, in screen space
+	SDL_Vertex *glyphs;		// 4 per glyph
+	i32 glyph_count;
+	r32 text_height;
+	r32 since_refresh;		// seconds
+	u64 refresh_counter;	// zones that ended since then go into the next refresh
+	u64 refresh_frame;
+
+	i32 *quad_indices;		// shared by the text and the graph
+	r32 build_ms;			// of the overlay, last frame
+};
+
+void perf_overlay_init(Perf_Overlay *overlay, Memory_Arena *arena)
+{
+	*overlay = {};
+	overlay->width = 460.f;
+	overlay->text_scale = 0.5f;
+	overlay->glyphs = PushArrayNoZero(arena, SDL_Vertex, PERF_MAX_GLYPHS * 4);
+	overlay->quad_indices = PushArrayNoZero(arena, i32, PERF_MAX_QUADS * 6);
+	for (i32 i = 0; i < PERF_MAX_QUADS; ++i) {
+		i32 *index = overlay->quad_indices + i * 6;
+		index[0] = i * 4 + 0; index[1] = i * 4 + 1; index[2] = i * 4 + 2;
+		index[3] = i * 4 + 0; index[4] = i * 4 + 2; index[5] = i * 4 + 3;
+	}
+	overlay->refresh_counter = SDL_GetPerformanceCounter();
+}
+
+// Once per frame after end_frame, shown or not
+void record_perf_frame(Perf_Overlay *overlay, Frame_Timing *timing, u32 draws)
+{
+	Perf_Frame *frame = &overlay->frames[overlay->frame_count++ & (PERF_HISTORY - 1)];
+	frame->frame_ms = timing->frame_ms;
+	frame->tick_ms = timing->ticks > 0 ? timing->tick_ms / timing->ticks : 0;
+	frame->ticks = timing->ticks;
+	frame->draws = draws;
+}
+
+inline void set_quad(SDL_Vertex *v, r32 x0, r32 y0, r32 x1, r32 y1, SDL_Color color,
+					 r32 u0 = 0, r32 v0 = 0, r32 u1 = 0, r32 v1 = 0)
+{
+	v[0] = { { x0, y0 }, color, { u0, v0 } };
+	v[1] = { { x1, y0 }, color, { u1, v0 } };
+	v[2] = { { x1, y1 }, color, { u1, v1 } };
+	v[3] = { { x0, y1 }, color, { u0, v1 } };
+}
+
+// Like render_text, but into the cached glyphs and scaled
+void add_perf_text(Perf_Overlay *overlay, Font *font, r32 x, r32 y, const char *text, SDL_Color color)
+{
+	r32 scale = overlay->text_scale;
+	r32 inv_size = 1.f / font->texture_size;
+	for (const char *c = text; *c && overlay->glyph_count < PERF_MAX_GLYPHS; ++c) {
+		if (*c < ' ' || *c >= 127)
+			continue;
+		stbtt_packedchar *info = &font->chars[*c - ' '];
+		r32 x0 = x + info->xoff * scale;
+		r32 y0 = y + (info->yoff + font->baseline) * scale;
+		set_quad(overlay->glyphs + overlay->glyph_count++ * 4, x0, y0,
+				 x0 + (info->xoff2 - info->xoff) * scale, y0 + (info->yoff2 - info->yoff) * scale, color,
+				 info->x0 * inv_size, info->y0 * inv_size, info->x1 * inv_size, info->y1 * inv_size);
+		x += info->xadvance * scale;
+	}
+}
+
+inline r32 sorted_percentile(r32 *sorted, i32 count, r32 p)
+{
+	return count > 0 ? sorted[Min(count - 1, (i32) (count * p))] : 0;
+}
+
+// Lays the text out again with the numbers as they are now
+void refresh_perf_text(Perf_Overlay *overlay, Font *font, Memory_Arena *scratch, Perf_Counts *counts, r32 x, r32 y)
+{
+	Temp_Memory temp = begin_temp_memory(scratch);
+	Defer(end_temp_memory(temp));
+
+	i32 frame_count = (i32) Min(overlay->frame_count, (u64) PERF_HISTORY);
+	r32 *frame_ms = PushArrayNoZero(scratch, r32, PERF_HISTORY);
+	r32 *tick_ms = PushArrayNoZero(scratch, r32, PERF_HISTORY);
+	i32 tick_frames = 0;
+	i32 ticks = 0, max_ticks = 0;
+	for (i32 i = 0; i < frame_count; ++i) {
+		Perf_Frame *frame = &overlay->frames[i];
+		frame_ms[i] = frame->frame_ms;
+		if (frame->ticks > 0)
+			tick_ms[tick_frames++] = frame->tick_ms;
+		ticks += frame->ticks;
+		max_ticks = Max(max_ticks, frame->ticks);
+	}
+	SDL_qsort(frame_ms, frame_count, sizeof(r32), compare_frame_times);
+	SDL_qsort(tick_ms, tick_frames, sizeof(r32), compare_frame_times);
+	Perf_Frame *last = &overlay->frames[(overlay->frame_count - 1) & (PERF_HISTORY - 1)];
+
+	u64 now = SDL_GetPerformanceCounter();
+	Profile_Zone_Total *zones = PushArrayNoZero(scratch, Profile_Zone_Total, PERF_MAX_ZONES);
+	i32 zone_count = total_profile_zones(overlay->refresh_counter, now, zones, PERF_MAX_ZONES);
+	i32 zone_frames = (i32) Max(overlay->frame_count - overlay->refresh_frame, (u64) 1);
+	overlay->refresh_counter = now;
+	overlay->refresh_frame = overlay->frame_count;
+
+	overlay->glyph_count = 0;
+	r32 line_height = font->size * overlay->text_scale;
+	r32 line_y = y;
+	char buff[128];
+	SDL_Color white = { 0xff, 0xff, 0xff, 0xff };
+	SDL_Color gray = { 0xc0, 0xc0, 0xc0, 0xff };
+	auto add_line = [&](SDL_Color color, const char *format, auto... args) {
+		SDL_snprintf(buff, sizeof(buff), format, args...);
+		add_perf_text(overlay, font, x, line_y, buff, color);
+		line_y += line_height;
+	};
+
+	add_line(white, "Frame p50 %.2f  p99 %.2f  max %.2f ms", sorted_percentile(frame_ms, frame_count, .5f),
+			 sorted_percentile(frame_ms, frame_count, .99f), sorted_percentile(frame_ms, frame_count, 1.f));
+	add_line(white, "Tick p50 %.2f  p99 %.2f ms, %.2f per frame (max %d)", sorted_percentile(tick_ms, tick_frames, .5f),
+			 sorted_percentile(tick_ms, tick_frames, .99f), frame_count ? (r32) ticks / frame_count : 0.f, max_ticks);
+	add_line(white, "%u draws, %u entities, %u colliders + %u static", last->draws, counts->entities, counts->colliders,
+			 counts->static_colliders);
+	add_line(white, "%u projectiles, %u particles, overlay %.2f ms", counts->projectiles, counts->particles, overlay->build_ms);
+	if (zone_count > 0) {
+		add_line(white, "Zones, ms per frame over %d frames", zone_frames);
+		for (i32 i = 0; i < Min(zone_count, PERF_TOP_ZONES); ++i) {
+			add_perf_text(overlay, font, x + 8.f, line_y, zones[i].name, gray);
+			SDL_snprintf(buff, sizeof(buff), "%.2f", zones[i].ms / zone_frames);
+			add_perf_text(overlay, font, x + overlay->width * 0.6f, line_y, buff, gray);
+			SDL_snprintf(buff, sizeof(buff), "x%.1f", (r32) zones[i].count / zone_frames);
+			add_perf_text(overlay, font, x + overlay->width * 0.78f, line_y, buff, gray);
+			line_y += line_height;
+		}
+	}
+	overlay->text_height = line_y - y;
+	overlay->since_refresh = 0;
+}
+
+// Records the overlay into the top right corner of the list, when it is shown
+void draw_perf_overlay(Perf_Overlay *overlay, Render_List *list, Font *font, Memory_Arena *scratch, Perf_Counts *counts,
+					   r32 frame_time, r32 screen_width)
+{
+	if (!overlay->visible)
+		return;
+	ProfileFunction();
+	u64 start = SDL_GetPerformanceCounter();
+
+	constexpr r32 margin = 8.f;
+	r32 x = screen_width - overlay->width - margin;
+	r32 y = margin;
+	r32 graph_bottom = y + margin + PERF_GRAPH_HEIGHT;
+	overlay->since_refresh += frame_time;
+	if (overlay->glyph_count == 0 || overlay->since_refresh >= PERF_REFRESH_SECONDS)
+		refresh_perf_text(overlay, font, scratch, counts, x + margin, graph_bottom + margin);
+
+	// the panel, lines at 60 and 30 Hz, and a bar per frame, oldest on the left
+	SDL_Vertex *graph = PushArrayNoZero(&list->data, SDL_Vertex, (PERF_HISTORY + 3) * 4);
+	i32 quads = 0;
+	r32 graph_width = overlay->width - 2 * margin;
+	r32 ms_to_pixels = PERF_GRAPH_HEIGHT / PERF_GRAPH_MS;
+	set_quad(graph + quads++ * 4, x, y, x + overlay->width, graph_bottom + overlay->text_height + 2 * margin, { 0, 0, 0, 0xb0 });
+	r32 guides[] = { 1000.f / 60.f, 1000.f / 30.f };
+	for (r32 ms : guides) {
+		r32 line_y = graph_bottom - ms * ms_to_pixels;
+		set_quad(graph + quads++ * 4, x + margin, line_y, x + margin + graph_width, line_y + 1.f, { 0x80, 0x80, 0x80, 0xff });
+	}
+	i32 frame_count = (i32) Min(overlay->frame_count, (u64) PERF_HISTORY);
+	r32 bar_width = graph_width / PERF_HISTORY;
+	for (i32 i = 0; i < frame_count; ++i) {
+		Perf_Frame *frame = &overlay->frames[(overlay->frame_count - frame_count + i) & (PERF_HISTORY - 1)];
+		SDL_Color color = { 0x40, 0xe0, 0x40, 0xff };
+		if (frame->frame_ms > 1000.f / 30.f + 1.f)
+			color = { 0xff, 0x40, 0x40, 0xff };
+		else if (frame->frame_ms > 1000.f / 60.f + 1.f)
+			color = { 0xff, 0xd0, 0x40, 0xff };
+		r32 bar_x = x + margin + (PERF_HISTORY - frame_count + i) * bar_width;
+		r32 height = Min(frame->frame_ms, PERF_GRAPH_MS) * ms_to_pixels;
+		set_quad(graph + quads++ * 4, bar_x, graph_bottom - height, bar_x + bar_width, graph_bottom, color);
+	}
+	push_geometry(list, nullptr, graph, quads * 4, overlay->quad_indices, quads * 6);
+
+	// the glyphs get laid out again while the render thread may still draw the last list
+	SDL_Vertex *glyphs = PushArrayNoZero(&list->data, SDL_Vertex, overlay->glyph_count * 4);
+	SDL_memcpy(glyphs, overlay->glyphs, overlay->glyph_count * 4 * sizeof(SDL_Vertex));
+	push_geometry(list, font->atlas, glyphs, overlay->glyph_count * 4, overlay->quad_indices, overlay->glyph_count * 6);
+
+	overlay->build_ms = counter_to_ms(SDL_GetPerformanceCounter() - start);
+}
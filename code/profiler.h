@@ -0,0 +1,274 @@
+#pragma once
+
+// Instrumentation profiler.
+//
+// ProfileZone("name") at the top of a block times the rest of the block. Every thread writes
+// the zones it finished into a ring of its own, so nothing is shared while recording: a thread
+// gets its ring the first time it ends a zone, and only publishes how far it wrote with an atomic
+// store. Zones nest by time, the inner ones end first and start later.
+//
+// The rings always hold the last few frames. A capture (P, or --profile N at startup) remembers
+// where the rings were when it started and writes everything from there to profile_trace.json
+// after N frames, which chrome://tracing and ui.perfetto.dev open.
+//
+// Building with PROFILER_ENABLED 0 compiles every zone out.
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+constexpr i32 MAX_PROFILE_THREADS = 32;
+constexpr u32 PROFILE_RING_SIZE = 1 << 15;	// zones per thread, power of two
+constexpr i32 PROFILE_FRAME_HISTORY = 256;	// power of two
+constexpr i32 DEFAULT_PROFILE_CAPTURE_FRAMES = 120;
+
+struct Profile_Event {
+	const char *name;	// has to live forever, string literals do
+	u64 start;			// performance counter
+	u64 end;
+};
+
+struct Profile_Thread {
+	Profile_Event *events;
+	SDL_atomic_t written;	// only counts up, masked when indexing
+	char name[32];
+};
+
+struct Profile_Capture {
+	i32 frames_left;
+	i32 frames;
+	u64 start;
+	u32 first[MAX_PROFILE_THREADS];	// of the events of each thread
+};
+
+struct Profiler {
+	Profile_Thread threads[MAX_PROFILE_THREADS];
+	SDL_atomic_t thread_count;
+
+	// main thread
+	u64 frames[PROFILE_FRAME_HISTORY];	// when each frame started
+	u64 frame_count;
+	Profile_Capture capture;
+};
+
+Profiler profiler;
+
+#if PROFILER_ENABLED
+
+thread_local Profile_Thread *profile_thread = nullptr;
+// What threads that didn't get a ring point to, so that they only ask for one once
+Profile_Thread profile_thread_dropped;
+
+Profile_Thread *register_profile_thread()
+{
+	i32 index = SDL_AtomicAdd(&profiler.thread_count, 1);
+	if (index >= MAX_PROFILE_THREADS) {
+		SDL_AtomicAdd(&profiler.thread_count, -1);
+		SDL_Log("Profiler: more than %d threads, the others aren't profiled", MAX_PROFILE_THREADS);
+		return &profile_thread_dropped;
+	}
+	Profile_Thread *thread = &profiler.threads[index];
+	SDL_snprintf(thread->name, sizeof(thread->name), "thread %d", index);
+	thread->events = (Profile_Event *) tagged_malloc(MEMORY_TAG_PROFILER, PROFILE_RING_SIZE * sizeof(Profile_Event));
+	if (!thread->events) {
+		SDL_Log("Profiler: no memory for the ring of %s", thread->name);
+		return &profile_thread_dropped;
+	}
+	return thread;
+}
+
+// What the calling thread shows up as in traces
+void set_profile_thread_name(const char *name)
+{
+	if (!profile_thread)
+		profile_thread = register_profile_thread();
+	if (profile_thread != &profile_thread_dropped)
+		SDL_strlcpy(profile_thread->name, name, sizeof(profile_thread->name));
+}
+
+// Also for zones timed some other way, like jobs (see profile_job_hook)
+void add_profile_event(const char *name, u64 start, u64 end)
+{
+	if (!profile_thread)
+		profile_thread = register_profile_thread();
+	if (profile_thread == &profile_thread_dropped)
+		return;
+	u32 written = (u32) SDL_AtomicGet(&profile_thread->written);
+	profile_thread->events[written & (PROFILE_RING_SIZE - 1)] = { name, start, end };
+	SDL_AtomicSet(&profile_thread->written, (int) (written + 1));
+}
+
+// the name is taken out here, __func__ inside the Defer would name the lambda
+#define ProfileZone(name) const char *CONCAT(_zone_name_, __LINE__) = name; \
+	u64 CONCAT(_zone_start_, __LINE__) = SDL_GetPerformanceCounter(); \
+	Defer(add_profile_event(CONCAT(_zone_name_, __LINE__), CONCAT(_zone_start_, __LINE__), SDL_GetPerformanceCounter()))
+#define ProfileFunction() ProfileZone(__func__)
+
+inline void start_profile_capture(i32 frames)
+{
+	Profile_Capture *capture = &profiler.capture;
+	if (capture->frames_left > 0)
+		return;
+	capture->frames_left = capture->frames = frames;
+	capture->start = SDL_GetPerformanceCounter();
+	for (i32 i = 0; i < MAX_PROFILE_THREADS; ++i) {
+		capture->first[i] = (u32) SDL_AtomicGet(&profiler.threads[i].written);
+	}
+}
+
+// Copies text into out as the inside of a JSON string, cut short if it doesn't fit
+void escape_json_string(const char *text, char *out, imem out_size)
+{
+	imem length = 0;
+	for (; *text && length + 7 < out_size; ++text) {
+		u8 c = (u8) *text;
+		if (c == '"' || c == '\\') {
+			out[length++] = '\\';
+			out[length++] = (char) c;
+		} else if (c < 0x20) {
+			length += SDL_snprintf(out + length, out_size - length, "\\u%04x", c);
+		} else {
+			out[length++] = (char) c;
+		}
+	}
+	out[length] = 0;
+}
+
+// Everything since the capture started, as Chrome trace events
+bool write_profile_trace(const char *path)
+{
+	SDL_RWops *out = SDL_RWFromFile(path, "wb");
+	if (!out)
+		return false;
+	Text_Writer writer = { out };
+	char name[96];
+
+	Profile_Capture *capture = &profiler.capture;
+	r64 us_per_count = 1000000.0 / (r64) SDL_GetPerformanceFrequency();
+	write_text(&writer, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	write_text(&writer, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"game\"}}");
+	i32 thread_count = Min(SDL_AtomicGet(&profiler.thread_count), MAX_PROFILE_THREADS);
+	for (i32 t = 0; t < thread_count; ++t) {
+		Profile_Thread *thread = &profiler.threads[t];
+		escape_json_string(thread->name, name, sizeof(name));
+		write_text(&writer, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", t, name);
+		u32 written = (u32) SDL_AtomicGet(&thread->written);
+		u32 first = capture->first[t];
+		if (written - first > PROFILE_RING_SIZE) {
+			SDL_Log("Profiler: %s wrote %u zones more than its ring holds, the capture misses its first ones",
+					thread->name, written - first - PROFILE_RING_SIZE);
+			first = written - PROFILE_RING_SIZE;
+		}
+		for (u32 i = first; i != written; ++i) {
+			Profile_Event *event = &thread->events[i & (PROFILE_RING_SIZE - 1)];
+			if (event->start < capture->start)
+				continue;
+			escape_json_string(event->name, name, sizeof(name));
+			write_text(&writer, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", name, t,
+					   (event->start - capture->start) * us_per_count, (event->end - event->start) * us_per_count);
+		}
+	}
+	write_text(&writer, "\n]}\n");
+	SDL_RWclose(out);
+	return !writer.failed;
+}
+
+// Call at the start of every frame on the main thread, it ends the one before
+void begin_profile_frame()
+{
+	u64 now = SDL_GetPerformanceCounter();
+	profiler.frames[profiler.frame_count++ & (PROFILE_FRAME_HISTORY - 1)] = now;
+
+	Profile_Capture *capture = &profiler.capture;
+	if (capture->frames_left > 0 && --capture->frames_left == 0) {
+		if (write_profile_trace("profile_trace.json"))
+			SDL_Log("Wrote %d frames to profile_trace.json", capture->frames);
+		else
+			SDL_Log("Could not write profile_trace.json");
+	}
+}
+
+inline bool profile_capturing()
+{
+	return profiler.capture.frames_left > 0;
+}
+
+// Once every other thread that profiled is gone, frees their rings
+void profiler_shutdown()
+{
+	i32 thread_count = Min(SDL_AtomicGet(&profiler.thread_count), MAX_PROFILE_THREADS);
+	for (i32 t = 0; t < thread_count; ++t) {
+		tagged_free(profiler.threads[t].events);
+		profiler.threads[t] = {};
+	}
+	SDL_AtomicSet(&profiler.thread_count, 0);
+	profile_thread = nullptr;
+}
+
+struct Profile_Zone_Total {
+	const char *name;
+	r64 ms;			// inclusive, zones nested in it count too
+	u32 count;
+};
+
+int compare_zone_totals(const void *a, const void *b)
+{
+	r64 x = ((Profile_Zone_Total *) a)->ms, y = ((Profile_Zone_Total *) b)->ms;
+	return (x < y) - (x > y);
+}
+
+// Adds up the zones of all threads that ended between from and to, the most expensive first.
+// Only looks back half a ring so it stays clear of the events the threads are writing meanwhile.
+i32 total_profile_zones(u64 from, u64 to, Profile_Zone_Total *totals, i32 max_totals)
+{
+	r64 ms_per_count = 1000.0 / (r64) SDL_GetPerformanceFrequency();
+	i32 count = 0;
+	i32 thread_count = Min(SDL_AtomicGet(&profiler.thread_count), MAX_PROFILE_THREADS);
+	for (i32 t = 0; t < thread_count; ++t) {
+		Profile_Thread *thread = &profiler.threads[t];
+		u32 written = (u32) SDL_AtomicGet(&thread->written);
+		u32 oldest = written > PROFILE_RING_SIZE / 2 ? written - PROFILE_RING_SIZE / 2 : 0;
+		// a thread ends its zones in order, so going back they only end earlier
+		for (u32 i = written; i-- > oldest;) {
+			Profile_Event *event = &thread->events[i & (PROFILE_RING_SIZE - 1)];
+			if (event->end < from)
+				break;
+			if (event->end >= to)
+				continue;
+			i32 index = 0;
+			while (index < count && totals[index].name != event->name && SDL_strcmp(totals[index].name, event->name) != 0)
+				++index;
+			if (index == count) {
+				if (count == max_totals)
+					continue;
+				totals[count++] = { event->name, 0, 0 };
+			}
+			totals[index].ms += (event->end - event->start) * ms_per_count;
+			totals[index].count++;
+		}
+	}
+	SDL_qsort(totals, count, sizeof(Profile_Zone_Total), compare_zone_totals);
+	return count;
+}
+
+#else
+
+#define ProfileZone(name)
+#define ProfileFunction()
+
+inline void set_profile_thread_name(const char *name) {}
+inline void add_profile_event(const char *name, u64 start, u64 end) {}
+inline void start_profile_capture(i32 frames) {}
+inline void begin_profile_frame() {}
+inline bool profile_capturing() { return false; }
+inline void profiler_shutdown() {}
+
+struct Profile_Zone_Total {
+	const char *name;
+	r64 ms;
+	u32 count;
+};
+
+inline i32 total_profile_zones(u64 from, u64 to, Profile_Zone_Total *totals, i32 max_totals) { return 0; }
+
+#endif
@@ -0,0 +1,300 @@
+#pragma once
+
+// Projectiles and effects: thrown swords, bombs, spores, eye bolts and the hit sparks they leave.
+//
+// These live for a second or two and come and go by the thousand, so they don't go through the
+// entity storage. A pool is a fixed set of parallel arrays allocated up front, nothing allocates
+// when spawning or despawning. Dead projectiles are swap-removed at the end of the update so the
+// live ones stay packed in [0, count) and every kernel is a straight loop over plain arrays.
+// Handles go through a slot table with a free list, for code that has to refer to one projectile
+// over several frames.
+
+enum Projectile_Kind : u8 {
+	PROJECTILE_SWORD,
+	PROJECTILE_BOMB,
+	PROJECTILE_SPORE,
+	PROJECTILE_EYE_BOLT,
+	EFFECT_HIT_SPARK,
+
+	COUNT_PROJECTILE_KIND,
+};
+
+struct Projectile_Type {
+	const char *texture_path;	// single row sprite sheet, nullptr for effects drawn as a quad
+	i32 frame_width;
+	i32 frame_height;
+	i32 frame_count;
+	r32 frame_duration;
+	r32 scale;
+	r32 radius;					// of the hit circle
+	r32 lifetime;
+	bool collides;
+};
+
+constexpr Projectile_Type projectile_types[COUNT_PROJECTILE_KIND] = {
+	{ "./data/Skeleton/Sword_sprite.png",        92,  102, 8,  0.05f, 1.f, 20.f, 1.5f,  true },
+	{ "./data/Goblin/Bomb_sprite.png",           100, 100, 19, 0.08f, 1.f, 16.f, 1.5f,  true },
+	{ "./data/Mushroom/Projectile_sprite.png",   50,  50,  8,  0.08f, 2.f, 12.f, 2.f,   true },
+	{ "./data/Flying eye/projectile_sprite.png", 48,  48,  8,  0.08f, 2.f, 10.f, 2.f,   true },
+	{ nullptr,                                   8,   8,   1,  1.f,   1.f, 0.f,  0.25f, false },
+};
+
+i32 projectile_textures[COUNT_PROJECTILE_KIND];
+
+constexpr u32 PROJECTILE_NO_SLOT = 0xffffffff;
+
+struct Projectile_Pool {
+	// per projectile, packed in [0, count)
+	r32 *x;
+	r32 *y;
+	r32 *vx;
+	r32 *vy;
+	r32 *age;
+	r32 *lifetime;
+	r32 *radius;
+	u32 *owner;		// entity index that fired it, which it can't hit
+	u32 *slot;		// back from a projectile to its slot, to fix the slot up when it moves
+	Projectile_Kind *kind;
+
+	// per slot
+	u32 *dense;		// index of the slot's projectile, or the next free slot while unused
+	u32 *generations;
+	u32 free_slot;
+	u32 slot_count;
+
+	u32 count;
+	u32 capacity;
+	u32 dropped;	// spawns that found the pool full
+};
+
+struct Projectile_Hit {
+	u32 projectile;	// index into the pool, valid until the next remove_expired_projectiles
+	u32 entity;		// index of the entity that was hit
+	V2 pos;
+};
+
+void projectile_pool_init(Projectile_Pool *pool, Memory_Arena *arena, u32 capacity)
+{
+	*pool = {};
+	pool->x = PushArrayNoZero(arena, r32, capacity);
+	pool->y = PushArrayNoZero(arena, r32, capacity);
+	pool->vx = PushArrayNoZero(arena, r32, capacity);
+	pool->vy = PushArrayNoZero(arena, r32, capacity);
+	pool->age = PushArrayNoZero(arena, r32, capacity);
+	pool->lifetime = PushArrayNoZero(arena, r32, capacity);
+	pool->radius = PushArrayNoZero(arena, r32, capacity);
+	pool->owner = PushArrayNoZero(arena, u32, capacity);
+	pool->slot = PushArrayNoZero(arena, u32, capacity);
+	pool->kind = PushArrayNoZero(arena, Projectile_Kind, capacity);
+	pool->dense = PushArrayNoZero(arena, u32, capacity);
+	pool->generations = PushArray(arena, u32, capacity);
+	pool->free_slot = PROJECTILE_NO_SLOT;
+	pool->capacity = capacity;
+}
+
+// Returns a zero handle when the pool is full, which is counted in dropped
+Handle spawn_projectile(Projectile_Pool *pool, Projectile_Kind kind, V2 pos, V2 vel, u32 owner = ENTITY_NONE)
+{
+	if (pool->count >= pool->capacity) {
+		pool->dropped++;
+		return {};
+	}
+
+	u32 slot = pool->free_slot;
+	if (slot == PROJECTILE_NO_SLOT) {
+		slot = pool->slot_count++;
+		pool->generations[slot] = 1;
+	} else {
+		pool->free_slot = pool->dense[slot];
+	}
+
+	const Projectile_Type *type = &projectile_types[kind];
+	u32 i = pool->count++;
+	pool->x[i] = pos.x;
+	pool->y[i] = pos.y;
+	pool->vx[i] = vel.x;
+	pool->vy[i] = vel.y;
+	pool->age[i] = 0;
+	pool->lifetime[i] = type->lifetime;
+	pool->radius[i] = type->radius;
+	pool->owner[i] = owner;
+	pool->slot[i] = slot;
+	pool->kind[i] = kind;
+	pool->dense[slot] = i;
+	return { slot, pool->generations[slot] };
+}
+
+// Index of the handle's projectile, or -1 once it is gone
+i32 projectile_index(Projectile_Pool *pool, Handle handle)
+{
+	if (handle.index >= pool->slot_count || pool->generations[handle.index] != handle.generation)
+		return -1;
+	return (i32) pool->dense[handle.index];
+}
+
+// Moves the last projectile into i
+void remove_projectile_at(Projectile_Pool *pool, u32 i)
+{
+	assert(i < pool->count);
+	u32 slot = pool->slot[i];
+	u32 generation = pool->generations[slot] + 1;
+	pool->generations[slot] = generation ? generation : 1;
+	pool->dense[slot] = pool->free_slot;
+	pool->free_slot = slot;
+
+	u32 last = --pool->count;
+	if (i != last) {
+		pool->x[i] = pool->x[last];
+		pool->y[i] = pool->y[last];
+		pool->vx[i] = pool->vx[last];
+		pool->vy[i] = pool->vy[last];
+		pool->age[i] = pool->age[last];
+		pool->lifetime[i] = pool->lifetime[last];
+		pool->radius[i] = pool->radius[last];
+		pool->owner[i] = pool->owner[last];
+		pool->slot[i] = pool->slot[last];
+		pool->kind[i] = pool->kind[last];
+		pool->dense[pool->slot[i]] = i;
+	}
+}
+
+// Despawning only ends the lifetime, the projectile goes away with the next compaction
+void despawn_projectile(Projectile_Pool *pool, Handle handle)
+{
+	i32 i = projectile_index(pool, handle);
+	if (i >= 0)
+		pool->lifetime[i] = 0;
+}
+
+void move_projectiles(Projectile_Pool *pool, r32 dt)
+{
+	ProfileFunction();
+	u32 count = pool->count;
+	r32 *x = pool->x, *y = pool->y, *vx = pool->vx, *vy = pool->vy, *age = pool->age;
+	for (u32 i = 0; i < count; ++i) {
+		x[i] += vx[i] * dt;
+		y[i] += vy[i] * dt;
+		age[i] += dt;
+	}
+}
+
+void remove_expired_projectiles(Projectile_Pool *pool)
+{
+	// back to front, so that whatever gets swapped into i was already checked
+	for (u32 i = pool->count; i-- > 0; ) {
+		if (pool->age[i] >= pool->lifetime[i])
+			remove_projectile_at(pool, i);
+	}
+}
+
+void update_projectiles(Projectile_Pool *pool, r32 dt)
+{
+	move_projectiles(pool, dt);
+	remove_expired_projectiles(pool);
+}
+
+struct Projectile_Target {
+	u32 entity;
+	Rect bounds;
+	Collider_Kind kind;
+	Rect rect;
+	Capsule capsule;
+};
+
+// Sweeps every projectile over the last dt of movement against the colliders in the world, so
+// that fast ones can't tunnel through a target between two steps. The swept circle is a
+// capsule from the old to the new position. Each projectile hits at most one entity and is
+// despawned by it. Returns the number of hits written, scratch memory comes from arena
+i32 collide_projectiles(Projectile_Pool *pool, World *world, Memory_Arena *arena, r32 dt, Projectile_Hit *hits, i32 max_hits)
+{
+	ProfileFunction();
+	Temp_Memory temp = begin_temp_memory(arena);
+	Defer(end_temp_memory(temp));
+
+	Component_Pool<Collider> *colliders = &world->colliders;
+	Projectile_Target *targets = PushArrayNoZero(arena, Projectile_Target, colliders->count);
+	u32 target_count = 0;
+	for (u32 i = 0; i < colliders->count; ++i) {
+		Transform *transform = joined_component(colliders, i, &world->transforms);
+		if (!transform)
+			continue;
+		Projectile_Target *target = &targets[target_count++];
+		target->entity = colliders->entities[i];
+		target->kind = colliders->data[i].kind;
+		if (target->kind == COLLIDER_RECT) {
+			target->rect = collider_rect(&colliders->data[i], transform);
+			target->bounds = target->rect;
+		} else {
+			target->capsule = collider_capsule(&colliders->data[i], transform);
+			Capsule c = target->capsule;
+			target->bounds = { V2(Min(c.a.x, c.b.x), Min(c.a.y, c.b.y)) - V2(c.radius),
+							   V2(Max(c.a.x, c.b.x), Max(c.a.y, c.b.y)) + V2(c.radius) };
+		}
+	}
+
+	i32 hit_count = 0;
+	for (u32 i = 0; i < pool->count && hit_count < max_hits; ++i) {
+		if (!projectile_types[pool->kind[i]].collides || pool->age[i] >= pool->lifetime[i])
+			continue;
+
+		V2 to = V2(pool->x[i], pool->y[i]);
+		V2 from = to - V2(pool->vx[i], pool->vy[i]) * Min(dt, pool->age[i]);
+		r32 radius = pool->radius[i];
+		Rect bounds = { V2(Min(from.x, to.x), Min(from.y, to.y)) - V2(radius),
+						V2(Max(from.x, to.x), Max(from.y, to.y)) + V2(radius) };
+		Capsule swept = { from, to, radius };
+
+		for (u32 t = 0; t < target_count; ++t) {
+			Projectile_Target *target = &targets[t];
+			if (target->entity == pool->owner[i])
+				continue;
+			if (bounds.max.x < target->bounds.min.x || bounds.min.x > target->bounds.max.x ||
+				bounds.max.y < target->bounds.min.y || bounds.min.y > target->bounds.max.y)
+				continue;
+
+			bool hit = target->kind == COLLIDER_RECT ? gjk(swept, target->rect) : gjk(swept, target->capsule);
+			if (hit) {
+				hits[hit_count++] = { i, target->entity, to };
+				pool->lifetime[i] = 0;
+				break;
+			}
+		}
+	}
+	return hit_count;
+}
+
+void load_projectile_types(SDL_Renderer *renderer)
+{
+	for (i32 i = 0; i < COUNT_PROJECTILE_KIND; ++i) {
+		const char *path = projectile_types[i].texture_path;
+		projectile_textures[i] = path ? find_or_load_texture(renderer, path) : -1;
+	}
+}
+
+// behind is how many seconds before the last tick the frame is drawn at. Projectiles fly straight,
+// so where they were then is their velocity away
+void render_projectiles(Render_List *list, Projectile_Pool *pool, r32 behind)
+{
+	for (u32 i = 0; i < pool->count; ++i) {
+		const Projectile_Type *type = &projectile_types[pool->kind[i]];
+		r32 width = type->frame_width * type->scale;
+		r32 height = type->frame_height * type->scale;
+		r32 x = pool->x[i] - pool->vx[i] * behind;
+		r32 y = pool->y[i] - pool->vy[i] * behind;
+		SDL_FRect dest = { x - width / 2 - camera.x + resolution.x / 2.f, y - height / 2 - camera.y + resolution.y / 2.f, width, height };
+
+		i32 texture = projectile_textures[pool->kind[i]];
+		if (texture < 0) {
+			// effects fade out over their lifetime
+			r32 t = 1.f - pool->age[i] / pool->lifetime[i];
+			push_draw_color(list, 0xffd04000 | (u8) (255 * Clamp(0.f, t, 1.f)));
+			push_fill_rect(list, &dest);
+			continue;
+		}
+
+		i32 frame = (i32) (pool->age[i] / type->frame_duration) % type->frame_count;
+		SDL_Rect src = { frame * type->frame_width, 0, type->frame_width, type->frame_height };
+		r64 angle = atan2f(pool->vy[i], pool->vx[i]) * (180.0 / PI64);
+		push_texture_copy(list, texture, &src, &dest, angle);
+	}
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+// Render lists.
+//
+// The main thread doesn't draw, it records what to draw into a render list and hands the list to
+// the render thread (see render_thread.h), which makes the SDL calls while the main thread goes
+// on with the next frame. Commands mirror the SDL calls they stand for and run in order.
+//
+// Nothing a command points to may change until the list was executed: what only lives for the
+// frame is copied into the list's own arena. Sprite sheets are referred to by their index in
+// textures, a hot reload may replace the texture itself before the list gets executed.
+
+enum Render_Command_Kind : u8 {
+	RENDER_CLEAR,
+	RENDER_DRAW_COLOR,
+	RENDER_FILL_RECT,
+	RENDER_DRAW_RECT,
+	RENDER_LINE,
+	RENDER_POINT,
+	RENDER_COPY,
+	RENDER_GEOMETRY,
+	RENDER_TILE_CHUNK,	// see tilemap.h
+};
+
+struct Render_Command {
+	Render_Command_Kind kind;
+	SDL_RendererFlip flip;
+	u32 color;			// draw color, or the color mod of a copy
+	i32 texture_index;	// into textures when >= 0, texture otherwise
+	SDL_Texture *texture;
+	SDL_Rect src;		// the whole texture when w is 0
+	SDL_FRect dest;		// lines go from (x, y) to (w, h), points only use x and y
+	r64 angle;
+	const void *data;	// geometry vertices, tile chunk image
+	const i32 *indices;
+	i32 count;			// vertices
+	i32 index_count;
+};
+
+struct Render_List {
+	Render_Command *commands;
+	u32 count;
+	u32 capacity;
+	u32 dropped;		// found the list full
+	u32 draws;			// commands that end up as draw calls
+	Memory_Arena data;
+};
+
+void render_list_init(Render_List *list, Memory_Arena *arena, u32 capacity, imem data_size, const char *name)
+{
+	*list = {};
+	list->commands = PushArrayNoZero(arena, Render_Command, capacity);
+	list->capacity = capacity;
+	arena_create(&list->data, data_size, name, MEMORY_TAG_RENDERING);
+}
+
+inline void reset_render_list(Render_List *list)
+{
+	list->count = 0;
+	list->dropped = 0;
+	list->draws = 0;
+	arena_reset(&list->data);
+}
+
+// A full list hands out a scratch command that never gets executed
+Render_Command *push_command(Render_List *list, Render_Command_Kind kind)
+{
+	static Render_Command overflow;
+	Render_Command *command = &overflow;
+	if (list->count < list->capacity) {
+		command = &list->commands[list->count++];
+		list->draws += kind != RENDER_DRAW_COLOR;
+	} else {
+		list->dropped++;
+	}
+	*command = {};
+	command->kind = kind;
+	command->texture_index = -1;
+	command->color = 0xffffffff;
+	return command;
+}
+
+inline void push_draw_color(Render_List *list, u32 color)
+{
+	push_command(list, RENDER_DRAW_COLOR)->color = color;
+}
+
+inline void push_clear(Render_List *list)
+{
+	push_command(list, RENDER_CLEAR);
+}
+
+inline void push_fill_rect(Render_List *list, const SDL_FRect *rect)
+{
+	push_command(list, RENDER_FILL_RECT)->dest = *rect;
+}
+
+inline void push_draw_rect(Render_List *list, const SDL_FRect *rect)
+{
+	push_command(list, RENDER_DRAW_RECT)->dest = *rect;
+}
+
+inline void push_line(Render_List *list, r32 x1, r32 y1, r32 x2, r32 y2)
+{
+	push_command(list, RENDER_LINE)->dest = { x1, y1, x2, y2 };
+}
+
+inline void push_point(Render_List *list, r32 x, r32 y)
+{
+	push_command(list, RENDER_POINT)->dest = { x, y, 0, 0 };
+}
+
+void push_copy(Render_List *list, SDL_Texture *texture, const SDL_Rect *src, const SDL_FRect *dest, u32 color_mod = 0xffffffff)
+{
+	Render_Command *command = push_command(list, RENDER_COPY);
+	command->texture = texture;
+	if (src)
+		command->src = *src;
+	command->dest = *dest;
+	command->color = color_mod;
+}
+
+// Of textures[texture_index]
+void push_texture_copy(Render_List *list, i32 texture_index, const SDL_Rect *src, const SDL_FRect *dest, r64 angle = 0,
+					   SDL_RendererFlip flip = SDL_FLIP_NONE)
+{
+	Render_Command *command = push_command(list, RENDER_COPY);
+	command->texture_index = texture_index;
+	if (src)
+		command->src = *src;
+	command->dest = *dest;
+	command->angle = angle;
+	command->flip = flip;
+}
+
+// The vertices and indices have to stay as they are until the list was executed
+void push_geometry(Render_List *list, SDL_Texture *texture, const SDL_Vertex *vertices, i32 count, const i32 *indices, i32 index_count)
+{
+	Render_Command *command = push_command(list, RENDER_GEOMETRY);
+	command->texture = texture;
+	command->data = vertices;
+	command->count = count;
+	command->indices = indices;
+	command->index_count = index_count;
+}
@@ -0,0 +1,336 @@
+#pragma once
+
+// Render thread.
+//
+// The main thread records a frame into a render list (see render_list.h) and the render thread
+// executes it and presents, so the simulation of the next frame overlaps presenting this one
+// instead of waiting on vsync. There are two frames: while the render thread works on one the
+// main thread records the other, and before handing it over it waits for the render thread to be
+// done with the one before.
+//
+// While the render thread is idle, between the wait and the submit, the main thread may use the
+// renderer itself: pump events (SDL resizes the renderer's viewport from an event watch), update
+// or create textures for hot reloads, and touch the tile cache. Outside of that window only the
+// render thread makes renderer calls.
+//
+// The OpenGL renderers keep their context current on the thread that created it, so with them
+// (and with --no-render-thread, to compare) the lists are executed on the main thread at submit.
+//
+// Every frame leaves a trace of when each side got to it, F2 writes the last ones to
+// frame_trace.csv.
+
+constexpr u32 RENDER_LIST_CAPACITY = 1 << 16;
+constexpr imem RENDER_LIST_DATA_SIZE = Megabytes(1);
+constexpr u32 FRAME_TRACE_SIZE = 1024;	// power of two
+
+// Performance counter values
+struct Frame_Trace {
+	u64 frame;
+	u64 main_start;		// the main thread started on the frame's ticks
+	u64 record_start;
+	u64 wait_start;		// for the frame before, to submit this one
+	u64 submit;
+	u64 render_start;
+	u64 present_start;
+	u64 render_end;
+	u64 overlap;		// of rendering this frame with the main thread working on the next one
+};
+
+struct Render_Frame {
+	Render_List list;
+	Frame_Trace trace;
+	// timestamps of the presses whose effect the frame is the first to show
+	u32 presses[MAX_UNSHOWN_PRESSES];
+	i32 press_count;
+	u32 submitted_ticks;
+	u32 presented_ticks;
+	Tilemap_Stats tile_stats;
+};
+
+struct Render_Thread {
+	SDL_Renderer *renderer;
+	bool threaded;
+	SDL_Thread *thread;
+	SDL_sem *submitted;
+	SDL_sem *finished;
+	SDL_atomic_t quit;
+
+	Tile_Cache tiles;	// render thread only, outside of the idle window
+	Render_Frame frames[2];
+	i32 recording;		// frame the main thread records into
+	bool recorded;		// since the last submit
+	Render_Frame *in_flight;
+	u64 frame_count;
+
+	// of the last finished frame
+	Tilemap_Stats tile_stats;
+	Frame_Trace traces[FRAME_TRACE_SIZE];
+	u64 trace_count;
+};
+
+void execute_render_list(Render_Thread *render, Render_List *list)
+{
+	ProfileFunction();
+	SDL_Renderer *renderer = render->renderer;
+	begin_tile_cache_frame(&render->tiles);
+	for (u32 i = 0; i < list->count; ++i) {
+		Render_Command *command = &list->commands[i];
+		switch (command->kind) {
+			case RENDER_CLEAR: {
+				SDL_RenderClear(renderer);
+			} break;
+
+			case RENDER_DRAW_COLOR: {
+				SDL_SetRenderDrawColor(renderer, HexColor(command->color));
+			} break;
+
+			case RENDER_FILL_RECT: {
+				SDL_RenderFillRectF(renderer, &command->dest);
+			} break;
+
+			case RENDER_DRAW_RECT: {
+				SDL_RenderDrawRectF(renderer, &command->dest);
+			} break;
+
+			case RENDER_LINE: {
+				SDL_FRect *line = &command->dest;
+				SDL_RenderDrawLineF(renderer, line->x, line->y, line->w, line->h);
+			} break;
+
+			case RENDER_POINT: {
+				SDL_RenderDrawPointF(renderer, command->dest.x, command->dest.y);
+			} break;
+
+			case RENDER_COPY: {
+				SDL_Texture *texture = command->texture_index >= 0 ? textures[command->texture_index].tex : command->texture;
+				Uint8 r, g, b, a;
+				UnHexColor(command->color, r, g, b, a);
+				SDL_SetTextureColorMod(texture, r, g, b);
+				SDL_SetTextureAlphaMod(texture, a);
+				SDL_RenderCopyExF(renderer, texture, command->src.w ? &command->src : nullptr, &command->dest,
+								  command->angle, nullptr, command->flip);
+			} break;
+
+			case RENDER_GEOMETRY: {
+				if (SDL_RenderGeometry(renderer, command->texture, (const SDL_Vertex *) command->data, command->count,
+									   command->indices, command->index_count) < 0) {
+					SDL_Log("Could not render geometry: %s", SDL_GetError());
+				}
+			} break;
+
+			case RENDER_TILE_CHUNK: {
+				draw_tile_chunk(renderer, &render->tiles, (Tile_Chunk_Image *) command->data);
+			} break;
+		}
+	}
+}
+
+void run_render_frame(Render_Thread *render, Render_Frame *frame)
+{
+	frame->trace.render_start = SDL_GetPerformanceCounter();
+	execute_render_list(render, &frame->list);
+	frame->tile_stats = render->tiles.stats;
+	frame->trace.present_start = SDL_GetPerformanceCounter();
+	SDL_RenderPresent(render->renderer);
+	frame->presented_ticks = SDL_GetTicks();
+	frame->trace.render_end = SDL_GetPerformanceCounter();
+	add_profile_event("present", frame->trace.present_start, frame->trace.render_end);
+}
+
+int render_thread_proc(void *data)
+{
+	Render_Thread *render = (Render_Thread *) data;
+	set_profile_thread_name("render");
+	while (true) {
+		SDL_SemWait(render->submitted);
+		if (SDL_AtomicGet(&render->quit))
+			break;
+		run_render_frame(render, render->in_flight);
+		SDL_SemPost(render->finished);
+	}
+	return 0;
+}
+
+void render_thread_init(Render_Thread *render, SDL_Renderer *renderer, Memory_Arena *arena, Memory_Arena *scratch, bool threaded)
+{
+	*render = {};
+	render->renderer = renderer;
+	tile_cache_init(&render->tiles, renderer, scratch);
+	render_list_init(&render->frames[0].list, arena, RENDER_LIST_CAPACITY, RENDER_LIST_DATA_SIZE, "render list 0");
+	render_list_init(&render->frames[1].list, arena, RENDER_LIST_CAPACITY, RENDER_LIST_DATA_SIZE, "render list 1");
+
+	SDL_RendererInfo info;
+	if (threaded && SDL_GetRendererInfo(renderer, &info) == 0 && SDL_strncmp(info.name, "opengl", 6) == 0) {
+		SDL_Log("The %s renderer can't be used from another thread, rendering on the main thread", info.name);
+		threaded = false;
+	}
+	if (threaded) {
+		render->submitted = SDL_CreateSemaphore(0);
+		render->finished = SDL_CreateSemaphore(0);
+		render->thread = SDL_CreateThread(render_thread_proc, "render", render);
+		if (!render->thread) {
+			SDL_Log("Could not start the render thread, rendering on the main thread: %s", SDL_GetError());
+			SDL_DestroySemaphore(render->submitted);
+			SDL_DestroySemaphore(render->finished);
+			threaded = false;
+		}
+	}
+	render->threaded = threaded;
+}
+
+// The list to record the next frame into
+Render_List *begin_render_frame(Render_Thread *render)
+{
+	Render_Frame *frame = &render->frames[render->recording];
+	reset_render_list(&frame->list);
+	frame->trace = {};
+	frame->trace.frame = render->frame_count;
+	frame->trace.main_start = SDL_GetPerformanceCounter();
+	render->recorded = true;
+	return &frame->list;
+}
+
+inline void begin_recording(Render_Thread *render)
+{
+	render->frames[render->recording].trace.record_start = SDL_GetPerformanceCounter();
+}
+
+// Blocks until the frame in flight was presented. The render thread is idle after this, until
+// submit_render_frame
+void wait_for_render(Render_Thread *render, Input_Ring *input)
+{
+	u64 wait_start = SDL_GetPerformanceCounter();
+	render->frames[render->recording].trace.wait_start = wait_start;
+	Render_Frame *frame = render->in_flight;
+	if (!frame)
+		return;
+	if (render->threaded) {
+		ProfileZone("wait for render");
+		SDL_SemWait(render->finished);
+	}
+	render->in_flight = nullptr;
+
+	// the main thread worked on the next frame from its start until it came here to wait
+	Frame_Trace *trace = &frame->trace;
+	u64 main_start = render->frames[render->recording].trace.main_start;
+	u64 overlap_start = Max(trace->render_start, main_start);
+	u64 overlap_end = Min(trace->render_end, wait_start);
+	trace->overlap = overlap_end > overlap_start ? overlap_end - overlap_start : 0;
+	render->traces[render->trace_count++ & (FRAME_TRACE_SIZE - 1)] = *trace;
+
+	render->tile_stats = frame->tile_stats;
+	record_presented_input(input, frame->presses, frame->press_count, frame->submitted_ticks, frame->presented_ticks);
+}
+
+// Hands the recorded frame to the render thread, or renders it right away without one. The
+// presses ticks took since the last submit are the ones the frame shows
+void submit_render_frame(Render_Thread *render, Input_Ring *input)
+{
+	assert(!render->in_flight);
+	if (!render->recorded)
+		return;
+	render->recorded = false;
+	Render_Frame *frame = &render->frames[render->recording];
+	frame->press_count = take_unshown_presses(input, frame->presses);
+	frame->submitted_ticks = SDL_GetTicks();
+	frame->trace.submit = SDL_GetPerformanceCounter();
+	if (frame->list.dropped)
+		SDL_Log("Render list full, %u commands dropped", frame->list.dropped);
+
+	render->in_flight = frame;
+	render->recording ^= 1;
+	render->frame_count++;
+	if (render->threaded)
+		SDL_SemPost(render->submitted);
+	else
+		run_render_frame(render, frame);
+}
+
+void render_thread_shutdown(Render_Thread *render, Input_Ring *input)
+{
+	wait_for_render(render, input);
+	if (!render->threaded)
+		return;
+	SDL_AtomicSet(&render->quit, 1);
+	SDL_SemPost(render->submitted);
+	SDL_WaitThread(render->thread, nullptr);
+	SDL_DestroySemaphore(render->submitted);
+	SDL_DestroySemaphore(render->finished);
+	render->thread = nullptr;
+}
+
+// Averages over the traced frames, in milliseconds
+struct Frame_Trace_Summary {
+	i32 frames;
+	r32 frame_ms;		// from one submit to the next
+	r32 main_ms;		// simulating and recording, without waiting
+	r32 wait_ms;
+	r32 render_ms;		// executing the list
+	r32 present_ms;
+	r32 overlap_ms;
+};
+
+Frame_Trace_Summary summarize_frame_traces(Render_Thread *render)
+{
+	Frame_Trace_Summary summary = {};
+	u64 count = Min(render->trace_count, (u64) FRAME_TRACE_SIZE);
+	u64 first = render->trace_count - count;
+	for (u64 i = first + 1; i < render->trace_count; ++i) {
+		Frame_Trace *trace = &render->traces[i & (FRAME_TRACE_SIZE - 1)];
+		Frame_Trace *before = &render->traces[(i - 1) & (FRAME_TRACE_SIZE - 1)];
+		summary.frames++;
+		summary.frame_ms += counter_to_ms(trace->submit - before->submit);
+		summary.main_ms += counter_to_ms(trace->wait_start - trace->main_start);
+		summary.wait_ms += counter_to_ms(trace->submit - trace->wait_start);
+		summary.render_ms += counter_to_ms(trace->present_start - trace->render_start);
+		summary.present_ms += counter_to_ms(trace->render_end - trace->present_start);
+		summary.overlap_ms += counter_to_ms(trace->overlap);
+	}
+	if (summary.frames > 0) {
+		r32 scale = 1.f / summary.frames;
+		summary.frame_ms *= scale;
+		summary.main_ms *= scale;
+		summary.wait_ms *= scale;
+		summary.render_ms *= scale;
+		summary.present_ms *= scale;
+		summary.overlap_ms *= scale;
+	}
+	return summary;
+}
+
+void log_frame_traces(Render_Thread *render)
+{
+	Frame_Trace_Summary summary = summarize_frame_traces(render);
+	if (summary.frames == 0)
+		return;
+	SDL_Log("Frames: %.2f ms on average over %d frames, rendering %s", summary.frame_ms, summary.frames,
+			render->threaded ? "on its own thread" : "on the main thread");
+	SDL_Log("Frames: main %.2f ms, waiting %.2f ms, render %.2f ms, present %.2f ms, %.2f ms of rendering overlapped the next frame",
+			summary.main_ms, summary.wait_ms, summary.render_ms, summary.present_ms, summary.overlap_ms);
+	SDL_Log("Frames: %.0f fps, %.0f fps if rendering didn't overlap", 1000.f / summary.frame_ms,
+			1000.f / (summary.frame_ms + summary.overlap_ms));
+}
+
+// The traced frames as CSV, one row per frame, in milliseconds from the first one's start
+bool dump_frame_traces(Render_Thread *render, const char *path)
+{
+	SDL_RWops *out = SDL_RWFromFile(path, "wb");
+	if (!out)
+		return false;
+	Text_Writer writer = { out };
+
+	u64 count = Min(render->trace_count, (u64) FRAME_TRACE_SIZE);
+	u64 first = render->trace_count - count;
+	u64 base = count ? render->traces[first & (FRAME_TRACE_SIZE - 1)].main_start : 0;
+	auto ms = [base](u64 counter) { return counter ? counter_to_ms(counter - base) : 0.f; };
+	write_text(&writer, "frame,main_start,record_start,wait_start,submit,render_start,present_start,render_end,overlap,threaded\n");
+	for (u64 i = first; i < render->trace_count; ++i) {
+		Frame_Trace *trace = &render->traces[i & (FRAME_TRACE_SIZE - 1)];
+		write_text(&writer, "%llu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%d\n", (unsigned long long) trace->frame,
+				   ms(trace->main_start), ms(trace->record_start), ms(trace->wait_start), ms(trace->submit),
+				   ms(trace->render_start), ms(trace->present_start), ms(trace->render_end), counter_to_ms(trace->overlap),
+				   render->threaded ? 1 : 0);
+	}
+	SDL_RWclose(out);
+	return !writer.failed;
+}
@@ -0,0 +1,262 @@
+#pragma once
+
+// Recording and replaying input.
+//
+// --record <file> writes the input of every tick to a file, --replay <file> feeds it back to the
+// simulation instead of the keyboard, so that a session played once can be run again as a
+// benchmark. The simulation only reads its Tick_Input, so that is what is recorded, run-length
+// encoded: ticks in a row with the same input are one run, a few minutes of play are a few KB.
+//
+// The same input only makes the same game if everything else the ticks see is the same too, so
+// recording and replaying both switch main.cpp to a deterministic setup: the simulation's seed
+// comes from the file, flow fields are built on the main thread, the AI has no time budget, the
+// world stream settles every tick around the simulation's camera, and the debug keys that change
+// the world (F1, F5, F7 and the editor) are off. The file has the simulation's hash from before
+// the first tick and after the last one, a replay checks both to tell whether it played the game
+// that was recorded.
+//
+// A replay runs in real time, or with --headless as fast as it can: no window to look at, a
+// software renderer without vsync and exactly one tick per frame. At the end it logs the tick
+// and frame time percentiles and writes every one of them to replay_ticks.csv and
+// replay_frames.csv.
+
+constexpr u32 REPLAY_FILE_MAGIC = 'R' | 'P' << 8 | 'L' << 16 | 'Y' << 24;
+constexpr u32 REPLAY_FILE_VERSION = 1;
+
+struct Replay_Header {
+	u32 magic;
+	u32 version;
+	r32 tick_rate;
+	u32 run_count;
+	u64 seed;			// of the simulation's random series
+	u64 tick_count;
+	u32 start_hash;		// hash_simulation before the first tick
+	u32 end_hash;		// and after the last one
+};
+
+// Ticks in a row that got the same input
+struct Replay_Run {
+	u32 ticks;
+	Tick_Input input;
+};
+
+struct Replay_Frame {
+	r32 frame_ms;
+	r32 work_ms;
+	i32 ticks;
+};
+
+enum Replay_Mode : u8 {
+	REPLAY_OFF,
+	REPLAY_RECORDING,
+	REPLAY_PLAYING,
+};
+
+struct Replay {
+	Replay_Mode mode;
+	const char *path;
+	Replay_Header header;
+	Array<Replay_Run> runs;
+	i32 run;			// playing, the one the next tick reads
+	u32 run_ticks;		// of it that were played
+	u64 ticks;			// recorded or played so far
+
+	// playing only
+	Array<r32> tick_ms;
+	Array<Replay_Frame> frames;
+	u64 start_counter;
+};
+
+void replay_init(Replay *replay, Replay_Mode mode, const char *path)
+{
+	*replay = {};
+	replay->mode = mode;
+	replay->path = path;
+	array_init(&replay->runs, heap_allocator(MEMORY_TAG_REPLAY));
+	array_init(&replay->tick_ms, heap_allocator(MEMORY_TAG_REPLAY));
+	array_init(&replay->frames, heap_allocator(MEMORY_TAG_REPLAY));
+}
+
+bool load_replay(Replay *replay)
+{
+	SDL_RWops *file = SDL_RWFromFile(replay->path, "rb");
+	if (!file)
+		return false;
+	Defer(SDL_RWclose(file));
+
+	Replay_Header *header = &replay->header;
+	if (SDL_RWread(file, header, sizeof(Replay_Header), 1) != 1) {
+		SDL_SetError("%s is too short to be a replay", replay->path);
+		return false;
+	}
+	if (header->magic != REPLAY_FILE_MAGIC || header->version != REPLAY_FILE_VERSION) {
+		SDL_SetError("%s is not a replay of this version", replay->path);
+		return false;
+	}
+	if ((i64) header->run_count * (i64) sizeof(Replay_Run) > SDL_RWsize(file) - (i64) sizeof(Replay_Header)) {
+		SDL_SetError("%s is cut short", replay->path);
+		return false;
+	}
+	array_reserve(&replay->runs, header->run_count);
+	replay->runs.count = header->run_count;
+	if (header->run_count && SDL_RWread(file, replay->runs.data, sizeof(Replay_Run), header->run_count) != header->run_count) {
+		SDL_SetError("%s is cut short", replay->path);
+		return false;
+	}
+	u64 ticks = 0;
+	for (i32 i = 0; i < replay->runs.count; ++i) {
+		ticks += replay->runs[i].ticks;
+	}
+	if (ticks != header->tick_count) {
+		SDL_SetError("%s has %llu ticks of input for %llu ticks", replay->path, (unsigned long long) ticks,
+					 (unsigned long long) header->tick_count);
+		return false;
+	}
+	return true;
+}
+
+// The seed of the simulation's random series: the recorded one when playing, the given one
+// otherwise, which a recording keeps
+u64 replay_seed(Replay *replay, u64 seed)
+{
+	if (replay->mode == REPLAY_PLAYING)
+		return replay->header.seed;
+	replay->header.seed = seed;
+	return seed;
+}
+
+// Once everything is set up, right before the first tick
+void begin_replay(Replay *replay, Simulation *sim, r32 tick_rate)
+{
+	u32 hash = hash_simulation(sim);
+	if (replay->mode == REPLAY_RECORDING) {
+		replay->header.tick_rate = tick_rate;
+		replay->header.start_hash = hash;
+		SDL_Log("Recording input to %s", replay->path);
+	} else if (replay->mode == REPLAY_PLAYING) {
+		SDL_Log("Replaying %llu ticks from %s", (unsigned long long) replay->header.tick_count, replay->path);
+		if (hash != replay->header.start_hash)
+			SDL_Log("Replay: the simulation starts out different from the recording (%08x, recorded %08x), "
+					"the world file or the code changed since", hash, replay->header.start_hash);
+	}
+	replay->start_counter = SDL_GetPerformanceCounter();
+}
+
+// Recording, stores the input of the tick. Playing, replaces it with the recorded one, or returns
+// false once all of them were played
+bool replay_tick_input(Replay *replay, Tick_Input *input)
+{
+	if (replay->mode == REPLAY_RECORDING) {
+		Replay_Run *last = replay->runs.count ? &array_last(&replay->runs) : nullptr;
+		if (last && last->input.held == input->held && last->input.pressed == input->pressed && last->ticks < UINT32_MAX)
+			last->ticks++;
+		else
+			array_add(&replay->runs, { 1, *input });
+		replay->ticks++;
+		return true;
+	}
+
+	if (replay->run >= replay->runs.count)
+		return false;
+	Replay_Run *run = &replay->runs[replay->run];
+	*input = run->input;
+	if (++replay->run_ticks == run->ticks) {
+		replay->run++;
+		replay->run_ticks = 0;
+	}
+	replay->ticks++;
+	return true;
+}
+
+inline void add_replay_tick_time(Replay *replay, r32 ms)
+{
+	if (replay->mode == REPLAY_PLAYING)
+		array_add(&replay->tick_ms, ms);
+}
+
+inline void add_replay_frame(Replay *replay, Frame_Timing *timing)
+{
+	if (replay->mode == REPLAY_PLAYING)
+		array_add(&replay->frames, { timing->frame_ms, timing->work_ms, timing->ticks });
+}
+
+bool save_replay(Replay *replay, Simulation *sim)
+{
+	Replay_Header *header = &replay->header;
+	header->magic = REPLAY_FILE_MAGIC;
+	header->version = REPLAY_FILE_VERSION;
+	header->run_count = (u32) replay->runs.count;
+	header->tick_count = replay->ticks;
+	header->end_hash = hash_simulation(sim);
+
+	SDL_RWops *file = SDL_RWFromFile(replay->path, "wb");
+	if (!file)
+		return false;
+	bool ok = SDL_RWwrite(file, header, sizeof(Replay_Header), 1) == 1;
+	if (ok && replay->runs.count)
+		ok = SDL_RWwrite(file, replay->runs.data, sizeof(Replay_Run), replay->runs.count) == (size_t) replay->runs.count;
+	SDL_RWclose(file);
+	return ok;
+}
+
+bool dump_replay_timing(Replay *replay, const char *ticks_path, const char *frames_path)
+{
+	Text_Writer writer = { SDL_RWFromFile(ticks_path, "wb") };
+	if (!writer.out)
+		return false;
+	write_text(&writer, "tick,ms\n");
+	for (i32 i = 0; i < replay->tick_ms.count; ++i) {
+		write_text(&writer, "%d,%.4f\n", i, replay->tick_ms[i]);
+	}
+	SDL_RWclose(writer.out);
+
+	writer.out = SDL_RWFromFile(frames_path, "wb");
+	if (!writer.out)
+		return false;
+	write_text(&writer, "frame,frame_ms,work_ms,ticks\n");
+	for (i32 i = 0; i < replay->frames.count; ++i) {
+		Replay_Frame *frame = &replay->frames[i];
+		write_text(&writer, "%d,%.4f,%.4f,%d\n", i, frame->frame_ms, frame->work_ms, frame->ticks);
+	}
+	SDL_RWclose(writer.out);
+	return !writer.failed;
+}
+
+// Logs how the replay went and whether it ended where the recording did
+bool finish_replay(Replay *replay, Simulation *sim, Memory_Arena *scratch)
+{
+	r64 seconds = counter_to_ms(SDL_GetPerformanceCounter() - replay->start_counter) / 1000.0;
+	Temp_Memory temp = begin_temp_memory(scratch);
+	Defer(end_temp_memory(temp));
+
+	i32 tick_count = (i32) replay->tick_ms.count;
+	i32 frame_count = (i32) replay->frames.count;
+	r32 *ticks = PushArrayNoZero(scratch, r32, tick_count + 1);
+	r32 *frames = PushArrayNoZero(scratch, r32, frame_count + 1);
+	SDL_memcpy(ticks, replay->tick_ms.data, tick_count * sizeof(r32));
+	for (i32 i = 0; i < frame_count; ++i) {
+		frames[i] = replay->frames[i].frame_ms;
+	}
+	SDL_qsort(ticks, tick_count, sizeof(r32), compare_frame_times);
+	SDL_qsort(frames, frame_count, sizeof(r32), compare_frame_times);
+
+	SDL_Log("Replay: %llu ticks in %d frames, %.2f s (%.0f ticks/s)", (unsigned long long) replay->ticks, frame_count,
+			seconds, seconds > 0 ? replay->ticks / seconds : 0.0);
+	SDL_Log("Replay: tick p50 %.3f ms, p99 %.3f, max %.3f", sorted_percentile(ticks, tick_count, .5f),
+			sorted_percentile(ticks, tick_count, .99f), sorted_percentile(ticks, tick_count, 1.f));
+	SDL_Log("Replay: frame p50 %.3f ms, p99 %.3f, max %.3f", sorted_percentile(frames, frame_count, .5f),
+			sorted_percentile(frames, frame_count, .99f), sorted_percentile(frames, frame_count, 1.f));
+	if (dump_replay_timing(replay, "replay_ticks.csv", "replay_frames.csv"))
+		SDL_Log("Wrote replay_ticks.csv and replay_frames.csv");
+
+	if (replay->ticks != replay->header.tick_count) {
+		SDL_Log("Replay: stopped after %llu of %llu ticks", (unsigned long long) replay->ticks,
+				(unsigned long long) replay->header.tick_count);
+		return false;
+	}
+	u32 hash = hash_simulation(sim);
+	bool matched = hash == replay->header.end_hash;
+	SDL_Log("Replay: %s (%08x, recorded %08x)", matched ? "ended where the recording did" : "DIVERGED from the recording",
+			hash, replay->header.end_hash);
+	return matched;
+}
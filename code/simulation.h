@@ -0,0 +1,589 @@
+#pragma once
+
+// The simulation: everything the fixed timestep loop steps, apart from the rest of the game so
+// that it can be saved and restored cheaply.
+//
+// The loose state lives in one plain struct, Sim_State. Entities and projectiles live in their
+// pools, which are allocated for their largest size up front, so a snapshot only copies the live
+// part of them: the packed [0, count) range of every pool plus the entity generations and free
+// list. Restoring writes that back and rebuilds the sparse arrays from the packed entity indices.
+//
+// Every tick is recorded into a ring before it runs, its snapshot along with the input it ran
+// with, so that any tick still in the ring can be restored and everything after it simulated
+// again with nothing rendered in between. The snapshots go one after the other into a buffer
+// allocated up front, the oldest ones make room when it is full.
+//
+// Not part of it: the level (it streams in on its own), the flow field (built on its own thread)
+// and whatever only shows, like particles. Debug spawns (F5, F7) and streaming change the world
+// between ticks, rolling back across them doesn't bring them back. Otherwise simulating the same
+// ticks again ends up in the same state, as long as the AI didn't run out of its time budget the
+// first time (re-simulating runs it without one).
+
+constexpr i32 MAX_BUFFERED_ACTIONS = 16;
+constexpr i32 MAX_SIM_IMPACTS = 256;
+
+// What the player asked for during a tick, one bit per Action
+struct Tick_Input {
+	u32 held;
+	u32 pressed;	// only for the first tick after the press
+};
+
+struct Sim_State {
+	u64 tick;
+	r32 t;
+	V2 camera;
+	Entity player;
+	Entity enemy;
+	i32 player_combo;
+	i32 attack_count;	// since the combo started
+	Polygon poly;
+	u32 collision_color;
+	Random_Series random;
+	InputAction actions[MAX_BUFFERED_ACTIONS];
+	i32 action_count;
+	AI_Scheduler ai;
+};
+
+struct Simulation {
+	Sim_State state;
+
+	World *world;
+	Job_System *jobs;
+	Projectile_Pool *projectiles;
+	Projectile_Pool *effects;
+	Static_Geometry *level;
+	Flow_Field_Builder *flow_builder;
+	Nav_Grid *grid;
+	Animation *player_animation;
+	Animation *enemy_animation;
+	V2 view_size;		// the AI wants to know what's on screen
+	Memory_Arena *scratch;
+	V2 *epa_points;
+	Projectile_Hit *hits;
+	i32 max_hits;
+
+	// where projectiles hit something since the last reset, for the effects that only show
+	V2 impacts[MAX_SIM_IMPACTS];
+	i32 impact_count;
+};
+
+// How actions are buffered. Held ones come from what is held during the tick and only last for
+// that tick, pressed ones stay in the buffer for their lifetime. Of a queued action only the
+// oldest one ages, the ones behind it wait (the next hit of a combo waits for the current one)
+struct Action_Rule {
+	bool held;
+	bool queued;
+	r32 lifetime;	// seconds
+};
+
+const Action_Rule action_rules[COUNT_ACTION] = {
+	{ false, false, 0 },	// ACTION_NONE
+	{ true, false, 0 },		// ACTION_MOVE_LEFT
+	{ true, false, 0 },		// ACTION_MOVE_RIGHT
+	{ true, false, 0 },		// ACTION_MOVE_UP
+	{ true, false, 0 },		// ACTION_MOVE_DOWN
+	{ false, true, .9f },	// ACTION_ATTACK
+	{ false, false, 0 },	// ACTION_JUMP
+	{ true, false, 0 },		// ACTION_CROUCH
+};
+
+inline void push_action(Sim_State *state, Action action)
+{
+	// the buffer being full drops the newest, like a key nobody pressed
+	if (state->action_count < MAX_BUFFERED_ACTIONS)
+		state->actions[state->action_count++] = { action, action_rules[action].lifetime, false };
+}
+
+// Drops the expired actions, compacting the buffer in place
+void refresh_actions(Sim_State *state)
+{
+	i32 count = 0;
+	for (i32 i = 0; i < state->action_count; ++i) {
+		if (state->actions[i].duration > 0)
+			state->actions[count++] = state->actions[i];
+	}
+	state->action_count = count;
+}
+
+void apply_actions(Simulation *sim, r32 dt)
+{
+	Sim_State *state = &sim->state;
+	World *world = sim->world;
+	Animation *player_animation = sim->player_animation;
+	Transform *player_transform = get_component(world, &world->transforms, state->player);
+	Velocity *player_velocity = get_component(world, &world->velocities, state->player);
+	Sprite *player_sprite = get_component(world, &world->sprites, state->player);
+	Animation_Playback *player_playback = &player_sprite->playback;
+
+	player_velocity->accn = {};
+	bool attack_encountered = false;
+	u32 seen = 0;
+
+	for (i32 i = 0; i < state->action_count; ++i) {
+		InputAction *action = &state->actions[i];
+		u32 bit = 1 << action->action;
+		if (!action_rules[action->action].queued || !(seen & bit))
+			action->duration -= dt;
+		seen |= bit;
+		switch (action->action) {
+			case ACTION_NONE: {
+				// no op
+				play_animation(player_playback, animation_state(player_animation, PLAYER_ANIMATION_IDLE));
+			} break;
+			case ACTION_MOVE_LEFT: {
+				player_velocity->accn.x -= 1;
+				play_animation(player_playback, animation_state(player_animation, PLAYER_ANIMATION_RUN));
+				player_sprite->flipped = true;
+			} break;
+
+			case ACTION_MOVE_RIGHT: {
+				player_velocity->accn.x += 1;
+				play_animation(player_playback, animation_state(player_animation, PLAYER_ANIMATION_RUN));
+				player_sprite->flipped = false;
+			} break;
+
+			case ACTION_MOVE_UP: {
+				player_velocity->accn.y -= 1;
+			} break;
+
+			case ACTION_MOVE_DOWN: {
+				player_velocity->accn.y += 1;
+			} break;
+
+			case ACTION_ATTACK: {
+				if (action->duration > 0 && !attack_encountered && !action->consumed) {
+					action->consumed = true;
+					// attacks play out in full, the next hit of the combo waits for the current one
+					play_animation(player_playback, animation_state(player_animation, PLAYER_ANIMATION_ATK1 + state->player_combo),
+								   ANIMATION_ONE_SHOT | ANIMATION_UNINTERRUPTIBLE | ANIMATION_RESTART);
+					if (state->player_combo == 2) {
+						// the last hit of the combo throws a sword
+						V2 direction = V2(player_sprite->flipped ? -1.f : 1.f, 0.f);
+						spawn_projectile(sim->projectiles, PROJECTILE_SWORD, player_transform->pos + player_transform->size / 2,
+										 direction * 700.f, state->player.index);
+					}
+					state->player_combo = (state->player_combo + 1) % 3; // TODO: un-hardcode this
+					state->attack_count++;
+				}
+				attack_encountered = true;
+			} break;
+
+			case ACTION_JUMP: {
+
+			} break;
+
+			case ACTION_CROUCH: {
+				play_animation(player_playback, animation_state(player_animation, PLAYER_ANIMATION_CROUCH));
+			} break;
+		}
+	}
+
+	if (state->action_count == 0) {
+		play_animation(player_playback, player_animation->default_state);
+	}
+
+	if (!attack_encountered) {
+		state->player_combo = 0;
+		state->attack_count = 0;
+	}
+}
+
+void simulate_tick(Simulation *sim, Tick_Input *input, r32 dt)
+{
+	ProfileFunction();
+	Sim_State *state = &sim->state;
+	World *world = sim->world;
+
+	for (i32 action = ACTION_NONE + 1; action < COUNT_ACTION; ++action) {
+		u32 bits = action_rules[action].held ? input->held : input->pressed;
+		if (bits & (1 << action))
+			push_action(state, (Action) action);
+	}
+
+	apply_actions(sim, dt);
+	refresh_actions(state);
+
+	Transform *player_transform = get_component(world, &world->transforms, state->player);
+	Velocity *player_velocity = get_component(world, &world->velocities, state->player);
+	Collider *player_collider = get_component(world, &world->colliders, state->player);
+	Transform *enemy_transform = get_component(world, &world->transforms, state->enemy);
+	Collider *enemy_collider = get_component(world, &world->colliders, state->enemy);
+
+	{
+		ProfileZone("ai");
+		AI_Context ai_context = {};
+		ai_context.world = world;
+		ai_context.animation = sim->enemy_animation;
+		ai_context.player_pos = player_transform->pos + player_transform->size / 2;
+		ai_context.view = { state->camera - sim->view_size / 2.f, state->camera + sim->view_size / 2.f };
+		ai_context.grid = sim->grid;
+		ai_context.flow = update_flow_field(sim->flow_builder, ai_context.player_pos);
+		ai_context.dt = dt;
+		update_ai(&state->ai, &ai_context);
+	}
+
+	player_velocity->accn = normalizez(player_velocity->accn);
+
+	// TODO: generate sword collider and make others get damaged if appropriate
+
+	integrate_velocities(world, dt);
+	Capsule c_player = collider_capsule(player_collider, player_transform);
+	Rect r_enemy = collider_rect(enemy_collider, enemy_transform);
+	state->collision_color = 0xff0000ff;
+
+	{
+		ProfileZone("epa");
+		V2 dist;
+
+		if (epa(c_player, r_enemy, dist, sim->epa_points, EPA_MAX_POINTS)) {
+			player_transform->pos -= dist / 2;
+			enemy_transform->pos += dist / 2;
+			c_player = collider_capsule(player_collider, player_transform);
+			r_enemy = collider_rect(enemy_collider, enemy_transform);
+			state->collision_color = 0xffffffff;
+		}
+	}
+	{
+		ProfileZone("epa");
+		V2 dist;
+		if (epa(state->poly, r_enemy, dist, sim->epa_points, EPA_MAX_POINTS)) {
+			state->poly.pos -= dist;	// for the polygon, just updating its position works
+			state->collision_color = 0xff00ffff;
+		}
+	}
+	{
+		ProfileZone("epa");
+		V2 dist;
+		if (epa(c_player, state->poly, dist, sim->epa_points, EPA_MAX_POINTS)) {
+			player_transform->pos -= dist;	// same here
+			state->collision_color = 0x00ffffff;
+		}
+	}
+
+	collide_world_with_level(world, sim->level);
+
+	move_projectiles(sim->projectiles, dt);
+	i32 hit_count = collide_projectiles(sim->projectiles, world, sim->scratch, dt, sim->hits, sim->max_hits);
+	hit_count += collide_projectiles_with_level(sim->projectiles, sim->level, dt, sim->hits + hit_count, sim->max_hits - hit_count);
+	for (i32 i = 0; i < hit_count; ++i) {
+		for (i32 j = 0; j < 6; ++j) {
+			V2 vel = V2(random_bilateral(&state->random), random_bilateral(&state->random)) * 200.f;
+			spawn_projectile(sim->effects, EFFECT_HIT_SPARK, sim->hits[i].pos, vel);
+		}
+		if (sim->impact_count < MAX_SIM_IMPACTS)
+			sim->impacts[sim->impact_count++] = sim->hits[i].pos;
+	}
+	remove_expired_projectiles(sim->projectiles);
+	update_projectiles(sim->effects, dt);
+
+	state->camera = lerp(state->camera, 0.025f, player_transform->pos);
+	update_sprites(sim->jobs, world, dt);
+
+	state->t += dt;
+	state->tick++;
+}
+
+////////////////////////////////////////
+//				Snapshots
+
+// Without data it only counts how big the snapshot is going to be
+struct Snapshot_Writer {
+	u8 *data;
+	imem size;
+};
+
+inline void write_snapshot(Snapshot_Writer *out, const void *data, imem size)
+{
+	if (out->data)
+		SDL_memcpy(out->data + out->size, data, size);
+	out->size += size;
+}
+
+inline void read_snapshot(u8 **in, void *data, imem size)
+{
+	SDL_memcpy(data, *in, size);
+	*in += size;
+}
+
+template <typename T>
+void save_component_pool(Snapshot_Writer *out, Component_Pool<T> *pool)
+{
+	write_snapshot(out, &pool->count, sizeof(pool->count));
+	write_snapshot(out, pool->data, pool->count * sizeof(T));
+	write_snapshot(out, pool->entities, pool->count * sizeof(u32));
+}
+
+template <typename T>
+void restore_component_pool(u8 **in, Component_Pool<T> *pool)
+{
+	for (u32 i = 0; i < pool->count; ++i) {
+		pool->sparse[pool->entities[i]] = ENTITY_NONE;
+	}
+	read_snapshot(in, &pool->count, sizeof(pool->count));
+	read_snapshot(in, pool->data, pool->count * sizeof(T));
+	read_snapshot(in, pool->entities, pool->count * sizeof(u32));
+	for (u32 i = 0; i < pool->count; ++i) {
+		pool->sparse[pool->entities[i]] = i;
+	}
+}
+
+void save_projectile_pool(Snapshot_Writer *out, Projectile_Pool *pool)
+{
+	write_snapshot(out, &pool->count, sizeof(pool->count));
+	write_snapshot(out, &pool->slot_count, sizeof(pool->slot_count));
+	write_snapshot(out, &pool->free_slot, sizeof(pool->free_slot));
+	write_snapshot(out, &pool->dropped, sizeof(pool->dropped));
+	u32 count = pool->count;
+	write_snapshot(out, pool->x, count * sizeof(r32));
+	write_snapshot(out, pool->y, count * sizeof(r32));
+	write_snapshot(out, pool->vx, count * sizeof(r32));
+	write_snapshot(out, pool->vy, count * sizeof(r32));
+	write_snapshot(out, pool->age, count * sizeof(r32));
+	write_snapshot(out, pool->lifetime, count * sizeof(r32));
+	write_snapshot(out, pool->radius, count * sizeof(r32));
+	write_snapshot(out, pool->owner, count * sizeof(u32));
+	write_snapshot(out, pool->slot, count * sizeof(u32));
+	write_snapshot(out, pool->kind, count * sizeof(Projectile_Kind));
+	write_snapshot(out, pool->dense, pool->slot_count * sizeof(u32));
+	write_snapshot(out, pool->generations, pool->slot_count * sizeof(u32));
+}
+
+void restore_projectile_pool(u8 **in, Projectile_Pool *pool)
+{
+	read_snapshot(in, &pool->count, sizeof(pool->count));
+	read_snapshot(in, &pool->slot_count, sizeof(pool->slot_count));
+	read_snapshot(in, &pool->free_slot, sizeof(pool->free_slot));
+	read_snapshot(in, &pool->dropped, sizeof(pool->dropped));
+	u32 count = pool->count;
+	read_snapshot(in, pool->x, count * sizeof(r32));
+	read_snapshot(in, pool->y, count * sizeof(r32));
+	read_snapshot(in, pool->vx, count * sizeof(r32));
+	read_snapshot(in, pool->vy, count * sizeof(r32));
+	read_snapshot(in, pool->age, count * sizeof(r32));
+	read_snapshot(in, pool->lifetime, count * sizeof(r32));
+	read_snapshot(in, pool->radius, count * sizeof(r32));
+	read_snapshot(in, pool->owner, count * sizeof(u32));
+	read_snapshot(in, pool->slot, count * sizeof(u32));
+	read_snapshot(in, pool->kind, count * sizeof(Projectile_Kind));
+	read_snapshot(in, pool->dense, pool->slot_count * sizeof(u32));
+	read_snapshot(in, pool->generations, pool->slot_count * sizeof(u32));
+}
+
+// Writes the snapshot to out, which has to have room for it, and returns its size. With out
+// nullptr it only returns the size
+imem save_simulation(Simulation *sim, u8 *data)
+{
+	Snapshot_Writer writer = { data, 0 };
+	Snapshot_Writer *out = &writer;
+	World *world = sim->world;
+	write_snapshot(out, &sim->state, sizeof(sim->state));
+	write_snapshot(out, &world->next_index, sizeof(world->next_index));
+	write_snapshot(out, &world->free_count, sizeof(world->free_count));
+	write_snapshot(out, &world->alive_count, sizeof(world->alive_count));
+	write_snapshot(out, world->generations, world->next_index * sizeof(u32));
+	write_snapshot(out, world->free_indices, world->free_count * sizeof(u32));
+	save_component_pool(out, &world->transforms);
+	save_component_pool(out, &world->velocities);
+	save_component_pool(out, &world->sprites);
+	save_component_pool(out, &world->colliders);
+	save_component_pool(out, &world->brains);
+	save_projectile_pool(out, sim->projectiles);
+	save_projectile_pool(out, sim->effects);
+	return writer.size;
+}
+
+void restore_simulation(Simulation *sim, u8 *snapshot, imem size)
+{
+	u8 *in = snapshot;
+	World *world = sim->world;
+	read_snapshot(&in, &sim->state, sizeof(sim->state));
+	read_snapshot(&in, &world->next_index, sizeof(world->next_index));
+	read_snapshot(&in, &world->free_count, sizeof(world->free_count));
+	read_snapshot(&in, &world->alive_count, sizeof(world->alive_count));
+	read_snapshot(&in, world->generations, world->next_index * sizeof(u32));
+	read_snapshot(&in, world->free_indices, world->free_count * sizeof(u32));
+	restore_component_pool(&in, &world->transforms);
+	restore_component_pool(&in, &world->velocities);
+	restore_component_pool(&in, &world->sprites);
+	restore_component_pool(&in, &world->colliders);
+	restore_component_pool(&in, &world->brains);
+	restore_projectile_pool(&in, sim->projectiles);
+	restore_projectile_pool(&in, sim->effects);
+	assert(in == snapshot + size);
+}
+
+// Of what moves, to tell whether simulating again ended up in the same place
+u32 hash_simulation(Simulation *sim)
+{
+	World *world = sim->world;
+	u32 hashes[4] = {
+		hash_string((const char *) world->transforms.data, world->transforms.count * sizeof(Transform)),
+		hash_string((const char *) world->transforms.entities, world->transforms.count * sizeof(u32)),
+		hash_string((const char *) sim->projectiles->x, sim->projectiles->count * sizeof(r32)),
+		hash_string((const char *) &sim->state.random, sizeof(sim->state.random)),
+	};
+	return hash_string((const char *) hashes, sizeof(hashes));
+}
+
+struct Tick_Record {
+	u64 tick;
+	Tick_Input input;
+	imem offset;			// of its snapshot in the buffer, from before the tick ran
+	imem size;
+	u32 epoch;				// of the history when it was recorded
+};
+
+struct Sim_History_Stats {
+	r32 save_ms;			// of the last tick
+	r32 peak_save_ms;
+	imem snapshot_bytes;	// of the last tick
+};
+
+// Ring of the last ticks, at most capacity of them and as many as their snapshots fit in buffer
+struct Sim_History {
+	Tick_Record *records;
+	i32 capacity;
+	i32 count;
+	i32 oldest;
+	u8 *buffer;
+	imem buffer_size;
+	u32 epoch;
+	Sim_History_Stats stats;
+};
+
+void sim_history_init(Sim_History *history, Memory_Arena *arena, i32 capacity, imem buffer_size)
+{
+	*history = {};
+	history->records = PushArray(arena, Tick_Record, capacity);
+	history->capacity = capacity;
+	history->buffer = PushArrayNoZero(arena, u8, buffer_size);
+	history->buffer_size = buffer_size;
+}
+
+// i-th recorded tick, 0 is the oldest
+inline Tick_Record *history_record(Sim_History *history, i32 i)
+{
+	assert(i >= 0 && i < history->count);
+	return &history->records[(history->oldest + i) % history->capacity];
+}
+
+// Call when something outside the ticks changed the world, like a chunk streaming in or out or a
+// debug spawn. A snapshot from before would undo it and hand its entity indices out again while
+// whatever created them still holds the handles, so resimulate doesn't go back past this
+inline void break_history(Sim_History *history)
+{
+	history->epoch++;
+}
+
+inline u8 *tick_snapshot(Sim_History *history, Tick_Record *record)
+{
+	return history->buffer + record->offset;
+}
+
+bool snapshot_overlaps(Sim_History *history, imem offset, imem size)
+{
+	for (i32 i = 0; i < history->count; ++i) {
+		Tick_Record *record = history_record(history, i);
+		if (record->offset < offset + size && offset < record->offset + record->size)
+			return true;
+	}
+	return false;
+}
+
+// Call right before the tick runs
+void record_tick(Sim_History *history, Simulation *sim, Tick_Input *input)
+{
+	u64 start = SDL_GetPerformanceCounter();
+	imem size = save_simulation(sim, nullptr);
+	if (size > history->buffer_size) {
+		SDL_Log("A snapshot of %lld bytes doesn't fit in the history, it stays empty", (long long) size);
+		history->count = 0;
+		return;
+	}
+
+	// right after the newest one, or back at the start of the buffer when it doesn't fit there
+	imem offset = 0;
+	if (history->count > 0) {
+		Tick_Record *newest = history_record(history, history->count - 1);
+		offset = newest->offset + newest->size;
+		if (offset + size > history->buffer_size)
+			offset = 0;
+	}
+	// the oldest ticks make room, the ones in the ring stay one after the other
+	while (history->count > 0 && (history->count == history->capacity || snapshot_overlaps(history, offset, size))) {
+		history->oldest = (history->oldest + 1) % history->capacity;
+		history->count--;
+	}
+
+	Tick_Record *record = &history->records[(history->oldest + history->count) % history->capacity];
+	record->tick = sim->state.tick;
+	record->input = *input;
+	record->offset = offset;
+	record->size = size;
+	record->epoch = history->epoch;
+	save_simulation(sim, tick_snapshot(history, record));
+	history->count++;
+
+	history->stats.save_ms = counter_to_ms(SDL_GetPerformanceCounter() - start);
+	history->stats.peak_save_ms = Max(history->stats.peak_save_ms, history->stats.save_ms);
+	history->stats.snapshot_bytes = size;
+}
+
+struct Resimulation {
+	i32 ticks;
+	r32 restore_ms;
+	r32 simulate_ms;
+	bool matched;		// ended where the live simulation did
+};
+
+// Goes back ticks ticks and simulates them again with the inputs they had, without rendering.
+// The simulation ends up at the tick it was at before. The AI gets no time budget meanwhile, so
+// the result only depends on the inputs; if it deferred brains the first time, it won't match.
+// Fewer ticks when the history was broken since
+Resimulation resimulate(Sim_History *history, Simulation *sim, i32 ticks, r32 dt)
+{
+	Resimulation result = {};
+	i32 unbroken = 0;
+	while (unbroken < history->count && history_record(history, history->count - 1 - unbroken)->epoch == history->epoch) {
+		unbroken++;
+	}
+	ticks = Min(ticks, unbroken);
+	if (ticks <= 0)
+		return result;
+	u32 live_hash = hash_simulation(sim);
+	u64 live_tick = sim->state.tick;
+
+	// the records get overwritten by the ticks simulated again, so they are replayed from a copy
+	// of the inputs
+	Temp_Memory temp = begin_temp_memory(sim->scratch);
+	Defer(end_temp_memory(temp));
+	Tick_Input *inputs = PushArrayNoZero(sim->scratch, Tick_Input, ticks);
+	i32 first = history->count - ticks;
+	for (i32 i = 0; i < ticks; ++i) {
+		inputs[i] = history_record(history, first + i)->input;
+	}
+
+	r32 budget_ms = sim->state.ai.budget_ms;
+	u64 start = SDL_GetPerformanceCounter();
+	Tick_Record *record = history_record(history, first);
+	restore_simulation(sim, tick_snapshot(history, record), record->size);
+	u64 restored = SDL_GetPerformanceCounter();
+	history->count = first;
+	for (i32 i = 0; i < ticks; ++i) {
+		sim->state.ai.budget_ms = 0;
+		record_tick(history, sim, &inputs[i]);
+		simulate_tick(sim, &inputs[i], dt);
+	}
+	u64 end = SDL_GetPerformanceCounter();
+	sim->state.ai.budget_ms = budget_ms;
+	sim->impact_count = 0;
+
+	result.ticks = ticks;
+	result.restore_ms = counter_to_ms(restored - start);
+	result.simulate_ms = counter_to_ms(end - restored);
+	result.matched = sim->state.tick == live_tick && hash_simulation(sim) == live_hash;
+	return result;
+}
+
+//				Snapshots
+////////////////////////////////////////
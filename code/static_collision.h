@@ -0,0 +1,471 @@
+#pragma once
+
+// Collision geometry of the level, baked from the solid tiles of the tilemap.
+//
+// One collider per solid tile would be tens of thousands of colliders, and anything sliding
+// along a wall would catch on the seams between them. Instead every chunk of the map is baked
+// into two things:
+//
+// * rectangles, the solid tiles merged by greedy meshing (grow a run of tiles along the row,
+//   then grow the run downwards while the rows below are solid too). Projectiles and other
+//   queries test against these.
+// * edges, the outline between solid and open tiles with collinear runs merged into one edge.
+//   Each edge only pushes out of its open side and knows the outline vertex before and after it
+//   (its ghost vertices), so a shape crossing from one edge into the next one in line (across a
+//   chunk border, say) never sees a corner there. Only real, convex corners push diagonally.
+//   Actors are resolved against these.
+//
+// A chunk is baked again when a tile in or next to it changes. Only resident chunks of the map
+// have geometry, kept in the same slots as their tiles.
+
+struct Static_Edge {
+	V2 a;
+	V2 b;
+	V2 normal;		// towards the open side
+	V2 ghost_a;		// outline vertex before a
+	V2 ghost_b;		// outline vertex after b
+};
+
+// Only where the outline turns away from the open side is there a corner to push around. Where
+// it goes on straight or turns into the open side, the next edge takes over
+inline bool is_corner(Static_Edge *edge, V2 vertex, V2 ghost)
+{
+	return dot(ghost - vertex, edge->normal) < 0;
+}
+
+struct Static_Chunk {
+	Array<Rect> rects;
+	Array<Static_Edge> edges;
+	u32 solid_tiles;
+	bool dirty;
+};
+
+struct Static_Geometry {
+	Tilemap *map;
+	Static_Chunk *chunks;	// one per slot of the map
+
+	u32 solid_tiles;
+	u32 rect_count;
+	u32 edge_count;
+	u32 chunks_baked;		// by the last update
+	r32 bake_ms;
+};
+
+struct Static_Contact {
+	V2 normal;
+	r32 depth;
+};
+
+void static_geometry_init(Static_Geometry *geometry, Memory_Arena *arena, Tilemap *map)
+{
+	*geometry = {};
+	geometry->map = map;
+	i32 chunk_count = map->chunk_capacity;
+	geometry->chunks = PushArray(arena, Static_Chunk, chunk_count);
+	for (i32 i = 0; i < chunk_count; ++i) {
+		array_init(&geometry->chunks[i].rects, heap_allocator(MEMORY_TAG_PHYSICS));
+		array_init(&geometry->chunks[i].edges, heap_allocator(MEMORY_TAG_PHYSICS));
+		geometry->chunks[i].dirty = true;
+	}
+}
+
+inline bool tile_is_solid(Tilemap *map, i32 x, i32 y)
+{
+	return tile_types[get_tile(map, x, y)].blocks;
+}
+
+// nullptr when chunk (cx, cy) isn't resident
+inline Static_Chunk *static_chunk_at(Static_Geometry *geometry, i32 cx, i32 cy)
+{
+	i32 slot = resident_slot(geometry->map, cx, cy);
+	return slot == TILE_NOT_RESIDENT ? nullptr : &geometry->chunks[slot];
+}
+
+// The outline of a changed tile can reach one tile into the chunks around it
+void mark_static_geometry_dirty(Static_Geometry *geometry, i32 x, i32 y)
+{
+	Tilemap *map = geometry->map;
+	for (i32 dy = -1; dy <= 1; ++dy) {
+		for (i32 dx = -1; dx <= 1; ++dx) {
+			if (!tile_in_bounds(map, x + dx, y + dy))
+				continue;
+			Static_Chunk *chunk = static_chunk_at(geometry, (x + dx) / TILE_CHUNK_SIZE, (y + dy) / TILE_CHUNK_SIZE);
+			if (chunk)
+				chunk->dirty = true;
+		}
+	}
+}
+
+// After chunk (cx, cy) came into or went out of memory: its own outline and the ones of the
+// chunks around it change
+void mark_static_chunk_dirty(Static_Geometry *geometry, i32 cx, i32 cy)
+{
+	for (i32 dy = -1; dy <= 1; ++dy) {
+		for (i32 dx = -1; dx <= 1; ++dx) {
+			Static_Chunk *chunk = static_chunk_at(geometry, cx + dx, cy + dy);
+			if (chunk)
+				chunk->dirty = true;
+		}
+	}
+}
+
+// Empties the geometry of a slot whose chunk is leaving memory, call before removing it from the
+// map. The slot keeps the capacity for the next chunk, so streaming doesn't go to the heap
+void release_static_chunk(Static_Geometry *geometry, i32 cx, i32 cy)
+{
+	i32 slot = resident_slot(geometry->map, cx, cy);
+	assert(slot != TILE_NOT_RESIDENT);
+	Static_Chunk *chunk = &geometry->chunks[slot];
+	geometry->solid_tiles -= chunk->solid_tiles;
+	geometry->rect_count -= (u32) chunk->rects.count;
+	geometry->edge_count -= (u32) chunk->edges.count;
+	array_clear(&chunk->rects);
+	array_clear(&chunk->edges);
+	chunk->solid_tiles = 0;
+	chunk->dirty = true;
+}
+
+// Memory the geometry of the chunk in a slot takes, not what the slot keeps allocated
+inline imem static_chunk_bytes(Static_Chunk *chunk)
+{
+	return chunk->rects.count * sizeof(Rect) + chunk->edges.count * sizeof(Static_Edge);
+}
+
+void bake_chunk_rects(Static_Geometry *geometry, Static_Chunk *chunk, i32 chunk_x, i32 chunk_y)
+{
+	Tilemap *map = geometry->map;
+	bool used[TILE_CHUNK_SIZE][TILE_CHUNK_SIZE] = {};
+	i32 x0 = chunk_x * TILE_CHUNK_SIZE, y0 = chunk_y * TILE_CHUNK_SIZE;
+	auto is_free = [&] (i32 x, i32 y) { return !used[y][x] && tile_is_solid(map, x0 + x, y0 + y); };
+
+	for (i32 y = 0; y < TILE_CHUNK_SIZE; ++y) {
+		for (i32 x = 0; x < TILE_CHUNK_SIZE; ++x) {
+			if (!is_free(x, y))
+				continue;
+			i32 width = 1;
+			while (x + width < TILE_CHUNK_SIZE && is_free(x + width, y))
+				width++;
+			i32 height = 1;
+			for (; y + height < TILE_CHUNK_SIZE; ++height) {
+				bool full = true;
+				for (i32 i = 0; i < width && full; ++i)
+					full = is_free(x + i, y + height);
+				if (!full)
+					break;
+			}
+			for (i32 j = 0; j < height; ++j) {
+				for (i32 i = 0; i < width; ++i)
+					used[y + j][x + i] = true;
+			}
+			V2 min = map->origin + V2((r32) (x0 + x), (r32) (y0 + y)) * (r32) TILE_SIZE;
+			array_add(&chunk->rects, Rect{ min, min + V2((r32) width, (r32) height) * (r32) TILE_SIZE });
+		}
+	}
+}
+
+// Going clockwise around the solid tiles, so that the solid side is always on the right (y down).
+// Per side of a tile: the direction towards the open neighbour and the direction the edge runs in
+constexpr i32 static_side_normal_x[4] = { 0, 1, 0, -1 };
+constexpr i32 static_side_normal_y[4] = { -1, 0, 1, 0 };
+constexpr i32 static_side_tangent_x[4] = { 1, 0, -1, 0 };
+constexpr i32 static_side_tangent_y[4] = { 0, 1, 0, -1 };
+// first corner of the side of tile (0, 0)
+constexpr i32 static_side_start_x[4] = { 0, 1, 1, 0 };
+constexpr i32 static_side_start_y[4] = { 0, 0, 1, 1 };
+
+void bake_chunk_edges(Static_Geometry *geometry, Static_Chunk *chunk, i32 chunk_x, i32 chunk_y)
+{
+	Tilemap *map = geometry->map;
+	i32 x0 = chunk_x * TILE_CHUNK_SIZE, y0 = chunk_y * TILE_CHUNK_SIZE;
+	auto in_chunk = [&] (i32 x, i32 y) { return x >= x0 && y >= y0 && x < x0 + TILE_CHUNK_SIZE && y < y0 + TILE_CHUNK_SIZE; };
+
+	for (i32 side = 0; side < 4; ++side) {
+		i32 nx = static_side_normal_x[side], ny = static_side_normal_y[side];
+		i32 tx = static_side_tangent_x[side], ty = static_side_tangent_y[side];
+		auto has_edge = [&] (i32 x, i32 y) { return tile_is_solid(map, x, y) && !tile_is_solid(map, x + nx, y + ny); };
+
+		for (i32 y = y0; y < y0 + TILE_CHUNK_SIZE; ++y) {
+			for (i32 x = x0; x < x0 + TILE_CHUNK_SIZE; ++x) {
+				// runs start at the first tile of the chunk that has the edge
+				if (!has_edge(x, y) || (in_chunk(x - tx, y - ty) && has_edge(x - tx, y - ty)))
+					continue;
+				i32 length = 1;
+				while (in_chunk(x + length * tx, y + length * ty) && has_edge(x + length * tx, y + length * ty))
+					length++;
+
+				// corners in tile units
+				V2i a = V2i(x + static_side_start_x[side], y + static_side_start_y[side]);
+				V2i b = V2i(a.x + length * tx, a.y + length * ty);
+				V2i normal = V2i(nx, ny), tangent = V2i(tx, ty);
+
+				// Past either end the outline goes on straight when the next tile is solid with
+				// the same open side, turns into the open side when the tile beyond is solid
+				// (concave) and turns away from it otherwise (convex)
+				i32 before_x = x - tx, before_y = y - ty;
+				i32 after_x = x + length * tx, after_y = y + length * ty;
+				bool convex_a = !tile_is_solid(map, before_x, before_y);
+				bool convex_b = !tile_is_solid(map, after_x, after_y);
+				V2i ghost_a = convex_a ? a - normal : tile_is_solid(map, before_x + nx, before_y + ny) ? a + normal : a - tangent;
+				V2i ghost_b = convex_b ? b - normal : tile_is_solid(map, after_x + nx, after_y + ny) ? b + normal : b + tangent;
+
+				auto to_world = [&] (V2i p) { return map->origin + V2((r32) p.x, (r32) p.y) * (r32) TILE_SIZE; };
+				Static_Edge edge;
+				edge.a = to_world(a);
+				edge.b = to_world(b);
+				edge.normal = V2((r32) nx, (r32) ny);
+				edge.ghost_a = to_world(ghost_a);
+				edge.ghost_b = to_world(ghost_b);
+				array_add(&chunk->edges, edge);
+			}
+		}
+	}
+}
+
+// Bakes the dirty chunks again
+void update_static_geometry(Static_Geometry *geometry)
+{
+	Tilemap *map = geometry->map;
+	u64 start = SDL_GetPerformanceCounter();
+	geometry->chunks_baked = 0;
+
+	for (i32 slot = 0; slot < map->chunk_capacity; ++slot) {
+		Tile_Chunk *tiles = &map->chunks[slot];
+		Static_Chunk *chunk = &geometry->chunks[slot];
+		if (tiles->index == TILE_NOT_RESIDENT || !chunk->dirty)
+			continue;
+		i32 cx = tiles->index % map->chunks_x, cy = tiles->index / map->chunks_x;
+		geometry->solid_tiles -= chunk->solid_tiles;
+		geometry->rect_count -= (u32) chunk->rects.count;
+		geometry->edge_count -= (u32) chunk->edges.count;
+		array_clear(&chunk->rects);
+		array_clear(&chunk->edges);
+
+		chunk->solid_tiles = 0;
+		for (i32 i = 0; i < TILE_CHUNK_SIZE * TILE_CHUNK_SIZE; ++i) {
+			chunk->solid_tiles += tile_types[tiles->tiles[i]].blocks;
+		}
+		if (chunk->solid_tiles) {
+			bake_chunk_rects(geometry, chunk, cx, cy);
+			bake_chunk_edges(geometry, chunk, cx, cy);
+		}
+		chunk->dirty = false;
+
+		geometry->solid_tiles += chunk->solid_tiles;
+		geometry->rect_count += (u32) chunk->rects.count;
+		geometry->edge_count += (u32) chunk->edges.count;
+		geometry->chunks_baked++;
+	}
+
+	if (geometry->chunks_baked)
+		geometry->bake_ms = counter_to_ms(SDL_GetPerformanceCounter() - start);
+}
+
+// Chunks that overlap bounds, clamped to the map
+inline void static_chunk_range(Static_Geometry *geometry, Rect bounds, V2i *min, V2i *max)
+{
+	Tilemap *map = geometry->map;
+	V2i tile_min = tile_cell(map, bounds.min);
+	V2i tile_max = tile_cell(map, bounds.max);
+	*min = V2i(Max(tile_min.x, 0) / TILE_CHUNK_SIZE, Max(tile_min.y, 0) / TILE_CHUNK_SIZE);
+	*max = V2i(Min(tile_max.x, map->width - 1) / TILE_CHUNK_SIZE, Min(tile_max.y, map->height - 1) / TILE_CHUNK_SIZE);
+	if (tile_max.x < 0 || tile_max.y < 0 || tile_min.x >= map->width || tile_min.y >= map->height)
+		*max = *min - V2i(1, 1);
+}
+
+////////////////////////////////////////
+//				Contacts
+
+// Parameters of the closest points between segments p1 q1 and p2 q2 (Real-Time Collision
+// Detection, 5.1.9). When they run in parallel the middle of their overlap is taken, so that a
+// capsule along a wall is pushed by the wall and not by one of its ends
+void closest_points_segments(V2 p1, V2 q1, V2 p2, V2 q2, r32 *s, r32 *t)
+{
+	constexpr r32 epsilon = 1e-6f;
+	V2 d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+	r32 a = dot(d1, d1), e = dot(d2, d2), f = dot(d2, r);
+	if (a <= epsilon && e <= epsilon) {
+		*s = *t = 0;
+		return;
+	}
+	if (a <= epsilon) {
+		*s = 0;
+		*t = Clamp(0.f, f / e, 1.f);
+		return;
+	}
+	r32 c = dot(d1, r);
+	if (e <= epsilon) {
+		*t = 0;
+		*s = Clamp(0.f, -c / a, 1.f);
+		return;
+	}
+
+	r32 b = dot(d1, d2);
+	r32 denominator = a * e - b * b;
+	if (denominator <= epsilon * a * e) {
+		r32 t0 = f / e, t1 = (f + b) / e;
+		r32 lo = Max(Min(t0, t1), 0.f), hi = Min(Max(t0, t1), 1.f);
+		*t = lo <= hi ? (lo + hi) / 2 : Clamp(0.f, t0, 1.f);
+		*s = Clamp(0.f, (b * *t - c) / a, 1.f);
+		return;
+	}
+	*s = Clamp(0.f, (b * f - c * e) / denominator, 1.f);
+	*t = (b * *s + f) / e;
+	if (*t < 0) {
+		*t = 0;
+		*s = Clamp(0.f, -c / a, 1.f);
+	} else if (*t > 1) {
+		*t = 1;
+		*s = Clamp(0.f, (b - c) / a, 1.f);
+	}
+}
+
+bool static_contact(Static_Edge *edge, Capsule capsule, Static_Contact *contact)
+{
+	r32 s, t;
+	closest_points_segments(capsule.a, capsule.b, edge->a, edge->b, &s, &t);
+	V2 on_capsule = lerp(capsule.a, s, capsule.b);
+	V2 on_edge = lerp(edge->a, t, edge->b);
+	// one sided, from behind the edge it's the other edges that push
+	if (dot(on_capsule - edge->a, edge->normal) <= 0)
+		return false;
+
+	// ends that aren't corners belong to the next edge along the outline
+	bool at_a = t <= 0, at_b = t >= 1;
+	if ((at_a && !is_corner(edge, edge->a, edge->ghost_a)) || (at_b && !is_corner(edge, edge->b, edge->ghost_b)))
+		return false;
+
+	V2 d = on_capsule - on_edge;
+	r32 distance_squared = length_squared(d);
+	if (distance_squared >= capsule.radius * capsule.radius)
+		return false;
+	r32 distance = sqrtf(distance_squared);
+	if (at_a || at_b)
+		contact->normal = distance > 0 ? d / distance : edge->normal;	// round around the corner
+	else
+		contact->normal = edge->normal;
+	contact->depth = capsule.radius - distance;
+	return true;
+}
+
+// Rects and edges are both axis aligned, the push is always along the edge normal
+bool static_contact(Static_Edge *edge, Rect rect, Static_Contact *contact)
+{
+	V2 tangent = normalizez(edge->b - edge->a);
+	r32 edge_min = Min(dot(edge->a, tangent), dot(edge->b, tangent));
+	r32 edge_max = Max(dot(edge->a, tangent), dot(edge->b, tangent));
+	r32 rect_min = Min(dot(rect.min, tangent), dot(rect.max, tangent));
+	r32 rect_max = Max(dot(rect.min, tangent), dot(rect.max, tangent));
+	if (rect_max <= edge_min || rect_min >= edge_max)
+		return false;
+	if (dot(center(rect) - edge->a, edge->normal) <= 0)
+		return false;
+
+	r32 depth = dot(edge->a - support(rect, -edge->normal), edge->normal);
+	if (depth <= 0)
+		return false;
+	contact->normal = edge->normal;
+	contact->depth = depth;
+	return true;
+}
+
+inline Rect shape_bounds(Capsule capsule)
+{
+	return { V2(Min(capsule.a.x, capsule.b.x), Min(capsule.a.y, capsule.b.y)) - V2(capsule.radius),
+			 V2(Max(capsule.a.x, capsule.b.x), Max(capsule.a.y, capsule.b.y)) + V2(capsule.radius) };
+}
+
+inline Rect shape_bounds(Rect rect) { return rect; }
+
+inline Capsule translate(Capsule capsule, V2 offset) { return { capsule.a + offset, capsule.b + offset, capsule.radius }; }
+inline Rect translate(Rect rect, V2 offset) { return { rect.min + offset, rect.max + offset }; }
+
+// Pushes shape out of the level and returns how far. The shallowest contact is resolved first,
+// which is the way out SAT would pick, then the contacts are looked for again from there
+template <typename Shape>
+V2 resolve_static_collision(Static_Geometry *geometry, Shape shape, i32 max_iterations = 4)
+{
+	V2 push = V2();
+	for (i32 iteration = 0; iteration < max_iterations; ++iteration) {
+		Rect bounds = shape_bounds(shape);
+		V2i min, max;
+		static_chunk_range(geometry, bounds, &min, &max);
+
+		Static_Contact best = { V2(), INFINITY };
+		for (i32 cy = min.y; cy <= max.y; ++cy) {
+			for (i32 cx = min.x; cx <= max.x; ++cx) {
+				Static_Chunk *chunk = static_chunk_at(geometry, cx, cy);
+				for (i32 i = 0; chunk && i < chunk->edges.count; ++i) {
+					Static_Edge *edge = &chunk->edges[i];
+					if (Max(edge->a.x, edge->b.x) < bounds.min.x || Min(edge->a.x, edge->b.x) > bounds.max.x ||
+						Max(edge->a.y, edge->b.y) < bounds.min.y || Min(edge->a.y, edge->b.y) > bounds.max.y)
+						continue;
+					Static_Contact contact;
+					if (static_contact(edge, shape, &contact) && contact.depth < best.depth)
+						best = contact;
+				}
+			}
+		}
+		if (best.depth == INFINITY)
+			break;
+		V2 step = best.normal * (best.depth + 0.001f);
+		shape = translate(shape, step);
+		push += step;
+	}
+	return push;
+}
+
+// Pushes every entity with a collider out of the walls
+void collide_world_with_level(World *world, Static_Geometry *geometry)
+{
+	ProfileFunction();
+	Component_Pool<Collider> *colliders = &world->colliders;
+	for (u32 i = 0; i < colliders->count; ++i) {
+		Transform *transform = joined_component(colliders, i, &world->transforms);
+		if (!transform)
+			continue;
+		Collider *collider = &colliders->data[i];
+		if (collider->kind == COLLIDER_RECT)
+			transform->pos += resolve_static_collision(geometry, collider_rect(collider, transform));
+		else
+			transform->pos += resolve_static_collision(geometry, collider_capsule(collider, transform));
+	}
+}
+
+// Same sweep as collide_projectiles, against the merged rects. Hits have entity ENTITY_NONE
+i32 collide_projectiles_with_level(Projectile_Pool *pool, Static_Geometry *geometry, r32 dt, Projectile_Hit *hits, i32 max_hits)
+{
+	ProfileFunction();
+	i32 hit_count = 0;
+	for (u32 i = 0; i < pool->count && hit_count < max_hits; ++i) {
+		if (!projectile_types[pool->kind[i]].collides || pool->age[i] >= pool->lifetime[i])
+			continue;
+
+		V2 to = V2(pool->x[i], pool->y[i]);
+		V2 from = to - V2(pool->vx[i], pool->vy[i]) * Min(dt, pool->age[i]);
+		Capsule swept = { from, to, pool->radius[i] };
+		Rect bounds = shape_bounds(swept);
+		V2i min, max;
+		static_chunk_range(geometry, bounds, &min, &max);
+
+		bool hit = false;
+		for (i32 cy = min.y; cy <= max.y && !hit; ++cy) {
+			for (i32 cx = min.x; cx <= max.x && !hit; ++cx) {
+				Static_Chunk *chunk = static_chunk_at(geometry, cx, cy);
+				for (i32 r = 0; chunk && r < chunk->rects.count && !hit; ++r) {
+					Rect rect = chunk->rects[r];
+					if (bounds.max.x < rect.min.x || bounds.min.x > rect.max.x || bounds.max.y < rect.min.y || bounds.min.y > rect.max.y)
+						continue;
+					hit = gjk(swept, rect);
+				}
+			}
+		}
+		if (hit) {
+			hits[hit_count++] = { i, ENTITY_NONE, to };
+			pool->lifetime[i] = 0;
+		}
+	}
+	return hit_count;
+}
+
+//				Contacts
+////////////////////////////////////////
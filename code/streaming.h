@@ -0,0 +1,821 @@
+#pragma once
+
+// World streaming: only the chunks of the level around the camera are in memory.
+//
+// The level is a world file of fixed size chunk records, the tiles of a chunk and the enemies
+// that spawn in it, so any chunk can be read or written on its own. Every frame the chunks within
+// the load radius of the camera that aren't resident are requested, nearest first. Loader threads
+// read them into staging records, and the main thread activates the finished ones at the start of
+// a frame (tiles, masks, collision, navigation and spawns), a few per frame so that a burst of
+// loads doesn't turn into a hitch. Once the resident chunks take more memory than the budget,
+// the ones outside the keep radius are evicted, farthest first. Edited chunks are written back by
+// the loaders on their way out. The main thread never touches the file after startup.
+//
+// Enemies belong to the chunk they spawned in and go away with it.
+//
+// A chunk on screen that isn't active is a stall, the stream counts them. F12 flies the camera
+// across the world to measure how the frame time holds up while chunks stream in and out.
+
+constexpr u32 WORLD_FILE_MAGIC = 'W' | 'R' << 8 | 'L' << 16 | 'D' << 24;
+constexpr u32 WORLD_FILE_VERSION = 1;
+constexpr i32 MAX_CHUNK_SPAWNS = 16;
+constexpr i32 WORLD_STREAM_THREADS = 2;
+constexpr i32 WORLD_STREAM_JOBS = 32;	// loads and writes in flight
+
+struct World_File_Header {
+	u32 magic;
+	u32 version;
+	i32 chunks_x;
+	i32 chunks_y;
+	V2 origin;
+};
+
+struct Chunk_Spawn {
+	V2 pos;				// world position of the enemy's center
+};
+
+// Chunk i is at sizeof(World_File_Header) + i * sizeof(Chunk_Record)
+struct Chunk_Record {
+	Tile_Kind tiles[TILE_CHUNK_SIZE * TILE_CHUNK_SIZE];
+	u32 spawn_count;
+	Chunk_Spawn spawns[MAX_CHUNK_SPAWNS];
+};
+
+enum Chunk_Stream_State : u8 {
+	CHUNK_UNLOADED,
+	CHUNK_LOADING,		// requested, being read or waiting to be activated
+	CHUNK_ACTIVE,
+};
+
+enum Stream_Job_Kind : u8 {
+	STREAM_JOB_LOAD,
+	STREAM_JOB_WRITE,
+};
+
+enum Stream_Job_State : u8 {
+	STREAM_JOB_FREE,
+	STREAM_JOB_QUEUED,
+	STREAM_JOB_RUNNING,
+	STREAM_JOB_DONE,
+	STREAM_JOB_FINISHED,	// done and seen by the main thread, only it touches the job from there on
+};
+
+struct Stream_Job {
+	Stream_Job_Kind kind;
+	Stream_Job_State state;		// guarded by the stream's mutex
+	bool ok;
+	bool ready;					// a finished load waiting to be activated, only the main thread reads it
+	i32 chunk;
+	u32 sequence;				// jobs run in the order they were queued
+	u64 requested_counter;
+	u64 io_counter;				// time the loader spent on it
+	Chunk_Record record;
+};
+
+// What the stream keeps per slot of the map besides the tiles
+struct Stream_Slot {
+	Chunk_Spawn spawns[MAX_CHUNK_SPAWNS];
+	u32 spawn_count;
+	Entity entities[MAX_CHUNK_SPAWNS];
+	u32 entity_count;
+};
+
+struct World_Stream_Stats {
+	u32 resident_chunks;
+	imem resident_bytes;
+	u32 stalled_chunks;		// on screen and not active this frame
+	r32 update_ms;
+	r32 peak_update_ms;
+	r32 peak_latency_ms;	// from request to activation
+
+	// since startup
+	u32 requests;
+	u32 loads;
+	u32 activations;
+	u32 evictions;
+	u32 writes;
+	u32 cancels;
+	u32 failures;
+	u32 stall_frames;
+	r64 io_ms;				// on the loader threads
+};
+
+struct World_Stream {
+	const char *path;
+	Tilemap *map;
+	Static_Geometry *geometry;
+	Flow_Field_Builder *flow_builder;
+	World *world;
+	Animation *enemy_animation;
+	V2 enemy_size;
+
+	u8 *states;				// Chunk_Stream_State per chunk of the map
+	u8 *writes_pending;		// per chunk of the map, it isn't loaded again before they are done
+	bool *nav_dirty;		// per chunk of the map, waiting to be copied into the navigation grid
+	i32 nav_dirty_count;
+	Stream_Slot *slots;		// per slot of the map
+
+	Stream_Job jobs[WORLD_STREAM_JOBS];
+	u32 sequence;
+	SDL_mutex *mutex;
+	SDL_sem *work;
+	SDL_atomic_t running;
+	SDL_Thread *threads[WORLD_STREAM_THREADS];
+
+	i32 load_radius;		// in chunks around the camera's
+	i32 keep_radius;
+	imem budget;			// bytes of resident chunks before the ones out of range are evicted
+	i32 max_activations;	// per frame
+	u32 epoch;				// changes whenever the stream creates or destroys entities
+
+	World_Stream_Stats stats;
+};
+
+inline i32 chunk_distance(Tilemap *map, i32 chunk, V2i center)
+{
+	return Max(SDL_abs(chunk % map->chunks_x - center.x), SDL_abs(chunk / map->chunks_x - center.y));
+}
+
+inline V2i chunk_at(Tilemap *map, V2 pos)
+{
+	V2 p = (pos - map->origin) / (r32) TILE_CHUNK_PIXELS;
+	return V2i((i32) floorf(p.x), (i32) floorf(p.y));
+}
+
+////////////////////////////////////////
+//				World file
+
+bool read_chunk_record(SDL_RWops *file, i32 chunk, Chunk_Record *record)
+{
+	if (SDL_RWseek(file, sizeof(World_File_Header) + (Sint64) chunk * sizeof(Chunk_Record), RW_SEEK_SET) < 0)
+		return false;
+	if (SDL_RWread(file, record, sizeof(*record), 1) != 1)
+		return false;
+	for (i32 i = 0; i < TILE_CHUNK_SIZE * TILE_CHUNK_SIZE; ++i) {
+		if (record->tiles[i] >= COUNT_TILE_KIND)
+			record->tiles[i] = TILE_EMPTY;
+	}
+	record->spawn_count = Min(record->spawn_count, (u32) MAX_CHUNK_SPAWNS);
+	return true;
+}
+
+bool write_chunk_record(SDL_RWops *file, i32 chunk, Chunk_Record *record)
+{
+	if (SDL_RWseek(file, sizeof(World_File_Header) + (Sint64) chunk * sizeof(Chunk_Record), RW_SEEK_SET) < 0)
+		return false;
+	return SDL_RWwrite(file, record, sizeof(*record), 1) == 1;
+}
+
+// Whether path is a world file of the map's size
+bool check_world_file(Tilemap *map, const char *path)
+{
+	SDL_RWops *file = SDL_RWFromFile(path, "rb");
+	if (!file)
+		return false;
+	World_File_Header header;
+	bool ok = SDL_RWread(file, &header, sizeof(header), 1) == 1;
+	Sint64 size = SDL_RWsize(file);
+	SDL_RWclose(file);
+	if (!ok || header.magic != WORLD_FILE_MAGIC || header.version != WORLD_FILE_VERSION) {
+		SDL_Log("%s: not a world file or an unsupported version", path);
+		return false;
+	}
+	if (header.chunks_x != map->chunks_x || header.chunks_y != map->chunks_y ||
+		size != (Sint64) (sizeof(header) + map->chunks_x * map->chunks_y * sizeof(Chunk_Record))) {
+		SDL_Log("%s: world is %dx%d chunks, expected %dx%d", path, header.chunks_x, header.chunks_y, map->chunks_x, map->chunks_y);
+		return false;
+	}
+	return true;
+}
+
+// Makes up caves the size of the map with a few enemies in them, for when there is no world file
+// yet. Runs on the main thread at startup, the whole map is in memory while it does
+bool create_world_file(Tilemap *map, Memory_Arena *arena, const char *path, Random_Series *random,
+					   V2 clear_center, r32 clear_radius)
+{
+	Temp_Memory temp = begin_temp_memory(arena);
+	Defer(end_temp_memory(temp));
+
+	Tilemap caves;
+	tilemap_init(&caves, arena, map->chunks_x, map->chunks_y, map->origin, map->chunks_x * map->chunks_y);
+	make_all_chunks_resident(&caves);
+	generate_cave_tilemap(&caves, arena, random, 0.45f, 5, clear_center, clear_radius);
+
+	SDL_RWops *file = SDL_RWFromFile(path, "wb");
+	if (!file)
+		return false;
+	World_File_Header header = { WORLD_FILE_MAGIC, WORLD_FILE_VERSION, map->chunks_x, map->chunks_y, map->origin };
+	bool written = SDL_RWwrite(file, &header, sizeof(header), 1) == 1;
+
+	Chunk_Record *record = PushStruct(arena, Chunk_Record);
+	for (i32 i = 0; written && i < map->chunks_x * map->chunks_y; ++i) {
+		Tile_Chunk *chunk = &caves.chunks[caves.resident[i]];
+		SDL_memcpy(record->tiles, chunk->tiles, sizeof(record->tiles));
+
+		// a couple of enemies on the floor of the chunk, none right next to the spawn
+		record->spawn_count = 0;
+		i32 attempts = random_choice(random, 3);
+		for (i32 a = 0; a < attempts; ++a) {
+			i32 t = random_choice(random, TILE_CHUNK_SIZE * TILE_CHUNK_SIZE);
+			i32 x = (i % map->chunks_x) * TILE_CHUNK_SIZE + t % TILE_CHUNK_SIZE;
+			i32 y = (i / map->chunks_x) * TILE_CHUNK_SIZE + t / TILE_CHUNK_SIZE;
+			V2 pos = map->origin + (V2((r32) x, (r32) y) + V2(0.5f)) * (r32) TILE_SIZE;
+			if (chunk->tiles[t] == TILE_FLOOR && length(pos - clear_center) > clear_radius)
+				record->spawns[record->spawn_count++] = { pos };
+		}
+		written = write_chunk_record(file, i, record);
+	}
+	SDL_RWclose(file);
+	return written;
+}
+
+//				World file
+////////////////////////////////////////
+
+////////////////////////////////////////
+//				Loader threads
+
+int world_stream_thread(void *data)
+{
+	World_Stream *stream = (World_Stream *) data;
+	set_profile_thread_name("world stream");
+	while (SDL_AtomicGet(&stream->running)) {
+		// time out every now and then to notice when we should stop
+		SDL_SemWaitTimeout(stream->work, 100);
+
+		while (SDL_AtomicGet(&stream->running)) {
+			// The oldest queued job, but never two jobs on the same chunk at once so that writes
+			// land in order and a load can't overtake a write
+			SDL_LockMutex(stream->mutex);
+			Stream_Job *job = nullptr;
+			for (i32 i = 0; i < WORLD_STREAM_JOBS; ++i) {
+				Stream_Job *candidate = &stream->jobs[i];
+				if (candidate->state != STREAM_JOB_QUEUED || (job && (i32) (candidate->sequence - job->sequence) > 0))
+					continue;
+				bool busy = false;
+				for (i32 j = 0; j < WORLD_STREAM_JOBS && !busy; ++j) {
+					busy = stream->jobs[j].state == STREAM_JOB_RUNNING && stream->jobs[j].chunk == candidate->chunk;
+				}
+				if (!busy)
+					job = candidate;
+			}
+			if (job)
+				job->state = STREAM_JOB_RUNNING;
+			SDL_UnlockMutex(stream->mutex);
+			if (!job)
+				break;
+
+			// opened per job, so that a write is on disk before the next job on the chunk runs
+			u64 start = SDL_GetPerformanceCounter();
+			SDL_RWops *file = SDL_RWFromFile(stream->path, job->kind == STREAM_JOB_LOAD ? "rb" : "r+b");
+			bool ok = false;
+			if (file) {
+				if (job->kind == STREAM_JOB_LOAD)
+					ok = read_chunk_record(file, job->chunk, &job->record);
+				else
+					ok = write_chunk_record(file, job->chunk, &job->record);
+				SDL_RWclose(file);
+			}
+			job->io_counter = SDL_GetPerformanceCounter() - start;
+
+			SDL_LockMutex(stream->mutex);
+			job->ok = ok;
+			job->state = STREAM_JOB_DONE;
+			SDL_UnlockMutex(stream->mutex);
+		}
+	}
+	return 0;
+}
+
+// The file has to exist already, see check_world_file and create_world_file
+void world_stream_init(World_Stream *stream, Memory_Arena *arena, const char *path, Tilemap *map,
+					   Static_Geometry *geometry, Flow_Field_Builder *flow_builder, World *world,
+					   Animation *enemy_animation, V2 enemy_size)
+{
+	*stream = {};
+	stream->path = path;
+	stream->map = map;
+	stream->geometry = geometry;
+	stream->flow_builder = flow_builder;
+	stream->world = world;
+	stream->enemy_animation = enemy_animation;
+	stream->enemy_size = enemy_size;
+
+	i32 chunk_count = map->chunks_x * map->chunks_y;
+	stream->states = PushArray(arena, u8, chunk_count);
+	stream->writes_pending = PushArray(arena, u8, chunk_count);
+	stream->nav_dirty = PushArray(arena, bool, chunk_count);
+	stream->slots = PushArray(arena, Stream_Slot, map->chunk_capacity);
+
+	stream->load_radius = 3;
+	stream->keep_radius = 5;
+	stream->budget = 96 * (sizeof(Tile_Chunk) + Kilobytes(2));
+	stream->max_activations = 8;
+
+	stream->mutex = SDL_CreateMutex();
+	stream->work = SDL_CreateSemaphore(0);
+	if (!stream->mutex || !stream->work) {
+		fatal_error(SDL_GetError());
+	}
+	SDL_AtomicSet(&stream->running, 1);
+	for (i32 i = 0; i < WORLD_STREAM_THREADS; ++i) {
+		stream->threads[i] = SDL_CreateThread(world_stream_thread, "world stream", stream);
+		if (!stream->threads[i]) {
+			fatal_error(SDL_GetError());
+		}
+	}
+}
+
+// Waits for the writes in flight, edits that were never written back are lost
+void world_stream_shutdown(World_Stream *stream)
+{
+	while (true) {
+		bool pending = false;
+		SDL_LockMutex(stream->mutex);
+		for (i32 i = 0; i < WORLD_STREAM_JOBS && !pending; ++i) {
+			Stream_Job *job = &stream->jobs[i];
+			pending = job->kind == STREAM_JOB_WRITE && (job->state == STREAM_JOB_QUEUED || job->state == STREAM_JOB_RUNNING);
+		}
+		SDL_UnlockMutex(stream->mutex);
+		if (!pending)
+			break;
+		SDL_Delay(1);
+	}
+
+	SDL_AtomicSet(&stream->running, 0);
+	for (i32 i = 0; i < WORLD_STREAM_THREADS; ++i) {
+		SDL_SemPost(stream->work);
+	}
+	for (i32 i = 0; i < WORLD_STREAM_THREADS; ++i) {
+		SDL_WaitThread(stream->threads[i], nullptr);
+	}
+	SDL_DestroySemaphore(stream->work);
+	SDL_DestroyMutex(stream->mutex);
+}
+
+// A free job for the main thread to fill in and queue, nullptr when they are all in use
+Stream_Job *acquire_stream_job(World_Stream *stream, Stream_Job_Kind kind, i32 chunk)
+{
+	Stream_Job *job = nullptr;
+	SDL_LockMutex(stream->mutex);
+	for (i32 i = 0; i < WORLD_STREAM_JOBS && !job; ++i) {
+		if (stream->jobs[i].state == STREAM_JOB_FREE)
+			job = &stream->jobs[i];
+	}
+	SDL_UnlockMutex(stream->mutex);
+	if (job) {
+		job->kind = kind;
+		job->chunk = chunk;
+		job->ok = false;
+		job->requested_counter = SDL_GetPerformanceCounter();
+	}
+	return job;
+}
+
+void queue_stream_job(World_Stream *stream, Stream_Job *job)
+{
+	SDL_LockMutex(stream->mutex);
+	job->sequence = stream->sequence++;
+	job->state = STREAM_JOB_QUEUED;
+	SDL_UnlockMutex(stream->mutex);
+	SDL_SemPost(stream->work);
+}
+
+inline void release_stream_job(World_Stream *stream, Stream_Job *job)
+{
+	SDL_LockMutex(stream->mutex);
+	job->state = STREAM_JOB_FREE;
+	SDL_UnlockMutex(stream->mutex);
+	job->ready = false;
+}
+
+//				Loader threads
+////////////////////////////////////////
+
+////////////////////////////////////////
+//				Residency
+
+inline void mark_chunk_nav_dirty(World_Stream *stream, i32 chunk)
+{
+	if (!stream->nav_dirty[chunk]) {
+		stream->nav_dirty[chunk] = true;
+		stream->nav_dirty_count++;
+	}
+}
+
+void activate_chunk(World_Stream *stream, Stream_Job *job)
+{
+	Tilemap *map = stream->map;
+	i32 cx = job->chunk % map->chunks_x, cy = job->chunk / map->chunks_x;
+	Tile_Chunk *chunk = add_resident_chunk(map, cx, cy);
+	assert(chunk);
+	SDL_memcpy(chunk->tiles, job->record.tiles, sizeof(chunk->tiles));
+	autotile_chunk(map, cx, cy);
+	mark_static_chunk_dirty(stream->geometry, cx, cy);
+	mark_chunk_nav_dirty(stream, job->chunk);
+
+	Stream_Slot *slot = &stream->slots[map->resident[job->chunk]];
+	slot->spawn_count = job->record.spawn_count;
+	SDL_memcpy(slot->spawns, job->record.spawns, sizeof(slot->spawns));
+	slot->entity_count = 0;
+	for (u32 i = 0; i < slot->spawn_count; ++i) {
+		Entity enemy = spawn_enemy(stream->world, stream->enemy_animation, slot->spawns[i].pos - stream->enemy_size / 2);
+		slot->entities[slot->entity_count++] = enemy;
+	}
+
+	stream->states[job->chunk] = CHUNK_ACTIVE;
+	stream->epoch++;
+	stream->stats.activations++;
+	stream->stats.peak_latency_ms = Max(stream->stats.peak_latency_ms, counter_to_ms(SDL_GetPerformanceCounter() - job->requested_counter));
+}
+
+// Writes the resident chunk back to the world file, false when no job is free for it right now
+bool write_back_chunk(World_Stream *stream, i32 chunk_index)
+{
+	Tilemap *map = stream->map;
+	i32 slot_index = map->resident[chunk_index];
+	Stream_Job *job = acquire_stream_job(stream, STREAM_JOB_WRITE, chunk_index);
+	if (!job)
+		return false;
+	Tile_Chunk *chunk = &map->chunks[slot_index];
+	Stream_Slot *slot = &stream->slots[slot_index];
+	SDL_memcpy(job->record.tiles, chunk->tiles, sizeof(job->record.tiles));
+	job->record.spawn_count = slot->spawn_count;
+	SDL_memcpy(job->record.spawns, slot->spawns, sizeof(job->record.spawns));
+	chunk->modified = false;
+	stream->writes_pending[chunk_index]++;
+	queue_stream_job(stream, job);
+	return true;
+}
+
+// False when the chunk was edited and can't be written back right now, it stays resident then
+bool evict_chunk(World_Stream *stream, i32 chunk_index)
+{
+	Tilemap *map = stream->map;
+	i32 slot_index = map->resident[chunk_index];
+	if (map->chunks[slot_index].modified && !write_back_chunk(stream, chunk_index))
+		return false;
+
+	Stream_Slot *slot = &stream->slots[slot_index];
+	for (u32 i = 0; i < slot->entity_count; ++i) {
+		destroy_entity(stream->world, slot->entities[i]);
+	}
+	slot->entity_count = 0;
+	stream->epoch++;
+
+	i32 cx = chunk_index % map->chunks_x, cy = chunk_index / map->chunks_x;
+	release_static_chunk(stream->geometry, cx, cy);
+	remove_resident_chunk(map, cx, cy);
+	mark_static_chunk_dirty(stream->geometry, cx, cy);
+	mark_chunk_nav_dirty(stream, chunk_index);
+	stream->states[chunk_index] = CHUNK_UNLOADED;
+	stream->stats.evictions++;
+	return true;
+}
+
+// Adds an enemy spawn to the chunk under pos, for the editor. False when the chunk isn't active
+// or already full
+bool add_chunk_spawn(World_Stream *stream, V2 pos)
+{
+	Tilemap *map = stream->map;
+	V2i c = chunk_at(map, pos);
+	i32 slot_index = resident_slot(map, c.x, c.y);
+	if (slot_index == TILE_NOT_RESIDENT)
+		return false;
+	Stream_Slot *slot = &stream->slots[slot_index];
+	if (slot->spawn_count >= MAX_CHUNK_SPAWNS)
+		return false;
+	slot->spawns[slot->spawn_count++] = { pos };
+	slot->entities[slot->entity_count++] = spawn_enemy(stream->world, stream->enemy_animation, pos - stream->enemy_size / 2);
+	stream->epoch++;
+	map->chunks[slot_index].modified = true;
+	return true;
+}
+
+// Writes every edited chunk back without waiting, returns how many are on their way
+i32 save_world_stream(World_Stream *stream)
+{
+	Tilemap *map = stream->map;
+	i32 saved = 0;
+	for (i32 i = 0; i < map->chunk_capacity; ++i) {
+		Tile_Chunk *chunk = &map->chunks[i];
+		if (chunk->index != TILE_NOT_RESIDENT && chunk->modified && write_back_chunk(stream, chunk->index))
+			saved++;
+	}
+	return saved;
+}
+
+// Copies the chunks that came and went into the navigation grid, once the flow field isn't
+// being built from it
+void sync_stream_navigation(World_Stream *stream)
+{
+	if (stream->nav_dirty_count == 0)
+		return;
+	Nav_Grid *grid = try_edit_nav_grid(stream->flow_builder);
+	if (!grid)
+		return;
+	Tilemap *map = stream->map;
+	for (i32 i = 0; i < map->chunks_x * map->chunks_y && stream->nav_dirty_count > 0; ++i) {
+		if (!stream->nav_dirty[i])
+			continue;
+		V2i min = V2i(i % map->chunks_x * TILE_CHUNK_SIZE, i / map->chunks_x * TILE_CHUNK_SIZE);
+		tiles_to_nav_grid(map, grid, min, min + V2i(TILE_CHUNK_SIZE - 1, TILE_CHUNK_SIZE - 1));
+		stream->nav_dirty[i] = false;
+		stream->nav_dirty_count--;
+	}
+}
+
+struct Stream_Candidate {
+	i32 chunk;
+	i32 distance;
+};
+
+// farthest first
+int compare_stream_candidates(const void *a, const void *b)
+{
+	return ((Stream_Candidate *) b)->distance - ((Stream_Candidate *) a)->distance;
+}
+
+// Call once per frame, before anything holds on to components: entities of evicted chunks are
+// destroyed and the ones of activated chunks created. Never waits on the loaders
+void update_world_stream(World_Stream *stream, Memory_Arena *scratch, V2 camera, Rect view)
+{
+	Temp_Memory temp = begin_temp_memory(scratch);
+	Defer(end_temp_memory(temp));
+
+	u64 start = SDL_GetPerformanceCounter();
+	Tilemap *map = stream->map;
+	World_Stream_Stats *stats = &stream->stats;
+	V2i center = chunk_at(map, camera);
+
+	// take in what the loaders finished
+	Stream_Job *finished[WORLD_STREAM_JOBS];
+	i32 finished_count = 0;
+	SDL_LockMutex(stream->mutex);
+	for (i32 i = 0; i < WORLD_STREAM_JOBS; ++i) {
+		if (stream->jobs[i].state == STREAM_JOB_DONE) {
+			stream->jobs[i].state = STREAM_JOB_FINISHED;
+			finished[finished_count++] = &stream->jobs[i];
+		}
+	}
+	SDL_UnlockMutex(stream->mutex);
+
+	for (i32 i = 0; i < finished_count; ++i) {
+		Stream_Job *job = finished[i];
+		stats->io_ms += counter_to_ms(job->io_counter);
+		if (job->kind == STREAM_JOB_WRITE) {
+			if (!job->ok) {
+				SDL_Log("World stream: could not write chunk %d to %s", job->chunk, stream->path);
+				stats->failures++;
+			}
+			stream->writes_pending[job->chunk]--;
+			stats->writes++;
+			release_stream_job(stream, job);
+			continue;
+		}
+		if (!job->ok) {
+			// better an empty chunk than asking for it again every frame
+			SDL_Log("World stream: could not read chunk %d from %s", job->chunk, stream->path);
+			SDL_memset(&job->record, 0, sizeof(job->record));
+			stats->failures++;
+		}
+		stats->loads++;
+		job->ready = true;
+	}
+
+	i32 ready = 0;
+	for (i32 i = 0; i < WORLD_STREAM_JOBS; ++i) {
+		Stream_Job *job = &stream->jobs[i];
+		if (!job->ready)
+			continue;
+		if (chunk_distance(map, job->chunk, center) > stream->keep_radius) {
+			// the camera moved on while it was loading
+			stream->states[job->chunk] = CHUNK_UNLOADED;
+			stats->cancels++;
+			release_stream_job(stream, job);
+			continue;
+		}
+		ready++;
+	}
+
+	// Evict the farthest chunks out of range, while over budget or when there are loads to
+	// activate and no slots to put them in
+	Stream_Candidate *candidates = PushArrayNoZero(scratch, Stream_Candidate, map->chunk_capacity);
+	i32 candidate_count = 0;
+	stats->resident_bytes = 0;
+	for (i32 i = 0; i < map->chunk_capacity; ++i) {
+		Tile_Chunk *chunk = &map->chunks[i];
+		if (chunk->index == TILE_NOT_RESIDENT)
+			continue;
+		stats->resident_bytes += sizeof(Tile_Chunk) + static_chunk_bytes(&stream->geometry->chunks[i]);
+		i32 distance = chunk_distance(map, chunk->index, center);
+		if (distance > stream->load_radius)
+			candidates[candidate_count++] = { chunk->index, distance };
+	}
+	SDL_qsort(candidates, candidate_count, sizeof(Stream_Candidate), compare_stream_candidates);
+	for (i32 i = 0; i < candidate_count; ++i) {
+		i32 chunk_index = candidates[i].chunk;
+		i32 slot_index = map->resident[chunk_index];
+		bool over_budget = stats->resident_bytes > stream->budget && candidates[i].distance > stream->keep_radius;
+		bool need_slot = map->chunk_capacity - map->resident_count < Min(ready, stream->max_activations);
+		if (!over_budget && !need_slot)
+			break;
+		imem bytes = sizeof(Tile_Chunk) + static_chunk_bytes(&stream->geometry->chunks[slot_index]);
+		if (evict_chunk(stream, chunk_index))
+			stats->resident_bytes -= bytes;
+	}
+
+	// activate finished loads, nearest first
+	for (i32 activated = 0; activated < stream->max_activations && map->resident_count < map->chunk_capacity; ++activated) {
+		Stream_Job *nearest = nullptr;
+		for (i32 i = 0; i < WORLD_STREAM_JOBS; ++i) {
+			Stream_Job *job = &stream->jobs[i];
+			if (job->ready && (!nearest || chunk_distance(map, job->chunk, center) < chunk_distance(map, nearest->chunk, center)))
+				nearest = job;
+		}
+		if (!nearest)
+			break;
+		activate_chunk(stream, nearest);
+		release_stream_job(stream, nearest);
+	}
+
+	// cancel the loads that haven't started and aren't needed anymore
+	SDL_LockMutex(stream->mutex);
+	for (i32 i = 0; i < WORLD_STREAM_JOBS; ++i) {
+		Stream_Job *job = &stream->jobs[i];
+		if (job->state == STREAM_JOB_QUEUED && job->kind == STREAM_JOB_LOAD && chunk_distance(map, job->chunk, center) > stream->keep_radius) {
+			job->state = STREAM_JOB_FREE;
+			stream->states[job->chunk] = CHUNK_UNLOADED;
+			stats->cancels++;
+		}
+	}
+	SDL_UnlockMutex(stream->mutex);
+
+	// request what's missing in range, ring by ring from the camera's chunk
+	bool jobs_left = true;
+	for (i32 radius = 0; radius <= stream->load_radius && jobs_left; ++radius) {
+		for (i32 cy = center.y - radius; cy <= center.y + radius && jobs_left; ++cy) {
+			for (i32 cx = center.x - radius; cx <= center.x + radius; ++cx) {
+				bool on_ring = SDL_abs(cx - center.x) == radius || SDL_abs(cy - center.y) == radius;
+				if (!on_ring || cx < 0 || cy < 0 || cx >= map->chunks_x || cy >= map->chunks_y)
+					continue;
+				i32 chunk_index = cy * map->chunks_x + cx;
+				if (stream->states[chunk_index] != CHUNK_UNLOADED || stream->writes_pending[chunk_index])
+					continue;
+				Stream_Job *job = acquire_stream_job(stream, STREAM_JOB_LOAD, chunk_index);
+				jobs_left = job != nullptr;
+				if (!job)
+					break;
+				stream->states[chunk_index] = CHUNK_LOADING;
+				queue_stream_job(stream, job);
+				stats->requests++;
+			}
+		}
+	}
+
+	sync_stream_navigation(stream);
+
+	stats->resident_chunks = (u32) map->resident_count;
+	V2i view_min = chunk_at(map, view.min), view_max = chunk_at(map, view.max);
+	stats->stalled_chunks = 0;
+	for (i32 cy = Max(view_min.y, 0); cy <= Min(view_max.y, map->chunks_y - 1); ++cy) {
+		for (i32 cx = Max(view_min.x, 0); cx <= Min(view_max.x, map->chunks_x - 1); ++cx) {
+			stats->stalled_chunks += stream->states[cy * map->chunks_x + cx] != CHUNK_ACTIVE;
+		}
+	}
+	if (stats->stalled_chunks)
+		stats->stall_frames++;
+
+	stats->update_ms = counter_to_ms(SDL_GetPerformanceCounter() - start);
+	stats->peak_update_ms = Max(stats->peak_update_ms, stats->update_ms);
+}
+
+// At startup, when there is no frame to keep going: streams until everything in view is active
+void finish_world_stream_loads(World_Stream *stream, Memory_Arena *scratch, V2 camera, Rect view)
+{
+	while (true) {
+		update_world_stream(stream, scratch, camera, view);
+		if (stream->stats.stalled_chunks == 0)
+			break;
+		SDL_Delay(1);
+	}
+}
+
+// For recording and replaying input, where the same chunks have to be active at the same tick
+// whatever the loaders were up to: streams until everything the camera asks for is active,
+// waiting for the loaders after each update so that the next one sees all of their work done
+void settle_world_stream(World_Stream *stream, Memory_Arena *scratch, V2 camera, Rect view)
+{
+	World_Stream_Stats *stats = &stream->stats;
+	while (true) {
+		u32 progress = stats->requests + stats->activations + stats->cancels;
+		update_world_stream(stream, scratch, camera, view);
+		bool in_flight = true;
+		while (in_flight) {
+			in_flight = false;
+			SDL_LockMutex(stream->mutex);
+			for (i32 i = 0; i < WORLD_STREAM_JOBS; ++i) {
+				Stream_Job_State state = stream->jobs[i].state;
+				in_flight = in_flight || state == STREAM_JOB_QUEUED || state == STREAM_JOB_RUNNING;
+			}
+			SDL_UnlockMutex(stream->mutex);
+			if (in_flight)
+				SDL_Delay(1);
+		}
+		if (stats->requests + stats->activations + stats->cancels == progress)
+			break;
+	}
+}
+
+//				Residency
+////////////////////////////////////////
+
+////////////////////////////////////////
+//				Fly-through
+//
+// The camera flies from one corner of the world to the opposite one at a fixed speed while
+// every frame time is recorded. Frames over twice the median are hitches.
+
+constexpr i32 MAX_FLY_THROUGH_FRAMES = 8192;
+
+struct Fly_Through {
+	bool active;
+	V2 from;
+	V2 to;
+	r32 speed;
+	r32 elapsed;
+	r32 *frame_ms;
+	i32 frame_count;
+	World_Stream_Stats start_stats;
+};
+
+void start_fly_through(Fly_Through *fly, Memory_Arena *arena, World_Stream *stream, r32 speed)
+{
+	if (!fly->frame_ms)
+		fly->frame_ms = PushArrayNoZero(arena, r32, MAX_FLY_THROUGH_FRAMES);
+	Tilemap *map = stream->map;
+	V2 margin = V2(2.f * TILE_CHUNK_PIXELS);
+	fly->active = true;
+	fly->from = map->origin + margin;
+	fly->to = map->origin + V2((r32) map->width, (r32) map->height) * (r32) TILE_SIZE - margin;
+	fly->speed = speed;
+	fly->elapsed = 0;
+	fly->frame_count = 0;
+	fly->start_stats = stream->stats;
+	stream->stats.peak_update_ms = 0;
+	stream->stats.peak_latency_ms = 0;
+}
+
+int compare_frame_times(const void *a, const void *b)
+{
+	r32 x = *(r32 *) a, y = *(r32 *) b;
+	return (x > y) - (x < y);
+}
+
+// Moves the camera along, and logs the results when it arrived
+void update_fly_through(Fly_Through *fly, Memory_Arena *scratch, World_Stream *stream, r32 frame_time, V2 *camera)
+{
+	if (!fly->active)
+		return;
+	if (fly->frame_count < MAX_FLY_THROUGH_FRAMES)
+		fly->frame_ms[fly->frame_count++] = frame_time * 1000.f;
+	fly->elapsed += frame_time;
+	r32 distance = length(fly->to - fly->from);
+	r32 t = Min(fly->elapsed * fly->speed / distance, 1.f);
+	*camera = lerp(fly->from, t, fly->to);
+	if (t < 1.f)
+		return;
+
+	fly->active = false;
+	Temp_Memory temp = begin_temp_memory(scratch);
+	Defer(end_temp_memory(temp));
+
+	// the first frame is the one that started it
+	i32 count = fly->frame_count - 1;
+	if (count <= 0)
+		return;
+	r32 *sorted = PushArrayNoZero(scratch, r32, count);
+	SDL_memcpy(sorted, fly->frame_ms + 1, count * sizeof(r32));
+	SDL_qsort(sorted, count, sizeof(r32), compare_frame_times);
+	r64 sum = 0;
+	for (i32 i = 0; i < count; ++i) {
+		sum += sorted[i];
+	}
+	r32 median = sorted[count / 2];
+	i32 hitches = 0;
+	for (i32 i = 0; i < count; ++i) {
+		hitches += sorted[i] > 2 * median;
+	}
+
+	World_Stream_Stats *stats = &stream->stats;
+	World_Stream_Stats *before = &fly->start_stats;
+	SDL_Log("Fly-through: %d frames, avg %.2f ms, median %.2f, p99 %.2f, max %.2f, %d hitches",
+			count, sum / count, median, sorted[Min(count - 1, count * 99 / 100)], sorted[count - 1], hitches);
+	SDL_Log("Fly-through: %u chunks loaded, %u evicted, %u cancelled, %u stalled frames, stream update peak %.2f ms, "
+			"request to activation peak %.2f ms, %.2f ms of io",
+			stats->loads - before->loads, stats->evictions - before->evictions, stats->cancels - before->cancels,
+			stats->stall_frames - before->stall_frames, stats->peak_update_ms, stats->peak_latency_ms, stats->io_ms - before->io_ms);
+}
+
+//				Fly-through
+////////////////////////////////////////
@@ -0,0 +1,138 @@
+#pragma once
+
+// Procedural stress scenes.
+//
+// A seeded crowd around a point, to see how the systems hold up with more of everything than a
+// level has: actors playing the .anims the game loaded (the ones on the enemy animation get a
+// brain, the others wander in a straight line), colliders of every kind that stand still for the
+// rest to run into, and projectiles of every kind. Density is how many actors and colliders there
+// are per screen of area. The square they spawn in grows with their count, so that twice the
+// actors is twice the work instead of the same area packed twice as tight.
+//
+// The game spawns one around the player with --stress, bench --sweep builds one for every power
+// of two of actors and measures them (see bench/bench.cpp). Both read the same config:
+//		actors=4096,colliders=1024,projectiles=4096,density=64,seed=1
+
+struct Stress_Config {
+	u64 seed;
+	i32 actors;
+	i32 colliders;
+	i32 projectiles;
+	r32 density;		// actors and colliders per 1280x720 of area
+};
+
+constexpr Stress_Config DEFAULT_STRESS_CONFIG = { 1, 4096, 1024, 4096, 64.f };
+
+struct Stress_Scene {
+	Stress_Config config;
+	Random_Series random;
+	V2 center;
+	r32 extent;			// half the side of the square it spawned in
+	i32 brains;
+};
+
+// Changes what the text sets, "key=value" separated by commas
+bool parse_stress_config(String text, Stress_Config *config)
+{
+	while (text.len > 0) {
+		String value = string_chop_by_delim(&text, ',');
+		String key = string_trim(string_chop_by_delim(&value, '='));
+		value = string_trim(value);
+		if (key == "actors")
+			config->actors = string_parse_i32(value);
+		else if (key == "colliders")
+			config->colliders = string_parse_i32(value);
+		else if (key == "projectiles")
+			config->projectiles = string_parse_i32(value);
+		else if (key == "density")
+			config->density = string_parse_r32(value);
+		else if (key == "seed")
+			config->seed = (u64) string_parse_i64(value);
+		else {
+			SDL_SetError("Unknown stress setting \"%.*s\"", (int) key.len, key.data);
+			return false;
+		}
+	}
+	// the player and whatever the level spawns need room too
+	if (config->actors < 0 || config->colliders < 0 || config->projectiles < 0 ||
+		config->actors + config->colliders > (i32) MAX_ENTITIES / 2 || !(config->density > 0)) {
+		SDL_SetError("Stress settings out of range");
+		return false;
+	}
+	return true;
+}
+
+inline r32 stress_extent(Stress_Config *config)
+{
+	r32 screens = (config->actors + config->colliders) / config->density;
+	return sqrtf(Max(screens, 1.f) * 1280.f * 720.f) / 2.f;
+}
+
+inline V2 random_stress_point(Stress_Scene *scene)
+{
+	return scene->center + V2(random_bilateral(&scene->random), random_bilateral(&scene->random)) * scene->extent;
+}
+
+// Stops early when the pool is full
+void spawn_stress_projectiles(Stress_Scene *scene, Projectile_Pool *projectiles, i32 count)
+{
+	for (i32 i = 0; i < count && projectiles->count < projectiles->capacity; ++i) {
+		// everything before the effects
+		Projectile_Kind kind = (Projectile_Kind) random_choice(&scene->random, EFFECT_HIT_SPARK);
+		r32 angle = random_between(&scene->random, 0, 2 * PI32);
+		V2 vel = V2(cosf(angle), sinf(angle)) * random_between(&scene->random, 150.f, 600.f);
+		spawn_projectile(projectiles, kind, random_stress_point(scene), vel);
+	}
+}
+
+// Projectiles expire, this brings them back to the configured count
+inline void refill_stress_projectiles(Stress_Scene *scene, Projectile_Pool *projectiles)
+{
+	spawn_stress_projectiles(scene, projectiles, scene->config.projectiles - (i32) projectiles->count);
+}
+
+void spawn_stress_scene(Stress_Scene *scene, Stress_Config *config, World *world, Projectile_Pool *projectiles,
+						Animation **animations, i32 animation_count, Animation *enemy_animation, V2 center)
+{
+	*scene = {};
+	scene->config = *config;
+	scene->random = random_seed(config->seed);
+	scene->center = center;
+	scene->extent = stress_extent(config);
+	Random_Series *random = &scene->random;
+
+	for (i32 i = 0; i < config->actors; ++i) {
+		Animation *animation = animations[i % animation_count];
+		V2 size = V2(2.f * animation->width, 2.f * animation->height);
+		V2 pos = random_stress_point(scene) - size / 2;
+		if (animation == enemy_animation) {
+			spawn_enemy(world, animation, pos);
+			scene->brains++;
+			continue;
+		}
+		Entity actor = create_entity(world);
+		r32 angle = random_between(random, 0, 2 * PI32);
+		Animation_Playback playback = make_animation_playback(animation);
+		playback.time = random_between(random, 0, animation->frame_duration);
+		add_component(world, &world->transforms, actor, { pos, size });
+		add_component(world, &world->velocities, actor, { V2(), V2(cosf(angle), sinf(angle)), random_between(random, 50.f, 200.f) });
+		add_component(world, &world->sprites, actor, { playback, angle > PI32 / 2 && angle < 3 * PI32 / 2 });
+		add_component(world, &world->colliders, actor, { COLLIDER_CAPSULE, V2(0.5f, 0.375f), V2(0.5f, 0.775f), 0.2f });
+	}
+
+	// rects and upright capsules as wide as their transform, 16 to 128 units
+	for (i32 i = 0; i < config->colliders; ++i) {
+		Entity prop = create_entity(world);
+		V2 size = V2(random_between(random, 16.f, 128.f), random_between(random, 16.f, 128.f));
+		add_component(world, &world->transforms, prop, { random_stress_point(scene) - size / 2, size });
+		if (i % 2 == 0) {
+			add_component(world, &world->colliders, prop, { COLLIDER_RECT, V2(0, 0), V2(1, 1), 0.f });
+		} else {
+			// the radius is a fraction of the width, the end points of the height
+			r32 end = Min(0.5f, 0.5f * size.x / size.y);
+			add_component(world, &world->colliders, prop, { COLLIDER_CAPSULE, V2(0.5f, end), V2(0.5f, 1.f - end), 0.5f });
+		}
+	}
+
+	spawn_stress_projectiles(scene, projectiles, config->projectiles);
+}
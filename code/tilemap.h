@@ -0,0 +1,574 @@
+#pragma once
+
+// Tile based level, stored in square chunks of tiles.
+//
+// Tiles blend into their neighbours through autotiling: every tile keeps a bitmask of which of
+// its four neighbours are of the same kind, and the mask picks the tileset variant to draw (edges
+// only show on the sides facing something else). Masks are computed once for a chunk when it is
+// loaded, after that an edit only recomputes the edited tile and its four neighbours.
+//
+// Drawing thousands of tiles one by one every frame is slow, so each chunk is drawn once into a
+// texture of its own and the screen is a handful of chunk textures. A chunk is only drawn again
+// when an edit changed its version. The textures come from a small cache shared by every chunk,
+// handed to the chunks on screen and taken back from the ones that weren't drawn for the longest
+// time. The cache belongs to the render thread (see render_thread.h): the main thread only puts
+// a copy of each visible chunk in the render list, and the render thread draws that copy into the
+// chunk's texture when the version it has is out of date.
+//
+// Only some of the chunks have their tiles in memory at a time (see streaming.h), in a fixed set
+// of slots. Everything outside of them reads as empty.
+
+enum Tile_Kind : u8 {
+	TILE_EMPTY,
+	TILE_FLOOR,
+	TILE_WALL,
+
+	COUNT_TILE_KIND,
+};
+
+struct Tile_Type {
+	const char *name;
+	u32 color;
+	u32 edge_color;		// drawn on the sides that face another kind
+	bool blocks;		// for navigation
+};
+
+constexpr Tile_Type tile_types[COUNT_TILE_KIND] = {
+	{ "empty", 0x00000000, 0x00000000, false },
+	{ "floor", 0x3a3a44ff, 0x2a2a32ff, false },
+	{ "wall",  0x6a5a4aff, 0x2a1e14ff, true  },
+};
+
+constexpr i32 TILE_SIZE = 32;			// pixels
+constexpr i32 TILE_CHUNK_SIZE = 16;		// tiles
+constexpr i32 TILE_CHUNK_PIXELS = TILE_SIZE * TILE_CHUNK_SIZE;
+constexpr i32 TILE_CACHE_SIZE = 48;		// chunk textures, a 1440p screen shows at most 24 chunks
+constexpr i32 TILE_NOT_RESIDENT = -1;
+
+// neighbours of the same kind, 16 variants per kind in the tileset
+enum : u8 {
+	TILE_NEIGHBOUR_UP = 1 << 0,
+	TILE_NEIGHBOUR_RIGHT = 1 << 1,
+	TILE_NEIGHBOUR_DOWN = 1 << 2,
+	TILE_NEIGHBOUR_LEFT = 1 << 3,
+};
+
+struct Tile_Chunk {
+	Tile_Kind tiles[TILE_CHUNK_SIZE * TILE_CHUNK_SIZE];
+	u8 masks[TILE_CHUNK_SIZE * TILE_CHUNK_SIZE];
+	i32 index;			// of the chunk of the map in this slot, TILE_NOT_RESIDENT while the slot is free
+	u16 tile_count;		// not empty, empty chunks don't need a texture at all
+	u32 version;		// changes with the tiles or masks, textures drawn from an older one are out of date
+	bool modified;		// edited since it was loaded or saved
+};
+
+// What the render thread gets of a chunk
+struct Tile_Chunk_Image {
+	Tile_Kind tiles[TILE_CHUNK_SIZE * TILE_CHUNK_SIZE];
+	u8 masks[TILE_CHUNK_SIZE * TILE_CHUNK_SIZE];
+	i32 chunk;			// of the map
+	u32 version;
+	V2 corner;			// on screen
+};
+
+struct Tile_Cache_Slot {
+	SDL_Texture *texture;
+	i32 chunk;			// of the map, -1 while free
+	u32 version;		// the texture was drawn from
+	u32 last_used;		// frame
+};
+
+struct Tilemap_Stats {
+	u32 chunks_drawn;
+	u32 chunks_rebuilt;
+	u32 tiles_drawn;	// one by one, either into chunk textures or straight to the screen
+	r32 rebuild_ms;
+	r32 draw_ms;		// including the rebuilds
+	r32 peak_rebuild_ms;
+};
+
+struct Tilemap {
+	i32 width;			// in tiles
+	i32 height;
+	i32 chunks_x;
+	i32 chunks_y;
+	V2 origin;			// world position of the top left corner
+	i32 *resident;		// per chunk of the map, its slot in chunks or TILE_NOT_RESIDENT
+	Tile_Chunk *chunks;	// slots
+	i32 chunk_capacity;
+	i32 resident_count;
+	u32 last_version;
+};
+
+// Chunk textures, only touched by the thread that renders
+struct Tile_Cache {
+	SDL_Texture *tileset;
+	Tile_Cache_Slot slots[TILE_CACHE_SIZE];
+	bool use_cache;		// false when the renderer can't render to textures, tiles are drawn directly then
+	u32 frame;
+	Tilemap_Stats stats;
+};
+
+// At most chunk_capacity chunks are resident at once, none to begin with
+void tilemap_init(Tilemap *map, Memory_Arena *arena, i32 chunks_x, i32 chunks_y, V2 origin, i32 chunk_capacity)
+{
+	*map = {};
+	map->chunks_x = chunks_x;
+	map->chunks_y = chunks_y;
+	map->width = chunks_x * TILE_CHUNK_SIZE;
+	map->height = chunks_y * TILE_CHUNK_SIZE;
+	map->origin = origin;
+	map->resident = PushArrayNoZero(arena, i32, chunks_x * chunks_y);
+	for (i32 i = 0; i < chunks_x * chunks_y; ++i) {
+		map->resident[i] = TILE_NOT_RESIDENT;
+	}
+	map->chunks = PushArray(arena, Tile_Chunk, chunk_capacity);
+	map->chunk_capacity = chunk_capacity;
+	for (i32 i = 0; i < chunk_capacity; ++i) {
+		map->chunks[i].index = TILE_NOT_RESIDENT;
+	}
+}
+
+inline void touch_chunk(Tilemap *map, Tile_Chunk *chunk)
+{
+	chunk->version = ++map->last_version;
+}
+
+inline bool tile_in_bounds(Tilemap *map, i32 x, i32 y)
+{
+	return x >= 0 && y >= 0 && x < map->width && y < map->height;
+}
+
+// Slot of chunk (cx, cy), TILE_NOT_RESIDENT when it isn't in memory or outside the map
+inline i32 resident_slot(Tilemap *map, i32 cx, i32 cy)
+{
+	if (cx < 0 || cy < 0 || cx >= map->chunks_x || cy >= map->chunks_y)
+		return TILE_NOT_RESIDENT;
+	return map->resident[cy * map->chunks_x + cx];
+}
+
+inline Tile_Chunk *resident_chunk(Tilemap *map, i32 cx, i32 cy)
+{
+	i32 slot = resident_slot(map, cx, cy);
+	return slot == TILE_NOT_RESIDENT ? nullptr : &map->chunks[slot];
+}
+
+// nullptr when the tile's chunk isn't resident, the tile has to be in bounds
+inline Tile_Chunk *tile_chunk(Tilemap *map, i32 x, i32 y)
+{
+	return resident_chunk(map, x / TILE_CHUNK_SIZE, y / TILE_CHUNK_SIZE);
+}
+
+inline i32 tile_index_in_chunk(i32 x, i32 y)
+{
+	return (y % TILE_CHUNK_SIZE) * TILE_CHUNK_SIZE + x % TILE_CHUNK_SIZE;
+}
+
+// Outside the map is empty
+inline Tile_Kind get_tile(Tilemap *map, i32 x, i32 y)
+{
+	if (!tile_in_bounds(map, x, y))
+		return TILE_EMPTY;
+	Tile_Chunk *chunk = tile_chunk(map, x, y);
+	return chunk ? chunk->tiles[tile_index_in_chunk(x, y)] : TILE_EMPTY;
+}
+
+inline V2i tile_cell(Tilemap *map, V2 pos)
+{
+	V2 cell = (pos - map->origin) / (r32) TILE_SIZE;
+	return V2i((i32) floorf(cell.x), (i32) floorf(cell.y));
+}
+
+u8 compute_tile_mask(Tilemap *map, i32 x, i32 y)
+{
+	Tile_Kind kind = get_tile(map, x, y);
+	u8 mask = 0;
+	if (get_tile(map, x, y - 1) == kind) mask |= TILE_NEIGHBOUR_UP;
+	if (get_tile(map, x + 1, y) == kind) mask |= TILE_NEIGHBOUR_RIGHT;
+	if (get_tile(map, x, y + 1) == kind) mask |= TILE_NEIGHBOUR_DOWN;
+	if (get_tile(map, x - 1, y) == kind) mask |= TILE_NEIGHBOUR_LEFT;
+	return mask;
+}
+
+void update_tile_mask(Tilemap *map, i32 x, i32 y)
+{
+	if (!tile_in_bounds(map, x, y))
+		return;
+	Tile_Chunk *chunk = tile_chunk(map, x, y);
+	if (!chunk)
+		return;
+	u8 *mask = &chunk->masks[tile_index_in_chunk(x, y)];
+	u8 new_mask = compute_tile_mask(map, x, y);
+	if (*mask != new_mask) {
+		*mask = new_mask;
+		touch_chunk(map, chunk);
+	}
+}
+
+// Returns whether the tile changed, tiles of chunks that aren't resident can't be set. Only the
+// tile and its neighbours get their masks updated, a neighbour across a chunk border changes that
+// chunk too
+bool set_tile(Tilemap *map, i32 x, i32 y, Tile_Kind kind)
+{
+	if (!tile_in_bounds(map, x, y))
+		return false;
+	Tile_Chunk *chunk = tile_chunk(map, x, y);
+	if (!chunk)
+		return false;
+	Tile_Kind *tile = &chunk->tiles[tile_index_in_chunk(x, y)];
+	if (*tile == kind)
+		return false;
+	chunk->tile_count += (kind != TILE_EMPTY) - (*tile != TILE_EMPTY);
+	*tile = kind;
+	touch_chunk(map, chunk);
+	chunk->modified = true;
+
+	update_tile_mask(map, x, y);
+	update_tile_mask(map, x, y - 1);
+	update_tile_mask(map, x + 1, y);
+	update_tile_mask(map, x, y + 1);
+	update_tile_mask(map, x - 1, y);
+	return true;
+}
+
+// Updates the masks along the borders of the chunks around (cx, cy), which see its tiles
+void autotile_chunk_neighbours(Tilemap *map, i32 cx, i32 cy)
+{
+	i32 x0 = cx * TILE_CHUNK_SIZE, y0 = cy * TILE_CHUNK_SIZE;
+	for (i32 i = 0; i < TILE_CHUNK_SIZE; ++i) {
+		update_tile_mask(map, x0 + i, y0 - 1);
+		update_tile_mask(map, x0 + i, y0 + TILE_CHUNK_SIZE);
+		update_tile_mask(map, x0 - 1, y0 + i);
+		update_tile_mask(map, x0 + TILE_CHUNK_SIZE, y0 + i);
+	}
+}
+
+// Recomputes the masks and count of the chunk, after its tiles were written directly
+void autotile_chunk(Tilemap *map, i32 cx, i32 cy)
+{
+	Tile_Chunk *chunk = resident_chunk(map, cx, cy);
+	assert(chunk);
+	i32 x0 = cx * TILE_CHUNK_SIZE, y0 = cy * TILE_CHUNK_SIZE;
+	chunk->tile_count = 0;
+	for (i32 y = y0; y < y0 + TILE_CHUNK_SIZE; ++y) {
+		for (i32 x = x0; x < x0 + TILE_CHUNK_SIZE; ++x) {
+			i32 i = tile_index_in_chunk(x, y);
+			chunk->masks[i] = compute_tile_mask(map, x, y);
+			chunk->tile_count += chunk->tiles[i] != TILE_EMPTY;
+		}
+	}
+	touch_chunk(map, chunk);
+	autotile_chunk_neighbours(map, cx, cy);
+}
+
+void autotile_tilemap(Tilemap *map)
+{
+	for (i32 i = 0; i < map->chunk_capacity; ++i) {
+		i32 index = map->chunks[i].index;
+		if (index != TILE_NOT_RESIDENT)
+			autotile_chunk(map, index % map->chunks_x, index / map->chunks_x);
+	}
+}
+
+// Gives chunk (cx, cy) a slot, with every tile empty. Returns nullptr when all the slots are taken
+Tile_Chunk *add_resident_chunk(Tilemap *map, i32 cx, i32 cy)
+{
+	i32 index = cy * map->chunks_x + cx;
+	assert(map->resident[index] == TILE_NOT_RESIDENT);
+	for (i32 slot = 0; slot < map->chunk_capacity; ++slot) {
+		Tile_Chunk *chunk = &map->chunks[slot];
+		if (chunk->index != TILE_NOT_RESIDENT)
+			continue;
+		SDL_memset(chunk->tiles, 0, sizeof(chunk->tiles));
+		SDL_memset(chunk->masks, 0, sizeof(chunk->masks));
+		chunk->index = index;
+		chunk->tile_count = 0;
+		touch_chunk(map, chunk);
+		chunk->modified = false;
+		map->resident[index] = slot;
+		map->resident_count++;
+		return chunk;
+	}
+	return nullptr;
+}
+
+void remove_resident_chunk(Tilemap *map, i32 cx, i32 cy)
+{
+	i32 index = cy * map->chunks_x + cx;
+	i32 slot = map->resident[index];
+	assert(slot != TILE_NOT_RESIDENT);
+	Tile_Chunk *chunk = &map->chunks[slot];
+	// its texture stays in the cache until it is needed for something else, it is still good if
+	// the chunk comes back without changes
+	chunk->index = TILE_NOT_RESIDENT;
+	map->resident[index] = TILE_NOT_RESIDENT;
+	map->resident_count--;
+	// the neighbours now see empty tiles there
+	autotile_chunk_neighbours(map, cx, cy);
+}
+
+// For maps that are in memory as a whole, like while generating one
+void make_all_chunks_resident(Tilemap *map)
+{
+	assert(map->chunk_capacity >= map->chunks_x * map->chunks_y);
+	for (i32 cy = 0; cy < map->chunks_y; ++cy) {
+		for (i32 cx = 0; cx < map->chunks_x; ++cx) {
+			if (resident_slot(map, cx, cy) == TILE_NOT_RESIDENT)
+				add_resident_chunk(map, cx, cy);
+		}
+	}
+}
+
+// Floor everywhere with cave walls grown by cellular automata: start from random walls, then a
+// few times over, every tile becomes a wall when most of its neighbours are walls. Tiles within
+// clear_radius of clear_center stay open. Every chunk has to be resident
+void generate_cave_tilemap(Tilemap *map, Memory_Arena *arena, Random_Series *random, r32 fill, i32 steps,
+						   V2 clear_center, r32 clear_radius)
+{
+	Temp_Memory temp = begin_temp_memory(arena);
+	Defer(end_temp_memory(temp));
+
+	assert(map->resident_count == map->chunks_x * map->chunks_y);
+	i32 width = map->width, height = map->height;
+	u8 *walls = PushArrayNoZero(arena, u8, width * height);
+	u8 *next = PushArrayNoZero(arena, u8, width * height);
+	V2i clear = tile_cell(map, clear_center);
+	r32 clear_tiles = clear_radius / TILE_SIZE;
+	auto is_cleared = [&] (i32 x, i32 y) {
+		r32 dx = (r32) (x - clear.x), dy = (r32) (y - clear.y);
+		return dx * dx + dy * dy < clear_tiles * clear_tiles;
+	};
+
+	for (i32 y = 0; y < height; ++y) {
+		for (i32 x = 0; x < width; ++x) {
+			bool border = x == 0 || y == 0 || x == width - 1 || y == height - 1;
+			walls[y * width + x] = border || (!is_cleared(x, y) && random_unilateral(random) < fill);
+		}
+	}
+
+	for (i32 step = 0; step < steps; ++step) {
+		for (i32 y = 0; y < height; ++y) {
+			for (i32 x = 0; x < width; ++x) {
+				i32 neighbours = 0;
+				for (i32 dy = -1; dy <= 1; ++dy) {
+					for (i32 dx = -1; dx <= 1; ++dx) {
+						i32 nx = x + dx, ny = y + dy;
+						// outside counts as wall so that the caves close at the border
+						if (nx < 0 || ny < 0 || nx >= width || ny >= height)
+							neighbours++;
+						else if (dx || dy)
+							neighbours += walls[ny * width + nx];
+					}
+				}
+				bool wall = walls[y * width + x] ? neighbours >= 4 : neighbours >= 5;
+				next[y * width + x] = wall && !is_cleared(x, y);
+			}
+		}
+		u8 *swap = walls;
+		walls = next;
+		next = swap;
+	}
+
+	for (i32 y = 0; y < height; ++y) {
+		for (i32 x = 0; x < width; ++x) {
+			tile_chunk(map, x, y)->tiles[tile_index_in_chunk(x, y)] = walls[y * width + x] ? TILE_WALL : TILE_FLOOR;
+		}
+	}
+	autotile_tilemap(map);
+}
+
+// Blocks the navigation cells under blocking tiles in [min, max], the grid has to line up with the map
+void tiles_to_nav_grid(Tilemap *map, Nav_Grid *grid, V2i min, V2i max)
+{
+	assert(grid->width == map->width && grid->height == map->height && grid->cell_size == TILE_SIZE);
+	for (i32 y = Max(min.y, 0); y <= Min(max.y, map->height - 1); ++y) {
+		for (i32 x = Max(min.x, 0); x <= Min(max.x, map->width - 1); ++x) {
+			grid->blocked[y * grid->width + x] = tile_types[get_tile(map, x, y)].blocks;
+		}
+	}
+}
+
+////////////////////////////////////////
+//				Rendering
+
+// One row per kind, one column per mask. Edges are drawn on the sides without a neighbour of the
+// same kind
+SDL_Texture *create_tileset_texture(SDL_Renderer *renderer, Memory_Arena *arena)
+{
+	constexpr i32 width = TILE_SIZE * 16;
+	constexpr i32 height = TILE_SIZE * COUNT_TILE_KIND;
+	constexpr i32 edge = 4;
+	Temp_Memory temp = begin_temp_memory(arena);
+	Defer(end_temp_memory(temp));
+
+	u32 *pixels = PushArrayNoZero(arena, u32, width * height);
+	for (i32 kind = 0; kind < COUNT_TILE_KIND; ++kind) {
+		const Tile_Type *type = &tile_types[kind];
+		for (i32 mask = 0; mask < 16; ++mask) {
+			for (i32 y = 0; y < TILE_SIZE; ++y) {
+				for (i32 x = 0; x < TILE_SIZE; ++x) {
+					bool on_edge = (!(mask & TILE_NEIGHBOUR_UP) && y < edge) ||
+								   (!(mask & TILE_NEIGHBOUR_RIGHT) && x >= TILE_SIZE - edge) ||
+								   (!(mask & TILE_NEIGHBOUR_DOWN) && y >= TILE_SIZE - edge) ||
+								   (!(mask & TILE_NEIGHBOUR_LEFT) && x < edge);
+					u32 color = on_edge ? type->edge_color : type->color;
+					// a faint grid so that single tiles can be told apart
+					if (!on_edge && (x == 0 || y == 0) && (color & 0xff))
+						color = (color & 0xffffff00) | 0xe0;
+					// SDL_PIXELFORMAT_RGBA32 is byte order
+					u8 *pixel = (u8 *) &pixels[(kind * TILE_SIZE + y) * width + mask * TILE_SIZE + x];
+					pixel[0] = (color >> 24) & 0xff;
+					pixel[1] = (color >> 16) & 0xff;
+					pixel[2] = (color >> 8) & 0xff;
+					pixel[3] = color & 0xff;
+				}
+			}
+		}
+	}
+
+	SDL_Texture *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, width, height);
+	if (!texture) {
+		fatal_error(SDL_GetError());
+	}
+	SDL_UpdateTexture(texture, nullptr, pixels, width * 4);
+	SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+	return texture;
+}
+
+void tile_cache_init(Tile_Cache *cache, SDL_Renderer *renderer, Memory_Arena *arena)
+{
+	*cache = {};
+	cache->tileset = create_tileset_texture(renderer, arena);
+	cache->use_cache = SDL_RenderTargetSupported(renderer);
+	if (!cache->use_cache)
+		SDL_Log("Render targets not supported, tiles are drawn one by one");
+	for (i32 i = 0; i < TILE_CACHE_SIZE; ++i) {
+		cache->slots[i].chunk = -1;
+	}
+}
+
+// Has every chunk drawn again, for when the renderer lost the content of its targets
+void invalidate_tile_cache(Tile_Cache *cache)
+{
+	for (i32 i = 0; i < TILE_CACHE_SIZE; ++i) {
+		cache->slots[i].version = 0;
+	}
+}
+
+// Puts the chunks that overlap view (in world space) into the render list. offset takes world
+// positions to the screen
+void render_tilemap(Render_List *list, Tilemap *map, Rect view, V2 offset)
+{
+	V2i min = tile_cell(map, view.min);
+	V2i max = tile_cell(map, view.max);
+	i32 min_x = Max(min.x, 0) / TILE_CHUNK_SIZE, max_x = Min(max.x, map->width - 1) / TILE_CHUNK_SIZE;
+	i32 min_y = Max(min.y, 0) / TILE_CHUNK_SIZE, max_y = Min(max.y, map->height - 1) / TILE_CHUNK_SIZE;
+
+	for (i32 cy = min_y; cy <= max_y && max.y >= 0; ++cy) {
+		for (i32 cx = min_x; cx <= max_x && max.x >= 0; ++cx) {
+			Tile_Chunk *chunk = resident_chunk(map, cx, cy);
+			if (!chunk || chunk->tile_count == 0)
+				continue;
+			Tile_Chunk_Image *image = PushStruct(&list->data, Tile_Chunk_Image);
+			SDL_memcpy(image->tiles, chunk->tiles, sizeof(chunk->tiles));
+			SDL_memcpy(image->masks, chunk->masks, sizeof(chunk->masks));
+			image->chunk = chunk->index;
+			image->version = chunk->version;
+			image->corner = map->origin + V2((r32) cx, (r32) cy) * (r32) TILE_CHUNK_PIXELS + offset;
+			push_command(list, RENDER_TILE_CHUNK)->data = image;
+		}
+	}
+}
+
+////////////////////////////////////////
+//				Render thread side
+
+void draw_chunk_tiles(SDL_Renderer *renderer, Tile_Cache *cache, Tile_Chunk_Image *image, V2 offset)
+{
+	for (i32 y = 0; y < TILE_CHUNK_SIZE; ++y) {
+		for (i32 x = 0; x < TILE_CHUNK_SIZE; ++x) {
+			i32 i = y * TILE_CHUNK_SIZE + x;
+			if (image->tiles[i] == TILE_EMPTY)
+				continue;
+			SDL_Rect src = { image->masks[i] * TILE_SIZE, image->tiles[i] * TILE_SIZE, TILE_SIZE, TILE_SIZE };
+			SDL_FRect dest = { offset.x + x * TILE_SIZE, offset.y + y * TILE_SIZE, TILE_SIZE, TILE_SIZE };
+			SDL_RenderCopyF(renderer, cache->tileset, &src, &dest);
+			cache->stats.tiles_drawn++;
+		}
+	}
+}
+
+// Texture of the chunk, taking the least recently used one if it has none. Returns nullptr when
+// every texture is already on screen this frame
+Tile_Cache_Slot *acquire_chunk_texture(SDL_Renderer *renderer, Tile_Cache *cache, i32 chunk)
+{
+	i32 best = 0;
+	for (i32 i = 0; i < TILE_CACHE_SIZE; ++i) {
+		if (cache->slots[i].chunk == chunk)
+			return &cache->slots[i];
+		if (cache->slots[best].chunk >= 0 && (cache->slots[i].chunk < 0 || cache->slots[i].last_used < cache->slots[best].last_used))
+			best = i;
+	}
+
+	Tile_Cache_Slot *slot = &cache->slots[best];
+	if (slot->chunk >= 0 && slot->last_used == cache->frame)
+		return nullptr;
+	if (!slot->texture) {
+		slot->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, TILE_CHUNK_PIXELS, TILE_CHUNK_PIXELS);
+		if (!slot->texture) {
+			fatal_error(SDL_GetError());
+		}
+		SDL_SetTextureBlendMode(slot->texture, SDL_BLENDMODE_BLEND);
+	}
+	slot->chunk = chunk;
+	slot->version = 0;
+	return slot;
+}
+
+void rebuild_chunk_texture(SDL_Renderer *renderer, Tile_Cache *cache, Tile_Chunk_Image *image, Tile_Cache_Slot *slot)
+{
+	u64 start = SDL_GetPerformanceCounter();
+	SDL_SetRenderTarget(renderer, slot->texture);
+	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+	SDL_RenderClear(renderer);
+	draw_chunk_tiles(renderer, cache, image, V2());
+	SDL_SetRenderTarget(renderer, nullptr);
+	slot->version = image->version;
+
+	r32 ms = counter_to_ms(SDL_GetPerformanceCounter() - start);
+	cache->stats.chunks_rebuilt++;
+	cache->stats.rebuild_ms += ms;
+	cache->stats.peak_rebuild_ms = Max(cache->stats.peak_rebuild_ms, ms);
+}
+
+// Once per render list, before its chunks
+void begin_tile_cache_frame(Tile_Cache *cache)
+{
+	cache->frame++;
+	r32 peak_rebuild_ms = cache->stats.peak_rebuild_ms;
+	cache->stats = {};
+	cache->stats.peak_rebuild_ms = peak_rebuild_ms;
+}
+
+void draw_tile_chunk(SDL_Renderer *renderer, Tile_Cache *cache, Tile_Chunk_Image *image)
+{
+	u64 start = SDL_GetPerformanceCounter();
+	Tile_Cache_Slot *slot = cache->use_cache ? acquire_chunk_texture(renderer, cache, image->chunk) : nullptr;
+	if (slot) {
+		if (slot->version != image->version)
+			rebuild_chunk_texture(renderer, cache, image, slot);
+		slot->last_used = cache->frame;
+		SDL_FRect dest = { image->corner.x, image->corner.y, TILE_CHUNK_PIXELS, TILE_CHUNK_PIXELS };
+		SDL_RenderCopyF(renderer, slot->texture, nullptr, &dest);
+	} else {
+		draw_chunk_tiles(renderer, cache, image, image->corner);
+	}
+	cache->stats.chunks_drawn++;
+	cache->stats.draw_ms += counter_to_ms(SDL_GetPerformanceCounter() - start);
+}
+
+//				Render thread side
+////////////////////////////////////////
+
+//				Rendering
+////////////////////////////////////////
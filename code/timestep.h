@@ -0,0 +1,125 @@
+#pragma once
+
+// Frame scheduling around the fixed timestep.
+//
+// Frames take however long they take and add that to the accumulator, ticks of dt take it out
+// again. What is left is how far the simulation is behind, as a fraction of a tick it is how far
+// to blend from the previous tick's state to the last one when drawing (see Previous_Positions).
+//
+// After a hitch the accumulator could hold seconds, and simulating all of it at once makes the
+// next frame take longer still. At most max_ticks_per_frame run per frame, the rest is dropped:
+// the game slows down instead of spiralling.
+//
+// Pacing is optional, vsync usually does it. With a target frame time the scheduler sleeps most
+// of what is left of the frame and spins the rest, or spins all of it with busy_wait, since
+// SDL_Delay can overshoot by a whole scheduler quantum.
+//
+// In lockstep every frame runs exactly one tick however long it took, and nothing is paced. That
+// is for headless replays, which should go as fast as they can without dropping ticks.
+
+constexpr i32 DEFAULT_MAX_TICKS_PER_FRAME = 8;
+
+struct Frame_Timing {
+	r32 frame_ms;
+	r32 avg_frame_ms;
+	r32 peak_frame_ms;
+	r32 work_ms;		// of the last frame, without the pacing
+	i32 ticks;			// last frame
+	r32 tick_ms;		// simulating them
+	r32 alpha;			// how far the last frame was drawn between two ticks
+	u32 dropped_ticks;	// by the max_ticks_per_frame guard, since the start
+};
+
+struct Frame_Scheduler {
+	r32 tick_rate;		// Hz
+	r32 dt;
+	i32 max_ticks_per_frame;
+	r32 target_frame_ms;	// 0 leaves pacing to vsync
+	bool busy_wait;
+	bool lockstep;
+
+	r32 accumulator;		// seconds the simulation is behind
+	r32 frame_time;			// seconds, of the last frame
+	u64 frame_counter;		// when the frame started
+	u32 frame_ticks;		// the same in SDL_GetTicks() time, which events are stamped with
+	u64 tick_counter;
+	Frame_Timing timing;
+};
+
+void frame_scheduler_init(Frame_Scheduler *scheduler, r32 tick_rate, i32 max_ticks_per_frame)
+{
+	*scheduler = {};
+	scheduler->tick_rate = tick_rate;
+	scheduler->dt = 1.f / tick_rate;
+	scheduler->max_ticks_per_frame = max_ticks_per_frame;
+	scheduler->accumulator = scheduler->dt;
+	scheduler->frame_time = scheduler->dt;
+	scheduler->frame_counter = SDL_GetPerformanceCounter();
+	scheduler->frame_ticks = SDL_GetTicks();
+}
+
+inline void set_tick_rate(Frame_Scheduler *scheduler, r32 tick_rate)
+{
+	scheduler->tick_rate = tick_rate;
+	scheduler->dt = 1.f / tick_rate;
+}
+
+// Where the first tick of this frame starts, in SDL_GetTicks() time
+inline r64 simulation_ticks(Frame_Scheduler *scheduler)
+{
+	return scheduler->frame_ticks - scheduler->accumulator * 1000.0;
+}
+
+inline void begin_ticks(Frame_Scheduler *scheduler)
+{
+	scheduler->timing.ticks = 0;
+	scheduler->tick_counter = SDL_GetPerformanceCounter();
+}
+
+// while (next_tick(scheduler)) simulates whatever the accumulator holds
+bool next_tick(Frame_Scheduler *scheduler)
+{
+	if (scheduler->accumulator < scheduler->dt) {
+		scheduler->timing.tick_ms = counter_to_ms(SDL_GetPerformanceCounter() - scheduler->tick_counter);
+		scheduler->timing.alpha = scheduler->accumulator / scheduler->dt;
+		return false;
+	}
+	scheduler->accumulator -= scheduler->dt;
+	scheduler->timing.ticks++;
+	return true;
+}
+
+// Paces the frame if there is a target, then starts the next one
+void end_frame(Frame_Scheduler *scheduler)
+{
+	Frame_Timing *timing = &scheduler->timing;
+	u64 counter = SDL_GetPerformanceCounter();
+	timing->work_ms = counter_to_ms(counter - scheduler->frame_counter);
+	if (scheduler->target_frame_ms > 0 && !scheduler->lockstep) {
+		r32 remaining_ms = scheduler->target_frame_ms - timing->work_ms;
+		if (!scheduler->busy_wait && remaining_ms > 2.f)
+			SDL_Delay((u32) (remaining_ms - 1.f));
+		do {
+			counter = SDL_GetPerformanceCounter();
+		} while (counter_to_ms(counter - scheduler->frame_counter) < scheduler->target_frame_ms);
+	}
+
+	scheduler->frame_time = (r32) ((r64) (counter - scheduler->frame_counter) / (r64) SDL_GetPerformanceFrequency());
+	scheduler->frame_counter = counter;
+	scheduler->frame_ticks = SDL_GetTicks();
+
+	timing->frame_ms = scheduler->frame_time * 1000.f;
+	timing->avg_frame_ms = timing->avg_frame_ms ? lerp(timing->avg_frame_ms, 0.05f, timing->frame_ms) : timing->frame_ms;
+	timing->peak_frame_ms = Max(timing->peak_frame_ms, timing->frame_ms);
+
+	if (scheduler->lockstep) {
+		scheduler->accumulator = scheduler->dt;
+		return;
+	}
+	scheduler->accumulator += scheduler->frame_time;
+	r32 max_behind = scheduler->max_ticks_per_frame * scheduler->dt;
+	if (scheduler->accumulator > max_behind + scheduler->dt) {
+		timing->dropped_ticks += (u32) ((scheduler->accumulator - max_behind) / scheduler->dt);
+		scheduler->accumulator = max_behind + fmodf(scheduler->accumulator, scheduler->dt);
+	}
+}
@@ -1,5 +1,6 @@
 #define ArrayCount(a) (sizeof(a) / sizeof(*(a)))
 
+#include <stddef.h>
 #include <stdint.h>
 
 typedef uint8_t u8;
@@ -40,4 +41,4 @@ DeferHelper<F> defer_func(F f) {
 //Maybe templatize them?
 #define Max(a, b) ((a) > (b) ? (a) : (b))
 #define Min(a, b) ((a) < (b) ? (a) : (b))
-#define Clamp(a, x, b) (Min(Max((a), (x)), (b))
\ No newline at end of file
+#define Clamp(a, x, b) (Min(Max((a), (x)), (b)))
\ No newline at end of file
@@ -0,0 +1,364 @@
+#pragma once
+
+// Containers: Array_View, growable Array, Small_Array with inline storage and Slot_Map with
+// generational handles.
+//
+// Indexing is bounds checked with assert, so it costs nothing once NDEBUG is defined.
+// All of them are plain structs without destructors, zero initialized containers are valid and
+// empty. Memory comes from an Allocator (see ren_memory.h) and
+// defaults to the heap when none was given.
+
+////////////////////////////////////////
+//				Array_View
+
+template <typename T>
+struct Array_View {
+	imem count;
+	T *data;
+
+	Array_View() : count(0), data(nullptr) {}
+	Array_View(T *_data, imem _count) : count(_count), data(_data) {}
+	template <imem _count> Array_View(T (&a)[_count]) : count(_count), data(a) {}
+
+	T &operator[](imem index) {
+		assert(index >= 0 && index < count);
+		return data[index];
+	}
+	const T &operator[](imem index) const {
+		assert(index >= 0 && index < count);
+		return data[index];
+	}
+	inline T *begin() { return data; }
+	inline T *end() { return data + count; }
+	inline const T *begin() const { return data; }
+	inline const T *end() const { return data + count; }
+};
+
+//				Array_View
+////////////////////////////////////////
+
+////////////////////////////////////////
+//				Array
+
+template <typename T>
+struct Array {
+	imem count;
+	imem allocated;
+	T *data;
+	Allocator allocator;
+
+	T &operator[](imem index) {
+		assert(index >= 0 && index < count);
+		return data[index];
+	}
+	const T &operator[](imem index) const {
+		assert(index >= 0 && index < count);
+		return data[index];
+	}
+	inline T *begin() { return data; }
+	inline T *end() { return data + count; }
+	inline const T *begin() const { return data; }
+	inline const T *end() const { return data + count; }
+
+	operator Array_View<T>() { return Array_View<T>(data, count); }
+};
+
+template <typename T>
+void array_init(Array<T> *array, Allocator allocator, imem reserve = 0)
+{
+	*array = {};
+	array->allocator = allocator;
+	if (reserve > 0) {
+		array->data = (T *) allocate(allocator, reserve * sizeof(T));
+		array->allocated = reserve;
+	}
+}
+
+template <typename T>
+void array_reserve(Array<T> *array, imem count)
+{
+	if (count <= array->allocated)
+		return;
+	if (!array->allocator.proc)
+		array->allocator = heap_allocator();
+	array->data = (T *) reallocate(array->allocator, array->data, array->allocated * sizeof(T), count * sizeof(T));
+	array->allocated = count;
+}
+
+template <typename T>
+inline void array_grow_for(Array<T> *array, imem count)
+{
+	if (count > array->allocated)
+		array_reserve(array, Max(count, Max(array->allocated * 2, (imem) 8)));
+}
+
+template <typename T>
+T *array_add(Array<T> *array, T value)
+{
+	array_grow_for(array, array->count + 1);
+	T *result = array->data + array->count++;
+	*result = value;
+	return result;
+}
+
+// Adds count zeroed elements and returns the first of them
+template <typename T>
+T *array_push(Array<T> *array, imem count = 1)
+{
+	array_grow_for(array, array->count + count);
+	T *result = array->data + array->count;
+	SDL_memset(result, 0, count * sizeof(T));
+	array->count += count;
+	return result;
+}
+
+template <typename T>
+void array_insert(Array<T> *array, imem index, T value)
+{
+	assert(index >= 0 && index <= array->count);
+	array_grow_for(array, array->count + 1);
+	SDL_memmove(array->data + index + 1, array->data + index, (array->count - index) * sizeof(T));
+	array->data[index] = value;
+	array->count++;
+}
+
+template <typename T>
+T array_pop(Array<T> *array)
+{
+	assert(array->count > 0);
+	return array->data[--array->count];
+}
+
+template <typename T>
+inline T &array_last(Array<T> *array)
+{
+	assert(array->count > 0);
+	return array->data[array->count - 1];
+}
+
+// O(1), moves the last element into the hole
+template <typename T>
+void array_remove_unordered(Array<T> *array, imem index)
+{
+	assert(index >= 0 && index < array->count);
+	array->data[index] = array->data[--array->count];
+}
+
+template <typename T>
+void array_remove_ordered(Array<T> *array, imem index)
+{
+	assert(index >= 0 && index < array->count);
+	SDL_memmove(array->data + index, array->data + index + 1, (array->count - index - 1) * sizeof(T));
+	array->count--;
+}
+
+template <typename T>
+inline void array_clear(Array<T> *array)
+{
+	array->count = 0;
+}
+
+template <typename T>
+void array_free(Array<T> *array)
+{
+	if (array->data)
+		deallocate(array->allocator, array->data, array->allocated * sizeof(T));
+	array->data = nullptr;
+	array->count = 0;
+	array->allocated = 0;
+}
+
+//				Array
+////////////////////////////////////////
+
+////////////////////////////////////////
+//				Small_Array
+
+// Keeps up to N elements inline and only goes to the allocator once it outgrows them. Without an
+// allocator it spills to the heap, tagged as small arrays so spills show up in the memory stats.
+// Can't be copied: after a spill both copies would own data
+template <typename T, imem N>
+struct Small_Array {
+	imem count;
+	imem allocated;
+	T *data;
+	Allocator allocator;
+	T storage[N];
+
+	Small_Array() = default;
+	Small_Array(const Small_Array &) = delete;
+	Small_Array &operator=(const Small_Array &) = delete;
+
+	T &operator[](imem index) {
+		assert(index >= 0 && index < count);
+		return items()[index];
+	}
+	const T &operator[](imem index) const {
+		assert(index >= 0 && index < count);
+		return items()[index];
+	}
+	// data is only set once the inline storage was outgrown, storage is used until then
+	inline T *items() { return data ? data : storage; }
+	inline const T *items() const { return data ? data : storage; }
+	inline T *begin() { return items(); }
+	inline T *end() { return items() + count; }
+
+	operator Array_View<T>() { return Array_View<T>(items(), count); }
+};
+
+template <typename T, imem N>
+T *array_add(Small_Array<T, N> *array, T value)
+{
+	imem capacity = array->data ? array->allocated : N;
+	if (array->count + 1 > capacity) {
+		if (!array->allocator.proc)
+			array->allocator = heap_allocator(MEMORY_TAG_SMALL_ARRAYS);
+		imem new_capacity = capacity * 2;
+		if (array->data) {
+			array->data = (T *) reallocate(array->allocator, array->data, capacity * sizeof(T), new_capacity * sizeof(T));
+		} else {
+			array->data = (T *) allocate(array->allocator, new_capacity * sizeof(T));
+			SDL_memcpy(array->data, array->storage, array->count * sizeof(T));
+		}
+		array->allocated = new_capacity;
+	}
+	T *result = array->items() + array->count++;
+	*result = value;
+	return result;
+}
+
+template <typename T, imem N>
+void array_remove_unordered(Small_Array<T, N> *array, imem index)
+{
+	assert(index >= 0 && index < array->count);
+	T *items = array->items();
+	items[index] = items[--array->count];
+}
+
+template <typename T, imem N>
+inline void array_clear(Small_Array<T, N> *array)
+{
+	array->count = 0;
+}
+
+template <typename T, imem N>
+void array_free(Small_Array<T, N> *array)
+{
+	if (array->data)
+		deallocate(array->allocator, array->data, array->allocated * sizeof(T));
+	array->data = nullptr;
+	array->count = 0;
+	array->allocated = 0;
+}
+
+//				Small_Array
+////////////////////////////////////////
+
+////////////////////////////////////////
+//				Slot_Map
+
+// Generation 0 is never handed out, so a zero initialized handle is always invalid
+struct Handle {
+	u32 index;
+	u32 generation;
+};
+
+inline bool operator==(Handle a, Handle b) { return a.index == b.index && a.generation == b.generation; }
+inline bool operator!=(Handle a, Handle b) { return !(a == b); }
+
+constexpr u32 SLOT_MAP_NO_SLOT = 0xffffffff;
+
+// Handles stay valid until their item is removed and are detected as stale afterwards. The
+// items themselves are kept densely packed (removal moves the last item into the hole) so
+// iterating over them is a linear walk over items
+template <typename T>
+struct Slot_Map {
+	struct Slot {
+		u32 dense_index;	// or the next free slot while the slot is unused
+		u32 generation;
+	};
+
+	Array<T> items;
+	Array<u32> item_slots;	// slot of each item, needed to fix up a slot when its item moves
+	Array<Slot> slots;
+	u32 free_slot;
+	bool initialized;
+};
+
+template <typename T>
+void slot_map_init(Slot_Map<T> *map, Allocator allocator, imem reserve = 0)
+{
+	*map = {};
+	array_init(&map->items, allocator, reserve);
+	array_init(&map->item_slots, allocator, reserve);
+	array_init(&map->slots, allocator, reserve);
+	map->free_slot = SLOT_MAP_NO_SLOT;
+	map->initialized = true;
+}
+
+template <typename T>
+Handle slot_map_add(Slot_Map<T> *map, T value)
+{
+	if (!map->initialized)
+		slot_map_init(map, heap_allocator());
+
+	u32 slot_index = map->free_slot;
+	if (slot_index == SLOT_MAP_NO_SLOT) {
+		slot_index = (u32) map->slots.count;
+		array_add(&map->slots, { 0, 1 });
+	} else {
+		map->free_slot = map->slots[slot_index].dense_index;
+	}
+
+	typename Slot_Map<T>::Slot *slot = &map->slots[slot_index];
+	slot->dense_index = (u32) map->items.count;
+	array_add(&map->items, value);
+	array_add(&map->item_slots, slot_index);
+	return { slot_index, slot->generation };
+}
+
+template <typename T>
+T *slot_map_get(Slot_Map<T> *map, Handle handle)
+{
+	if (handle.index >= (u32) map->slots.count)
+		return nullptr;
+	typename Slot_Map<T>::Slot *slot = &map->slots[handle.index];
+	if (slot->generation != handle.generation)
+		return nullptr;
+	return &map->items[slot->dense_index];
+}
+
+template <typename T>
+bool slot_map_remove(Slot_Map<T> *map, Handle handle)
+{
+	if (!slot_map_get(map, handle))
+		return false;
+
+	typename Slot_Map<T>::Slot *slot = &map->slots[handle.index];
+	u32 dense_index = slot->dense_index;
+	u32 last = (u32) map->items.count - 1;
+	if (dense_index != last) {
+		map->items[dense_index] = map->items[last];
+		map->item_slots[dense_index] = map->item_slots[last];
+		map->slots[map->item_slots[dense_index]].dense_index = dense_index;
+	}
+	map->items.count--;
+	map->item_slots.count--;
+
+	// skip 0 on wrap around so that zeroed handles stay invalid
+	slot->generation = slot->generation + 1 ? slot->generation + 1 : 1;
+	slot->dense_index = map->free_slot;
+	map->free_slot = handle.index;
+	return true;
+}
+
+// Handle of the item at a position in items, for when iterating over them
+template <typename T>
+inline Handle slot_map_handle_at(Slot_Map<T> *map, imem dense_index)
+{
+	u32 slot_index = map->item_slots[dense_index];
+	return { slot_index, map->slots[slot_index].generation };
+}
+
+//				Slot_Map
+////////////////////////////////////////
@@ -3,6 +3,7 @@
 // TODO: Look into how to vectorize everything, or even just replace ren_math.h with an actual maths library
 #include <math.h>
 #include <assert.h>
+#include <stdint.h>
 
 constexpr float PI32 = 3.14159265359f;
 constexpr double PI64 = 3.14159265358979323846;
@@ -14,9 +15,9 @@ struct V2T {
 		T d[2];
 	};
 
-	V2T<T>() : x(), y() {}
-	V2T<T>(T a) : x(a), y(a) {}
-	V2T<T>(T _x, T _y) : x(_x), y(_y) {}
+	V2T() : x(), y() {}
+	V2T(T a) : x(a), y(a) {}
+	V2T(T _x, T _y) : x(_x), y(_y) {}
 
 	T &operator[](int index) {
 		assert(index >= 0 && index < 2);
@@ -36,23 +37,24 @@ template<typename T>
 struct V3T {
 	union {
 		struct { T x, y, z; };
+		// the other members of these alias x and z above, gcc doesn't allow the same name twice
 		struct {
 			V2T<T> xy;
-			T z;
+			T _xy_z;
 		};
 		struct {
-			T x;
+			T _yz_x;
 			V2T<T> yz;
 		};
 		T d[3];
 	};
 
-	V3T<T>() : x(), y(), z() {}
-	V3T<T>(float a) : x(a), y(a), z(a) {}
-	V3T<T>(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
-	V3T<T>(V2T<T> a) : x(a.x), y(a.y), z() {}
-	V3T<T>(V2T<T> a, float b) : x(a.x), y(a.y), z(b) {}
-	V3T<T>(float a, V2T<T> b) : x(a), y(b.x), z(b.y) {}
+	V3T() : x(), y(), z() {}
+	V3T(float a) : x(a), y(a), z(a) {}
+	V3T(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+	V3T(V2T<T> a) : x(a.x), y(a.y), z() {}
+	V3T(V2T<T> a, float b) : x(a.x), y(a.y), z(b) {}
+	V3T(float a, V2T<T> b) : x(a), y(b.x), z(b.y) {}
 
 	T &operator[](int index) {
 		assert(index >= 0 && index < 3);
@@ -162,6 +164,44 @@ T map_range(T r1, T r2, T val, T r3, T r4) {
 	return r3 + (r4 - r3) * (val - r1) / (r2 - r1);
 }
 
+// xorshift64*, cheap and good enough for gameplay and effects. Not thread safe, give every
+// thread its own series
+struct Random_Series {
+	uint64_t state;
+};
+
+inline Random_Series random_seed(uint64_t seed) {
+	return { seed ? seed : 0x9e3779b97f4a7c15ull };
+}
+
+inline uint32_t random_next(Random_Series *series) {
+	uint64_t x = series->state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	series->state = x;
+	return (uint32_t) ((x * 0x2545f4914f6cdd1dull) >> 32);
+}
+
+// [0, 1)
+inline float random_unilateral(Random_Series *series) {
+	return (random_next(series) >> 8) * (1.f / 16777216.f);
+}
+
+// [-1, 1)
+inline float random_bilateral(Random_Series *series) {
+	return 2.f * random_unilateral(series) - 1.f;
+}
+
+inline float random_between(Random_Series *series, float min, float max) {
+	return min + (max - min) * random_unilateral(series);
+}
+
+// [0, count)
+inline int random_choice(Random_Series *series, int count) {
+	return (int) (random_next(series) % (uint32_t) count);
+}
+
 struct Rect {
 	V2 min;
 	V2 max;
@@ -318,9 +358,9 @@ bool gjk(ShapeA s1, ShapeB s2, V2 *points = 0, int* size = 0)
 constexpr int EPA_MAX_POINTS = 256;
 
 template<typename T>
-void insert(T *arr, int &size, int index, T val)
+void insert(T *arr, int &size, int capacity, int index, T val)
 {
-	assert(size + 1 <= EPA_MAX_POINTS);
+	assert(size + 1 <= capacity);
 	for (int i = size - 1; i >= index; i--) {
 		arr[i + 1] = arr[i];
 	}
@@ -328,10 +368,10 @@ void insert(T *arr, int &size, int index, T val)
 	arr[index] = val;
 }
 
-// TODO: make the insertion dynamic
+// points is the scratch space for the expanding polytope, so that callers can hand out memory
+// that is already around (e.g. from a frame arena) instead of putting it on the stack each call
 template<typename ShapeA, typename ShapeB>
-bool epa(ShapeA s1, ShapeB s2, V2 &dist) {
-	V2 points[EPA_MAX_POINTS];
+bool epa(ShapeA s1, ShapeB s2, V2 &dist, V2 *points, int max_points) {
 	int point_count = 0;
 	if (!gjk(s1, s2, points, &point_count))
 		return false;
@@ -369,9 +409,15 @@ bool epa(ShapeA s1, ShapeB s2, V2 &dist) {
 
 		if (fabs(s_distance - min_distance) > 0.001f) {
 			min_distance = INFINITY;
-			insert(points, point_count, min_index, sp);
+			insert(points, point_count, max_points, min_index, sp);
 		}
 	}
 	dist = min_normal * (min_distance + 0.001f);
 	return true;
+}
+
+template<typename ShapeA, typename ShapeB>
+bool epa(ShapeA s1, ShapeB s2, V2 &dist) {
+	V2 points[EPA_MAX_POINTS];
+	return epa(s1, s2, dist, points, EPA_MAX_POINTS);
 }
\ No newline at end of file
@@ -0,0 +1,492 @@
+#pragma once
+
+// Memory arenas, temporary memory markers and fixed size pools.
+//
+// Everything is carved out of a few big blocks that are allocated once at startup, so after
+// that nothing in here calls into the general purpose heap. In DEBUG builds freed memory is
+// filled with a poison pattern so that use after free/reset shows up as garbage instead of
+// silently reading stale but plausible values.
+//
+// Every arena, pool and heap allocation is tagged with the subsystem it belongs to, and live
+// bytes, peak bytes and allocation counts are kept per tag (see get_memory_stats and
+// write_memory_report). The SDL allocation hooks can attribute SDL's own allocations too.
+
+#include <stdlib.h>
+
+#define Kilobytes(n) ((imem) (n) * 1024)
+#define Megabytes(n) (Kilobytes(n) * 1024)
+
+#if defined(DEBUG)
+#define MEMORY_POISON 1
+#else
+#define MEMORY_POISON 0
+#endif
+
+constexpr u8 MEMORY_POISON_FREED = 0xdd;
+constexpr u8 MEMORY_POISON_UNINITIALIZED = 0xcd;
+
+inline void memory_poison(void *ptr, imem size, u8 pattern)
+{
+#if MEMORY_POISON
+	SDL_memset(ptr, pattern, size);
+#endif
+}
+
+inline imem align_up(imem value, imem align)
+{
+	assert((align & (align - 1)) == 0);
+	return (value + align - 1) & ~(align - 1);
+}
+
+////////////////////////////////////////
+//				Tracking
+
+enum Memory_Tag {
+	MEMORY_TAG_UNTAGGED,
+	MEMORY_TAG_ASSETS,
+	MEMORY_TAG_FONTS,
+	MEMORY_TAG_PHYSICS,
+	MEMORY_TAG_FRAME_SCRATCH,
+	MEMORY_TAG_ENTITIES,
+	MEMORY_TAG_PARTICLES,
+	MEMORY_TAG_NAVIGATION,
+	MEMORY_TAG_LEVEL,
+	MEMORY_TAG_SNAPSHOTS,
+	MEMORY_TAG_RENDERING,
+	MEMORY_TAG_PROFILER,
+	MEMORY_TAG_REPLAY,
+	MEMORY_TAG_SMALL_ARRAYS,
+	MEMORY_TAG_SDL,
+
+	COUNT_MEMORY_TAG
+};
+
+const char *memory_tag_names[COUNT_MEMORY_TAG] = {
+	"untagged", "assets", "fonts", "physics", "frame scratch", "entities", "particles", "navigation", "level", "snapshots", "rendering", "profiler", "replay", "small arrays", "sdl",
+};
+
+struct Memory_Stats {
+	i64 live_bytes;
+	i64 peak_bytes;
+	i64 reserved_bytes;		// backing memory of arenas, live_bytes is what's used of it
+	i64 live_allocations;
+	i64 total_allocations;
+};
+
+Memory_Stats memory_stats[COUNT_MEMORY_TAG];
+SDL_SpinLock memory_stats_lock;
+
+void memory_track(Memory_Tag tag, imem bytes, i64 allocations)
+{
+	SDL_AtomicLock(&memory_stats_lock);
+	Memory_Stats *stats = &memory_stats[tag];
+	stats->live_bytes += bytes;
+	stats->peak_bytes = Max(stats->peak_bytes, stats->live_bytes);
+	stats->live_allocations += allocations;
+	if (allocations > 0)
+		stats->total_allocations += allocations;
+	SDL_AtomicUnlock(&memory_stats_lock);
+}
+
+void memory_track_reserve(Memory_Tag tag, imem bytes)
+{
+	SDL_AtomicLock(&memory_stats_lock);
+	memory_stats[tag].reserved_bytes += bytes;
+	SDL_AtomicUnlock(&memory_stats_lock);
+}
+
+Memory_Stats get_memory_stats(Memory_Tag tag)
+{
+	SDL_AtomicLock(&memory_stats_lock);
+	Memory_Stats result = memory_stats[tag];
+	SDL_AtomicUnlock(&memory_stats_lock);
+	return result;
+}
+
+// Heap allocations carry a small header so that frees know what to take off which tag
+struct Heap_Header {
+	imem size;
+	i32 tag;
+	u32 magic;
+};
+
+constexpr u32 HEAP_HEADER_MAGIC = 0x4d454d21;
+static_assert(sizeof(Heap_Header) == 16, "Heap_Header must keep allocations 16 byte aligned");
+
+void *tagged_malloc(Memory_Tag tag, imem size)
+{
+	Heap_Header *header = (Heap_Header *) malloc(sizeof(Heap_Header) + size);
+	if (!header)
+		return nullptr;
+	*header = { size, tag, HEAP_HEADER_MAGIC };
+	memory_track(tag, size, 1);
+	return header + 1;
+}
+
+void tagged_free(void *ptr)
+{
+	if (!ptr)
+		return;
+	Heap_Header *header = (Heap_Header *) ptr - 1;
+	assert(header->magic == HEAP_HEADER_MAGIC);
+	memory_track((Memory_Tag) header->tag, -header->size, -1);
+	header->magic = 0;
+	free(header);
+}
+
+void *tagged_realloc(Memory_Tag tag, void *ptr, imem size)
+{
+	if (!ptr)
+		return tagged_malloc(tag, size);
+	Heap_Header *header = (Heap_Header *) ptr - 1;
+	assert(header->magic == HEAP_HEADER_MAGIC);
+	Heap_Header old = *header;
+	header = (Heap_Header *) realloc(header, sizeof(Heap_Header) + size);
+	if (!header)
+		return nullptr;
+	header->size = size;
+	memory_track((Memory_Tag) old.tag, size - old.size, 0);
+	return header + 1;
+}
+
+// Routes SDL's own allocations through the tracking above. Has to be called before SDL
+// allocates anything at all, so before SDL_Init
+void *sdl_tracked_malloc(size_t size) { return tagged_malloc(MEMORY_TAG_SDL, size); }
+void *sdl_tracked_realloc(void *ptr, size_t size) { return tagged_realloc(MEMORY_TAG_SDL, ptr, size); }
+void sdl_tracked_free(void *ptr) { tagged_free(ptr); }
+void *sdl_tracked_calloc(size_t count, size_t size)
+{
+	void *result = tagged_malloc(MEMORY_TAG_SDL, count * size);
+	if (result)
+		SDL_memset(result, 0, count * size);
+	return result;
+}
+
+bool track_sdl_allocations()
+{
+	return SDL_SetMemoryFunctions(sdl_tracked_malloc, sdl_tracked_calloc, sdl_tracked_realloc, sdl_tracked_free) == 0;
+}
+
+//				Tracking
+////////////////////////////////////////
+
+////////////////////////////////////////
+//				Allocator
+
+enum Allocation_Kind {
+	ALLOCATION_ALLOCATE,
+	ALLOCATION_RESIZE,
+	ALLOCATION_FREE,
+};
+
+typedef void *(*Allocator_Proc)(Allocation_Kind kind, void *ptr, imem old_size, imem new_size, void *context);
+
+// Type erased allocator so that containers don't need to know what they are allocating from
+struct Allocator {
+	Allocator_Proc proc;
+	void *context;
+};
+
+inline void *allocate(Allocator allocator, imem size)
+{
+	return allocator.proc(ALLOCATION_ALLOCATE, nullptr, 0, size, allocator.context);
+}
+
+inline void *reallocate(Allocator allocator, void *ptr, imem old_size, imem new_size)
+{
+	return allocator.proc(ALLOCATION_RESIZE, ptr, old_size, new_size, allocator.context);
+}
+
+inline void deallocate(Allocator allocator, void *ptr, imem size)
+{
+	allocator.proc(ALLOCATION_FREE, ptr, size, 0, allocator.context);
+}
+
+void *heap_allocator_proc(Allocation_Kind kind, void *ptr, imem old_size, imem new_size, void *context)
+{
+	Memory_Tag tag = (Memory_Tag) (intptr_t) context;
+	switch (kind) {
+		case ALLOCATION_ALLOCATE: return tagged_malloc(tag, new_size);
+		case ALLOCATION_RESIZE: return tagged_realloc(tag, ptr, new_size);
+		case ALLOCATION_FREE: tagged_free(ptr); return nullptr;
+	}
+	return nullptr;
+}
+
+inline Allocator heap_allocator(Memory_Tag tag = MEMORY_TAG_UNTAGGED)
+{
+	return { heap_allocator_proc, (void *) (intptr_t) tag };
+}
+
+//				Allocator
+////////////////////////////////////////
+
+////////////////////////////////////////
+//				Arena
+
+struct Memory_Arena {
+	u8 *base;
+	imem size;
+	imem used;
+	imem high_water;
+	imem last;			// offset of the most recent allocation, which can be resized in place
+	i64 allocation_count;
+	i32 temp_count;
+	Memory_Tag tag;
+	const char *name;
+};
+
+// Every arena that was initialized, for write_memory_report
+Memory_Arena *memory_arenas[32];
+i32 memory_arena_count;
+
+void arena_init(Memory_Arena *arena, void *base, imem size, const char *name, Memory_Tag tag)
+{
+	*arena = {};
+	arena->base = (u8 *) base;
+	arena->size = size;
+	arena->last = -1;
+	arena->name = name;
+	arena->tag = tag;
+	memory_poison(arena->base, size, MEMORY_POISON_UNINITIALIZED);
+	memory_track_reserve(tag, size);
+	if (memory_arena_count < (i32) ArrayCount(memory_arenas))
+		memory_arenas[memory_arena_count++] = arena;
+}
+
+// The only heap allocation an arena ever does, meant to be called once at startup.
+// Goes straight to malloc so that tracked SDL allocations don't count it twice
+void arena_create(Memory_Arena *arena, imem size, const char *name, Memory_Tag tag)
+{
+	void *base = malloc(size);
+	if (!base) {
+		fatal_error("Could not allocate memory for an arena");
+	}
+	arena_init(arena, base, size, name, tag);
+}
+
+void *arena_push(Memory_Arena *arena, imem size, imem align = 16)
+{
+	imem start = align_up((imem) arena->base + arena->used, align) - (imem) arena->base;
+	if (start + size > arena->size) {
+		SDL_Log("Arena %s is out of memory (%lld of %lld bytes used, %lld requested)", arena->name,
+				(long long) arena->used, (long long) arena->size, (long long) size);
+		fatal_error("Arena is out of memory");
+	}
+	memory_track(arena->tag, start + size - arena->used, 1);
+	arena->allocation_count++;
+	arena->last = start;
+	arena->used = start + size;
+	arena->high_water = Max(arena->high_water, arena->used);
+	return arena->base + start;
+}
+
+void *arena_push_zero(Memory_Arena *arena, imem size, imem align = 16)
+{
+	void *result = arena_push(arena, size, align);
+	SDL_memset(result, 0, size);
+	return result;
+}
+
+#define PushStruct(arena, type) ((type *) arena_push_zero((arena), sizeof(type), alignof(type)))
+#define PushArray(arena, type, count) ((type *) arena_push_zero((arena), sizeof(type) * (count), alignof(type)))
+#define PushArrayNoZero(arena, type, count) ((type *) arena_push((arena), sizeof(type) * (count), alignof(type)))
+
+// Grows (or shrinks) the last allocation in place, otherwise moves it to the top of the arena
+void *arena_resize(Memory_Arena *arena, void *ptr, imem old_size, imem new_size, imem align = 16)
+{
+	if (ptr && (u8 *) ptr == arena->base + arena->last && arena->last + new_size <= arena->size) {
+		if (new_size < old_size)
+			memory_poison((u8 *) ptr + new_size, old_size - new_size, MEMORY_POISON_FREED);
+		memory_track(arena->tag, arena->last + new_size - arena->used, 0);
+		arena->used = arena->last + new_size;
+		arena->high_water = Max(arena->high_water, arena->used);
+		return ptr;
+	}
+	void *result = arena_push(arena, new_size, align);
+	if (ptr)
+		SDL_memcpy(result, ptr, Min(old_size, new_size));
+	return result;
+}
+
+void arena_reset(Memory_Arena *arena)
+{
+	assert(arena->temp_count == 0);
+	memory_poison(arena->base, arena->used, MEMORY_POISON_FREED);
+	memory_track(arena->tag, -arena->used, -arena->allocation_count);
+	arena->used = 0;
+	arena->last = -1;
+	arena->allocation_count = 0;
+}
+
+String arena_push_string(Memory_Arena *arena, String string)
+{
+	u8 *data = PushArrayNoZero(arena, u8, string.len + 1);
+	SDL_memcpy(data, string.data, string.len);
+	data[string.len] = 0;
+	return String(data, string.len);
+}
+
+void *arena_allocator_proc(Allocation_Kind kind, void *ptr, imem old_size, imem new_size, void *context)
+{
+	Memory_Arena *arena = (Memory_Arena *) context;
+	switch (kind) {
+		case ALLOCATION_ALLOCATE: return arena_push(arena, new_size);
+		case ALLOCATION_RESIZE: return arena_resize(arena, ptr, old_size, new_size);
+		case ALLOCATION_FREE: {
+			// only the last allocation can actually be given back
+			if ((u8 *) ptr == arena->base + arena->last) {
+				memory_poison(ptr, old_size, MEMORY_POISON_FREED);
+				memory_track(arena->tag, arena->last - arena->used, -1);
+				arena->used = arena->last;
+				arena->last = -1;
+				arena->allocation_count--;
+			}
+		} return nullptr;
+	}
+	return nullptr;
+}
+
+inline Allocator arena_allocator(Memory_Arena *arena)
+{
+	return { arena_allocator_proc, arena };
+}
+
+// Everything pushed onto the arena between begin and end is freed again by end
+struct Temp_Memory {
+	Memory_Arena *arena;
+	imem used;
+	imem last;
+	i64 allocation_count;
+};
+
+Temp_Memory begin_temp_memory(Memory_Arena *arena)
+{
+	arena->temp_count++;
+	return { arena, arena->used, arena->last, arena->allocation_count };
+}
+
+void end_temp_memory(Temp_Memory temp)
+{
+	Memory_Arena *arena = temp.arena;
+	assert(arena->temp_count > 0 && arena->used >= temp.used);
+	memory_poison(arena->base + temp.used, arena->used - temp.used, MEMORY_POISON_FREED);
+	memory_track(arena->tag, temp.used - arena->used, temp.allocation_count - arena->allocation_count);
+	arena->used = temp.used;
+	arena->last = temp.last;
+	arena->allocation_count = temp.allocation_count;
+	arena->temp_count--;
+}
+
+// Keeps everything allocated since begin_temp_memory, e.g. once loading something succeeded
+void commit_temp_memory(Temp_Memory temp)
+{
+	assert(temp.arena->temp_count > 0);
+	temp.arena->temp_count--;
+}
+
+void log_arena_usage(Memory_Arena *arena)
+{
+	SDL_Log("Arena %-10s %8.2f KB used, %8.2f KB high water, %8.2f KB reserved", arena->name,
+			arena->used / 1024.0, arena->high_water / 1024.0, arena->size / 1024.0);
+}
+
+//				Arena
+////////////////////////////////////////
+
+////////////////////////////////////////
+//				Pool
+
+// Fixed size blocks with an intrusive free list, for objects that come and go in any order
+struct Memory_Pool {
+	u8 *blocks;
+	imem block_size;
+	i32 block_count;
+	i32 used;
+	i32 high_water;
+	Memory_Tag tag;
+	void *free_list;
+};
+
+// The blocks are counted as live bytes of the arena they come from, the pool's tag only counts
+// how many of them are handed out
+void pool_init(Memory_Pool *pool, Memory_Arena *arena, imem block_size, i32 block_count, Memory_Tag tag)
+{
+	*pool = {};
+	pool->tag = tag;
+	pool->block_size = align_up(Max(block_size, (imem) sizeof(void *)), 16);
+	pool->block_count = block_count;
+	pool->blocks = (u8 *) arena_push(arena, pool->block_size * block_count);
+	for (i32 i = block_count - 1; i >= 0; --i) {
+		void **block = (void **) (pool->blocks + i * pool->block_size);
+		*block = pool->free_list;
+		pool->free_list = block;
+	}
+}
+
+void *pool_alloc(Memory_Pool *pool)
+{
+	void **block = (void **) pool->free_list;
+	if (!block)
+		return nullptr;
+	pool->free_list = *block;
+	pool->used++;
+	pool->high_water = Max(pool->high_water, pool->used);
+	memory_track(pool->tag, 0, 1);
+	memory_poison(block, pool->block_size, MEMORY_POISON_UNINITIALIZED);
+	return block;
+}
+
+void pool_free(Memory_Pool *pool, void *ptr)
+{
+	if (!ptr)
+		return;
+	assert((u8 *) ptr >= pool->blocks && (u8 *) ptr < pool->blocks + pool->block_size * pool->block_count);
+	assert(((u8 *) ptr - pool->blocks) % pool->block_size == 0);
+	memory_poison(ptr, pool->block_size, MEMORY_POISON_FREED);
+	void **block = (void **) ptr;
+	*block = pool->free_list;
+	pool->free_list = block;
+	pool->used--;
+	memory_track(pool->tag, 0, -1);
+}
+
+//				Pool
+////////////////////////////////////////
+
+////////////////////////////////////////
+//				Report
+
+bool write_memory_report(SDL_RWops *out)
+{
+	Text_Writer writer = { out };
+
+	write_text(&writer, "%-14s %14s %14s %14s %12s %12s\n", "tag", "live bytes", "peak bytes", "reserved", "live allocs", "total allocs");
+	for (i32 i = 0; i < COUNT_MEMORY_TAG; ++i) {
+		Memory_Stats stats = get_memory_stats((Memory_Tag) i);
+		write_text(&writer, "%-14s %14lld %14lld %14lld %12lld %12lld\n", memory_tag_names[i],
+				   (long long) stats.live_bytes, (long long) stats.peak_bytes, (long long) stats.reserved_bytes,
+				   (long long) stats.live_allocations, (long long) stats.total_allocations);
+	}
+
+	write_text(&writer, "\n%-14s %-14s %14s %14s %14s\n", "arena", "tag", "used", "high water", "size");
+	for (i32 i = 0; i < memory_arena_count; ++i) {
+		Memory_Arena *arena = memory_arenas[i];
+		write_text(&writer, "%-14s %-14s %14lld %14lld %14lld\n", arena->name, memory_tag_names[arena->tag],
+				   (long long) arena->used, (long long) arena->high_water, (long long) arena->size);
+	}
+	return !writer.failed;
+}
+
+bool dump_memory_report(const char *path)
+{
+	SDL_RWops *out = SDL_RWFromFile(path, "wb");
+	if (!out)
+		return false;
+	bool ok = write_memory_report(out);
+	SDL_RWclose(out);
+	return ok;
+}
+
+//				Report
+////////////////////////////////////////
@@ -0,0 +1,75 @@
+#pragma once
+
+// Thin wrapper over whatever float SIMD the target has, so that kernels over SoA arrays can be
+// written once. Wide is 8 lanes of AVX when the compiler targets it (/arch:AVX, -mavx), 4 lanes
+// of SSE2 (always there on x64) or a plain float everywhere else.
+//
+// Loads and stores are aligned: arrays have to start at a multiple of WIDE_ALIGN and be padded
+// to a multiple of WIDE_LANES (see wide_padded).
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define WIDE_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WIDE_SSE 1
+#endif
+
+// gcc and clang have the arithmetic operators on vector types built in, MSVC needs them spelled out
+#if defined(_MSC_VER) && !defined(__clang__)
+#define WIDE_OPERATORS 1
+#endif
+
+#if WIDE_AVX
+
+typedef __m256 Wide;
+constexpr int WIDE_LANES = 8;
+constexpr int WIDE_ALIGN = 32;
+
+inline Wide wide_set1(float a)					{ return _mm256_set1_ps(a); }
+inline Wide wide_load(const float *a)			{ return _mm256_load_ps(a); }
+inline void wide_store(float *a, Wide b)		{ _mm256_store_ps(a, b); }
+#if WIDE_OPERATORS
+inline Wide operator+(Wide a, Wide b)			{ return _mm256_add_ps(a, b); }
+inline Wide operator-(Wide a, Wide b)			{ return _mm256_sub_ps(a, b); }
+inline Wide operator*(Wide a, Wide b)			{ return _mm256_mul_ps(a, b); }
+#endif
+inline Wide wide_min(Wide a, Wide b)			{ return _mm256_min_ps(a, b); }
+inline Wide wide_max(Wide a, Wide b)			{ return _mm256_max_ps(a, b); }
+
+#elif WIDE_SSE
+
+typedef __m128 Wide;
+constexpr int WIDE_LANES = 4;
+constexpr int WIDE_ALIGN = 16;
+
+inline Wide wide_set1(float a)					{ return _mm_set1_ps(a); }
+inline Wide wide_load(const float *a)			{ return _mm_load_ps(a); }
+inline void wide_store(float *a, Wide b)		{ _mm_store_ps(a, b); }
+#if WIDE_OPERATORS
+inline Wide operator+(Wide a, Wide b)			{ return _mm_add_ps(a, b); }
+inline Wide operator-(Wide a, Wide b)			{ return _mm_sub_ps(a, b); }
+inline Wide operator*(Wide a, Wide b)			{ return _mm_mul_ps(a, b); }
+#endif
+inline Wide wide_min(Wide a, Wide b)			{ return _mm_min_ps(a, b); }
+inline Wide wide_max(Wide a, Wide b)			{ return _mm_max_ps(a, b); }
+
+#else
+
+typedef float Wide;
+constexpr int WIDE_LANES = 1;
+constexpr int WIDE_ALIGN = 4;
+
+inline Wide wide_set1(float a)					{ return a; }
+inline Wide wide_load(const float *a)			{ return *a; }
+inline void wide_store(float *a, Wide b)		{ *a = b; }
+inline Wide wide_min(Wide a, Wide b)			{ return a < b ? a : b; }
+inline Wide wide_max(Wide a, Wide b)			{ return a > b ? a : b; }
+
+#endif
+
+inline Wide wide_lerp(Wide a, Wide t, Wide b)	{ return a + (b - a) * t; }
+
+inline int wide_padded(int count) {
+	return (count + WIDE_LANES - 1) & ~(WIDE_LANES - 1);
+}
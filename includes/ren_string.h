@@ -37,6 +37,29 @@ bool operator==(String a, String b)
 	return SDL_memcmp(a.data, b.data, a.len) == 0;
 }
 
+// FNV-1a. constexpr so that hashes of string literals can be computed at compile time
+constexpr u32 hash_string(const char *data, imem len)
+{
+	u32 hash = 2166136261u;
+	for (imem i = 0; i < len; ++i) {
+		hash ^= (u8) data[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+constexpr u32 hash_string(const char *data)
+{
+	imem len = 0;
+	while (data[len]) len++;
+	return hash_string(data, len);
+}
+
+u32 hash_string(String a)
+{
+	return hash_string((const char *) a.data, a.len);
+}
+
 String string_substring(String a, i32 start, u32 len)
 {
 	return { a.data + start, len };
@@ -117,6 +140,16 @@ String string_chop_by_delim(String *string, u8 delim) {
 	return result;
 }
 
+// Index of the first occurrence of needle, -1 if there is none
+imem string_find(String haystack, String needle)
+{
+	for (imem i = 0; i + needle.len <= haystack.len; ++i) {
+		if (SDL_memcmp(haystack.data + i, needle.data, needle.len) == 0)
+			return i;
+	}
+	return -1;
+}
+
 bool string_eq_sensitive(String a, String b)
 {
 	if (a.len != b.len) return false;
@@ -159,3 +192,39 @@ r64 string_parse_r64(String a)
 	return result;
 }
 
+
+// Writes printf style text to a file. A line longer than the buffer on the stack is formatted
+// again into one of its size rather than cut off. failed sticks once a write didn't go through
+struct Text_Writer {
+	SDL_RWops *out;
+	bool failed;
+};
+
+void write_text(Text_Writer *writer, const char *format, ...)
+{
+	char line[256];
+	va_list args;
+	va_start(args, format);
+	int length = SDL_vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+	if (length < 0) {
+		writer->failed = true;
+		return;
+	}
+
+	char *text = line;
+	if (length >= (int) sizeof(line)) {
+		text = (char *) SDL_malloc(length + 1);
+		if (!text) {
+			writer->failed = true;
+			return;
+		}
+		va_start(args, format);
+		SDL_vsnprintf(text, length + 1, format, args);
+		va_end(args);
+	}
+	if (SDL_RWwrite(writer->out, text, 1, length) != (size_t) length)
+		writer->failed = true;
+	if (text != line)
+		SDL_free(text);
+}
@@ -1,9 +1,9 @@
 -- premake.lua
 	workspace ("Untitled Game")
-	configurations ({ 
+	configurations ({
 		"Debug", "Release"})
-	platforms {"Win64"}
-	
+	platforms {"Win64", "Linux64"}
+
 	project ("game")
 	kind ("ConsoleApp")
 	language ("C++")
@@ -12,12 +12,44 @@
 	targetdir ("build/%{cfg.buildcfg}/%{cfg.architecture}")
 	-- Intermediate Files
 	objdir("bin/%{cfg.buildcfg}/%{cfg.architecture}")
-	
-	files ({ "**.hpp", "**.cpp", "**.h", "**.c" })
-	links ({"SDL2.lib","SDL2main.lib"})
+
+	-- everything is included from main.cpp
+	files ({ "code/**.cpp", "code/**.h", "includes/**.h" })
 	includedirs ({"extern/includes","includes"})
 	libdirs ({"extern/lib/"})
-	
+
+	filter ("configurations:Debug")
+	defines ({ "DEBUG" })
+	symbols ("On")
+		filter ("configurations:Release")
+		defines ({ "NDEBUG" })
+		optimize ("On")
+
+		filter  ("platforms:Win64")
+		system ("Windows")
+		architecture ("x86_64")
+		links ({"SDL2.lib","SDL2main.lib"})
+
+		filter  ("platforms:Linux64")
+		system ("linux")
+		architecture ("x86_64")
+		links ({"SDL2", "m", "pthread"})
+
+	filter ({})
+
+	-- Headless benchmarks of the hot paths, see bench/bench.cpp. Run it from the repository root
+	-- so that it finds data/, usually as: premake5 gmake2 && make config=release_linux64 bench
+	project ("bench")
+	kind ("ConsoleApp")
+	language ("C++")
+	cppdialect ("C++20")
+	targetdir ("build/%{cfg.buildcfg}/%{cfg.architecture}")
+	objdir("bin/bench/%{cfg.buildcfg}/%{cfg.architecture}")
+
+	files ({ "bench/**.cpp", "bench/**.h" })
+	includedirs ({"extern/includes","includes","code"})
+	libdirs ({"extern/lib/"})
+
 	filter ("configurations:Debug")
 	defines ({ "DEBUG" })
 	symbols ("On")
@@ -25,6 +57,12 @@
 		defines ({ "NDEBUG" })
 		optimize ("On")
 
-		filter  ("platforms:x64") 
+		filter  ("platforms:Win64")
 		system ("Windows")
-		architecture ("x86_64")
\ No newline at end of file
+		architecture ("x86_64")
+		links ({"SDL2.lib"})
+
+		filter  ("platforms:Linux64")
+		system ("linux")
+		architecture ("x86_64")
+		links ({"SDL2", "m", "pthread"})